@@ -17,6 +17,7 @@
 
 /** Shader Wrapper */
 #include <ShaderProgram.h>
+#include <GLState.h>
 
 /** Camera Wrapper */
 #include <EularCamera.h>
@@ -221,12 +222,12 @@ bool initOpenGL() {
 	//glViewport(0, 0, gWindowWidth, gWindowHeight);
 
 	// Configure global OpenGL state	
-	glEnable(GL_DEPTH_TEST);
+	GLState::Shared().Enable(GL_DEPTH_TEST);
 
 	// Blending functionality
-	glEnable(GL_BLEND);
+	GLState::Shared().Enable(GL_BLEND);
 	// Tell OpenGL how to calc colors of blended fragments (pixels)
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::Shared().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	// Hide the cursor and capture it
 	glfwSetInputMode(gWindow, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -17,6 +17,8 @@
 
 /** Shader Wrapper */
 #include <ShaderProgram.h>
+#include <GLState.h>
+#include <StreamBuffer.h>
 
 /** Camera Wrapper */
 #include <EularCamera.h>
@@ -193,6 +195,9 @@ int main() {
 
 
 
+		// This frame's uploads are fenced, the next one writes the next region of the ring
+		StreamBuffer::Shared().EndFrame();
+
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		glfwPollEvents();
 		glfwSwapBuffers(gWindow);
@@ -254,12 +259,12 @@ bool initOpenGL() {
 	//glViewport(0, 0, gWindowWidth, gWindowHeight);
 
 	// Depth testing
-	glEnable(GL_DEPTH_TEST);
+	GLState::Shared().Enable(GL_DEPTH_TEST);
 
 	// Blending
-	glEnable(GL_BLEND);
+	GLState::Shared().Enable(GL_BLEND);
 	glBlendEquation(GL_FUNC_ADD);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::Shared().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	// Hide the cursor and capture it
 	glfwSetInputMode(gWindow, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
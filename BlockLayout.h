@@ -0,0 +1,249 @@
+#ifndef BLOCK_LAYOUT_H
+#define BLOCK_LAYOUT_H
+
+#include <cstddef>
+#include <initializer_list>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+* Uniform / storage block structs declared once, for both C++ and GLSL:
+*
+*   #define POINT_LIGHT_FIELDS(FIELD) \
+*       FIELD(position, glm::vec3)    \
+*       FIELD(constant, float)
+*   BLOCK_STRUCT(PointLight, "Point_Light_t", Std140, POINT_LIGHT_FIELDS);
+*
+* gives a C++ struct whose members sit at their std140 offsets (alignas on each
+* member, so a float after a vec3 still packs into its last 4 bytes), checked
+* against the rules by static_asserts, and its GLSL declaration. Arrays are
+* BlockArray<T, N, Rules>, padded to the array stride of the rules.
+*
+* Supported members: float, int, unsigned int, glm vec2-4 / ivec2-4 / uvec2-4,
+* glm::mat4, BLOCK_STRUCTs and BlockArrays of them. mat3 (three padded columns)
+* and bool (4 bytes in GLSL) have no C++ twin of the right size: use mat4 / int.
+*/
+
+constexpr size_t BlockAlignUp(size_t value, size_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+constexpr size_t BlockMaxAlign(std::initializer_list<size_t> aligns) {
+	size_t result = 1;
+	for (size_t align : aligns)
+		result = align > result ? align : result;
+	return result;
+}
+
+/** Arrays and structs round their alignment up to a vec4 */
+struct Std140 {
+	static const char * Name() { return "std140"; }
+	static constexpr size_t AggregateAlign(size_t align) { return BlockAlignUp(align, 16); }
+};
+
+/** As their members: shader storage blocks only (GL 4.3) */
+struct Std430 {
+	static const char * Name() { return "std430"; }
+	static constexpr size_t AggregateAlign(size_t align) { return align; }
+};
+
+/** GLSL of a block: the structs it needs, dependencies first, then the block itself */
+struct BlockSource {
+	std::vector<std::pair<std::string, std::string>> structs; // name, declaration
+	std::string block;
+
+	void AddStruct(const std::string & name, const std::string & declaration) {
+		for (const auto & known : structs)
+			if (known.first == name)
+				return;
+		structs.emplace_back(name, declaration);
+	}
+};
+
+/**
+* Base alignment, size and GLSL spelling of a member type. BLOCK_STRUCTs answer
+* for themselves, a type that is neither one nor listed below does not compile.
+*/
+template<typename T>
+struct BlockTraits {
+	typedef typename T::Rules Rules;
+	static constexpr size_t Align() { return T::BlockAlign(); }
+	static constexpr size_t Size() { return sizeof(T); }
+	static std::string Type() { return T::GlslName(); }
+	static std::string Suffix() { return ""; }
+	static void Declare(BlockSource & source) { T::Declare(source); }
+};
+
+#define BLOCK_BASIC_TYPE(CppType, GlslType, Alignment)                    \
+	template<>                                                            \
+	struct BlockTraits<CppType> {                                         \
+		typedef void Rules; /* same under every rules */                  \
+		static constexpr size_t Align() { return Alignment; }            \
+		static constexpr size_t Size() { return sizeof(CppType); }       \
+		static std::string Type() { return GlslType; }                   \
+		static std::string Suffix() { return ""; }                       \
+		static void Declare(BlockSource &) {}                            \
+	}
+
+BLOCK_BASIC_TYPE(float,        "float", 4);
+BLOCK_BASIC_TYPE(int,          "int",   4);
+BLOCK_BASIC_TYPE(unsigned int, "uint",  4);
+BLOCK_BASIC_TYPE(glm::vec2,    "vec2",  8);
+BLOCK_BASIC_TYPE(glm::vec3,    "vec3",  16);
+BLOCK_BASIC_TYPE(glm::vec4,    "vec4",  16);
+BLOCK_BASIC_TYPE(glm::ivec2,   "ivec2", 8);
+BLOCK_BASIC_TYPE(glm::ivec3,   "ivec3", 16);
+BLOCK_BASIC_TYPE(glm::ivec4,   "ivec4", 16);
+BLOCK_BASIC_TYPE(glm::uvec2,   "uvec2", 8);
+BLOCK_BASIC_TYPE(glm::uvec3,   "uvec3", 16);
+BLOCK_BASIC_TYPE(glm::uvec4,   "uvec4", 16);
+BLOCK_BASIC_TYPE(glm::mat4,    "mat4",  16);
+
+/** T can sit in a block laid out with Rules */
+template<typename Rules, typename T>
+constexpr bool BlockRulesMatch() {
+	return std::is_same<typename BlockTraits<T>::Rules, void>::value
+		|| std::is_same<typename BlockTraits<T>::Rules, Rules>::value;
+}
+
+template<typename Rules, typename T>
+constexpr size_t BlockArrayAlign() {
+	return Rules::AggregateAlign(BlockTraits<T>::Align());
+}
+
+template<typename Rules, typename T>
+constexpr size_t BlockArrayStride() {
+	return BlockAlignUp(BlockTraits<T>::Size(), BlockArrayAlign<Rules, T>());
+}
+
+/** One array element and the padding up to the stride */
+template<typename T, size_t Stride, bool Padded = (Stride > sizeof(T))>
+struct BlockElement {
+	T value;
+	unsigned char padding[Stride - sizeof(T)];
+};
+
+template<typename T, size_t Stride>
+struct BlockElement<T, Stride, false> {
+	T value;
+};
+
+/** T[N] with the array stride of Rules, e.g. 16 bytes per float under std140 */
+template<typename T, size_t N, typename LayoutRules = Std140>
+struct BlockArray {
+	static_assert(BlockRulesMatch<LayoutRules, T>(), "BlockArray element laid out with other rules");
+
+	typedef LayoutRules Rules;
+
+	BlockElement<T, BlockArrayStride<LayoutRules, T>()> elements[N];
+
+	T & operator[](size_t index) { return elements[index].value; }
+	const T & operator[](size_t index) const { return elements[index].value; }
+	static constexpr size_t size() { return N; }
+};
+
+template<typename T, size_t N, typename LayoutRules>
+struct BlockTraits<BlockArray<T, N, LayoutRules>> {
+	typedef LayoutRules Rules;
+	static constexpr size_t Align() { return BlockArrayAlign<LayoutRules, T>(); }
+	static constexpr size_t Size() { return N * BlockArrayStride<LayoutRules, T>(); }
+	static std::string Type() { return BlockTraits<T>::Type(); }
+	static std::string Suffix() { return "[" + std::to_string(N) + "]"; }
+	static void Declare(BlockSource & source) { BlockTraits<T>::Declare(source); }
+};
+
+/** FIELD(name, type) callbacks of BLOCK_STRUCT, type last so it may hold commas */
+#define BLOCK_FIELD_ALIGN(name, ...)  BlockTraits<__VA_ARGS__>::Align(),
+#define BLOCK_FIELD_MEMBER(name, ...) alignas(BlockTraits<__VA_ARGS__>::Align()) __VA_ARGS__ name;
+#define BLOCK_FIELD_INDEX(name, ...)  name,
+#define BLOCK_FIELD_GLSL(name, ...) \
+	glsl += "\t" + BlockTraits<__VA_ARGS__>::Type() + " " #name + BlockTraits<__VA_ARGS__>::Suffix() + ";\n";
+#define BLOCK_FIELD_DECLARE(name, ...) BlockTraits<__VA_ARGS__>::Declare(source);
+#define BLOCK_FIELD_OFFSET(name, ...)                                   \
+	offset = BlockAlignUp(offset, BlockTraits<__VA_ARGS__>::Align());   \
+	if (index++ == field)                                               \
+		return offset;                                                  \
+	offset += BlockTraits<__VA_ARGS__>::Size();
+#define BLOCK_FIELD_CHECK(name, ...)                                    \
+	static_assert(BlockRulesMatch<Rules, __VA_ARGS__>(),                \
+		#name " is laid out with other rules than its struct");          \
+	static_assert(offsetof(Self, name) == LayoutOffset(Field::name),    \
+		#name " is not at its GLSL offset");
+
+/**
+* struct Type, named GlslType in shaders, members from FIELDS(FIELD) laid out
+* with LayoutRules (Std140 / Std430). LayoutOffset(Field::name) is the offset
+* the rules give, LayoutOffset(Field::Count) the struct size.
+*/
+#define BLOCK_STRUCT(Type, GlslType, LayoutRules, FIELDS)                                   \
+	struct alignas(LayoutRules::AggregateAlign(BlockMaxAlign({ FIELDS(BLOCK_FIELD_ALIGN) 4 }))) Type { \
+		typedef LayoutRules Rules;                                                          \
+		typedef Type Self;                                                                  \
+                                                                                            \
+		FIELDS(BLOCK_FIELD_MEMBER)                                                          \
+                                                                                            \
+		struct Field { enum : size_t { FIELDS(BLOCK_FIELD_INDEX) Count }; };                \
+                                                                                            \
+		static constexpr size_t BlockAlign() {                                              \
+			return LayoutRules::AggregateAlign(BlockMaxAlign({ FIELDS(BLOCK_FIELD_ALIGN) 4 })); \
+		}                                                                                   \
+		static constexpr size_t LayoutOffset(size_t field) {                                \
+			size_t offset = 0, index = 0;                                                   \
+			FIELDS(BLOCK_FIELD_OFFSET)                                                      \
+			return BlockAlignUp(offset, BlockAlign());                                      \
+		}                                                                                   \
+                                                                                            \
+		static const char * GlslName() { return GlslType; }                                 \
+		static std::string GlslMembers() {                                                  \
+			std::string glsl;                                                               \
+			FIELDS(BLOCK_FIELD_GLSL)                                                        \
+			return glsl;                                                                    \
+		}                                                                                   \
+		static void DeclareMembers(BlockSource & source) { FIELDS(BLOCK_FIELD_DECLARE) }   \
+		static void Declare(BlockSource & source) {                                         \
+			DeclareMembers(source);                                                         \
+			source.AddStruct(GlslName(), "struct " + std::string(GlslName()) + " {\n" + GlslMembers() + "};\n"); \
+		}                                                                                   \
+                                                                                            \
+	private:                                                                                \
+		static void checkLayout() {                                                         \
+			FIELDS(BLOCK_FIELD_CHECK)                                                       \
+			static_assert(sizeof(Self) == LayoutOffset(Field::Count),                       \
+				#Type " is not the size of its GLSL struct");                                \
+		}                                                                                   \
+	}
+
+/**
+* GLSL of Block (a BLOCK_STRUCT) as an interface block named name:
+* "layout (std140) uniform name { ... };" after the structs it uses.
+*/
+template<typename Block>
+BlockSource BlockDeclaration(const std::string & name, const char * storage = "uniform") {
+	BlockSource source;
+	Block::DeclareMembers(source);
+	source.block = "layout (" + std::string(Block::Rules::Name()) + ") " + storage + " " + name + " {\n"
+		+ Block::GlslMembers() + "};\n";
+	return source;
+}
+
+/**
+* GLSL of a shader storage block holding one runtime sized array of Element (a
+* Std430 BLOCK_STRUCT or a basic type), at a fixed binding (GL 4.3):
+* "layout (std430, binding = 0) readonly buffer name { Element member[]; };"
+*/
+template<typename Element>
+BlockSource BlockArrayDeclaration(const std::string & name, const std::string & member, int binding,
+	const char * qualifiers = "") {
+	static_assert(BlockRulesMatch<Std430, Element>(), "storage arrays are laid out with Std430");
+	BlockSource source;
+	BlockTraits<Element>::Declare(source);
+	source.block = "layout (std430, binding = " + std::to_string(binding) + ") " + qualifiers
+		+ (*qualifiers ? " " : "") + "buffer " + name + " {\n\t" + BlockTraits<Element>::Type() + " " + member + "[];\n};\n";
+	return source;
+}
+
+#endif
@@ -20,6 +20,8 @@
 
 /** Shader Wrapper */
 #include <ShaderProgram.h>
+#include <GLState.h>
+#include <StreamBuffer.h>
 
 /** Camera Wrapper */
 #include <EularCamera.h>
@@ -89,7 +91,7 @@ void Skybox :: setup() {
 	glGenBuffers(1, &ebo);
 	glGenVertexArrays(1, &vao); // Tell OpenGL to create new Vertex Array Object
 	
-	glBindVertexArray(vao); // Make the vertices buffer the current one
+	GLState::Shared().BindVertexArray(vao); // Make the vertices buffer the current one
 	
 	glBindBuffer(GL_ARRAY_BUFFER, vbo); // "bind" or set as the current buffer we are working with
 	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * skyboxVertices.size(),
@@ -102,7 +104,7 @@ void Skybox :: setup() {
 	glEnableVertexAttribArray(0); // vertex positions
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), NULL);
 
-	glBindVertexArray(0); // Release control of vao
+	GLState::Shared().BindVertexArray(0); // Release control of vao
 }
 
 void Skybox :: Draw(Shader & shader, glm::mat4 & view, glm::mat4 & projection) {
@@ -112,18 +114,18 @@ void Skybox :: Draw(Shader & shader, glm::mat4 & view, glm::mat4 & projection) {
 	shader.setUniform("uProjection", projection);
 	shader.setUniform("uSkybox", 0); // no other texture units
 
-	glDepthMask(GL_FALSE);
-	glDepthFunc(GL_LEQUAL); // change depth func so depth test passes when val == depth buffer
+	GLState::Shared().DepthMask(GL_FALSE);
+	GLState::Shared().DepthFunc(GL_LEQUAL); // change depth func so depth test passes when val == depth buffer
 
-	glBindVertexArray(vao);
-	glActiveTexture(GL_TEXTURE0 + texture_skybox_index);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, tid);
+	GLState::Shared().BindVertexArray(vao);
+	GLState::Shared().ActiveTexture(GL_TEXTURE0 + texture_skybox_index);
+	GLState::Shared().BindTexture(GL_TEXTURE_CUBE_MAP, tid);
 	glDrawElements(GL_TRIANGLES, skyboxElements.size(), GL_UNSIGNED_INT, 0);
 	
-	glBindVertexArray(0); // Unbind
-	glActiveTexture(GL_TEXTURE0);
-	glDepthFunc(GL_LESS); // restore default depth func
-	glDepthMask(GL_TRUE);
+	GLState::Shared().BindVertexArray(0); // Unbind
+	GLState::Shared().ActiveTexture(GL_TEXTURE0);
+	GLState::Shared().DepthFunc(GL_LESS); // restore default depth func
+	GLState::Shared().DepthMask(GL_TRUE);
 }
 
 void Skybox :: LoadTexture(std::vector<std::string> & faces) {
@@ -371,6 +373,9 @@ int main() {
 
 
 
+		// This frame's uploads are fenced, the next one writes the next region of the ring
+		StreamBuffer::Shared().EndFrame();
+
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		glfwPollEvents();
 		glfwSwapBuffers(gWindow);
@@ -432,12 +437,12 @@ bool initOpenGL() {
 	//glViewport(0, 0, gWindowWidth, gWindowHeight);
 
 	// Depth testing
-	glEnable(GL_DEPTH_TEST);
+	GLState::Shared().Enable(GL_DEPTH_TEST);
 
 	// Blending
-	glEnable(GL_BLEND);
+	GLState::Shared().Enable(GL_BLEND);
 	glBlendEquation(GL_FUNC_ADD);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::Shared().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	// Hide the cursor and capture it
 	glfwSetInputMode(gWindow, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -18,13 +18,21 @@
 
 /** Shader Wrapper */
 #include <ShaderProgram.h>
+#include <GLState.h>
+#include <StreamBuffer.h>
+#include <FrameUniforms.h>
 
 /** Camera Wrapper */
 #include <EularCamera.h>
 
 /** Model Wrapper */
 #include <Model.h>
+#include <StreamingModel.h>
 #include <Primitives.h>
+#include <TextureLoader.h>
+#include <TextureCompression.h>
+#include <RenderQueue.h>
+#include <IndirectScene.h>
 
 
 
@@ -40,17 +48,17 @@ public:
 	}
 
 	~FrameBuffer() {
-		glDeleteFramebuffers(1, &fbo);
+		GLState::Shared().DeleteFramebuffers(1, &fbo);
 		glDeleteRenderbuffers(1, &rbo);
 	}
 
 	void Bind() { // bind to framebuffer and draw scene as normally
-		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, fbo);
 	}
 
 	void Unbind() {
 		// now bind back to default framebuffer and draw a quad plane with attached fb color texture
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, 0);
 	}
 
 	unsigned int FBO() { return fbo; }
@@ -74,10 +82,10 @@ void FrameBuffer :: setup() {
 	#endif
 	// Framebuffer config
 	glGenFramebuffers(1, &fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, fbo);
 	// Crete a color attachment texture
 	glGenTextures(1, &tid);
-	glBindTexture(GL_TEXTURE_2D, tid);
+	GLState::Shared().BindTexture(GL_TEXTURE_2D, tid);
 	// set tex dimensions to screen size (for OSX, double screen size)
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, ratio * width, ratio * height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -93,7 +101,7 @@ void FrameBuffer :: setup() {
 	//
 	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 		std::cerr << "ERROR: Framebuffer is not complete!\n";
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 
@@ -114,16 +122,26 @@ void scrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 void glfw_onFramebufferSize(GLFWwindow* window, int width, int height);
 void showFPS(GLFWwindow* window);
 bool initOpenGL();
-void renderScene(Shader & shader);
+void placeModels();
+void renderScene(Shader & shader, const glm::mat4 & view, const glm::mat4 & projection);
 
 // Models
 std::shared_ptr<Model>
 objectCountryhouseModel,
-objectWarehouseModel,
 objectFarmhouseModel,
 objectIndustrialFansModel,
 objectNanosuit,
 objectSphere;
+std::shared_ptr<StreamingModel> objectWarehouseModel; // cut into cells, loaded around the camera
+
+// Placements, fixed for the whole run
+glm::mat4 farmhouseMatrix, warehouseMatrix, countryhouseMatrix, nanosuitMatrix, fanMatrices[4];
+
+// Scene draws, sorted by state each frame
+RenderQueue renderQueue;
+// Static models culled and drawn on the GPU (GL 4.3), the queue takes them without it
+IndirectScene indirectScene;
+std::shared_ptr<Shader> indirectShader;
 
 //-----------------------------------------------------------------------------
 // Main Application Entry Point
@@ -145,18 +163,31 @@ int main() {
 	//Model objectNanosuit("Resources/nanosuit/nanosuit.obj");
 	//Model objectSphere("Resources/sphere/sphere.obj");
 
-	objectCountryhouseModel = std::make_shared<Model>("Resources/CountryHouse/house.obj");
-	objectWarehouseModel = std::make_shared<Model>("Resources/warehouse/warehouse.obj");
-	objectFarmhouseModel = std::make_shared<Model>("Resources/farmhouse/farmhouse.obj");
-	objectIndustrialFansModel = std::make_shared<Model>("Resources/IndustrialFans/IndustrialFans.obj");
-	objectNanosuit = std::make_shared<Model>("Resources/nanosuit/nanosuit.obj");
-	objectSphere = std::make_shared<Model>("Resources/sphere/sphere.obj");
+	// Meshes convert on the worker pool, textures stream in while rendering
+	unsigned int modelFlags = MODEL_PARALLEL | MODEL_ASYNC_TEXTURES | MODEL_OPTIMIZE | MODEL_LOD | MODEL_MESHLETS;
+	objectCountryhouseModel = std::make_shared<Model>("Resources/CountryHouse/house.obj", false, modelFlags);
+	objectWarehouseModel = std::make_shared<StreamingModel>("Resources/warehouse/warehouse.obj", false, modelFlags);
+	objectFarmhouseModel = std::make_shared<Model>("Resources/farmhouse/farmhouse.obj", false, modelFlags);
+	objectIndustrialFansModel = std::make_shared<Model>("Resources/IndustrialFans/IndustrialFans.obj", false, modelFlags);
+	objectNanosuit = std::make_shared<Model>("Resources/nanosuit/nanosuit.obj", false, modelFlags);
+	objectSphere = std::make_shared<Model>("Resources/sphere/sphere.obj", false, modelFlags);
 
 	// Shader loader
 	Shader objectShader("shaders/demo.vert", "shaders/demo.frag");
 	Shader screenShader("shaders/screenshader.vert", "shaders/screenshader.frag");
 	Shader sphereShader("shaders/sphere.vert", "shaders/sphere.frag");
 
+	// Everything but the streamed warehouse (its cells come and go) goes to the GPU once
+	placeModels();
+	if (IndirectScene::Supported()) {
+		indirectShader = std::make_shared<Shader>("shaders/indirect.vert", "shaders/demo.frag");
+		indirectScene.AddModel(*objectFarmhouseModel, farmhouseMatrix);
+		indirectScene.AddModel(*objectCountryhouseModel, countryhouseMatrix);
+		indirectScene.AddModel(*objectNanosuit, nanosuitMatrix);
+		for (int i=0; i<4; i++)
+			indirectScene.AddModel(*objectIndustrialFansModel, fanMatrices[i]);
+	}
+
 	// Framebuffer
 	FrameBuffer framebuffer(gWindowWidth, gWindowHeight);
 	Quad objectQuad;
@@ -172,33 +203,33 @@ int main() {
 	};
 	glm::vec3 directionalLightDirection(1.0f, -1.0f, 0.0f);
 
-	// Object shader config
-	objectShader.use();
-	// Light config
+	// Light config, shared by every shader through the uLights block
+	LightBlock & lights = FrameUniforms::Shared().Lights();
 	// Directional light
-	objectShader.setUniform("uDirectionalLight.direction", directionalLightDirection);
-	objectShader.setUniform("uDirectionalLight.ambient", 0.5f, 0.5f, 0.5f);
-	objectShader.setUniform("uDirectionalLight.diffuse", 1.0f, 1.0f, 1.0f);
-	objectShader.setUniform("uDirectionalLight.specular", 1.0f, 1.0f, 1.0f);
+	lights.uDirectionalLight.direction = directionalLightDirection;
+	lights.uDirectionalLight.ambient = glm::vec3(0.5f, 0.5f, 0.5f);
+	lights.uDirectionalLight.diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+	lights.uDirectionalLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
 	// Point light
 	//for (int i=0; i<4; i++) {
-	//	objectShader.setUniform(("uPointLights[" + std::to_string(i) +"].position").c_str(),  pointLightPos[i]);
-	//	objectShader.setUniform(("uPointLights[" + std::to_string(i) +"].ambient").c_str(),   0.2f, 0.2f, 0.2f);
-	//	objectShader.setUniform(("uPointLights[" + std::to_string(i) +"].diffuse").c_str(),   1.0f, 1.0f, 1.0f);
-	//	objectShader.setUniform(("uPointLights[" + std::to_string(i) +"].specular").c_str(),  1.0f, 1.0f, 1.0f);
-	//	objectShader.setUniform(("uPointLights[" + std::to_string(i) +"].constant").c_str(),  1.0f);
-	//	objectShader.setUniform(("uPointLights[" + std::to_string(i) +"].linear").c_str(),    0.09f);
-	//	objectShader.setUniform(("uPointLights[" + std::to_string(i) +"].quadratic").c_str(), 0.032f);
+	//	lights.uPointLights[i].position = pointLightPos[i];
+	//	lights.uPointLights[i].ambient = glm::vec3(0.2f, 0.2f, 0.2f);
+	//	lights.uPointLights[i].diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+	//	lights.uPointLights[i].specular = glm::vec3(1.0f, 1.0f, 1.0f);
+	//	lights.uPointLights[i].constant = 1.0f;
+	//	lights.uPointLights[i].linear = 0.09f;
+	//	lights.uPointLights[i].quadratic = 0.032f;
 	//}
-	// Spot light
-	objectShader.setUniform("uSpotLight.innerCutOff", glm::cos(glm::radians(12.5f)));
-	objectShader.setUniform("uSpotLight.outerCutOff", glm::cos(glm::radians(17.5f)));
-	objectShader.setUniform("uSpotLight.ambient", 0.0f, 0.0f, 0.0f);
-	objectShader.setUniform("uSpotLight.diffuse", 1.0f, 1.0f, 1.0f);
-	objectShader.setUniform("uSpotLight.specular", 1.0f, 1.0f, 1.0f);
-	objectShader.setUniform("uSpotLight.constant", 1.0f);
-	objectShader.setUniform("uSpotLight.linear", 0.09f);
-	objectShader.setUniform("uSpotLight.quadratic", 0.032f);
+	//lights.uPointLightCount = 4;
+	// Spot light, follows the camera
+	lights.uSpotLight.innerCutOff = glm::cos(glm::radians(12.5f));
+	lights.uSpotLight.outerCutOff = glm::cos(glm::radians(17.5f));
+	lights.uSpotLight.ambient = glm::vec3(0.0f, 0.0f, 0.0f);
+	lights.uSpotLight.diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+	lights.uSpotLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+	lights.uSpotLight.constant = 1.0f;
+	lights.uSpotLight.linear = 0.09f;
+	lights.uSpotLight.quadratic = 0.032f;
 
 
 
@@ -216,6 +247,9 @@ int main() {
 		// Key input
 		processInput(gWindow);
 
+		// Upload textures decoded in the background, 2 ms per frame
+		TextureLoader::Shared().Update(2.0);
+
 
 
 		// Camera transformations
@@ -223,22 +257,20 @@ int main() {
 		projection = glm::perspective(glm::radians(camera.fov), width_height_ratio, 0.1f, 100.0f);
 		//projection = glm::ortho(-1.0f, 1.0f, -1.0f, 1.0f, 1.0f, 100.0f);
 
-		// Set shader(s) and draw model(s)
-		objectShader.use();
-		objectShader.setUniform("uView", view);
-		objectShader.setUniform("uProjection", projection);
-		objectShader.setUniform("uCameraPos", camera.position);
-
-		objectShader.setUniform("uSpotLight.position", camera.position);
-		objectShader.setUniform("uSpotLight.direction", camera.front);
+		// Per-frame engine uniforms: one buffer write for every shader
+		FrameUniforms::Shared().SetCamera(view, projection, camera.position, camera.front);
+		FrameUniforms::Shared().SetTime((float) glfwGetTime());
+		FrameUniforms::Shared().Lights().uSpotLight.position = camera.position;
+		FrameUniforms::Shared().Lights().uSpotLight.direction = camera.front;
+		FrameUniforms::Shared().Update();
 
 		// Draw scene
 		framebuffer.Bind();
-		glEnable(GL_DEPTH_TEST);
+		GLState::Shared().Enable(GL_DEPTH_TEST);
 		//glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		renderScene(objectShader);
+		renderScene(objectShader, view, projection);
 
 		framebuffer.Unbind();
 
@@ -248,8 +280,8 @@ int main() {
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		//screenShader.use();
-		//glActiveTexture(GL_TEXTURE0);
-		//glBindTexture(GL_TEXTURE_2D, framebuffer.TID());
+		//GLState::Shared().ActiveTexture(GL_TEXTURE0);
+		//GLState::Shared().BindTexture(GL_TEXTURE_2D, framebuffer.TID());
 		//screenShader.setUniform("uMaterial.texture1", 0); // load texture manually
 		//modelMatrix = glm::mat4(1.0f);
 		//modelMatrix = glm::translate(modelMatrix, glm::vec3(0.5f, 0.5f, 0.0f));
@@ -260,10 +292,8 @@ int main() {
 		//objectQuad.Draw(screenShader);
 
 		sphereShader.use();
-		sphereShader.setUniform("uView", view);
-		sphereShader.setUniform("uProjection", projection);
-		glActiveTexture(GL_TEXTURE0 + 3);
-		glBindTexture(GL_TEXTURE_2D, framebuffer.TID());
+		GLState::Shared().ActiveTexture(GL_TEXTURE0 + 3);
+		GLState::Shared().BindTexture(GL_TEXTURE_2D, framebuffer.TID());
 		sphereShader.setUniform("sphereMap", 3);
 
 		float degree = (float) glfwGetTime() * glm::radians(10.0f);
@@ -276,9 +306,12 @@ int main() {
 		sphereShader.setUniform("uModel", modelMatrix);
 		objectSphere.get()->Draw(sphereShader);
 
-		renderScene(objectShader);
+		renderScene(objectShader, view, projection);
+
 
 
+		// This frame's uploads are fenced, the next one writes the next region of the ring
+		StreamBuffer::Shared().EndFrame();
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		glfwPollEvents();
@@ -290,50 +323,60 @@ int main() {
 	return 0;
 }
 
-void renderScene(Shader & shader) {
+void placeModels() {
 
-	glm::mat4 modelMatrix;
+	farmhouseMatrix = glm::mat4(1.0f);
+	farmhouseMatrix = glm::translate(farmhouseMatrix, glm::vec3(-30.0f, -5.0f, 0.0f));
+	farmhouseMatrix = glm::rotate(farmhouseMatrix, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 
-	modelMatrix = glm::mat4(1.0f);
-	modelMatrix = glm::translate(modelMatrix, glm::vec3(-30.0f, -5.0f, 0.0f));
-	modelMatrix = glm::rotate(modelMatrix, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-	shader.use();
-	shader.setUniform("uModel", modelMatrix);
-	objectFarmhouseModel.get()->Draw(shader);
-	
-	modelMatrix = glm::mat4(1.0f);
-	modelMatrix = glm::translate(modelMatrix, glm::vec3(30.0f, 0.0f, 0.0f));
-	modelMatrix = glm::scale(modelMatrix, glm::vec3(2.0f, 2.0f, 2.0f));
-	modelMatrix = glm::rotate(modelMatrix, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-	shader.use();
-	shader.setUniform("uModel", modelMatrix);
-	objectWarehouseModel.get()->Draw(shader);
-
-	modelMatrix = glm::mat4(1.0f);
-	modelMatrix = glm::translate(modelMatrix, glm::vec3(10.0f, -5.0f, 0.0f));
-	modelMatrix = glm::scale(modelMatrix, glm::vec3(0.002f, 0.002f, 0.002f));
-	//modelMatrix = glm::rotate(modelMatrix, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-	shader.use();
-	shader.setUniform("uModel", modelMatrix);
-	objectCountryhouseModel.get()->Draw(shader);
-
-	modelMatrix = glm::mat4(1.0f);
-	modelMatrix = glm::translate(modelMatrix, glm::vec3(-4.0f, -1.0f, 25.0f));
-	modelMatrix = glm::scale(modelMatrix, glm::vec3(0.2f, 0.2f, 0.2f));
-	shader.use();
-	shader.setUniform("uModel", modelMatrix);
-	objectNanosuit.get()->Draw(shader);
+	warehouseMatrix = glm::mat4(1.0f);
+	warehouseMatrix = glm::translate(warehouseMatrix, glm::vec3(30.0f, 0.0f, 0.0f));
+	warehouseMatrix = glm::scale(warehouseMatrix, glm::vec3(2.0f, 2.0f, 2.0f));
+	warehouseMatrix = glm::rotate(warehouseMatrix, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+
+	countryhouseMatrix = glm::mat4(1.0f);
+	countryhouseMatrix = glm::translate(countryhouseMatrix, glm::vec3(10.0f, -5.0f, 0.0f));
+	countryhouseMatrix = glm::scale(countryhouseMatrix, glm::vec3(0.002f, 0.002f, 0.002f));
+	//countryhouseMatrix = glm::rotate(countryhouseMatrix, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	nanosuitMatrix = glm::mat4(1.0f);
+	nanosuitMatrix = glm::translate(nanosuitMatrix, glm::vec3(-4.0f, -1.0f, 25.0f));
+	nanosuitMatrix = glm::scale(nanosuitMatrix, glm::vec3(0.2f, 0.2f, 0.2f));
 
 	for (int i=0; i<4; i++) {
-		modelMatrix = glm::mat4(1.0f);
 		glm::vec3 FansPosition(-34.0f + i * 2.5f, -3.5f, 17.0f);
-		modelMatrix = glm::translate(modelMatrix, FansPosition);
-		shader.use();
-		shader.setUniform("uModel", modelMatrix);
-		objectIndustrialFansModel.get()->Draw(shader);
+		fanMatrices[i] = glm::translate(glm::mat4(1.0f), FansPosition);
 	}
 }
 
+void renderScene(Shader & shader, const glm::mat4 & view, const glm::mat4 & projection) {
+
+	renderQueue.Begin(view, projection);
+
+	if (indirectShader) {
+		// One compute dispatch and a multi-draw per page and material, whatever the object count; levels per instance
+		indirectScene.Draw(*indirectShader, projection * view, camera, (float) gWindowHeight);
+	} else {
+		// Packets keep the level picked right before them: each fan draws at its own
+		objectFarmhouseModel.get()->UpdateLod(camera, farmhouseMatrix, (float) gWindowHeight);
+		objectFarmhouseModel.get()->Submit(renderQueue, shader, farmhouseMatrix);
+		objectCountryhouseModel.get()->UpdateLod(camera, countryhouseMatrix, (float) gWindowHeight);
+		objectCountryhouseModel.get()->Submit(renderQueue, shader, countryhouseMatrix);
+		objectNanosuit.get()->UpdateLod(camera, nanosuitMatrix, (float) gWindowHeight);
+		objectNanosuit.get()->Submit(renderQueue, shader, nanosuitMatrix);
+		for (int i=0; i<4; i++) {
+			objectIndustrialFansModel.get()->UpdateLod(camera, fanMatrices[i], (float) gWindowHeight);
+			objectIndustrialFansModel.get()->Submit(renderQueue, shader, fanMatrices[i]);
+		}
+	}
+
+	objectWarehouseModel.get()->Update(camera.position, warehouseMatrix);
+	objectWarehouseModel.get()->UpdateLod(camera, warehouseMatrix, (float) gWindowHeight);
+	objectWarehouseModel.get()->Submit(renderQueue, shader, warehouseMatrix);
+
+	renderQueue.Flush();
+}
+
 //-----------------------------------------------------------------------------
 // Initialize GLFW and OpenGL
 //-----------------------------------------------------------------------------
@@ -347,7 +390,8 @@ bool initOpenGL() {
 		return false;
 	}
 
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	// 4.3 for IndirectScene (compute, storage blocks), 3.3 below
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	// forward compatible with newer versions of OpenGL as they become available
@@ -356,8 +400,13 @@ bool initOpenGL() {
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-	// Create an OpenGL 3.3 core, forward compatible context window
+	// Create an OpenGL 4.3 (else 3.3) core, forward compatible context window
 	gWindow = glfwCreateWindow(gWindowWidth, gWindowHeight, APP_TITLE, NULL, NULL);
+	if (gWindow == NULL) {
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		gWindow = glfwCreateWindow(gWindowWidth, gWindowHeight, APP_TITLE, NULL, NULL);
+	}
 	if (gWindow == NULL) {
 		std::cerr << "Failed to create GLFW window" << std::endl;
 		glfwTerminate();
@@ -379,18 +428,21 @@ bool initOpenGL() {
 		return false;
 	}
 
+	// Block-compressed textures when the driver has S3TC
+	EnableTextureCompression();
+
 	glClearColor(0.3f, 0.3f, 0.3f, 1.0f);
 
 	// Define the viewport dimensions
 	//glViewport(0, 0, gWindowWidth, gWindowHeight);
 
 	// Configure global OpenGL state	
-	glEnable(GL_DEPTH_TEST);
+	GLState::Shared().Enable(GL_DEPTH_TEST);
 
 	// Blending functionality
-	glEnable(GL_BLEND);
+	GLState::Shared().Enable(GL_BLEND);
 	// Tell OpenGL how to calc colors of blended fragments (pixels)
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::Shared().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	// Hide the cursor and capture it
 	glfwSetInputMode(gWindow, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -496,6 +548,8 @@ void showFPS(GLFWwindow* window)
 		previousSeconds = currentSeconds;
 		double fps = (double)frameCount / elapsedSeconds;
 		double msPerFrame = 1000.0 / fps;
+		GLStateStats state = GLState::Shared().Stats();
+		size_t frames = frameCount > 0 ? frameCount : 1;
 
 		// The C++ way of setting the window title
 		std::ostringstream outs;
@@ -503,11 +557,17 @@ void showFPS(GLFWwindow* window)
 		outs << std::fixed
 			<< APP_TITLE << "    "
 			<< "FPS: " << fps << "    "
-			<< "Frame Time: " << msPerFrame << " (ms)";
+			<< "Frame Time: " << msPerFrame << " (ms)    "
+			<< "GL state calls: " << state.calls / frames
+			<< " (" << state.dropped / frames << " dropped)    "
+			<< "Uniforms: " << Shader::UniformCalls() / frames
+			<< " (" << Shader::UniformsDropped() / frames << " dropped)";
 		glfwSetWindowTitle(window, outs.str().c_str());
 
 		// Reset for next average.
 		frameCount = 0;
+		GLState::Shared().ResetStats();
+		Shader::ResetUniformStats();
 	}
 
 	frameCount++;
@@ -17,6 +17,8 @@
 
 /** Shader Wrapper */
 #include <ShaderProgram.h>
+#include <GLState.h>
+#include <StreamBuffer.h>
 
 /** Camera Wrapper */
 #include <EularCamera.h>
@@ -24,6 +26,7 @@
 /** Model Wrapper */
 #include <Model.h>
 #include <Primitives.h>
+#include <RenderQueue.h>
 
 class FrameBuffer {
 public:
@@ -33,17 +36,17 @@ public:
 	}
 
 	~FrameBuffer() {
-		glDeleteFramebuffers(1, &fbo);
+		GLState::Shared().DeleteFramebuffers(1, &fbo);
 		glDeleteRenderbuffers(1, &rbo);
 	}
 
 	void Bind() { // bind to framebuffer and draw scene as normally
-		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, fbo);
 	}
 
 	void Unbind() {
 		// now bind back to default framebuffer and draw a quad plane with attached fb color texture
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, 0);
 	}
 
 	unsigned int FBO() { return fbo; }
@@ -69,11 +72,11 @@ void FrameBuffer :: setup(int width, int height) {
 	height *= display_device_revise;
 	// Framebuffer config
 	glGenFramebuffers(1, &fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, fbo);
 	// Crete a color attachment texture
 	// For this tex, only allocate mem but not fill it. Fill it when to render framebuffer
 	glGenTextures(1, &tid);
-	glBindTexture(GL_TEXTURE_2D, tid);
+	GLState::Shared().BindTexture(GL_TEXTURE_2D, tid);
 	// set tex dimensions to screen size (for OSX, double screen size)
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -94,7 +97,7 @@ void FrameBuffer :: setup(int width, int height) {
 	//
 	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 		std::cerr << "ERROR: Framebuffer is not complete!\n";
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 
@@ -108,6 +111,9 @@ GLFWwindow* gWindow = NULL;
 // Camera system
 Camera camera(glm::vec3(0.0f, 1.0f, 3.0f));
 
+// Scene draws, sorted by state each frame
+RenderQueue renderQueue;
+
 // Function prototypes
 void processInput(GLFWwindow* window);
 void mouseCallback(GLFWwindow* window, double xpos, double ypos);
@@ -221,7 +227,7 @@ int main() {
 		// Draw scene on framebuffer
 		// -------------------------
 		framebuffer.Bind();
-		glEnable(GL_DEPTH_TEST);
+		GLState::Shared().Enable(GL_DEPTH_TEST);
 
 		// Clear the screen of current bound framebuffer
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -239,40 +245,36 @@ int main() {
 
 		glm::mat4 modelMatrix;
 
+		renderQueue.Begin(view, projection);
+
 		modelMatrix = glm::mat4(1.0f);
 		modelMatrix = glm::translate(modelMatrix, glm::vec3(5.0f, 0.0f, -10.0f));
 		modelMatrix = glm::scale(modelMatrix, glm::vec3(0.001f, 0.001f, 0.001f));
-		objectShader.use();
-		objectShader.setUniform("uModel", modelMatrix);
-		objectCountryhouseModel.Draw(objectShader);
+		objectCountryhouseModel.Submit(renderQueue, objectShader, modelMatrix);
 
 		modelMatrix = glm::mat4(1.0f);
 		modelMatrix = glm::translate(modelMatrix, glm::vec3(0.0f, -0.6f, 0.0f));
 		modelMatrix = glm::scale(modelMatrix, glm::vec3(10.0f, 10.0f, 10.0f));
-		objectShader.use();
-		objectShader.setUniform("uModel", modelMatrix);
-		objectPlane.Draw(objectShader);
+		renderQueue.Add(objectPlane, objectShader, modelMatrix);
 
 		float degree = (float)glfwGetTime() * glm::radians(10.0f);
 
 		modelMatrix = glm::mat4(1.0f);
 		modelMatrix = glm::translate(modelMatrix, glm::vec3(-1.0f, 0.0f, 0.0f));
 		modelMatrix = glm::rotate(modelMatrix, degree, glm::vec3(0.0f, 1.0f, 0.0f));
-		objectShader.use();
-		objectShader.setUniform("uModel", modelMatrix);
-		objectCube1.Draw(objectShader);
+		renderQueue.Add(objectCube1, objectShader, modelMatrix);
 
 		modelMatrix = glm::mat4(1.0f);
 		modelMatrix = glm::translate(modelMatrix, glm::vec3( 2.0f, 0.0f, 0.0f));
 		modelMatrix = glm::rotate(modelMatrix, degree, glm::vec3(0.0f, 1.0f, 0.0f));
 		objectCube2.UpdateRenderOrder(camera.position, modelMatrix);
-		objectShader.use();
-		objectShader.setUniform("uModel", modelMatrix);
-		objectCube2.Draw(objectShader); // to see correct blending effect, draw this at the very end
+		renderQueue.Add(objectCube2, objectShader, modelMatrix, RENDER_TRANSPARENT); // blended after every opaque draw
+
+		renderQueue.Flush();
 
 		framebuffer.Unbind();
 		// disable depth test so screen space will not be discarded
-		glDisable(GL_DEPTH_TEST);
+		GLState::Shared().Disable(GL_DEPTH_TEST);
 
 
 
@@ -283,8 +285,8 @@ int main() {
 
 		// draw what has been rendered
 		screenShader.use();
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, framebuffer.TID());
+		GLState::Shared().ActiveTexture(GL_TEXTURE0);
+		GLState::Shared().BindTexture(GL_TEXTURE_2D, framebuffer.TID());
 		screenShader.setUniform("uMaterial.texture1", 0); // load texture manually
 
 		modelMatrix = glm::mat4(1.0f);
@@ -321,6 +323,9 @@ int main() {
 
 
 
+		// This frame's uploads are fenced, the next one writes the next region of the ring
+		StreamBuffer::Shared().EndFrame();
+
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		glfwPollEvents();
 		glfwSwapBuffers(gWindow);
@@ -382,12 +387,12 @@ bool initOpenGL() {
 	//glViewport(0, 0, gWindowWidth, gWindowHeight);
 
 	// Depth testing
-	glEnable(GL_DEPTH_TEST);
+	GLState::Shared().Enable(GL_DEPTH_TEST);
 
 	// Blending
-	glEnable(GL_BLEND);
+	GLState::Shared().Enable(GL_BLEND);
 	glBlendEquation(GL_FUNC_ADD);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::Shared().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	// Hide the cursor and capture it
 	glfwSetInputMode(gWindow, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
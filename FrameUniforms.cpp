@@ -0,0 +1,72 @@
+#include <FrameUniforms.h>
+#include <StreamBuffer.h>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstring>
+
+// Layouts are checked by BLOCK_STRUCT, these are the sizes the shaders were written for
+static_assert(sizeof(FrameBlock) == 176, "uFrame is 176 bytes");
+static_assert(sizeof(LightBlock) == 496, "uLights is 496 bytes");
+
+FrameUniforms :: FrameUniforms()
+{
+	std::memset(static_cast<void *>(&mFrame), 0, sizeof(mFrame));
+	std::memset(static_cast<void *>(&mLights), 0, sizeof(mLights));
+	mFrame.uView = glm::mat4(1.0f);
+	mFrame.uProjection = glm::mat4(1.0f);
+	mFrame.uExposure = 1.0f;
+	// Attenuation of 1 rather than a division by zero for lights left unset
+	mLights.uSpotLight.constant = 1.0f;
+	for (size_t i = 0; i < FRAME_MAX_POINT_LIGHTS; i++)
+		mLights.uPointLights[i].constant = 1.0f;
+}
+
+FrameUniforms & FrameUniforms :: Shared() {
+	// Never destroyed, like the stream ring it writes to
+	static FrameUniforms * uniforms = new FrameUniforms();
+	return *uniforms;
+}
+
+void FrameUniforms :: SetCamera(const glm::mat4 & view, const glm::mat4 & projection,
+	const glm::vec3 & position, const glm::vec3 & front) {
+	mFrame.uView = view;
+	mFrame.uProjection = projection;
+	mFrame.uCameraPos = position;
+	mFrame.uCameraFront = front;
+}
+
+void FrameUniforms :: SetTime(float time) {
+	mFrame.uDeltaTime = time - mFrame.uTime;
+	mFrame.uTime = time;
+}
+
+void FrameUniforms :: SetExposure(float exposure) {
+	mFrame.uExposure = exposure;
+}
+
+LightBlock & FrameUniforms :: Lights() {
+	return mLights;
+}
+
+void FrameUniforms :: Update() {
+
+	// A fresh range of the ring each time: the draws of the frames before still read theirs
+	StreamRange frame = StreamBuffer::Shared().UploadUniform(&mFrame, sizeof(mFrame));
+	StreamRange lights = StreamBuffer::Shared().UploadUniform(&mLights, sizeof(mLights));
+	glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, frame.buffer, frame.offset, frame.size);
+	glBindBufferRange(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING, lights.buffer, lights.offset, lights.size);
+}
+
+void FrameUniforms :: BindBlocks(GLuint program) {
+
+	GLuint frame = glGetUniformBlockIndex(program, FRAME_BLOCK_NAME);
+	if (frame != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, frame, FRAME_BLOCK_BINDING);
+
+	GLuint lights = glGetUniformBlockIndex(program, LIGHT_BLOCK_NAME);
+	if (lights != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, lights, LIGHT_BLOCK_BINDING);
+}
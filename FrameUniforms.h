@@ -0,0 +1,111 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <cstddef>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <BlockLayout.h>
+
+#define FRAME_BLOCK_NAME       "uFrame"
+#define LIGHT_BLOCK_NAME       "uLights"
+#define FRAME_BLOCK_BINDING    1 // 0 is left to hand-made blocks (UniformBuffers.cpp)
+#define LIGHT_BLOCK_BINDING    2
+#define FRAME_MAX_POINT_LIGHTS 4
+
+/**
+* Uniform blocks shared by every shader. Shader binds blocks with these names to
+* these points when it links, and "#pragma block uFrame" / "#pragma block uLights"
+* in a shader source expands to their GLSL (with the light structs).
+*/
+#define FRAME_BLOCK_FIELDS(FIELD)  \
+	FIELD(uView, glm::mat4)        \
+	FIELD(uProjection, glm::mat4)  \
+	FIELD(uCameraPos, glm::vec3)   \
+	FIELD(uTime, float)            \
+	FIELD(uCameraFront, glm::vec3) \
+	FIELD(uDeltaTime, float)       \
+	FIELD(uExposure, float)
+BLOCK_STRUCT(FrameBlock, FRAME_BLOCK_NAME, Std140, FRAME_BLOCK_FIELDS);
+
+#define DIRECTIONAL_LIGHT_FIELDS(FIELD) \
+	FIELD(direction, glm::vec3)         \
+	FIELD(ambient, glm::vec3)           \
+	FIELD(diffuse, glm::vec3)           \
+	FIELD(specular, glm::vec3)
+BLOCK_STRUCT(DirectionalLight, "Directional_Light_t", Std140, DIRECTIONAL_LIGHT_FIELDS);
+
+#define SPOT_LIGHT_FIELDS(FIELD) \
+	FIELD(position, glm::vec3)   \
+	FIELD(direction, glm::vec3)  \
+	FIELD(ambient, glm::vec3)    \
+	FIELD(diffuse, glm::vec3)    \
+	FIELD(specular, glm::vec3)   \
+	FIELD(constant, float)       \
+	FIELD(linear, float)         \
+	FIELD(quadratic, float)      \
+	FIELD(innerCutOff, float) /* cosines */ \
+	FIELD(outerCutOff, float)
+BLOCK_STRUCT(SpotLight, "Spot_Light_t", Std140, SPOT_LIGHT_FIELDS);
+
+#define POINT_LIGHT_FIELDS(FIELD) \
+	FIELD(position, glm::vec3)    \
+	FIELD(ambient, glm::vec3)     \
+	FIELD(diffuse, glm::vec3)     \
+	FIELD(specular, glm::vec3)    \
+	FIELD(constant, float)        \
+	FIELD(linear, float)          \
+	FIELD(quadratic, float)
+BLOCK_STRUCT(PointLight, "Point_Light_t", Std140, POINT_LIGHT_FIELDS);
+
+#define LIGHT_BLOCK_FIELDS(FIELD)                                            \
+	FIELD(uDirectionalLight, DirectionalLight)                               \
+	FIELD(uSpotLight, SpotLight)                                             \
+	FIELD(uPointLights, BlockArray<PointLight, FRAME_MAX_POINT_LIGHTS>)      \
+	FIELD(uPointLightCount, int)
+BLOCK_STRUCT(LightBlock, LIGHT_BLOCK_NAME, Std140, LIGHT_BLOCK_FIELDS);
+
+/**
+* Both blocks copied into StreamBuffer::Shared() by every Update, and bound
+* there: no upload waits on the draws of earlier frames.
+*
+*   FrameUniforms::Shared().Lights().uDirectionalLight.direction = direction;
+*   ...
+*   FrameUniforms::Shared().SetCamera(view, projection, camera.position, camera.front);
+*   FrameUniforms::Shared().Update();
+*   ... draws ...
+*   StreamBuffer::Shared().EndFrame();
+*
+* GL thread only. Update again after the ring's EndFrame before drawing: ranges
+* live one frame.
+*/
+class FrameUniforms {
+
+public:
+	FrameUniforms();
+
+	void SetCamera(const glm::mat4 & view, const glm::mat4 & projection,
+		const glm::vec3 & position, const glm::vec3 & front);
+	/** Seconds, uDeltaTime is taken from the previous call */
+	void SetTime(float time);
+	void SetExposure(float exposure);
+
+	/** Writable lights, uploaded with the frame by Update */
+	LightBlock & Lights();
+	const FrameBlock & Frame() const { return mFrame; }
+
+	/** Uploads both blocks and binds their ranges */
+	void Update();
+
+	/** Points the blocks of a linked program at FRAME_BLOCK_BINDING / LIGHT_BLOCK_BINDING, when it has them */
+	static void BindBlocks(GLuint program);
+
+	static FrameUniforms & Shared();
+
+private:
+	FrameBlock mFrame;
+	LightBlock mLights;
+};
+
+#endif
@@ -0,0 +1,263 @@
+#include <GLState.h>
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <unordered_map>
+
+#define GL_STATE_UNKNOWN 0xFFFFFFFFu // never a valid name or enum
+
+GLState :: GLState() {
+	Invalidate();
+	ResetStats();
+}
+
+GLState & GLState :: Shared() {
+	// Never destroyed: globals release GL objects after static teardown
+	static GLState * state = new GLState();
+	return *state;
+}
+
+void GLState :: Invalidate() {
+	mProgram = GL_STATE_UNKNOWN;
+	mVao = GL_STATE_UNKNOWN;
+	mActiveUnit = GL_STATE_UNKNOWN;
+	for (int unit=0; unit<GL_STATE_TEXTURE_UNITS; unit++)
+		for (int target=0; target<TARGET_COUNT; target++)
+			mTextures[unit][target] = GL_STATE_UNKNOWN;
+	mDrawFramebuffer = mReadFramebuffer = GL_STATE_UNKNOWN;
+	mCaps.clear();
+	mBlend[0] = mBlend[1] = GL_STATE_UNKNOWN;
+	mDepthFunc = GL_STATE_UNKNOWN;
+	mDepthMask = -1;
+	mStencilFunc = GL_STATE_UNKNOWN;
+	mStencilRef = 0;
+	mStencilFuncMask = 0;
+	mStencilOp[0] = mStencilOp[1] = mStencilOp[2] = GL_STATE_UNKNOWN;
+	mStencilMask = 0;
+	mStencilMaskKnown = false;
+	mCullFace = GL_STATE_UNKNOWN;
+}
+
+void GLState :: ResetStats() {
+	mStats.calls = 0;
+	mStats.dropped = 0;
+}
+
+bool GLState :: same(bool unchanged) {
+	mStats.calls++;
+	if (unchanged)
+		mStats.dropped++;
+	return unchanged;
+}
+
+int GLState :: targetSlot(GLenum target) {
+	switch (target) {
+	case GL_TEXTURE_2D:       return TARGET_2D;
+	case GL_TEXTURE_CUBE_MAP: return TARGET_CUBE_MAP;
+	case GL_TEXTURE_2D_ARRAY: return TARGET_2D_ARRAY;
+	default:                  return -1;
+	}
+}
+
+/*************************************************
+*
+* Program, VAO, textures
+*
+*************************************************/
+
+void GLState :: UseProgram(GLuint program) {
+	if (same(program == mProgram))
+		return;
+	glUseProgram(program);
+	mProgram = program;
+}
+
+void GLState :: BindVertexArray(GLuint vao) {
+	if (same(vao == mVao))
+		return;
+	glBindVertexArray(vao);
+	mVao = vao;
+}
+
+void GLState :: ActiveTexture(GLenum unit) {
+	if (same(unit == mActiveUnit))
+		return;
+	glActiveTexture(unit);
+	mActiveUnit = unit;
+}
+
+void GLState :: BindTexture(GLenum target, GLuint texture) {
+
+	int slot = targetSlot(target);
+	unsigned int unit = mActiveUnit - GL_TEXTURE0;
+	bool tracked = slot >= 0 && mActiveUnit != GL_STATE_UNKNOWN && unit < GL_STATE_TEXTURE_UNITS;
+	if (same(tracked && mTextures[unit][slot] == texture))
+		return;
+
+	glBindTexture(target, texture);
+	if (tracked)
+		mTextures[unit][slot] = texture;
+}
+
+void GLState :: BindTextureUnit(unsigned int unit, GLenum target, GLuint texture) {
+
+	int slot = targetSlot(target);
+	if (slot >= 0 && unit < GL_STATE_TEXTURE_UNITS && mTextures[unit][slot] == texture) {
+		same(true);
+		return;
+	}
+	ActiveTexture(GL_TEXTURE0 + unit);
+	BindTexture(target, texture);
+}
+
+/*************************************************
+*
+* Framebuffers
+*
+*************************************************/
+
+void GLState :: BindFramebuffer(GLenum target, GLuint framebuffer) {
+
+	bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+	bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+	if (same((!draw || mDrawFramebuffer == framebuffer) && (!read || mReadFramebuffer == framebuffer)))
+		return;
+
+	glBindFramebuffer(target, framebuffer);
+	if (draw)
+		mDrawFramebuffer = framebuffer;
+	if (read)
+		mReadFramebuffer = framebuffer;
+}
+
+GLuint GLState :: Framebuffer() {
+	if (mDrawFramebuffer == GL_STATE_UNKNOWN) {
+		GLint binding = 0;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &binding);
+		mDrawFramebuffer = (GLuint) binding;
+	}
+	return mDrawFramebuffer;
+}
+
+/*************************************************
+*
+* Fixed function state
+*
+*************************************************/
+
+void GLState :: Enable(GLenum cap) {
+	auto found = mCaps.find(cap);
+	if (same(found != mCaps.end() && found->second))
+		return;
+	glEnable(cap);
+	mCaps[cap] = true;
+}
+
+void GLState :: Disable(GLenum cap) {
+	auto found = mCaps.find(cap);
+	if (same(found != mCaps.end() && !found->second))
+		return;
+	glDisable(cap);
+	mCaps[cap] = false;
+}
+
+void GLState :: BlendFunc(GLenum source, GLenum destination) {
+	if (same(mBlend[0] == source && mBlend[1] == destination))
+		return;
+	glBlendFunc(source, destination);
+	mBlend[0] = source;
+	mBlend[1] = destination;
+}
+
+void GLState :: DepthFunc(GLenum func) {
+	if (same(func == mDepthFunc))
+		return;
+	glDepthFunc(func);
+	mDepthFunc = func;
+}
+
+void GLState :: DepthMask(GLboolean flag) {
+	if (same(mDepthMask == (GLint) flag))
+		return;
+	glDepthMask(flag);
+	mDepthMask = flag;
+}
+
+void GLState :: StencilFunc(GLenum func, GLint ref, GLuint mask) {
+	if (same(func == mStencilFunc && ref == mStencilRef && mask == mStencilFuncMask))
+		return;
+	glStencilFunc(func, ref, mask);
+	mStencilFunc = func;
+	mStencilRef = ref;
+	mStencilFuncMask = mask;
+}
+
+void GLState :: StencilOp(GLenum stencilFail, GLenum depthFail, GLenum depthPass) {
+	if (same(stencilFail == mStencilOp[0] && depthFail == mStencilOp[1] && depthPass == mStencilOp[2]))
+		return;
+	glStencilOp(stencilFail, depthFail, depthPass);
+	mStencilOp[0] = stencilFail;
+	mStencilOp[1] = depthFail;
+	mStencilOp[2] = depthPass;
+}
+
+void GLState :: StencilMask(GLuint mask) {
+	if (same(mStencilMaskKnown && mask == mStencilMask))
+		return;
+	glStencilMask(mask);
+	mStencilMask = mask;
+	mStencilMaskKnown = true;
+}
+
+void GLState :: CullFace(GLenum mode) {
+	if (same(mode == mCullFace))
+		return;
+	glCullFace(mode);
+	mCullFace = mode;
+}
+
+/*************************************************
+*
+* Deletion: GL unbinds what it deletes
+*
+*************************************************/
+
+void GLState :: DeleteTextures(GLsizei count, const GLuint * textures) {
+	for (GLsizei i=0; i<count; i++) {
+		if (textures[i] == 0)
+			continue;
+		for (int unit=0; unit<GL_STATE_TEXTURE_UNITS; unit++)
+			for (int target=0; target<TARGET_COUNT; target++)
+				if (mTextures[unit][target] == textures[i])
+					mTextures[unit][target] = 0;
+	}
+	glDeleteTextures(count, textures);
+}
+
+void GLState :: DeleteVertexArrays(GLsizei count, const GLuint * vaos) {
+	for (GLsizei i=0; i<count; i++)
+		if (vaos[i] != 0 && vaos[i] == mVao)
+			mVao = 0;
+	glDeleteVertexArrays(count, vaos);
+}
+
+void GLState :: DeleteFramebuffers(GLsizei count, const GLuint * framebuffers) {
+	for (GLsizei i=0; i<count; i++) {
+		if (framebuffers[i] == 0)
+			continue;
+		if (framebuffers[i] == mDrawFramebuffer)
+			mDrawFramebuffer = 0;
+		if (framebuffers[i] == mReadFramebuffer)
+			mReadFramebuffer = 0;
+	}
+	glDeleteFramebuffers(count, framebuffers);
+}
+
+void GLState :: DeleteProgram(GLuint program) {
+	// A deleted program in use stays current until another is used: its name
+	// cannot be recycled before, nothing to forget until then
+	glDeleteProgram(program);
+	if (program != 0 && program == mProgram)
+		mProgram = GL_STATE_UNKNOWN;
+}
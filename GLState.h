@@ -0,0 +1,103 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <cstddef>
+#include <unordered_map>
+
+#include <glad/glad.h>
+
+#define GL_STATE_TEXTURE_UNITS 32 // units tracked, higher ones are always passed through
+
+struct GLStateStats {
+	size_t calls;   // state calls made through the cache
+	size_t dropped; // of them, the ones that changed nothing and never reached the driver
+};
+
+/**
+* Shadow copy of the GL state the wrappers touch: program, VAO, texture unit
+* bindings (2D, cube map, 2D array), framebuffers, enable caps, blend, depth,
+* stencil and cull state. Calls that set what is already current are dropped.
+*
+* Only coherent if every change goes through it: code calling GL directly for
+* any of this state must call Invalidate afterwards. Deleting a texture, VAO,
+* framebuffer or program also unbinds it, use the Delete* methods so recycled
+* names are not taken as still bound. Starts with everything unknown, so the
+* first call of each kind always reaches the driver. GL thread only.
+*/
+class GLState {
+
+public:
+	GLState();
+
+	void UseProgram(GLuint program);
+	/** Program in use, 0xFFFFFFFF while unknown */
+	GLuint Program() const { return mProgram; }
+	void BindVertexArray(GLuint vao);
+
+	/** unit: GL_TEXTURE0 + i, as glActiveTexture */
+	void ActiveTexture(GLenum unit);
+	/** On the active unit, as glBindTexture */
+	void BindTexture(GLenum target, GLuint texture);
+	/** On unit GL_TEXTURE0 + unit, the active unit only changes when the binding does */
+	void BindTextureUnit(unsigned int unit, GLenum target, GLuint texture);
+
+	/** GL_FRAMEBUFFER binds both the draw and the read framebuffer */
+	void BindFramebuffer(GLenum target, GLuint framebuffer);
+	/** Current draw framebuffer, asked to GL when unknown */
+	GLuint Framebuffer();
+
+	void Enable(GLenum cap);
+	void Disable(GLenum cap);
+	void BlendFunc(GLenum source, GLenum destination);
+	void DepthFunc(GLenum func);
+	void DepthMask(GLboolean flag);
+	void StencilFunc(GLenum func, GLint ref, GLuint mask);
+	void StencilOp(GLenum stencilFail, GLenum depthFail, GLenum depthPass);
+	void StencilMask(GLuint mask);
+	void CullFace(GLenum mode);
+
+	void DeleteTextures(GLsizei count, const GLuint * textures);
+	void DeleteVertexArrays(GLsizei count, const GLuint * vaos);
+	void DeleteFramebuffers(GLsizei count, const GLuint * framebuffers);
+	void DeleteProgram(GLuint program);
+
+	/** Forgets everything, after GL calls made around the cache */
+	void Invalidate();
+
+	GLStateStats Stats() const { return mStats; }
+	void ResetStats();
+
+	static GLState & Shared();
+
+private:
+	enum TextureTarget {
+		TARGET_2D,
+		TARGET_CUBE_MAP,
+		TARGET_2D_ARRAY,
+		TARGET_COUNT
+	};
+
+	GLuint mProgram;
+	GLuint mVao;
+	GLenum mActiveUnit;
+	GLuint mTextures[GL_STATE_TEXTURE_UNITS][TARGET_COUNT];
+	GLuint mDrawFramebuffer;
+	GLuint mReadFramebuffer;
+	std::unordered_map<GLenum, bool> mCaps; // absent: unknown
+	GLenum mBlend[2];
+	GLenum mDepthFunc;
+	GLint mDepthMask;   // -1: unknown
+	GLenum mStencilFunc;
+	GLint mStencilRef;
+	GLuint mStencilFuncMask;
+	GLenum mStencilOp[3];
+	GLuint mStencilMask;
+	bool mStencilMaskKnown;
+	GLenum mCullFace;
+	GLStateStats mStats;
+
+	bool same(bool unchanged);
+	static int targetSlot(GLenum target);
+};
+
+#endif
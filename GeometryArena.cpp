@@ -0,0 +1,370 @@
+#include <GeometryArena.h>
+#include <GLState.h>
+#include <VertexPacking.h>
+
+#include <glad/glad.h>
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#define ARENA_PAGE_VERTICES    (1 << 18)         // 256K vertices: 6 MB packed, 14 MB full
+#define ARENA_PAGE_INDEX_BYTES (4 * 1024 * 1024)
+
+static size_t indexSize(GLenum type) {
+	return type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+/** First fit with the offset rounded up to align, the rest of the block stays free */
+static bool takeBlock(std::vector<ArenaBlock> & blocks, size_t size, size_t align, size_t & offset) {
+
+	for (size_t i=0; i<blocks.size(); i++) {
+		ArenaBlock block = blocks[i];
+		size_t aligned = (block.offset + align - 1) / align * align;
+		if (aligned + size > block.offset + block.size)
+			continue;
+
+		offset = aligned;
+		size_t head = aligned - block.offset;
+		size_t tail = block.offset + block.size - (aligned + size);
+
+		blocks.erase(blocks.begin() + i);
+		if (tail > 0)
+			blocks.insert(blocks.begin() + i, ArenaBlock{ aligned + size, tail });
+		if (head > 0)
+			blocks.insert(blocks.begin() + i, ArenaBlock{ block.offset, head });
+		return true;
+	}
+	return false;
+}
+
+/** Back into the sorted list, merged with the blocks it touches */
+static void giveBlock(std::vector<ArenaBlock> & blocks, size_t offset, size_t size) {
+
+	auto it = std::lower_bound(blocks.begin(), blocks.end(), offset,
+		[](const ArenaBlock & block, size_t value) { return block.offset < value; });
+	it = blocks.insert(it, ArenaBlock{ offset, size });
+
+	auto next = it + 1;
+	if (next != blocks.end() && it->offset + it->size == next->offset) {
+		it->size += next->size;
+		blocks.erase(next);
+	}
+	if (it != blocks.begin()) {
+		auto previous = it - 1;
+		if (previous->offset + previous->size == it->offset) {
+			previous->size += it->size;
+			blocks.erase(it);
+		}
+	}
+}
+
+GeometryArena & GeometryArena :: Shared() {
+	// Never destroyed: meshes held in globals free their ranges after static teardown
+	static GeometryArena * arena = new GeometryArena();
+	return *arena;
+}
+
+unsigned int GeometryArena :: createPage(VertexFormat format, size_t vertexCount, size_t indexBytes) {
+
+	Page page;
+	page.format = format;
+	page.vertexCapacity = std::max((size_t) ARENA_PAGE_VERTICES, vertexCount);
+	page.indexCapacity  = std::max((size_t) ARENA_PAGE_INDEX_BYTES, (indexBytes + 3) / 4 * 4);
+	page.freeVertices.push_back(ArenaBlock{ 0, page.vertexCapacity });
+	page.freeIndices.push_back(ArenaBlock{ 0, page.indexCapacity });
+	page.ranges = 0;
+
+	glGenBuffers(1, &page.vbo);
+	glGenBuffers(1, &page.ebo);
+	glGenVertexArrays(1, &page.vao);
+
+	GLState::Shared().BindVertexArray(page.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, page.vbo);
+	glBufferData(GL_ARRAY_BUFFER, page.vertexCapacity * VertexStride(format), NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, page.ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, page.indexCapacity, NULL, GL_STATIC_DRAW);
+	SetupVertexAttributes(format);
+	GLState::Shared().BindVertexArray(0);
+
+	// Reuse a released slot so page numbers stay small
+	for (unsigned int i=0; i<mPages.size(); i++) {
+		if (mPages[i].vao == 0) {
+			mPages[i] = page;
+			return i;
+		}
+	}
+	mPages.push_back(page);
+	return (unsigned int) mPages.size() - 1;
+}
+
+void GeometryArena :: releasePage(unsigned int index) {
+	Page & page = mPages[index];
+	GLState::Shared().DeleteVertexArrays(1, &page.vao);
+	glDeleteBuffers(1, &page.vbo);
+	glDeleteBuffers(1, &page.ebo);
+	page = Page();
+	page.vao = page.vbo = page.ebo = 0;
+}
+
+GeometryHandle GeometryArena :: Allocate(VertexFormat format, const void * vertices, size_t vertexCount,
+	const unsigned int * indices, size_t indexCount) {
+
+	if (vertexCount == 0 || indexCount == 0)
+		return 0;
+
+	GLenum indexType = vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	size_t indexBytes = indexCount * indexSize(indexType);
+
+	// First page of this format with room for both parts
+	unsigned int pageIndex = 0;
+	size_t vertexOffset = 0, indexOffset = 0;
+	bool found = false;
+	for (unsigned int i=0; i<mPages.size() && !found; i++) {
+		Page & page = mPages[i];
+		if (page.vao == 0 || page.format != format)
+			continue;
+		if (!takeBlock(page.freeVertices, vertexCount, 1, vertexOffset))
+			continue;
+		if (!takeBlock(page.freeIndices, indexBytes, sizeof(GLuint), indexOffset)) {
+			giveBlock(page.freeVertices, vertexOffset, vertexCount);
+			continue;
+		}
+		pageIndex = i;
+		found = true;
+	}
+
+	if (!found) {
+		pageIndex = createPage(format, vertexCount, indexBytes);
+		Page & page = mPages[pageIndex];
+		takeBlock(page.freeVertices, vertexCount, 1, vertexOffset);
+		takeBlock(page.freeIndices, indexBytes, sizeof(GLuint), indexOffset);
+	}
+
+	Page & page = mPages[pageIndex];
+	size_t stride = VertexStride(format);
+
+	// Copy targets leave the VAO element binding alone
+	glBindBuffer(GL_COPY_WRITE_BUFFER, page.vbo);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, vertexOffset * stride, vertexCount * stride, vertices);
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, page.ebo);
+	if (indexType == GL_UNSIGNED_SHORT) {
+		std::vector<GLushort> shortIndices(indices, indices + indexCount);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset, indexBytes, shortIndices.data());
+	} else {
+		glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset, indexBytes, indices);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	GeometryRange range;
+	range.format      = format;
+	range.page        = pageIndex;
+	range.vao         = page.vao;
+	range.baseVertex  = (GLint) vertexOffset;
+	range.vertexCount = vertexCount;
+	range.indexOffset = indexOffset;
+	range.indexCount  = indexCount;
+	range.indexType   = indexType;
+	range.live        = true;
+	page.ranges++;
+
+	GeometryHandle handle;
+	if (!mFreeHandles.empty()) {
+		handle = mFreeHandles.back();
+		mFreeHandles.pop_back();
+		mRanges[handle - 1] = range;
+	} else {
+		mRanges.push_back(range);
+		handle = (GeometryHandle) mRanges.size();
+	}
+	return handle;
+}
+
+void GeometryArena :: Free(GeometryHandle handle) {
+
+	if (handle == 0 || handle > mRanges.size() || !mRanges[handle - 1].live)
+		return;
+
+	GeometryRange & range = mRanges[handle - 1];
+	Page & page = mPages[range.page];
+	giveBlock(page.freeVertices, (size_t) range.baseVertex, range.vertexCount);
+	giveBlock(page.freeIndices, range.indexOffset, range.indexCount * indexSize(range.indexType));
+	range.live = false;
+	mFreeHandles.push_back(handle);
+
+	if (--page.ranges == 0)
+		releasePage(range.page);
+}
+
+bool GeometryArena :: UpdateIndices(GeometryHandle handle, const unsigned int * indices, size_t indexCount) {
+
+	const GeometryRange * range = Range(handle);
+	if (!range || range->indexCount != indexCount) {
+		std::cerr << "GeometryArena::UpdateIndices: index count mismatch\n";
+		return false;
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mPages[range->page].ebo);
+	if (range->indexType == GL_UNSIGNED_SHORT) {
+		std::vector<GLushort> shortIndices(indices, indices + indexCount);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, range->indexOffset, indexCount * sizeof(GLushort), shortIndices.data());
+	} else {
+		glBufferSubData(GL_COPY_WRITE_BUFFER, range->indexOffset, indexCount * sizeof(GLuint), indices);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	return true;
+}
+
+const GeometryRange * GeometryArena :: Range(GeometryHandle handle) const {
+	if (handle == 0 || handle > mRanges.size() || !mRanges[handle - 1].live)
+		return NULL;
+	return &mRanges[handle - 1];
+}
+
+bool GeometryArena :: PageBuffers(unsigned int page, GLuint & vbo, GLuint & ebo) const {
+	if (page >= mPages.size() || mPages[page].vao == 0)
+		return false;
+	vbo = mPages[page].vbo;
+	ebo = mPages[page].ebo;
+	return true;
+}
+
+void GeometryArena :: Draw(GeometryHandle handle, GLsizei instances) const {
+
+	const GeometryRange * range = Range(handle);
+	if (range)
+		DrawRange(handle, 0, range->indexCount, instances);
+}
+
+void GeometryArena :: DrawRange(GeometryHandle handle, size_t first, size_t indexCount, GLsizei instances) const {
+
+	const GeometryRange * range = Range(handle);
+	if (!range || first + indexCount > range->indexCount)
+		return;
+
+	size_t offset = range->indexOffset + first * indexSize(range->indexType);
+	GLState::Shared().BindVertexArray(range->vao);
+	if (instances == 1)
+		glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei) indexCount, range->indexType,
+			(void*) offset, range->baseVertex);
+	else
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, (GLsizei) indexCount, range->indexType,
+			(void*) offset, instances, range->baseVertex);
+}
+
+void GeometryArena :: MultiDrawRanges(GeometryHandle handle, const size_t * firsts, const GLsizei * counts,
+	GLsizei drawCount) const {
+
+	const GeometryRange * range = Range(handle);
+	if (!range || drawCount <= 0)
+		return;
+
+	size_t size = indexSize(range->indexType);
+	mDrawOffsets.resize(drawCount);
+	mDrawBaseVertices.assign(drawCount, range->baseVertex);
+	for (GLsizei i=0; i<drawCount; i++)
+		mDrawOffsets[i] = (const void *) (range->indexOffset + firsts[i] * size);
+
+	GLState::Shared().BindVertexArray(range->vao);
+	glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts, range->indexType, mDrawOffsets.data(),
+		drawCount, mDrawBaseVertices.data());
+}
+
+void GeometryArena :: compactPage(unsigned int index) {
+
+	Page & page = mPages[index];
+	size_t stride = VertexStride(page.format);
+
+	GLuint vbo, ebo;
+	glGenBuffers(1, &vbo);
+	glGenBuffers(1, &ebo);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+	glBufferData(GL_COPY_WRITE_BUFFER, page.vertexCapacity * stride, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+	glBufferData(GL_COPY_WRITE_BUFFER, page.indexCapacity, NULL, GL_STATIC_DRAW);
+
+	// Live ranges in their current order, packed from offset 0 into the new buffers
+	std::vector<GeometryRange *> ranges;
+	for (GeometryRange & range : mRanges)
+		if (range.live && range.page == index)
+			ranges.push_back(&range);
+	std::sort(ranges.begin(), ranges.end(), [](const GeometryRange * a, const GeometryRange * b) {
+		return a->baseVertex < b->baseVertex;
+	});
+
+	size_t vertexEnd = 0, indexEnd = 0;
+	for (GeometryRange * range : ranges) {
+		size_t indexBytes = range->indexCount * indexSize(range->indexType);
+
+		glBindBuffer(GL_COPY_READ_BUFFER, page.vbo);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+			(size_t) range->baseVertex * stride, vertexEnd * stride, range->vertexCount * stride);
+
+		glBindBuffer(GL_COPY_READ_BUFFER, page.ebo);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, range->indexOffset, indexEnd, indexBytes);
+
+		range->baseVertex  = (GLint) vertexEnd;
+		range->indexOffset = indexEnd;
+		vertexEnd += range->vertexCount;
+		indexEnd  += (indexBytes + 3) / 4 * 4;
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	glDeleteBuffers(1, &page.vbo);
+	glDeleteBuffers(1, &page.ebo);
+	page.vbo = vbo;
+	page.ebo = ebo;
+
+	// Same VAO, pointed at the new buffers
+	GLState::Shared().BindVertexArray(page.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, page.vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, page.ebo);
+	SetupVertexAttributes(page.format);
+	GLState::Shared().BindVertexArray(0);
+
+	page.freeVertices.assign(1, ArenaBlock{ vertexEnd, page.vertexCapacity - vertexEnd });
+	page.freeIndices.assign(1, ArenaBlock{ indexEnd, page.indexCapacity - indexEnd });
+	if (page.freeVertices[0].size == 0) page.freeVertices.clear();
+	if (page.freeIndices[0].size == 0) page.freeIndices.clear();
+}
+
+void GeometryArena :: Compact() {
+	for (unsigned int i=0; i<mPages.size(); i++) {
+		const Page & page = mPages[i];
+		if (page.vao == 0)
+			continue;
+		// Already packed: at most one free block per buffer and it ends the buffer
+		bool packedVertices = page.freeVertices.empty() || (page.freeVertices.size() == 1
+			&& page.freeVertices[0].offset + page.freeVertices[0].size == page.vertexCapacity);
+		bool packedIndices = page.freeIndices.empty() || (page.freeIndices.size() == 1
+			&& page.freeIndices[0].offset + page.freeIndices[0].size == page.indexCapacity);
+		if (!packedVertices || !packedIndices)
+			compactPage(i);
+	}
+}
+
+GeometryArenaStats GeometryArena :: Stats() const {
+
+	GeometryArenaStats stats = {};
+	for (const Page & page : mPages) {
+		if (page.vao == 0)
+			continue;
+		size_t stride = VertexStride(page.format);
+		size_t freeVertices = 0, freeIndices = 0;
+		for (const ArenaBlock & block : page.freeVertices) freeVertices += block.size;
+		for (const ArenaBlock & block : page.freeIndices) freeIndices += block.size;
+
+		stats.pages++;
+		stats.vertexBytes     += page.vertexCapacity * stride;
+		stats.indexBytes      += page.indexCapacity;
+		stats.usedVertexBytes += (page.vertexCapacity - freeVertices) * stride;
+		stats.usedIndexBytes  += page.indexCapacity - freeIndices;
+		stats.freeBlocks      += page.freeVertices.size() + page.freeIndices.size();
+		stats.ranges          += page.ranges;
+	}
+	return stats;
+}
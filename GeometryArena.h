@@ -0,0 +1,104 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <vector>
+#include <cstddef>
+
+#include <glad/glad.h>
+
+#include <VertexPacking.h>
+
+/** 0 is never a valid handle */
+typedef unsigned int GeometryHandle;
+
+/** Where one allocation lives, valid until the next Compact() */
+struct GeometryRange {
+	VertexFormat format;
+	unsigned int page;
+	GLuint vao;          // shared by every range of the page
+	GLint baseVertex;    // first vertex in the page vertex buffer
+	size_t vertexCount;
+	size_t indexOffset;  // bytes into the page index buffer
+	size_t indexCount;
+	GLenum indexType;    // GL_UNSIGNED_SHORT when vertexCount <= 65536, indices are relative to baseVertex
+	bool live;
+};
+
+/** Free list entry, in vertices for vertex buffers and bytes for index buffers */
+struct ArenaBlock {
+	size_t offset;
+	size_t size;
+};
+
+struct GeometryArenaStats {
+	size_t pages;
+	size_t ranges;
+	size_t vertexBytes;     // capacity
+	size_t indexBytes;
+	size_t usedVertexBytes;
+	size_t usedIndexBytes;
+	size_t freeBlocks;      // fragments over all free lists
+};
+
+/**
+* Sub-allocates meshes out of a few large vertex/index buffer pairs ("pages").
+* Pages hold one vertex format each and own a single VAO, so consecutive draws
+* of meshes in the same page need no VAO switch and draw with
+* glDrawElementsBaseVertex at their offsets.
+*
+* Freed ranges go back to per-page free lists (coalesced with their neighbours),
+* empty pages are released and Compact() moves live ranges to the front of
+* fragmented pages. GL thread only.
+*/
+class GeometryArena {
+
+public:
+	/** Vertices are already laid out as format, indices are relative to the first vertex */
+	GeometryHandle Allocate(VertexFormat format, const void * vertices, size_t vertexCount,
+		const unsigned int * indices, size_t indexCount);
+	void Free(GeometryHandle handle);
+
+	/** Rewrite the indices of a range in place, indexCount must not change */
+	bool UpdateIndices(GeometryHandle handle, const unsigned int * indices, size_t indexCount);
+
+	const GeometryRange * Range(GeometryHandle handle) const;
+	/** Buffers of a live page, for VAOs of one's own over them (Compact() replaces them) */
+	bool PageBuffers(unsigned int page, GLuint & vbo, GLuint & ebo) const;
+
+	/** Binds the page VAO (left bound) and draws the range */
+	void Draw(GeometryHandle handle, GLsizei instances = 1) const;
+	/** Same for indexCount indices starting at index first of the range */
+	void DrawRange(GeometryHandle handle, size_t first, size_t indexCount, GLsizei instances = 1) const;
+	/** Several sub-ranges in one glMultiDrawElementsBaseVertex, firsts in indices from the range start */
+	void MultiDrawRanges(GeometryHandle handle, const size_t * firsts, const GLsizei * counts, GLsizei drawCount) const;
+
+	/** Repack fragmented pages so all their free space is one block at the end */
+	void Compact();
+
+	GeometryArenaStats Stats() const;
+
+	static GeometryArena & Shared();
+
+private:
+	struct Page {
+		VertexFormat format;
+		GLuint vao, vbo, ebo;
+		size_t vertexCapacity; // vertices
+		size_t indexCapacity;  // bytes
+		std::vector<ArenaBlock> freeVertices; // sorted by offset, never adjacent
+		std::vector<ArenaBlock> freeIndices;
+		size_t ranges;         // live allocations, the page is released at 0
+	};
+
+	std::vector<Page> mPages;             // released pages keep their slot with vao == 0
+	std::vector<GeometryRange> mRanges;   // handle - 1
+	std::vector<GeometryHandle> mFreeHandles;
+	mutable std::vector<const void *> mDrawOffsets; // MultiDrawRanges scratch
+	mutable std::vector<GLint> mDrawBaseVertices;
+
+	unsigned int createPage(VertexFormat format, size_t vertexCount, size_t indexBytes);
+	void releasePage(unsigned int page);
+	void compactPage(unsigned int page);
+};
+
+#endif
@@ -17,6 +17,9 @@
 
 /** Shader Wrapper */
 #include <ShaderProgram.h>
+#include <GLState.h>
+#include <StreamBuffer.h>
+#include <FrameUniforms.h>
 
 /** Camera Wrapper */
 #include <EularCamera.h>
@@ -86,33 +89,33 @@ int main() {
 	};
 	glm::vec3 directionalLightDirection(1.0f, -1.0f, 0.0f);
 
-	// Object shader config
-	objectShader.use();
-	// Light config
+	// Light config, shared by every shader through the uLights block
+	LightBlock & lights = FrameUniforms::Shared().Lights();
 	// Directional light
-	objectShader.setUniform("uDirectionalLight.direction", directionalLightDirection);
-	objectShader.setUniform("uDirectionalLight.ambient", 0.5f, 0.5f, 0.5f);
-	objectShader.setUniform("uDirectionalLight.diffuse", 1.0f, 1.0f, 1.0f);
-	objectShader.setUniform("uDirectionalLight.specular", 1.0f, 1.0f, 1.0f);
+	lights.uDirectionalLight.direction = directionalLightDirection;
+	lights.uDirectionalLight.ambient = glm::vec3(0.5f, 0.5f, 0.5f);
+	lights.uDirectionalLight.diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+	lights.uDirectionalLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
 	// Point light
 	//for (int i=0; i<4; i++) {
-	//	objectShader.setUniform(("uPointLights[" + std::to_string(i) +"].position").c_str(),  pointLightPos[i]);
-	//	objectShader.setUniform(("uPointLights[" + std::to_string(i) +"].ambient").c_str(),   0.2f, 0.2f, 0.2f);
-	//	objectShader.setUniform(("uPointLights[" + std::to_string(i) +"].diffuse").c_str(),   1.0f, 1.0f, 1.0f);
-	//	objectShader.setUniform(("uPointLights[" + std::to_string(i) +"].specular").c_str(),  1.0f, 1.0f, 1.0f);
-	//	objectShader.setUniform(("uPointLights[" + std::to_string(i) +"].constant").c_str(),  1.0f);
-	//	objectShader.setUniform(("uPointLights[" + std::to_string(i) +"].linear").c_str(),    0.09f);
-	//	objectShader.setUniform(("uPointLights[" + std::to_string(i) +"].quadratic").c_str(), 0.032f);
+	//	lights.uPointLights[i].position = pointLightPos[i];
+	//	lights.uPointLights[i].ambient = glm::vec3(0.2f, 0.2f, 0.2f);
+	//	lights.uPointLights[i].diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+	//	lights.uPointLights[i].specular = glm::vec3(1.0f, 1.0f, 1.0f);
+	//	lights.uPointLights[i].constant = 1.0f;
+	//	lights.uPointLights[i].linear = 0.09f;
+	//	lights.uPointLights[i].quadratic = 0.032f;
 	//}
-	// Spot light
-	objectShader.setUniform("uSpotLight.innerCutOff", glm::cos(glm::radians(12.5f)));
-	objectShader.setUniform("uSpotLight.outerCutOff", glm::cos(glm::radians(17.5f)));
-	objectShader.setUniform("uSpotLight.ambient", 0.0f, 0.0f, 0.0f);
-	objectShader.setUniform("uSpotLight.diffuse", 1.0f, 1.0f, 1.0f);
-	objectShader.setUniform("uSpotLight.specular", 1.0f, 1.0f, 1.0f);
-	objectShader.setUniform("uSpotLight.constant", 1.0f);
-	objectShader.setUniform("uSpotLight.linear", 0.09f);
-	objectShader.setUniform("uSpotLight.quadratic", 0.032f);
+	//lights.uPointLightCount = 4;
+	// Spot light, follows the camera
+	lights.uSpotLight.innerCutOff = glm::cos(glm::radians(12.5f));
+	lights.uSpotLight.outerCutOff = glm::cos(glm::radians(17.5f));
+	lights.uSpotLight.ambient = glm::vec3(0.0f, 0.0f, 0.0f);
+	lights.uSpotLight.diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+	lights.uSpotLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+	lights.uSpotLight.constant = 1.0f;
+	lights.uSpotLight.linear = 0.09f;
+	lights.uSpotLight.quadratic = 0.032f;
 
 
 
@@ -127,14 +130,14 @@ int main() {
 	unsigned int pointsVBO, pointsVAO;
 	glGenBuffers(1, &pointsVBO);
 	glGenVertexArrays(1, &pointsVAO);
-	glBindVertexArray(pointsVAO);
+	GLState::Shared().BindVertexArray(pointsVAO);
 	glBindBuffer(GL_ARRAY_BUFFER, pointsVBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(points), &points, GL_STATIC_DRAW);
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 0);
 	glEnableVertexAttribArray(1);
 	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(2 * sizeof(float)));
-	glBindVertexArray(0);
+	GLState::Shared().BindVertexArray(0);
 
 
 
@@ -166,14 +169,13 @@ int main() {
 		glm::mat4 view = camera.getViewMatrix();
 		glm::mat4 projection = glm::perspective(glm::radians(camera.fov), width_height_ratio, 0.1f, 100.0f);
 		//glm::mat4 projection = glm::ortho(-1.0f, 1.0f, -1.0f, 1.0f, 1.0f, 100.0f);
-		
-		objectShader.use();
-		objectShader.setUniform("uView", view);
-		objectShader.setUniform("uProjection", projection);
-		objectShader.setUniform("uCameraPos", camera.position);
-		
-		objectShader.setUniform("uSpotLight.position", camera.position);
-		objectShader.setUniform("uSpotLight.direction", camera.front);
+
+		// Per-frame engine uniforms: one buffer write for every shader
+		FrameUniforms::Shared().SetCamera(view, projection, camera.position, camera.front);
+		FrameUniforms::Shared().SetTime((float) glfwGetTime());
+		FrameUniforms::Shared().Lights().uSpotLight.position = camera.position;
+		FrameUniforms::Shared().Lights().uSpotLight.direction = camera.front;
+		FrameUniforms::Shared().Update();
 
 		// Draw Models
 		//objectNanosuit.Translate(-4.0f, -1.0f, 25.0f);
@@ -182,11 +184,14 @@ int main() {
 
 		// Draw points
 		geometryShader.use();
-		glBindVertexArray(pointsVAO);
+		GLState::Shared().BindVertexArray(pointsVAO);
 		glDrawArrays(GL_POINTS, 0, 4);
 
 
 
+		// This frame's uploads are fenced, the next one writes the next region of the ring
+		StreamBuffer::Shared().EndFrame();
+
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		glfwPollEvents();
 		glfwSwapBuffers(gWindow);
@@ -248,12 +253,12 @@ bool initOpenGL() {
 	//glViewport(0, 0, gWindowWidth, gWindowHeight);
 
 	// Configure global OpenGL state	
-	glEnable(GL_DEPTH_TEST);
+	GLState::Shared().Enable(GL_DEPTH_TEST);
 
 	// Blending functionality
-	glEnable(GL_BLEND);
+	GLState::Shared().Enable(GL_BLEND);
 	// Tell OpenGL how to calc colors of blended fragments (pixels)
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::Shared().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	// Hide the cursor and capture it
 	glfwSetInputMode(gWindow, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -0,0 +1,926 @@
+#include <GltfLoader.h>
+#include <TangentSpace.h>
+#include <Mesh.h>
+#include <Texture.h>
+#include <MappedFile.h>
+#include <ThreadPool.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+
+
+
+
+/*************************************************
+*
+* JSON
+*
+*************************************************/
+
+enum JsonType {
+	JSON_NULL,
+	JSON_BOOL,
+	JSON_NUMBER,
+	JSON_STRING,
+	JSON_ARRAY,
+	JSON_OBJECT
+};
+
+struct JsonNode {
+	JsonType type;
+	double number;     // numbers, booleans as 0 / 1
+	std::string text;  // strings
+	std::string key;   // name of the member when the parent is an object
+	std::vector<size_t> children;
+};
+
+/** Read-only cursor into a parsed document, anything missing reads as null */
+class JsonRef {
+
+public:
+	JsonRef(const std::vector<JsonNode> * nodes = NULL, size_t index = 0) : mNodes(nodes), mIndex(index) {}
+
+	bool Exists() const { return mNodes != NULL; }
+	JsonType Type() const { return mNodes ? node().type : JSON_NULL; }
+	size_t Size() const { return mNodes ? node().children.size() : 0; }
+
+	JsonRef operator[](size_t i) const {
+		if (!mNodes || node().type != JSON_ARRAY || i >= node().children.size())
+			return JsonRef();
+		return JsonRef(mNodes, node().children[i]);
+	}
+
+	JsonRef operator[](const std::string & key) const {
+		if (!mNodes || node().type != JSON_OBJECT)
+			return JsonRef();
+		for (size_t child : node().children)
+			if ((*mNodes)[child].key == key)
+				return JsonRef(mNodes, child);
+		return JsonRef();
+	}
+
+	double Number(double fallback = 0.0) const {
+		return Type() == JSON_NUMBER ? node().number : fallback;
+	}
+
+	long long Integer(long long fallback = -1) const {
+		return Type() == JSON_NUMBER ? (long long) node().number : fallback;
+	}
+
+	bool Bool(bool fallback = false) const {
+		return Type() == JSON_BOOL ? node().number != 0.0 : fallback;
+	}
+
+	std::string Text() const {
+		return Type() == JSON_STRING ? node().text : std::string();
+	}
+
+private:
+	const std::vector<JsonNode> * mNodes;
+	size_t mIndex;
+
+	const JsonNode & node() const { return (*mNodes)[mIndex]; }
+};
+
+#define JSON_MAX_DEPTH 256
+
+struct JsonParser {
+	const char * ptr;
+	const char * end;
+	std::vector<JsonNode> & nodes;
+
+	void skipSpaces() {
+		while (ptr < end && (*ptr == ' ' || *ptr == '\t' || *ptr == '\n' || *ptr == '\r'))
+			ptr++;
+	}
+
+	bool literal(const char * word) {
+		size_t length = std::strlen(word);
+		if ((size_t)(end - ptr) < length || std::memcmp(ptr, word, length) != 0)
+			return false;
+		ptr += length;
+		return true;
+	}
+
+	static void appendUtf8(std::string & out, unsigned int code) {
+		if (code < 0x80) {
+			out += (char) code;
+		} else if (code < 0x800) {
+			out += (char)(0xC0 | (code >> 6));
+			out += (char)(0x80 | (code & 0x3F));
+		} else if (code < 0x10000) {
+			out += (char)(0xE0 | (code >> 12));
+			out += (char)(0x80 | ((code >> 6) & 0x3F));
+			out += (char)(0x80 | (code & 0x3F));
+		} else {
+			out += (char)(0xF0 | (code >> 18));
+			out += (char)(0x80 | ((code >> 12) & 0x3F));
+			out += (char)(0x80 | ((code >> 6) & 0x3F));
+			out += (char)(0x80 | (code & 0x3F));
+		}
+	}
+
+	bool hex4(unsigned int & code) {
+		if (end - ptr < 4)
+			return false;
+		code = 0;
+		for (int i=0; i<4; i++) {
+			char c = *ptr++;
+			code <<= 4;
+			if (c >= '0' && c <= '9')      code |= (unsigned int)(c - '0');
+			else if (c >= 'a' && c <= 'f') code |= (unsigned int)(c - 'a' + 10);
+			else if (c >= 'A' && c <= 'F') code |= (unsigned int)(c - 'A' + 10);
+			else return false;
+		}
+		return true;
+	}
+
+	bool string(std::string & out) {
+		if (ptr >= end || *ptr != '"')
+			return false;
+		ptr++;
+		while (ptr < end && *ptr != '"') {
+			if (*ptr != '\\') {
+				out += *ptr++;
+				continue;
+			}
+			if (++ptr >= end)
+				return false;
+			char c = *ptr++;
+			switch (c) {
+				case '"': case '\\': case '/': out += c; break;
+				case 'b': out += '\b'; break;
+				case 'f': out += '\f'; break;
+				case 'n': out += '\n'; break;
+				case 'r': out += '\r'; break;
+				case 't': out += '\t'; break;
+				case 'u': {
+					unsigned int code;
+					if (!hex4(code))
+						return false;
+					// Surrogate pair
+					if (code >= 0xD800 && code < 0xDC00 && end - ptr >= 6 && ptr[0] == '\\' && ptr[1] == 'u') {
+						ptr += 2;
+						unsigned int low;
+						if (!hex4(low))
+							return false;
+						code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+					}
+					appendUtf8(out, code);
+					break;
+				}
+				default:
+					return false;
+			}
+		}
+		if (ptr >= end)
+			return false;
+		ptr++;
+		return true;
+	}
+
+	bool number(double & value) {
+		// Copy the token: the chunk is not zero terminated, strtod would run on
+		const char * start = ptr;
+		while (ptr < end && *ptr && (std::strchr("+-.eE", *ptr) || (*ptr >= '0' && *ptr <= '9')))
+			ptr++;
+		if (ptr == start)
+			return false;
+		std::string token(start, ptr);
+		char * stop;
+		value = std::strtod(token.c_str(), &stop);
+		return *stop == '\0';
+	}
+
+	/** Parses one value into a new node, returns its index or SIZE_MAX on error */
+	size_t value(int depth) {
+
+		skipSpaces();
+		if (ptr >= end || depth > JSON_MAX_DEPTH)
+			return SIZE_MAX;
+
+		size_t index = nodes.size();
+		nodes.emplace_back();
+		nodes[index].type = JSON_NULL;
+		nodes[index].number = 0.0;
+
+		char c = *ptr;
+		if (c == '{' || c == '[') {
+			bool object = c == '{';
+			nodes[index].type = object ? JSON_OBJECT : JSON_ARRAY;
+			char close = object ? '}' : ']';
+			ptr++;
+			skipSpaces();
+			if (ptr < end && *ptr == close) {
+				ptr++;
+				return index;
+			}
+			while (true) {
+				std::string key;
+				if (object) {
+					skipSpaces();
+					if (!string(key))
+						return SIZE_MAX;
+					skipSpaces();
+					if (ptr >= end || *ptr++ != ':')
+						return SIZE_MAX;
+				}
+				size_t child = value(depth + 1);
+				if (child == SIZE_MAX)
+					return SIZE_MAX;
+				nodes[child].key.swap(key);
+				nodes[index].children.push_back(child);
+				skipSpaces();
+				if (ptr >= end)
+					return SIZE_MAX;
+				if (*ptr == ',') {
+					ptr++;
+					continue;
+				}
+				if (*ptr++ != close)
+					return SIZE_MAX;
+				return index;
+			}
+		}
+
+		if (c == '"') {
+			nodes[index].type = JSON_STRING;
+			std::string text;
+			if (!string(text))
+				return SIZE_MAX;
+			nodes[index].text.swap(text);
+		} else if (literal("true")) {
+			nodes[index].type = JSON_BOOL;
+			nodes[index].number = 1.0;
+		} else if (literal("false")) {
+			nodes[index].type = JSON_BOOL;
+		} else if (literal("null")) {
+			nodes[index].type = JSON_NULL;
+		} else {
+			nodes[index].type = JSON_NUMBER;
+			double parsed;
+			if (!number(parsed))
+				return SIZE_MAX;
+			nodes[index].number = parsed;
+		}
+		return index;
+	}
+};
+
+/** Root at nodes[0] */
+static bool parseJson(const char * begin, const char * end, std::vector<JsonNode> & nodes) {
+	JsonParser parser = { begin, end, nodes };
+	return parser.value(0) == 0;
+}
+
+
+
+
+
+/*************************************************
+*
+* Buffers and accessors
+*
+*************************************************/
+
+struct GlbBuffer {
+	const unsigned char * data;
+	size_t size;
+};
+
+/** Typed, strided view of an accessor inside one of the buffers */
+struct GltfAccessor {
+	const unsigned char * data; // first element
+	size_t count;
+	size_t stride;              // bytes between elements
+	int componentType;          // GL enum values, as in the file
+	int components;
+	bool normalized;
+};
+
+static uint32_t readU32(const unsigned char * ptr) {
+	uint32_t value;
+	std::memcpy(&value, ptr, sizeof(value));
+	return value;
+}
+
+static size_t componentSize(int componentType) {
+	switch (componentType) {
+		case 0x1400: case 0x1401: return 1; // GL_BYTE, GL_UNSIGNED_BYTE
+		case 0x1402: case 0x1403: return 2; // GL_SHORT, GL_UNSIGNED_SHORT
+		case 0x1405: case 0x1406: return 4; // GL_UNSIGNED_INT, GL_FLOAT
+		default: return 0;
+	}
+}
+
+static int componentCount(const std::string & type) {
+	if (type == "SCALAR") return 1;
+	if (type == "VEC2")   return 2;
+	if (type == "VEC3")   return 3;
+	if (type == "VEC4")   return 4;
+	return 0;
+}
+
+static bool resolveAccessor(const JsonRef & gltf, const std::vector<GlbBuffer> & buffers,
+	long long index, GltfAccessor & accessor) {
+
+	JsonRef json = gltf["accessors"][(size_t) index];
+	if (index < 0 || !json.Exists())
+		return false;
+
+	// Sparse accessors and accessors without a view (all zeros) never show up in exported meshes
+	long long view = json["bufferView"].Integer();
+	JsonRef bufferView = gltf["bufferViews"][(size_t) view];
+	if (json["sparse"].Exists() || view < 0 || !bufferView.Exists())
+		return false;
+
+	long long buffer = bufferView["buffer"].Integer();
+	if (buffer < 0 || (size_t) buffer >= buffers.size() || !buffers[buffer].data)
+		return false;
+
+	accessor.componentType = (int) json["componentType"].Integer(0);
+	accessor.components    = componentCount(json["type"].Text());
+	accessor.normalized    = json["normalized"].Bool();
+	accessor.count         = (size_t) json["count"].Integer(0);
+
+	size_t elementSize = componentSize(accessor.componentType) * accessor.components;
+	if (elementSize == 0)
+		return false;
+
+	size_t viewOffset = (size_t) bufferView["byteOffset"].Integer(0);
+	size_t viewLength = (size_t) bufferView["byteLength"].Integer(0);
+	size_t offset     = (size_t) json["byteOffset"].Integer(0);
+	accessor.stride   = (size_t) bufferView["byteStride"].Integer(0);
+	if (accessor.stride == 0)
+		accessor.stride = elementSize;
+
+	const GlbBuffer & source = buffers[buffer];
+	if (viewOffset > source.size || viewLength > source.size - viewOffset)
+		return false;
+	if (accessor.count > 0) {
+		if (offset > viewLength || viewLength - offset < elementSize)
+			return false;
+		if (accessor.count - 1 > (viewLength - offset - elementSize) / accessor.stride)
+			return false;
+	}
+
+	accessor.data = source.data + viewOffset + offset;
+	return true;
+}
+
+static float readComponent(const unsigned char * ptr, int componentType, bool normalized) {
+	switch (componentType) {
+		case 0x1400: { int8_t v;   std::memcpy(&v, ptr, 1); return normalized ? std::max(v / 127.0f, -1.0f) : v; }
+		case 0x1401: { uint8_t v;  std::memcpy(&v, ptr, 1); return normalized ? v / 255.0f : v; }
+		case 0x1402: { int16_t v;  std::memcpy(&v, ptr, 2); return normalized ? std::max(v / 32767.0f, -1.0f) : v; }
+		case 0x1403: { uint16_t v; std::memcpy(&v, ptr, 2); return normalized ? v / 65535.0f : v; }
+		case 0x1405: { uint32_t v; std::memcpy(&v, ptr, 4); return (float) v; }
+		default:     { float v;    std::memcpy(&v, ptr, 4); return v; }
+	}
+}
+
+/**
+* Components [first, first + count) of every element into out, outStride bytes apart.
+* Float data (the common case) is one memcpy per element.
+*/
+static void readFloats(const GltfAccessor & accessor, int first, int count, void * out, size_t outStride) {
+
+	unsigned char * dst = (unsigned char *) out;
+	count = std::min(count, accessor.components - first);
+	if (count <= 0)
+		return;
+
+	if (accessor.componentType == 0x1406) {
+		const unsigned char * src = accessor.data + first * sizeof(float);
+		for (size_t i=0; i<accessor.count; i++, src+=accessor.stride, dst+=outStride)
+			std::memcpy(dst, src, count * sizeof(float));
+		return;
+	}
+
+	size_t size = componentSize(accessor.componentType);
+	const unsigned char * src = accessor.data + first * size;
+	for (size_t i=0; i<accessor.count; i++, src+=accessor.stride, dst+=outStride) {
+		float values[4];
+		for (int c=0; c<count; c++)
+			values[c] = readComponent(src + c * size, accessor.componentType, accessor.normalized);
+		std::memcpy(dst, values, count * sizeof(float));
+	}
+}
+
+static bool readIndices(const GltfAccessor & accessor, size_t vertexCount, std::vector<unsigned int> & indices) {
+
+	if (accessor.components != 1)
+		return false;
+
+	indices.resize(accessor.count);
+	if (accessor.componentType == 0x1405 && accessor.stride == 4) {
+		if (accessor.count)
+			std::memcpy(indices.data(), accessor.data, accessor.count * 4);
+	} else if (accessor.componentType == 0x1403 || accessor.componentType == 0x1401 || accessor.componentType == 0x1405) {
+		size_t size = componentSize(accessor.componentType);
+		const unsigned char * src = accessor.data;
+		for (size_t i=0; i<accessor.count; i++, src+=accessor.stride) {
+			uint32_t value = 0;
+			std::memcpy(&value, src, size); // little endian, like the file
+			indices[i] = value;
+		}
+	} else {
+		return false;
+	}
+
+	for (unsigned int index : indices)
+		if (index >= vertexCount)
+			return false;
+	return true;
+}
+
+
+
+
+
+/*************************************************
+*
+* Scene
+*
+*************************************************/
+
+/** One primitive placed by a node */
+struct GlbDraw {
+	size_t mesh;
+	size_t primitive;
+	glm::mat4 transform;
+};
+
+static glm::mat4 nodeMatrix(const JsonRef & node) {
+
+	JsonRef matrix = node["matrix"];
+	if (matrix.Size() == 16) {
+		glm::mat4 result;
+		for (int i=0; i<16; i++)
+			result[i / 4][i % 4] = (float) matrix[i].Number(); // column major, like glm
+		return result;
+	}
+
+	JsonRef t = node["translation"], r = node["rotation"], s = node["scale"];
+	glm::mat4 result(1.0f);
+	if (t.Size() == 3)
+		result = glm::translate(result, glm::vec3(t[0].Number(), t[1].Number(), t[2].Number()));
+	if (r.Size() == 4)
+		result = result * glm::mat4_cast(glm::quat((float) r[3].Number(1.0), (float) r[0].Number(),
+			(float) r[1].Number(), (float) r[2].Number()));
+	if (s.Size() == 3)
+		result = glm::scale(result, glm::vec3(s[0].Number(1.0), s[1].Number(1.0), s[2].Number(1.0)));
+	return result;
+}
+
+static void collectNode(const JsonRef & gltf, long long index, const glm::mat4 & parent,
+	std::vector<GlbDraw> & draws, int depth) {
+
+	JsonRef node = gltf["nodes"][(size_t) index];
+	if (index < 0 || !node.Exists() || depth > JSON_MAX_DEPTH)
+		return;
+
+	glm::mat4 world = parent * nodeMatrix(node);
+
+	long long mesh = node["mesh"].Integer();
+	if (mesh >= 0)
+		for (size_t p=0; p<gltf["meshes"][(size_t) mesh]["primitives"].Size(); p++)
+			draws.push_back(GlbDraw{(size_t) mesh, p, world});
+
+	JsonRef children = node["children"];
+	for (size_t i=0; i<children.Size(); i++)
+		collectNode(gltf, children[i].Integer(), world, draws, depth + 1);
+}
+
+/** Primitives of the default scene, every mesh once untransformed when the file has no scene */
+static std::vector<GlbDraw> collectDraws(const JsonRef & gltf) {
+
+	std::vector<GlbDraw> draws;
+	JsonRef scene = gltf["scenes"][(size_t) gltf["scene"].Integer(0)];
+
+	if (scene.Exists()) {
+		JsonRef roots = scene["nodes"];
+		for (size_t i=0; i<roots.Size(); i++)
+			collectNode(gltf, roots[i].Integer(), glm::mat4(1.0f), draws, 0);
+	} else {
+		JsonRef meshes = gltf["meshes"];
+		for (size_t m=0; m<meshes.Size(); m++)
+			for (size_t p=0; p<meshes[m]["primitives"].Size(); p++)
+				draws.push_back(GlbDraw{m, p, glm::mat4(1.0f)});
+	}
+	return draws;
+}
+
+
+
+
+
+/*************************************************
+*
+* Images and materials
+*
+*************************************************/
+
+static bool decodeBase64(const char * begin, const char * end, std::vector<unsigned char> & out) {
+
+	unsigned int bits = 0;
+	int count = 0;
+	for (const char * ptr = begin; ptr < end; ptr++) {
+		char c = *ptr;
+		unsigned int value;
+		if (c >= 'A' && c <= 'Z')      value = c - 'A';
+		else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+		else if (c >= '0' && c <= '9') value = c - '0' + 52;
+		else if (c == '+')             value = 62;
+		else if (c == '/')             value = 63;
+		else if (c == '=')             break;
+		else return false;
+		bits = (bits << 6) | value;
+		count += 6;
+		if (count >= 8) {
+			count -= 8;
+			out.push_back((unsigned char)((bits >> count) & 0xFF));
+		}
+	}
+	return true;
+}
+
+static std::string decodeUri(const std::string & uri) {
+
+	std::string result;
+	for (size_t i=0; i<uri.size(); i++) {
+		if (uri[i] == '%' && i + 2 < uri.size()) {
+			result += (char) std::strtol(uri.substr(i + 1, 2).c_str(), NULL, 16);
+			i += 2;
+		} else {
+			result += uri[i];
+		}
+	}
+	return result;
+}
+
+/** Writes an embedded image next to the model unless an up to date copy is there already */
+static bool extractImage(const std::string & target, const std::string & source,
+	const unsigned char * data, size_t size) {
+
+	long long modified = FileModifiedTime(target);
+	if (modified != 0 && modified >= FileModifiedTime(source))
+		return true;
+
+	std::string temp = target + ".tmp";
+	{
+		std::ofstream out(temp.c_str(), std::ios::binary);
+		if (!out.write((const char *) data, size)) {
+			std::cerr << "LoadGlb: unable to write " << temp << "\n";
+			std::remove(temp.c_str());
+			return false;
+		}
+	}
+	std::remove(target.c_str()); // rename does not overwrite on Windows
+	if (std::rename(temp.c_str(), target.c_str()) != 0) {
+		std::cerr << "LoadGlb: unable to write " << target << "\n";
+		std::remove(temp.c_str());
+		return false;
+	}
+	return true;
+}
+
+/** Path of every image relative to the model directory, empty when unusable */
+static std::vector<std::string> resolveImages(const JsonRef & gltf, const std::vector<GlbBuffer> & buffers,
+	const std::string & path) {
+
+	std::string directory = path.substr(0, path.find_last_of('/') + 1);
+	std::string name = path.substr(directory.size());
+
+	JsonRef images = gltf["images"];
+	std::vector<std::string> result(images.Size());
+
+	for (size_t i=0; i<images.Size(); i++) {
+
+		JsonRef image = images[i];
+		std::string uri = image["uri"].Text();
+		std::string mime = image["mimeType"].Text();
+
+		if (!uri.empty() && uri.compare(0, 5, "data:") != 0) {
+			result[i] = decodeUri(uri);
+			continue;
+		}
+
+		// Embedded: data URI or buffer view
+		std::vector<unsigned char> decoded;
+		const unsigned char * data = NULL;
+		size_t size = 0;
+
+		if (!uri.empty()) {
+			size_t comma = uri.find(',');
+			if (comma == std::string::npos || uri.rfind(";base64", comma) == std::string::npos
+				|| !decodeBase64(uri.c_str() + comma + 1, uri.c_str() + uri.size(), decoded)) {
+				std::cerr << "LoadGlb: " << path << ": unreadable data URI in image " << i << "\n";
+				continue;
+			}
+			if (mime.empty())
+				mime = uri.substr(5, uri.find_first_of(";,") - 5);
+			data = decoded.data();
+			size = decoded.size();
+		} else {
+			JsonRef view = gltf["bufferViews"][(size_t) image["bufferView"].Integer()];
+			long long buffer = view["buffer"].Integer();
+			size_t offset = (size_t) view["byteOffset"].Integer(0);
+			size = (size_t) view["byteLength"].Integer(0);
+			if (!view.Exists() || buffer < 0 || (size_t) buffer >= buffers.size() || !buffers[buffer].data
+				|| offset > buffers[buffer].size || size > buffers[buffer].size - offset) {
+				std::cerr << "LoadGlb: " << path << ": invalid buffer view in image " << i << "\n";
+				continue;
+			}
+			data = buffers[buffer].data + offset;
+		}
+
+		// stb sniffs the format from the bytes, the extension is for whoever looks at the folder
+		std::string extension = mime == "image/jpeg" ? "jpg" : mime == "image/png" ? "png" : "img";
+		std::string file = name + ".image" + std::to_string(i) + "." + extension;
+		if (extractImage(directory + file, path, data, size))
+			result[i] = file;
+	}
+
+	return result;
+}
+
+/** Texture references in the order Model::processMesh collects them */
+static std::vector<Texture> materialTextures(const JsonRef & gltf, long long material,
+	const std::vector<std::string> & images) {
+
+	JsonRef json = gltf["materials"][(size_t) material];
+
+	// glTF has no specular or height map, their slots get the default textures
+	struct Slot {
+		TextureType type;
+		JsonRef info;
+	} slots[] = {
+		{ TEX_DIFFUSE,  json["pbrMetallicRoughness"]["baseColorTexture"] },
+		{ TEX_SPECULAR, JsonRef() },
+		{ TEX_NORMAL,   json["normalTexture"] },
+		{ TEX_EMISSION, json["emissiveTexture"] },
+		{ TEX_AMBIENT,  json["occlusionTexture"] }
+	};
+
+	std::vector<Texture> textures;
+	for (const Slot & slot : slots) {
+		long long source = gltf["textures"][(size_t) slot.info["index"].Integer()]["source"].Integer();
+		if (source >= 0 && (size_t) source < images.size() && !images[source].empty())
+			textures.push_back(Texture{0, slot.type, images[source]});
+		else if (slot.type == TEX_DIFFUSE || slot.type == TEX_SPECULAR)
+			textures.push_back(Texture{0, slot.type, ""});
+	}
+	return textures;
+}
+
+
+
+
+
+/*************************************************
+*
+* Primitives
+*
+*************************************************/
+
+static Vertex emptyVertex() {
+	Vertex vertex;
+	vertex.position  = glm::vec3(0.0f);
+	vertex.normal    = glm::vec3(0.0f, 1.0f, 0.0f);
+	vertex.texCoords = glm::vec2(0.0f);
+	vertex.tangent   = glm::vec3(1.0f, 0.0f, 0.0f);
+	vertex.bitangent = glm::vec3(0.0f, 0.0f, 1.0f);
+	return vertex;
+}
+
+/** Without normals glTF asks for flat shading: one vertex per corner, face normals */
+static void flatNormals(MeshData & mesh) {
+
+	std::vector<Vertex> vertices;
+	vertices.reserve(mesh.indices.size());
+	for (size_t i=0; i+2<mesh.indices.size(); i+=3) {
+		const Vertex & a = mesh.vertices[mesh.indices[i]];
+		const Vertex & b = mesh.vertices[mesh.indices[i + 1]];
+		const Vertex & c = mesh.vertices[mesh.indices[i + 2]];
+		glm::vec3 n = glm::cross(b.position - a.position, c.position - a.position);
+		float length = glm::length(n);
+		n = length > 0.0f ? n / length : glm::vec3(0.0f, 1.0f, 0.0f);
+		for (const Vertex * corner : { &a, &b, &c }) {
+			vertices.push_back(*corner);
+			vertices.back().normal = n;
+		}
+	}
+	mesh.vertices.swap(vertices);
+	for (size_t i=0; i<mesh.indices.size(); i++)
+		mesh.indices[i] = (unsigned int) i;
+}
+
+static void applyTransform(MeshData & mesh, const glm::mat4 & transform) {
+
+	glm::mat3 linear(transform);
+	glm::mat3 normalMatrix = glm::transpose(glm::inverse(linear));
+
+	for (Vertex & vertex : mesh.vertices) {
+		vertex.position  = glm::vec3(transform * glm::vec4(vertex.position, 1.0f));
+		vertex.normal    = glm::normalize(normalMatrix * vertex.normal);
+		vertex.tangent   = glm::normalize(linear * vertex.tangent);
+		vertex.bitangent = glm::normalize(linear * vertex.bitangent);
+	}
+
+	// A mirroring transform turns the triangles inside out
+	if (glm::determinant(linear) < 0.0f)
+		for (size_t i=0; i+2<mesh.indices.size(); i+=3)
+			std::swap(mesh.indices[i + 1], mesh.indices[i + 2]);
+}
+
+static bool buildPrimitive(const JsonRef & gltf, const std::vector<GlbBuffer> & buffers,
+	const std::vector<std::string> & images, const GlbDraw & draw, MeshData & mesh, bool parallel) {
+
+	JsonRef primitive = gltf["meshes"][draw.mesh]["primitives"][draw.primitive];
+	if (primitive["mode"].Integer(4) != 4) // triangles only, points and lines have no place here
+		return false;
+
+	JsonRef attributes = primitive["attributes"];
+	GltfAccessor position, normal, texCoord, tangent;
+	if (!resolveAccessor(gltf, buffers, attributes["POSITION"].Integer(), position)
+		|| position.components != 3 || position.count == 0)
+		return false;
+
+	bool hasNormals   = resolveAccessor(gltf, buffers, attributes["NORMAL"].Integer(), normal)
+		&& normal.components == 3 && normal.count == position.count;
+	bool hasTexCoords = resolveAccessor(gltf, buffers, attributes["TEXCOORD_0"].Integer(), texCoord)
+		&& texCoord.components == 2 && texCoord.count == position.count;
+	bool hasTangents  = hasNormals && resolveAccessor(gltf, buffers, attributes["TANGENT"].Integer(), tangent)
+		&& tangent.components == 4 && tangent.count == position.count;
+
+	// Straight from the mapped buffers, one pass per attribute
+	mesh.vertices.assign(position.count, emptyVertex());
+	readFloats(position, 0, 3, &mesh.vertices[0].position, sizeof(Vertex));
+	if (hasNormals)
+		readFloats(normal, 0, 3, &mesh.vertices[0].normal, sizeof(Vertex));
+	if (hasTexCoords)
+		readFloats(texCoord, 0, 2, &mesh.vertices[0].texCoords, sizeof(Vertex)); // top-left origin, as uploaded
+
+	GltfAccessor indices;
+	long long indexAccessor = primitive["indices"].Integer();
+	if (indexAccessor >= 0) {
+		if (!resolveAccessor(gltf, buffers, indexAccessor, indices)
+			|| !readIndices(indices, mesh.vertices.size(), mesh.indices))
+			return false;
+	} else {
+		mesh.indices.resize(mesh.vertices.size());
+		for (size_t i=0; i<mesh.indices.size(); i++)
+			mesh.indices[i] = (unsigned int) i;
+	}
+	mesh.indices.resize(mesh.indices.size() / 3 * 3);
+	if (mesh.indices.empty())
+		return false;
+
+	if (hasTangents) {
+		std::vector<float> handedness(tangent.count);
+		readFloats(tangent, 0, 3, &mesh.vertices[0].tangent, sizeof(Vertex));
+		readFloats(tangent, 3, 1, handedness.data(), sizeof(float));
+		for (size_t i=0; i<mesh.vertices.size(); i++) {
+			Vertex & vertex = mesh.vertices[i];
+			vertex.bitangent = glm::cross(vertex.normal, vertex.tangent) * (handedness[i] < 0.0f ? -1.0f : 1.0f);
+		}
+	}
+
+	if (!hasNormals)
+		flatNormals(mesh);
+
+	if (draw.transform != glm::mat4(1.0f))
+		applyTransform(mesh, draw.transform);
+
+	if (!hasTangents && hasTexCoords)
+		GenerateTangents(mesh.vertices, mesh.indices, parallel);
+
+	mesh.textures = materialTextures(gltf, primitive["material"].Integer(), images);
+	return true;
+}
+
+
+
+
+
+/*************************************************
+*
+* Loader
+*
+*************************************************/
+
+bool LoadGlb(const std::string & path, std::vector<MeshData> & meshes, bool parallel) {
+
+	MappedFile file(path);
+	if (!file.IsOpen()) {
+		std::cerr << "LoadGlb: unable to open " << path << "\n";
+		return false;
+	}
+
+	// Header, then chunks: JSON first, the optional BIN chunk second
+	const unsigned char * data = file.Data();
+	size_t size = file.Size();
+	if (size < 20 || readU32(data) != GLB_MAGIC || readU32(data + 4) != 2) {
+		std::cerr << "LoadGlb: " << path << " is not a glTF 2.0 binary\n";
+		return false;
+	}
+	size = std::min(size, (size_t) readU32(data + 8));
+
+	const unsigned char * json = NULL, * bin = NULL;
+	size_t jsonSize = 0, binSize = 0;
+	for (size_t offset = 12; offset + 8 <= size; ) {
+		size_t length = readU32(data + offset);
+		uint32_t type = readU32(data + offset + 4);
+		if (length > size - offset - 8)
+			break;
+		if (type == GLB_CHUNK_JSON && !json) {
+			json = data + offset + 8;
+			jsonSize = length;
+		} else if (type == GLB_CHUNK_BIN && !bin) {
+			bin = data + offset + 8;
+			binSize = length;
+		}
+		offset += 8 + ((length + 3) & ~(size_t) 3);
+	}
+
+	std::vector<JsonNode> nodes;
+	if (!json || !parseJson((const char *) json, (const char *) json + jsonSize, nodes)) {
+		std::cerr << "LoadGlb: " << path << ": missing or malformed JSON chunk\n";
+		return false;
+	}
+	JsonRef gltf(&nodes, 0);
+
+	// Buffers: the BIN chunk, or ".bin" files next to the model (mapped as well)
+	std::string directory = path.substr(0, path.find_last_of('/') + 1);
+	JsonRef bufferList = gltf["buffers"];
+	std::vector<GlbBuffer> buffers(bufferList.Size(), GlbBuffer{NULL, 0});
+	std::vector<std::unique_ptr<MappedFile> > external;
+
+	for (size_t i=0; i<bufferList.Size(); i++) {
+		std::string uri = bufferList[i]["uri"].Text();
+		size_t length = (size_t) bufferList[i]["byteLength"].Integer(0);
+		if (uri.empty()) {
+			if (bin && length <= binSize)
+				buffers[i] = GlbBuffer{bin, length};
+		} else if (uri.compare(0, 5, "data:") == 0) {
+			std::cerr << "LoadGlb: " << path << ": data URI buffers are not supported\n";
+		} else {
+			external.emplace_back(new MappedFile(directory + decodeUri(uri)));
+			if (external.back()->IsOpen() && length <= external.back()->Size())
+				buffers[i] = GlbBuffer{external.back()->Data(), length};
+			else
+				std::cerr << "LoadGlb: " << path << ": unable to read buffer " << uri << "\n";
+		}
+	}
+
+	std::vector<std::string> images = resolveImages(gltf, buffers, path);
+	std::vector<GlbDraw> draws = collectDraws(gltf);
+
+	std::vector<MeshData> result(draws.size());
+	std::vector<char> built(draws.size(), 0);
+	auto build = [&](size_t i) {
+		built[i] = buildPrimitive(gltf, buffers, images, draws[i], result[i], parallel) ? 1 : 0;
+	};
+	if (parallel) {
+		ThreadPool::Shared().ParallelFor(draws.size(), build);
+	} else {
+		for (size_t i=0; i<draws.size(); i++)
+			build(i);
+	}
+
+	size_t skipped = 0;
+	meshes.clear();
+	meshes.reserve(draws.size());
+	for (size_t i=0; i<draws.size(); i++) {
+		if (built[i])
+			meshes.push_back(std::move(result[i]));
+		else
+			skipped++;
+	}
+
+	if (skipped)
+		std::cerr << "LoadGlb: " << path << ": skipped " << skipped
+			<< " primitives (not triangles, sparse or invalid accessors)\n";
+
+	if (meshes.empty()) {
+		std::cerr << "LoadGlb: no triangles in " << path << "\n";
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,31 @@
+#ifndef GLTF_LOADER_H
+#define GLTF_LOADER_H
+
+#include <vector>
+#include <string>
+
+#include <Mesh.h>
+
+/**
+* Native glTF 2.0 binary (".glb") reader, the fast path behind Model for ".glb".
+*
+* The file is memory mapped and its JSON chunk parsed once. Accessors are read
+* straight out of the mapped binary chunk (or external ".bin" buffers, mapped
+* too): one strided copy per vertex attribute, a single memcpy for 32-bit
+* indices, no intermediate scene. Every triangle primitive reached from the
+* default scene becomes one MeshData with its node transform baked in.
+*
+* Materials map onto the TextureType slots: base color -> diffuse, normal ->
+* normal, emissive -> emission, occlusion -> ambient. Images stored inside the
+* file are written once next to it as "<source>.image<N>.<ext>" so the usual
+* texture pipeline (registry, async loads, texture cache) picks them up.
+*/
+
+#define GLB_MAGIC      0x46546C67u // "glTF"
+#define GLB_CHUNK_JSON 0x4E4F534Au // "JSON"
+#define GLB_CHUNK_BIN  0x004E4942u // "BIN\0"
+
+/** parallel: convert primitives on the shared worker pool. Textures are unresolved references (see MeshData) */
+bool LoadGlb(const std::string & path, std::vector<MeshData> & meshes, bool parallel = true);
+
+#endif
@@ -18,6 +18,7 @@
 
 /** Shader Wrapper */
 #include <ShaderProgram.h>
+#include <GLState.h>
 
 /** Camera Wrapper */
 #include <EularCamera.h>
@@ -38,12 +39,12 @@ public:
 	{ setup(); }
 
 	~FrameBuffer() {
-		glDeleteFramebuffers(1, &fbo);
+		GLState::Shared().DeleteFramebuffers(1, &fbo);
 		glDeleteRenderbuffers(1, &rbo);
 	}
 
-	void Bind() { glBindFramebuffer(GL_FRAMEBUFFER, fbo); }
-	void Unbind() { glBindFramebuffer(GL_FRAMEBUFFER, 0); }
+	void Bind() { GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, fbo); }
+	void Unbind() { GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, 0); }
 
 	unsigned int FBO() { return fbo; }
 	unsigned int RBO() { return rbo; }
@@ -65,10 +66,10 @@ void FrameBuffer :: setup() {
 	#endif
 	// Framebuffer config
 	glGenFramebuffers(1, &fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, fbo);
 	// Crete a color attachment texture
 	glGenTextures(1, &tid);
-	glBindTexture(GL_TEXTURE_2D, tid);
+	GLState::Shared().BindTexture(GL_TEXTURE_2D, tid);
 	// set tex dimensions to screen size (for OSX, double screen size)
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, ratio * width, ratio * height, 0, GL_RGBA, GL_FLOAT, NULL);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -83,7 +84,7 @@ void FrameBuffer :: setup() {
 	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
 	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 		std::cerr << "ERROR: Framebuffer is not complete!\n";
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 
@@ -264,8 +265,8 @@ int main() {
 
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		hdrShader.use();
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, frameBuffer.TID());
+		GLState::Shared().ActiveTexture(GL_TEXTURE0);
+		GLState::Shared().BindTexture(GL_TEXTURE_2D, frameBuffer.TID());
 		hdrShader.setUniform("uHDRBuffer", 0);
 		hdrShader.setUniform("uHDR", use_hdr);
 		hdrShader.setUniform("uExposure", use_exposure);
@@ -334,12 +335,12 @@ bool initOpenGL() {
 	//glViewport(0, 0, gWindowWidth, gWindowHeight);
 
 	// Configure global OpenGL state	
-	glEnable(GL_DEPTH_TEST);
+	GLState::Shared().Enable(GL_DEPTH_TEST);
 
 	// Blending functionality
-	glEnable(GL_BLEND);
+	GLState::Shared().Enable(GL_BLEND);
 	// Tell OpenGL how to calc colors of blended fragments (pixels)
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::Shared().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	// Hide the cursor and capture it
 	glfwSetInputMode(gWindow, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
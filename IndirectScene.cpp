@@ -0,0 +1,334 @@
+#include <IndirectScene.h>
+#include <GLState.h>
+#include <StreamBuffer.h>
+#include <GeometryArena.h>
+#include <Mesh.h>
+#include <Model.h>
+#include <Meshlet.h>
+#include <VertexPacking.h>
+#include <EularCamera.h>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// The command layout GL reads, the struct layout the shaders see
+static_assert(sizeof(IndirectCommand) == 5 * sizeof(GLuint), "DrawElementsIndirectCommand is 20 bytes");
+static_assert(sizeof(IndirectInstance) == 80, "Indirect_Instance_t is 80 bytes");
+static_assert(sizeof(IndirectMesh) == 64, "Indirect_Mesh_t is 64 bytes");
+
+/** Writes bytes at the start of buffer (data NULL: only sizes it), reallocating it (same name) when it outgrew capacity */
+static void uploadStorage(GLuint buffer, size_t & capacity, const void * data, size_t bytes) {
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	if (bytes > capacity) {
+		capacity = bytes + bytes / 2;
+		glBufferData(GL_SHADER_STORAGE_BUFFER, capacity, NULL, GL_DYNAMIC_DRAW);
+	}
+	if (bytes > 0 && data)
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, bytes, data);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+IndirectScene :: IndirectScene()
+	: mInstancesDirty(true),
+	mInstanceBuffer(0), mVisibleBuffer(0),
+	mInstanceCapacity(0), mVisibleCapacity(0),
+	mStats()
+{
+}
+
+IndirectScene :: ~IndirectScene() {
+
+	for (PageVao & page : mPageVaos)
+		if (page.vao)
+			GLState::Shared().DeleteVertexArrays(1, &page.vao);
+	if (mInstanceBuffer) {
+		GLuint buffers[] = { mInstanceBuffer, mVisibleBuffer };
+		glDeleteBuffers(2, buffers);
+	}
+}
+
+bool IndirectScene :: Supported() {
+
+	if (!GLAD_GL_VERSION_4_3)
+		return false;
+	// 4.3 allows no storage blocks in vertex shaders, indirect.vert needs one
+	GLint vertexBlocks = 0;
+	glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &vertexBlocks);
+	return vertexBlocks > 0;
+}
+
+int IndirectScene :: AddMesh(Mesh & mesh, Model * owner) {
+
+	if (mesh.Geometry() == 0)
+		return -1;
+	for (size_t i=0; i<mMeshes.size(); i++)
+		if (mMeshes[i].mesh == &mesh)
+			return (int) i;
+
+	mMeshes.push_back(Entry{ &mesh, owner, 0, 0 });
+	return (int) mMeshes.size() - 1;
+}
+
+int IndirectScene :: AddInstance(int mesh, const glm::mat4 & modelMatrix) {
+
+	if (mesh < 0 || mesh >= (int) mMeshes.size())
+		return -1;
+
+	IndirectInstance instance;
+	instance.mesh = (unsigned int) mesh;
+	instance.lod = 0;
+	mInstances.push_back(instance);
+	mMeshes[mesh].instances++;
+
+	SetInstance((int) mInstances.size() - 1, modelMatrix);
+	return (int) mInstances.size() - 1;
+}
+
+void IndirectScene :: SetInstance(int instance, const glm::mat4 & modelMatrix) {
+
+	if (instance < 0 || instance >= (int) mInstances.size())
+		return;
+
+	// Bounding spheres grow by the largest axis scale
+	IndirectInstance & placed = mInstances[instance];
+	placed.model = modelMatrix;
+	placed.scale = std::max(glm::length(glm::vec3(modelMatrix[0])),
+		std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+	mInstancesDirty = true;
+}
+
+void IndirectScene :: AddModel(Model & model, const glm::mat4 & modelMatrix) {
+
+	for (Mesh & mesh : model.meshes)
+		AddInstance(AddMesh(mesh, &model), modelMatrix);
+}
+
+void IndirectScene :: Clear() {
+
+	mMeshes.clear();
+	mInstances.clear();
+	mInstancesDirty = true;
+}
+
+void IndirectScene :: create() {
+
+	GLuint buffers[2];
+	glGenBuffers(2, buffers);
+	mInstanceBuffer = buffers[0];
+	mVisibleBuffer  = buffers[1];
+
+	mCull.loadCompute("shaders/indirect_cull.comp");
+	for (int i=0; i<6; i++)
+		mFrustumUniforms[i] = mCull.uniform(("uFrustum[" + std::to_string(i) + "]").c_str());
+	mInstanceCountUniform = mCull.uniform("uInstanceCount");
+	mEyeUniform = mCull.uniform("uEye");
+	mPixelsPerUnitUniform = mCull.uniform("uPixelsPerUnit");
+}
+
+void IndirectScene :: uploadInstances() {
+
+	// Each level of a mesh owns a run of the visible list as long as its instance count
+	unsigned int slot = 0;
+	for (Entry & entry : mMeshes) {
+		entry.firstSlot = slot;
+		slot += entry.instances * (unsigned int) entry.mesh->LodCount();
+	}
+
+	uploadStorage(mInstanceBuffer, mInstanceCapacity, mInstances.data(), mInstances.size() * sizeof(IndirectInstance));
+	uploadStorage(mVisibleBuffer, mVisibleCapacity, NULL, slot * sizeof(GLuint));
+	mInstancesDirty = false;
+}
+
+void IndirectScene :: buildCommands() {
+
+	/**
+	* One command per mesh and level, the culling pass picks the level of each
+	* instance. Ordered so the commands one multi-draw covers are consecutive:
+	* page (VAO), index type, material. O(meshes) with a sort, instances never
+	* show up here.
+	*/
+	struct CommandKey {
+		unsigned int page;
+		GLenum indexType;
+		Model * owner;
+		uint64_t material;
+		size_t entry;
+	};
+
+	std::vector<CommandKey> keys;
+	keys.reserve(mMeshes.size());
+	size_t commandCount = 0;
+	for (size_t i=0; i<mMeshes.size(); i++) {
+		commandCount += mMeshes[i].mesh->LodCount();
+		const Entry & entry = mMeshes[i];
+		const GeometryRange * range = GeometryArena::Shared().Range(entry.mesh->Geometry());
+		keys.push_back(CommandKey{ range ? range->page : ~0u, range ? range->indexType : 0,
+			entry.owner, entry.mesh->MaterialKey(), i });
+	}
+	std::sort(keys.begin(), keys.end(), [](const CommandKey & a, const CommandKey & b) {
+		if (a.page != b.page) return a.page < b.page;
+		if (a.indexType != b.indexType) return a.indexType < b.indexType;
+		if (a.owner != b.owner) return a.owner < b.owner;
+		if (a.material != b.material) return a.material < b.material;
+		return a.entry < b.entry;
+	});
+
+	mCommands.resize(commandCount);
+	mMeshData.resize(mMeshes.size());
+	mBatches.clear();
+	size_t next = 0;
+	for (size_t i=0; i<keys.size(); i++) {
+
+		const Entry & entry = mMeshes[keys[i].entry];
+		Mesh & mesh = *entry.mesh;
+		const GeometryRange * range = GeometryArena::Shared().Range(mesh.Geometry());
+		size_t levels = std::min(mesh.LodCount(), (size_t) MESH_SIMPLIFIER_MAX_LEVELS);
+
+		IndirectMesh & data = mMeshData[keys[i].entry];
+		data.center = mesh.Center();
+		data.radius = mesh.Radius();
+		data.command = (unsigned int) next;
+		data.levels = (unsigned int) levels;
+		for (size_t level=0; level<MESH_SIMPLIFIER_MAX_LEVELS; level++)
+			data.errors[level] = level < levels ? mesh.LodError(level) : 0.0f;
+
+		// Freed range: the culling pass may still count into it, nothing is drawn
+		size_t first = next;
+		for (size_t level=0; level<levels; level++) {
+			IndirectCommand & command = mCommands[next++];
+			command.count = 0;
+			command.instanceCount = 0;
+			command.firstIndex = 0;
+			command.baseVertex = 0;
+			command.baseInstance = entry.firstSlot + (unsigned int) level * entry.instances;
+			if (!range)
+				continue;
+
+			// firstIndex counts indices of the range's type from the start of the page buffer (offsets are 4-byte aligned)
+			size_t indexSize = range->indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+			command.count = (unsigned int) mesh.LodIndexCount(level);
+			command.firstIndex = (unsigned int) (range->indexOffset / indexSize + mesh.LodFirstIndex(level));
+			command.baseVertex = range->baseVertex;
+		}
+		if (!range)
+			continue;
+
+		bool sameBatch = !mBatches.empty() && i > 0
+			&& keys[i - 1].page == keys[i].page && keys[i - 1].indexType == keys[i].indexType
+			&& keys[i - 1].owner == keys[i].owner && keys[i - 1].material == keys[i].material;
+		if (sameBatch) {
+			mBatches.back().count += levels;
+			continue;
+		}
+		mBatches.push_back(Batch{ pageVao(*range), range->indexType, first, levels, &mesh, keys[i].material, entry.owner });
+	}
+	mCommands.resize(next);
+}
+
+GLuint IndirectScene :: pageVao(const GeometryRange & range) {
+
+	if (range.page >= mPageVaos.size())
+		mPageVaos.resize(range.page + 1, PageVao{ 0, 0, 0, VERTEX_FULL });
+
+	PageVao & page = mPageVaos[range.page];
+	GLuint vbo = 0, ebo = 0;
+	GeometryArena::Shared().PageBuffers(range.page, vbo, ebo);
+	if (page.vao && page.vbo == vbo && page.ebo == ebo && page.format == range.format)
+		return page.vao;
+
+	// The arena's attributes over the same buffers (Compact() replaces them), plus the visible list
+	if (!page.vao)
+		glGenVertexArrays(1, &page.vao);
+	GLState::Shared().BindVertexArray(page.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	SetupVertexAttributes(range.format);
+	glBindBuffer(GL_ARRAY_BUFFER, mVisibleBuffer);
+	glEnableVertexAttribArray(INDIRECT_VISIBLE_ATTRIBUTE);
+	glVertexAttribIPointer(INDIRECT_VISIBLE_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+	glVertexAttribDivisor(INDIRECT_VISIBLE_ATTRIBUTE, 1); // stepped from the command's baseInstance
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	page.vbo = vbo;
+	page.ebo = ebo;
+	page.format = range.format;
+	return page.vao;
+}
+
+void IndirectScene :: Draw(Shader & shader, const glm::mat4 & viewProjection, const Camera & camera,
+	float viewportHeight) {
+
+	mStats = IndirectSceneStats{ mMeshes.size(), mInstances.size(), 0, 0 };
+	if (mInstances.empty())
+		return;
+
+	if (!mInstanceBuffer)
+		create();
+	for (const Entry & entry : mMeshes)
+		if (entry.owner)
+			entry.owner->ResolveTextures();
+	if (mInstancesDirty)
+		uploadInstances();
+
+	// Rebuilt every draw: the stream ring, so the writes never wait on the GPU reading last frame's
+	buildCommands();
+	StreamRange meshes = StreamBuffer::Shared().UploadStorage(mMeshData.data(), mMeshData.size() * sizeof(IndirectMesh));
+	StreamRange commands = StreamBuffer::Shared().UploadStorage(mCommands.data(), mCommands.size() * sizeof(IndirectCommand));
+	if (!meshes.buffer || !commands.buffer) {
+		std::cerr << "IndirectScene: " << mMeshes.size() << " meshes do not fit a StreamBuffer region" << std::endl;
+		return;
+	}
+	mStats.commands = mCommands.size();
+
+	// Cull: survivors are counted into instanceCount and listed from baseInstance on
+	Frustum frustum = ExtractFrustum(viewProjection);
+	mCull.use();
+	for (int i=0; i<6; i++)
+		mCull.setUniform(mFrustumUniforms[i], frustum.planes[i]);
+	mCull.setUniform(mInstanceCountUniform, (int) mInstances.size());
+	mCull.setUniform(mEyeUniform, camera.position);
+	mCull.setUniform(mPixelsPerUnitUniform, viewportHeight * 0.5f / std::tan(glm::radians(camera.fov) * 0.5f));
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_INSTANCE_BINDING, mInstanceBuffer);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, INDIRECT_MESH_BINDING, meshes.buffer, meshes.offset, meshes.size);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, INDIRECT_COMMAND_BINDING, commands.buffer, commands.offset, commands.size);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_VISIBLE_BINDING, mVisibleBuffer);
+	GLuint groups = (GLuint) ((mInstances.size() + INDIRECT_CULL_GROUP_SIZE - 1) / INDIRECT_CULL_GROUP_SIZE);
+	glDispatchCompute(groups, 1, 1);
+	// Commands are read by the draw, the visible list as a vertex attribute, levels by the next pass
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+	// Draw: textures per batch, one multi-draw over its commands
+	shader.use();
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commands.buffer);
+	Model * boundOwner = NULL;
+	uint64_t boundMaterial = 0;
+	bool materialBound = false;
+	for (const Batch & batch : mBatches) {
+
+		if (batch.owner && batch.owner != boundOwner) {
+			batch.owner->BindMaterials(shader);
+			boundOwner = batch.owner;
+		}
+		if (!materialBound || batch.materialKey != boundMaterial) {
+			batch.material->BindTextures(shader);
+			boundMaterial = batch.materialKey;
+			materialBound = true;
+		}
+
+		GLState::Shared().BindVertexArray(batch.vao);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, batch.indexType,
+			(const void *) (commands.offset + batch.first * sizeof(IndirectCommand)), (GLsizei) batch.count, 0);
+		mStats.draws++;
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	GLState::Shared().ActiveTexture(GL_TEXTURE0);
+}
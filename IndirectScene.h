@@ -0,0 +1,166 @@
+#ifndef INDIRECT_SCENE_H
+#define INDIRECT_SCENE_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <BlockLayout.h>
+#include <ShaderProgram.h>
+#include <GeometryArena.h>
+#include <VertexPacking.h>
+#include <MeshSimplifier.h>
+
+class Mesh;
+class Model;
+class Camera;
+
+/** Storage blocks of the culling pass and of indirect.vert, "#pragma block <name>" */
+#define INDIRECT_INSTANCE_BLOCK "uIndirectInstances"
+#define INDIRECT_MESH_BLOCK     "uIndirectMeshes"
+#define INDIRECT_COMMAND_BLOCK  "uIndirectCommands"
+#define INDIRECT_VISIBLE_BLOCK  "uIndirectVisible"
+#define INDIRECT_INSTANCE_BINDING 0
+#define INDIRECT_MESH_BINDING     1
+#define INDIRECT_COMMAND_BINDING  2
+#define INDIRECT_VISIBLE_BINDING  3
+
+#define INDIRECT_VISIBLE_ATTRIBUTE 5  // per-instance uint, the vertex formats take 0-4
+#define INDIRECT_CULL_GROUP_SIZE   64 // local_size_x of indirect_cull.comp
+
+/**
+* One placement of a mesh: object to world, the largest axis scale for its bounding
+* sphere, and the level the culling pass last picked for it (hysteresis, as UpdateLod)
+*/
+#define INDIRECT_INSTANCE_FIELDS(FIELD) \
+	FIELD(model, glm::mat4)             \
+	FIELD(mesh, unsigned int)           \
+	FIELD(scale, float)                 \
+	FIELD(lod, unsigned int)
+BLOCK_STRUCT(IndirectInstance, "Indirect_Instance_t", Std430, INDIRECT_INSTANCE_FIELDS);
+
+/** Object space bounding sphere, the command of level 0 (the others follow) and the error of each level */
+#define INDIRECT_MESH_FIELDS(FIELD) \
+	FIELD(center, glm::vec3)        \
+	FIELD(radius, float)            \
+	FIELD(command, unsigned int)    \
+	FIELD(levels, unsigned int)     \
+	FIELD(errors, BlockArray<float, MESH_SIMPLIFIER_MAX_LEVELS, Std430>)
+BLOCK_STRUCT(IndirectMesh, "Indirect_Mesh_t", Std430, INDIRECT_MESH_FIELDS);
+
+/** DrawElementsIndirectCommand: what glMultiDrawElementsIndirect reads, 20 bytes apart */
+#define INDIRECT_COMMAND_FIELDS(FIELD) \
+	FIELD(count, unsigned int)         \
+	FIELD(instanceCount, unsigned int) \
+	FIELD(firstIndex, unsigned int)    \
+	FIELD(baseVertex, int)             \
+	FIELD(baseInstance, unsigned int)
+BLOCK_STRUCT(IndirectCommand, "Draw_Command_t", Std430, INDIRECT_COMMAND_FIELDS);
+
+struct IndirectSceneStats {
+	size_t meshes;
+	size_t instances; // culled on the GPU, how many survive is never read back
+	size_t commands;
+	size_t draws;     // glMultiDrawElementsIndirect calls
+};
+
+/**
+* Static placements of arena meshes drawn without a CPU loop over them (GL 4.3):
+* a compute pass frustum-culls every instance, picks its level of detail as
+* Model::UpdateLod would, and counts the survivors into one DrawElementsIndirectCommand
+* per mesh and level, then glMultiDrawElementsIndirect submits the commands.
+* indirect.vert fetches the model matrix through the visible list (attribute
+* INDIRECT_VISIBLE_ATTRIBUTE, stepped by baseInstance).
+*
+*   scene.AddModel(model, modelMatrix);      // once
+*   ...
+*   scene.Draw(shader, projection * view, camera, viewportHeight);
+*
+* Textures are still bound per draw call: commands are grouped into one
+* multi-draw per arena page, index type and material. Meshes with their own
+* buffers (MODEL_OWN_BUFFERS) are not taken. GL thread only; meshes and models
+* must outlive the scene's use of them.
+*/
+class IndirectScene {
+
+public:
+	IndirectScene();
+	~IndirectScene();
+
+	/** The context has compute shaders, storage blocks and indirect multi-draws */
+	static bool Supported();
+
+	/**
+	* Index of the mesh in the scene, added on first use. owner: the model whose
+	* textures and materials it uses (ResolveTextures / BindMaterials), may be NULL.
+	* -1 for meshes outside the arena.
+	*/
+	int AddMesh(Mesh & mesh, Model * owner = NULL);
+	/** Returns the instance index, -1 for an unknown mesh */
+	int AddInstance(int mesh, const glm::mat4 & modelMatrix);
+	void SetInstance(int instance, const glm::mat4 & modelMatrix);
+	/** Every arena mesh of the model at modelMatrix */
+	void AddModel(Model & model, const glm::mat4 & modelMatrix);
+	void Clear();
+
+	/**
+	* Culls and draws every instance with shader (indirect.vert), uFrame must be up to date.
+	* camera and viewportHeight size the level errors in pixels, per instance
+	*/
+	void Draw(Shader & shader, const glm::mat4 & viewProjection, const Camera & camera, float viewportHeight);
+
+	IndirectSceneStats Stats() const { return mStats; }
+
+private:
+	struct Entry {
+		Mesh * mesh;
+		Model * owner;
+		unsigned int instances;
+		unsigned int firstSlot; // of the visible list, level 0's baseInstance; each level has a run of instances slots
+	};
+
+	/** Commands [first, first + count) drawn with one glMultiDrawElementsIndirect */
+	struct Batch {
+		GLuint vao;
+		GLenum indexType;
+		size_t first, count;
+		Mesh * material;  // binds the textures of the run
+		uint64_t materialKey;
+		Model * owner;
+	};
+
+	/** Page VAO of the scene: the arena buffers plus the visible list */
+	struct PageVao {
+		GLuint vao, vbo, ebo;
+		VertexFormat format;
+	};
+
+	std::vector<Entry> mMeshes;
+	std::vector<IndirectInstance> mInstances;
+	bool mInstancesDirty;
+
+	std::vector<IndirectMesh> mMeshData;       // rebuilt every draw
+	std::vector<IndirectCommand> mCommands;
+	std::vector<Batch> mBatches;
+	std::vector<PageVao> mPageVaos;            // by arena page
+
+	GLuint mInstanceBuffer, mVisibleBuffer; // meshes and commands go through StreamBuffer::Shared()
+	size_t mInstanceCapacity, mVisibleCapacity; // bytes
+	Shader mCull;
+	UniformHandle mFrustumUniforms[6];
+	UniformHandle mInstanceCountUniform;
+	UniformHandle mEyeUniform;
+	UniformHandle mPixelsPerUnitUniform;
+
+	IndirectSceneStats mStats;
+
+	void create();
+	void uploadInstances();
+	void buildCommands();
+	GLuint pageVao(const GeometryRange & range);
+};
+
+#endif
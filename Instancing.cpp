@@ -17,12 +17,16 @@
 
 /** Shader Wrapper */
 #include <ShaderProgram.h>
+#include <GLState.h>
+#include <StreamBuffer.h>
+#include <FrameUniforms.h>
 
 /** Camera Wrapper */
 #include <EularCamera.h>
 
 /** Model Wrapper */
 #include <Model.h>
+#include <IndirectScene.h>
 
 // Global Variables
 const char* APP_TITLE = "Advanced OpenGL - Instancing";
@@ -65,13 +69,18 @@ int main() {
 	//Model objectFarmhouseModel("Resources/farmhouse/farmhouse.obj");
 	//Model objectIndustrialFansModel("Resources/IndustrialFans/IndustrialFans.obj");
 	//Model objectNanosuit("Resources/nanosuit/nanosuit.obj");
-	Model objectPlanet("Resources/planet/planet.obj");
-	Model objectRock("Resources/rock/rock.obj");
+	Model objectPlanet("Resources/planet/planet.obj", false, MODEL_LOD);
+	// GL 4.3: rocks culled and drawn on the GPU from the arena, else instance attributes go into their own VAOs
+	bool gpuRocks = IndirectScene::Supported();
+	Model objectRock("Resources/rock/rock.obj", false, gpuRocks ? MODEL_LOD : MODEL_OWN_BUFFERS | MODEL_LOD);
 
 	// Shader loader
 	Shader objectShader, instanceShader;
 	objectShader.loadShaders("shaders/demo.vert", "shaders/demo.frag");
-	instanceShader.loadShaders("shaders/instancing.vert", "shaders/instancing.frag");
+	if (gpuRocks)
+		instanceShader.loadShaders("shaders/indirect.vert", "shaders/instancing.frag");
+	else
+		instanceShader.loadShaders("shaders/instancing.vert", "shaders/instancing.frag");
 
 
 
@@ -84,35 +93,22 @@ int main() {
 	};
 	glm::vec3 directionalLightDirection(1.0f, -1.0f, 0.0f);
 
-	// Object shader config
-	objectShader.use();
-	// Light config
-	objectShader.setUniform("uDirectionalLight.direction", directionalLightDirection);
-	objectShader.setUniform("uDirectionalLight.ambient", 0.5f, 0.5f, 0.5f);
-	objectShader.setUniform("uDirectionalLight.diffuse", 1.0f, 1.0f, 1.0f);
-	objectShader.setUniform("uDirectionalLight.specular", 1.0f, 1.0f, 1.0f);
-	objectShader.setUniform("uSpotLight.innerCutOff", glm::cos(glm::radians(12.5f)));
-	objectShader.setUniform("uSpotLight.outerCutOff", glm::cos(glm::radians(17.5f)));
-	objectShader.setUniform("uSpotLight.ambient", 0.0f, 0.0f, 0.0f);
-	objectShader.setUniform("uSpotLight.diffuse", 1.0f, 1.0f, 1.0f);
-	objectShader.setUniform("uSpotLight.specular", 1.0f, 1.0f, 1.0f);
-	objectShader.setUniform("uSpotLight.constant", 1.0f);
-	objectShader.setUniform("uSpotLight.linear", 0.09f);
-	objectShader.setUniform("uSpotLight.quadratic", 0.032f);
-
-	instanceShader.use();
-	instanceShader.setUniform("uDirectionalLight.direction", directionalLightDirection);
-	instanceShader.setUniform("uDirectionalLight.ambient", 0.5f, 0.5f, 0.5f);
-	instanceShader.setUniform("uDirectionalLight.diffuse", 1.0f, 1.0f, 1.0f);
-	instanceShader.setUniform("uDirectionalLight.specular", 1.0f, 1.0f, 1.0f);
-	instanceShader.setUniform("uSpotLight.innerCutOff", glm::cos(glm::radians(12.5f)));
-	instanceShader.setUniform("uSpotLight.outerCutOff", glm::cos(glm::radians(17.5f)));
-	instanceShader.setUniform("uSpotLight.ambient", 0.0f, 0.0f, 0.0f);
-	instanceShader.setUniform("uSpotLight.diffuse", 1.0f, 1.0f, 1.0f);
-	instanceShader.setUniform("uSpotLight.specular", 1.0f, 1.0f, 1.0f);
-	instanceShader.setUniform("uSpotLight.constant", 1.0f);
-	instanceShader.setUniform("uSpotLight.linear", 0.09f);
-	instanceShader.setUniform("uSpotLight.quadratic", 0.032f);
+	// Light config, shared by every shader through the uLights block
+	LightBlock & lights = FrameUniforms::Shared().Lights();
+	// Directional light
+	lights.uDirectionalLight.direction = directionalLightDirection;
+	lights.uDirectionalLight.ambient = glm::vec3(0.5f, 0.5f, 0.5f);
+	lights.uDirectionalLight.diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+	lights.uDirectionalLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+	// Spot light, follows the camera
+	lights.uSpotLight.innerCutOff = glm::cos(glm::radians(12.5f));
+	lights.uSpotLight.outerCutOff = glm::cos(glm::radians(17.5f));
+	lights.uSpotLight.ambient = glm::vec3(0.0f, 0.0f, 0.0f);
+	lights.uSpotLight.diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+	lights.uSpotLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+	lights.uSpotLight.constant = 1.0f;
+	lights.uSpotLight.linear = 0.09f;
+	lights.uSpotLight.quadratic = 0.032f;
 
 
 
@@ -145,32 +141,41 @@ int main() {
 		modelMatrices[i] = matrix;
 	}
 
-	unsigned int ibo;
-	glGenBuffers(1, &ibo);
-	glBindBuffer(GL_ARRAY_BUFFER, ibo);
-	glBufferData(GL_ARRAY_BUFFER, cnt_obj * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
-
-	for (Mesh & mesh : objectRock.meshes) {
-
-		unsigned rockVAO = mesh.VAO();
-		glBindVertexArray(rockVAO);
-		size_t vec4Size = (int) sizeof(glm::vec4);
-
-		glEnableVertexAttribArray(3);
-		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)0);
-		glEnableVertexAttribArray(4);
-		glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(vec4Size));
-		glEnableVertexAttribArray(5);
-		glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(2 * vec4Size));
-		glEnableVertexAttribArray(6);
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(3 * vec4Size));
+	IndirectScene rockScene;
+	if (gpuRocks) {
+		for (Mesh & mesh : objectRock.meshes) {
+			int rock = rockScene.AddMesh(mesh, &objectRock);
+			for (unsigned int i=0; i<cnt_obj; i++)
+				rockScene.AddInstance(rock, modelMatrices[i]);
+		}
+	} else {
+		unsigned int ibo;
+		glGenBuffers(1, &ibo);
+		glBindBuffer(GL_ARRAY_BUFFER, ibo);
+		glBufferData(GL_ARRAY_BUFFER, cnt_obj * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
 
-		glVertexAttribDivisor(3, 1);
-		glVertexAttribDivisor(4, 1);
-		glVertexAttribDivisor(5, 1);
-		glVertexAttribDivisor(6, 1);
+		for (Mesh & mesh : objectRock.meshes) {
 
-		glBindVertexArray(0);
+			unsigned rockVAO = mesh.VAO();
+			GLState::Shared().BindVertexArray(rockVAO);
+			size_t vec4Size = (int) sizeof(glm::vec4);
+
+			glEnableVertexAttribArray(3);
+			glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)0);
+			glEnableVertexAttribArray(4);
+			glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(vec4Size));
+			glEnableVertexAttribArray(5);
+			glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(2 * vec4Size));
+			glEnableVertexAttribArray(6);
+			glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(3 * vec4Size));
+
+			glVertexAttribDivisor(3, 1);
+			glVertexAttribDivisor(4, 1);
+			glVertexAttribDivisor(5, 1);
+			glVertexAttribDivisor(6, 1);
+
+			GLState::Shared().BindVertexArray(0);
+		}
 	}
 
 
@@ -204,20 +209,12 @@ int main() {
 		glm::mat4 projection = glm::perspective(glm::radians(camera.fov), width_height_ratio, 0.1f, 1000.0f);
 		//glm::mat4 projection = glm::ortho(-1.0f, 1.0f, -1.0f, 1.0f, 1.0f, 100.0f);
 
-		objectShader.use();
-		objectShader.setUniform("uView", view);
-		objectShader.setUniform("uProjection", projection);
-		objectShader.setUniform("uCameraPos", camera.position);
-
-		objectShader.setUniform("uSpotLight.position", camera.position);
-		objectShader.setUniform("uSpotLight.direction", camera.front);
-
-		instanceShader.use();
-		instanceShader.setUniform("uView", view);
-		instanceShader.setUniform("uProjection", projection);
-		instanceShader.setUniform("uCameraPos", camera.position);
-		instanceShader.setUniform("uSpotLight.position", camera.position);
-		instanceShader.setUniform("uSpotLight.direction", camera.front);
+		// Per-frame engine uniforms: one buffer write for every shader
+		FrameUniforms::Shared().SetCamera(view, projection, camera.position, camera.front);
+		FrameUniforms::Shared().SetTime((float) glfwGetTime());
+		FrameUniforms::Shared().Lights().uSpotLight.position = camera.position;
+		FrameUniforms::Shared().Lights().uSpotLight.direction = camera.front;
+		FrameUniforms::Shared().Update();
 
 		// Draw Models
 		glm::mat4 modelMatrix;
@@ -227,19 +224,30 @@ int main() {
 		modelMatrix = glm::scale(modelMatrix, glm::vec3(4.0f, 4.0f, 4.0f));
 		objectShader.use();
 		objectShader.setUniform("uModel", modelMatrix);
+		objectPlanet.UpdateLod(camera, modelMatrix, (float) gWindowHeight);
 		objectPlanet.Draw(objectShader);
 
 		// To see difference between using Instancing (1) and not (2)
 
 		// (1)
-		instanceShader.use();
-		instanceShader.setUniform("uMaterial.texture_diffuse1", 0);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, objectRock.textures_loaded[0].id);
-		for (Mesh & mesh : objectRock.meshes) {
-			glBindVertexArray(mesh.VAO());
-			glDrawElementsInstanced(GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_INT, 0, cnt_obj);
-			glBindVertexArray(0);
+		if (gpuRocks) {
+			// Only the rocks in view are drawn, culled and given their level by a compute pass: no CPU work per rock
+			rockScene.Draw(instanceShader, projection * view, camera, (float) gWindowHeight);
+		} else {
+			// Every rock shares the level of one draw: pick it for the largest rock on the ring point closest to the camera
+			glm::vec3 toCamera(camera.position.x, 0.0f, camera.position.z);
+			float ringDistance = glm::clamp(glm::length(toCamera), radius - offset, radius + offset);
+			glm::vec3 ringPoint = glm::length(toCamera) > 0.0f ? glm::normalize(toCamera) * ringDistance : glm::vec3(ringDistance, 0.0f, 0.0f);
+			glm::mat4 nearestRock = glm::scale(glm::translate(glm::mat4(1.0f), ringPoint), glm::vec3(0.25f));
+			objectRock.UpdateLod(camera, nearestRock, (float) gWindowHeight);
+
+			instanceShader.use();
+			instanceShader.setUniform("uMaterial.texture_diffuse1", 0);
+			GLState::Shared().ActiveTexture(GL_TEXTURE0);
+			GLState::Shared().BindTexture(GL_TEXTURE_2D, objectRock.textures_loaded[0].id);
+			for (Mesh & mesh : objectRock.meshes) {
+				mesh.DrawGeometry(cnt_obj);
+			}
 		}
 		
 		// (2)
@@ -251,6 +259,9 @@ int main() {
 
 
 
+		// This frame's uploads are fenced, the next one writes the next region of the ring
+		StreamBuffer::Shared().EndFrame();
+
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		glfwPollEvents();
 		glfwSwapBuffers(gWindow);
@@ -274,7 +285,8 @@ bool initOpenGL() {
 		return false;
 	}
 
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	// 4.3 for IndirectScene (compute, storage blocks), 3.3 below
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	// forward compatible with newer versions of OpenGL as they become available
@@ -283,8 +295,13 @@ bool initOpenGL() {
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-	// Create an OpenGL 3.3 core, forward compatible context window
+	// Create an OpenGL 4.3 (else 3.3) core, forward compatible context window
 	gWindow = glfwCreateWindow(gWindowWidth, gWindowHeight, APP_TITLE, NULL, NULL);
+	if (gWindow == NULL) {
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		gWindow = glfwCreateWindow(gWindowWidth, gWindowHeight, APP_TITLE, NULL, NULL);
+	}
 	if (gWindow == NULL) {
 		std::cerr << "Failed to create GLFW window" << std::endl;
 		glfwTerminate();
@@ -312,12 +329,12 @@ bool initOpenGL() {
 	//glViewport(0, 0, gWindowWidth, gWindowHeight);
 
 	// Configure global OpenGL state	
-	glEnable(GL_DEPTH_TEST);
+	GLState::Shared().Enable(GL_DEPTH_TEST);
 
 	// Blending functionality
-	glEnable(GL_BLEND);
+	GLState::Shared().Enable(GL_BLEND);
 	// Tell OpenGL how to calc colors of blended fragments (pixels)
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::Shared().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	// Hide the cursor and capture it
 	glfwSetInputMode(gWindow, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -0,0 +1,160 @@
+#include <MappedFile.h>
+
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN 1
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <iostream>
+#include <string>
+#include <atomic>
+#include <climits>
+#include <cstdlib>
+
+MappedFile :: MappedFile()
+	: mData(NULL), mSize(0)
+#ifdef _WIN32
+	, mFile(NULL), mMapping(NULL)
+#endif
+{}
+
+MappedFile :: MappedFile(const std::string & filename)
+	: MappedFile()
+{
+	Open(filename);
+}
+
+MappedFile :: ~MappedFile() {
+	Close();
+}
+
+bool MappedFile :: Open(const std::string & filename) {
+
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		CloseHandle(file);
+		return false;
+	}
+
+	void * view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == NULL) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	mFile    = file;
+	mMapping = mapping;
+	mData    = (const unsigned char *) view;
+	mSize    = (size_t) size.QuadPart;
+#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return false;
+	}
+
+	void * view = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping keeps its own reference to the file
+	if (view == MAP_FAILED) {
+		std::cerr << "MappedFile::Open: mmap failed for " << filename << "\n";
+		return false;
+	}
+
+	mData = (const unsigned char *) view;
+	mSize = (size_t) st.st_size;
+#endif
+
+	return true;
+}
+
+void MappedFile :: Close() {
+
+	if (!mData)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(mData);
+	CloseHandle((HANDLE) mMapping);
+	CloseHandle((HANDLE) mFile);
+	mFile    = NULL;
+	mMapping = NULL;
+#else
+	munmap((void *) mData, mSize);
+#endif
+
+	mData = NULL;
+	mSize = 0;
+}
+
+long long FileModifiedTime(const std::string & filename) {
+	struct stat st;
+	if (stat(filename.c_str(), &st) != 0)
+		return 0;
+	return (long long) st.st_mtime;
+}
+
+FileStamp GetFileStamp(const std::string & filename) {
+	FileStamp stamp = { 0, 0 };
+	struct stat st;
+	if (stat(filename.c_str(), &st) != 0)
+		return stamp;
+	stamp.time = (int64_t) st.st_mtime * 1000000000;
+#if defined(__APPLE__)
+	stamp.time += st.st_mtimespec.tv_nsec;
+#elif !defined(_WIN32)
+	stamp.time += st.st_mtim.tv_nsec;
+#endif
+	stamp.size = (uint64_t) st.st_size;
+	return stamp;
+}
+
+std::string CanonicalPath(const std::string & filename) {
+#ifdef _WIN32
+	char buffer[MAX_PATH];
+	if (!_fullpath(buffer, filename.c_str(), MAX_PATH) || FileModifiedTime(buffer) == 0)
+		return std::string();
+	return std::string(buffer);
+#else
+	char buffer[PATH_MAX];
+	if (!realpath(filename.c_str(), buffer))
+		return std::string();
+	return std::string(buffer);
+#endif
+}
+
+std::string UniqueTempPath(const std::string & target) {
+	static std::atomic<unsigned int> counter(0);
+#ifdef _WIN32
+	unsigned long process = (unsigned long) GetCurrentProcessId();
+#else
+	unsigned long process = (unsigned long) getpid();
+#endif
+	return target + "." + std::to_string(process) + "." + std::to_string(counter++) + ".tmp";
+}
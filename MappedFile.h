@@ -0,0 +1,60 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+/**
+* Read-only memory mapping of a whole file.
+* The view stays valid until Close() or destruction.
+*/
+class MappedFile {
+
+public:
+	MappedFile();
+	MappedFile(const std::string & filename);
+	~MappedFile();
+
+	bool Open(const std::string & filename);
+	void Close();
+
+	bool IsOpen() const { return mData != NULL; }
+	const unsigned char * Data() const { return mData; }
+	size_t Size() const { return mSize; }
+
+private:
+	const unsigned char * mData;
+	size_t mSize;
+#ifdef _WIN32
+	void * mFile;
+	void * mMapping;
+#endif
+
+	/** Non-copyable: the mapping is owned */
+	MappedFile(const MappedFile &) = delete;
+	MappedFile & operator=(const MappedFile &) = delete;
+};
+
+/** Modification time of a file in seconds, 0 if it does not exist */
+long long FileModifiedTime(const std::string & filename);
+
+/** What a cache records of a source to notice any edit: compared for equality, never ordered */
+struct FileStamp {
+	int64_t time;  // modification time in nanoseconds (whole seconds where the platform has nothing finer)
+	uint64_t size;
+
+	bool operator==(const FileStamp & other) const { return time == other.time && size == other.size; }
+	bool operator!=(const FileStamp & other) const { return !(*this == other); }
+};
+
+/** Both 0 if the file does not exist */
+FileStamp GetFileStamp(const std::string & filename);
+
+/** Absolute path with "." / ".." and links resolved, empty if the file does not exist */
+std::string CanonicalPath(const std::string & filename);
+
+/** Name next to target to write it under before renaming: never the same for two writers, threads or processes */
+std::string UniqueTempPath(const std::string & target);
+
+#endif
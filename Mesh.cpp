@@ -1,96 +1,298 @@
 #include <Mesh.h>
 #include <ShaderProgram.h>
+#include <GLState.h>
 #include <Texture.h>
+#include <VertexPacking.h>
+#include <GeometryArena.h>
+#include <MeshSimplifier.h>
+#include <Meshlet.h>
+#include <VirtualTexture.h>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
 #include <vector>
 #include <string>
+#include <utility>
 
 Mesh :: Mesh(
 	std::vector<Vertex> vertices,
 	std::vector<GLuint> indices,
-	std::vector<Texture> textures) :
-vertices(vertices), indices(indices), textures(textures) {
-	
-	setup();
+	std::vector<Texture> textures,
+	VertexFormat format,
+	MeshStorage storage,
+	const std::vector<MeshLod> & lods,
+	std::vector<Meshlet> meshlets) :
+vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)),
+vbo(0), ebo(0), vao(0), format(format), indexType(GL_UNSIGNED_INT), geometry(0), lod(0), meshlets(std::move(meshlets)) {
+
+	ComputeBoundingSphere(this->vertices, center, radius);
+
+	// One index buffer for the whole chain, a level is a sub-range of it
+	lodRanges.push_back(LodRange{0, this->indices.size(), 0.0f});
+	std::vector<unsigned int> chain;
+	if (!lods.empty()) {
+		chain = this->indices;
+		for (const MeshLod & level : lods) {
+			lodRanges.push_back(LodRange{chain.size(), level.indices.size(), level.error});
+			chain.insert(chain.end(), level.indices.begin(), level.indices.end());
+		}
+	}
+	const std::vector<unsigned int> & allIndices = lods.empty() ? this->indices : chain;
+
+	if (storage == MESH_ARENA)
+		setupArena(allIndices);
+	else
+		setup(allIndices);
+}
+
+void Mesh :: setupArena(const std::vector<unsigned int> & allIndices) {
+
+	GeometryArena & arena = GeometryArena::Shared();
+	if (format == VERTEX_PACKED) {
+		std::vector<PackedVertex> packed(vertices.size());
+		PackVertices(vertices.data(), vertices.size(), packed.data());
+		geometry = arena.Allocate(format, packed.data(), packed.size(), allIndices.data(), allIndices.size());
+	} else {
+		geometry = arena.Allocate(format, vertices.data(), vertices.size(), allIndices.data(), allIndices.size());
+	}
+
+	const GeometryRange * range = arena.Range(geometry);
+	if (range) {
+		vao = range->vao;
+		indexType = range->indexType;
+	}
 }
 
-void Mesh :: setup() {
+void Mesh :: setup(const std::vector<unsigned int> & allIndices) {
 
 	glGenBuffers(1, &vbo); // Generate an empty vertex buffer on the GPU
 	glGenBuffers(1, &ebo);
 	glGenVertexArrays(1, &vao); // Tell OpenGL to create new Vertex Array Object
 	
-	glBindVertexArray(vao); // Make the vertices buffer the current one
+	GLState::Shared().BindVertexArray(vao); // Make the vertices buffer the current one
 	
 	glBindBuffer(GL_ARRAY_BUFFER, vbo); // "bind" or set as the current buffer we are working with
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+	if (format == VERTEX_PACKED) {
+		std::vector<PackedVertex> packed(vertices.size());
+		PackVertices(vertices.data(), vertices.size(), packed.data());
+		glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(PackedVertex), packed.data(), GL_STATIC_DRAW);
+	} else {
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+	}
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
-
-	glEnableVertexAttribArray(0); // vertex positions
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), NULL);
-	glEnableVertexAttribArray(1); // vertex normals
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-	glEnableVertexAttribArray(2); // vertex texture coords
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
-	glEnableVertexAttribArray(3); // vertex tangent coords
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tangent));
-	glEnableVertexAttribArray(4); // vertex bitangent coords
-	glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, bitangent));
-
-	glBindVertexArray(0); // Release control of vao
+	if (vertices.size() <= 65536) {
+		// Half the index bandwidth, CPU side keeps 32-bit indices
+		std::vector<GLushort> shortIndices(allIndices.begin(), allIndices.end());
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(GLushort), shortIndices.data(), GL_STATIC_DRAW);
+		indexType = GL_UNSIGNED_SHORT;
+	} else {
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, allIndices.size() * sizeof(unsigned int), allIndices.data(), GL_STATIC_DRAW);
+		indexType = GL_UNSIGNED_INT;
+	}
+
+	SetupVertexAttributes(format);
+
+	GLState::Shared().BindVertexArray(0); // Release control of vao
 }
 
 void Mesh :: Draw(Shader & shader) {
 
-	// Bind textures
-	unsigned int diffuseNr  = 1;
-	unsigned int specularNr = 1;
-	unsigned int normalNr   = 1;
-	unsigned int heightNr   = 1;
-	unsigned int emissionNr = 1;
-	unsigned int ambientNr  = 1;
-
-	for (unsigned int i=0; i<textures.size(); i++) {
-
-		glActiveTexture(GL_TEXTURE0 + i); // activate proper texture unit before binding
-
-		std::string number;
-		TextureType type = textures[i].type;
-
-		if (type == TEX_DIFFUSE)
-			number = std::to_string(diffuseNr++);
-		else if (type == TEX_SPECULAR)
-			number = std::to_string(specularNr++);
-		else if (type == TEX_NORMAL)
-			number = std::to_string(normalNr++);
-		else if (type == TEX_HEIGHT)
-			number = std::to_string(heightNr++);
-		else if (type == TEX_EMISSION)
-			number = std::to_string(emissionNr++);
-		else if (type == TEX_AMBIENT)
-			number = std::to_string(ambientNr++);
-
-		shader.setUniform("uMaterial." + TextureTypeName[type] + number, (int)i);
-		// Bind the texture
-		glBindTexture(GL_TEXTURE_2D, textures[i].id);
-	}
-	glActiveTexture(GL_TEXTURE0);
+	BindTextures(shader);
 
 	// Draw mesh
-	glBindVertexArray(vao);
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+	drawLevel(1, lod);
 
-	glActiveTexture(GL_TEXTURE0);
+	GLState::Shared().ActiveTexture(GL_TEXTURE0);
+}
+
+size_t Mesh :: DrawClusters(Shader & shader, const Frustum & frustum, const glm::vec3 & eye, unsigned int cull) {
+
+	if (meshlets.empty() || lod != 0) {
+		if ((cull & CLUSTER_CULL_FRUSTUM) && !SphereInFrustum(frustum, center, radius))
+			return 0;
+		Draw(shader);
+		return 1;
+	}
+
+	size_t visible = selectClusters(frustum, eye, cull);
+	if (visible == 0)
+		return 0;
+
+	BindTextures(shader);
+	drawClusters();
+
+	GLState::Shared().ActiveTexture(GL_TEXTURE0);
+	return visible;
+}
+
+size_t Mesh :: DrawClusterGeometry(const Frustum & frustum, const glm::vec3 & eye, unsigned int level,
+	unsigned int cull) {
+
+	if (level >= lodRanges.size())
+		level = (unsigned int) lodRanges.size() - 1;
+	if (meshlets.empty() || level != 0) {
+		if ((cull & CLUSTER_CULL_FRUSTUM) && !SphereInFrustum(frustum, center, radius))
+			return 0;
+		drawLevel(1, level);
+		return 1;
+	}
+
+	size_t visible = selectClusters(frustum, eye, cull);
+	if (visible != 0)
+		drawClusters();
+	return visible;
+}
+
+size_t Mesh :: selectClusters(const Frustum & frustum, const glm::vec3 & eye, unsigned int cull) {
+
+	// Visible clusters, neighbours in the index buffer merged into one run
+	clusterFirsts.clear();
+	clusterCounts.clear();
+	size_t visible = 0;
+	for (const Meshlet & meshlet : meshlets) {
+		if (!MeshletVisible(meshlet, frustum, eye, cull))
+			continue;
+		visible++;
+		if (!clusterFirsts.empty() && clusterFirsts.back() + clusterCounts.back() == meshlet.firstIndex)
+			clusterCounts.back() += meshlet.indexCount;
+		else {
+			clusterFirsts.push_back(meshlet.firstIndex);
+			clusterCounts.push_back(meshlet.indexCount);
+		}
+	}
+	return visible;
+}
+
+void Mesh :: drawClusters() {
+
+	GLsizei drawCount = (GLsizei) clusterFirsts.size();
+	if (geometry) {
+		GeometryArena::Shared().MultiDrawRanges(geometry, clusterFirsts.data(), clusterCounts.data(), drawCount);
+	} else {
+		size_t size = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+		std::vector<const void *> offsets(drawCount);
+		for (GLsizei i=0; i<drawCount; i++)
+			offsets[i] = (const void *) (clusterFirsts[i] * size);
+		GLState::Shared().BindVertexArray(vao);
+		glMultiDrawElements(GL_TRIANGLES, clusterCounts.data(), indexType, offsets.data(), drawCount);
+	}
+}
+
+uint64_t Mesh :: MaterialKey() const {
+
+	// FNV-1a over everything BindTextures sends
+	uint64_t hash = 14695981039346656037ull;
+	auto mix = [&hash](uint64_t value) {
+		for (int i=0; i<8; i++) {
+			hash ^= (value >> (i * 8)) & 0xFF;
+			hash *= 1099511628211ull;
+		}
+	};
+	for (size_t i=0; i<textures.size(); i++) {
+		mix(((uint64_t) textures[i].type << 32) | textures[i].id);
+		if (layers.size() == textures.size())
+			mix(((uint64_t) (uint32_t) layers[i].array << 32) | (uint32_t) layers[i].layer);
+		if (virtualIds.size() == textures.size())
+			mix((uint64_t) (uint32_t) virtualIds[i]);
+	}
+	return hash;
+}
+
+void Mesh :: BindTextures(Shader & shader) {
+
+	const MaterialTable & table = materialTable(shader);
+	bool arrays = layers.size() == textures.size();
+	bool virtualTextures = !arrays && virtualIds.size() == textures.size();
+
+	for (size_t i=0; i<table.bindings.size(); i++) {
+		const MaterialBinding & binding = table.bindings[i];
+		if (arrays) {
+			// Array already bound on its unit, pick the layer
+			shader.setUniform(binding.sampler, layers[i].array);
+			shader.setUniform(binding.extra, (float) layers[i].layer);
+		} else if (virtualTextures) {
+			// Page table on the unit, pages come from the pool
+			VirtualTextureCache::Shared().BindTable(virtualIds[i], binding.unit);
+			shader.setUniform(binding.sampler, (int) binding.unit);
+			shader.setUniform(binding.extra, VirtualTextureCache::Shared().Params(virtualIds[i]));
+		} else {
+			shader.setUniform(binding.sampler, (int) binding.unit);
+			GLState::Shared().BindTextureUnit(binding.unit, GL_TEXTURE_2D, textures[i].id);
+		}
+	}
+	GLState::Shared().ActiveTexture(GL_TEXTURE0);
+}
+
+const Mesh::MaterialTable & Mesh :: materialTable(Shader & shader) {
+
+	for (MaterialTable & table : materialTables)
+		if (table.program == shader.ID() && table.generation == shader.Generation()) {
+			bool same = table.types.size() == textures.size();
+			for (size_t i=0; same && i<textures.size(); i++)
+				same = table.types[i] == textures[i].type;
+			if (same)
+				return table;
+			materialTables.clear(); // texture types changed: every program's table is stale
+			break;
+		}
+
+	// The only place names are built, once per program
+	MaterialTable table;
+	table.program = shader.ID();
+	table.generation = shader.Generation();
+	for (const Texture & texture : textures)
+		table.types.push_back(texture.type);
+
+	bool arrays = layers.size() == textures.size();
+	bool companions = arrays || virtualIds.size() == textures.size();
+	std::vector<std::string> names = SamplerUniformNames(textures);
+	for (size_t i=0; i<names.size(); i++) {
+		MaterialBinding binding;
+		binding.unit = (unsigned int) i;
+		binding.sampler = shader.uniform(names[i].c_str());
+		if (companions)
+			binding.extra = shader.uniform((names[i] + (arrays ? "_layer" : "_vt")).c_str());
+		table.bindings.push_back(binding);
+	}
+	materialTables.push_back(std::move(table));
+	return materialTables.back();
+}
+
+void Mesh :: DrawGeometry(GLsizei instances) {
+	drawLevel(instances, lod);
+}
+
+void Mesh :: drawLevel(GLsizei instances, unsigned int level) {
+
+	const LodRange & range = lodRanges[level];
+	if (geometry) {
+		GeometryArena::Shared().DrawRange(geometry, range.first, range.count, instances); // page VAO stays bound for the next mesh
+		return;
+	}
+
+	size_t offset = range.first * (indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint));
+	GLState::Shared().BindVertexArray(vao);
+	if (instances == 1)
+		glDrawElements(GL_TRIANGLES, range.count, indexType, (void*) offset);
+	else
+		glDrawElementsInstanced(GL_TRIANGLES, range.count, indexType, (void*) offset, instances); // left bound like arena pages
 }
 
 void Mesh :: DeleteBuffers() {
-	glDeleteVertexArrays(1, &vao);
+	if (geometry) {
+		GeometryArena::Shared().Free(geometry);
+		geometry = 0;
+		vao = 0;
+		return;
+	}
+	GLState::Shared().DeleteVertexArrays(1, &vao);
 	glDeleteBuffers(1, &vbo);
 	glDeleteBuffers(1, &ebo);
 }
+
+void Mesh :: ReleaseCpuData() {
+	std::vector<Vertex>().swap(vertices);
+	std::vector<unsigned int>().swap(indices);
+}
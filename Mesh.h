@@ -3,12 +3,18 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
 #include <ShaderProgram.h>
 #include <Texture.h>
+#include <VertexPacking.h>
+#include <GeometryArena.h>
+#include <Meshlet.h>
+#include <TextureArray.h>
+#include <VirtualTexture.h>
 
 struct Pixel {
 	glm::vec2 position;
@@ -23,6 +29,31 @@ struct Vertex {
 	glm::vec3 bitangent;
 };
 
+/** Coarser index list over the LOD 0 vertices, see MeshSimplifier */
+struct MeshLod {
+	std::vector<unsigned int> indices;
+	float error; // relative to the mesh bounding sphere radius
+};
+
+/**
+* CPU side mesh produced by the importers, before any GL object exists.
+* Texture ids are unresolved (0); paths are relative to the model directory
+* and an empty path stands for DefaultTexture(type).
+*/
+struct MeshData {
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<Texture> textures;
+	std::vector<MeshLod> lods; // levels 1.., coarsest last, empty without MODEL_LOD
+	std::vector<Meshlet> meshlets; // clusters of the LOD 0 indices, empty without MODEL_MESHLETS
+};
+
+/** Where a mesh keeps its GPU copy */
+enum MeshStorage {
+	MESH_OWN_BUFFERS, // private VAO / VBO / EBO, free to customise (instancing attributes...)
+	MESH_ARENA        // range of GeometryArena::Shared(), VAO shared with the other meshes of the page
+};
+
 class Mesh {
 
 public:
@@ -34,22 +65,121 @@ public:
 	/** Methods */
 	Mesh(std::vector<Vertex> vertices,
 		std::vector<unsigned int> indices,
-		std::vector<Texture> textures);
+		std::vector<Texture> textures,
+		VertexFormat format = VERTEX_FULL,
+		MeshStorage storage = MESH_OWN_BUFFERS,
+		const std::vector<MeshLod> & lods = std::vector<MeshLod>(),
+		std::vector<Meshlet> meshlets = std::vector<Meshlet>());
 	//~Mesh();
 
 	void Draw(Shader & shader);
+	/** Geometry only, whatever VAO and textures are bound stay as the caller set them up */
+	void DrawGeometry(GLsizei instances = 1);
+	/**
+	* Draws only the clusters passing the cull tests, frustum and eye in object space.
+	* Whole-mesh draws (no clusters, LOD > 0) are culled by their bounding sphere.
+	* Returns the number of clusters drawn.
+	*/
+	size_t DrawClusters(Shader & shader, const Frustum & frustum, const glm::vec3 & eye,
+		unsigned int cull = CLUSTER_CULL_FRUSTUM);
+	/**
+	* DrawClusters without the texture setup, for callers that already bound this material,
+	* at level instead of the current Lod() (queued draws keep the level of their placement)
+	*/
+	size_t DrawClusterGeometry(const Frustum & frustum, const glm::vec3 & eye, unsigned int level,
+		unsigned int cull = CLUSTER_CULL_FRUSTUM);
+	/** Samplers and texture units of the material, what Draw does before drawing */
+	void BindTextures(Shader & shader);
+	/** Equal keys bind the same textures, layers and page tables */
+	uint64_t MaterialKey() const;
 	void DeleteBuffers();
+	/** Drops the CPU copies of vertices and indices once the GPU has them (bounds and clusters stay) */
+	void ReleaseCpuData();
 
 	GLuint VAO() const { return vao; }
 	GLuint VBO() const { return vbo; }
 	GLuint EBO() const { return ebo; }
+	VertexFormat Format() const { return format; }
+	GLenum IndexType() const { return indexType; }
+	GeometryHandle Geometry() const { return geometry; }
+
+	/** Level of detail, every level is drawn from the same vertices */
+	size_t LodCount() const { return lodRanges.size(); }
+	float LodError(size_t level) const { return lodRanges[level].error; }
+	size_t LodIndexCount(size_t level) const { return lodRanges[level].count; }
+	/** First index of the level, counted from the start of the mesh's indices */
+	size_t LodFirstIndex(size_t level) const { return lodRanges[level].first; }
+	unsigned int Lod() const { return lod; }
+	void SetLod(unsigned int level) { lod = level < lodRanges.size() ? level : (unsigned int) lodRanges.size() - 1; }
+	/** Object space bounding sphere */
+	const glm::vec3 & Center() const { return center; }
+	float Radius() const { return radius; }
+	const std::vector<Meshlet> & Meshlets() const { return meshlets; }
+
+	/**
+	* Texture array layers, one per texture: Draw then sets "uMaterial.<type>N" to the
+	* array's unit and "uMaterial.<type>N_layer" to the layer, and binds nothing
+	* (the owner binds the arrays, see TextureArraySet::Bind). Empty: 2D textures.
+	*/
+	void SetTextureLayers(std::vector<TextureLayer> textureLayers) { layers = std::move(textureLayers); materialTables.clear(); }
+
+	/**
+	* Virtual texture ids, one per texture (0: none): Draw binds the page table on the
+	* texture's unit for "uMaterial.<type>N" and sets "uMaterial.<type>N_vt" to
+	* VirtualTextureCache::Params (the owner binds the page pool). Empty: 2D textures.
+	*/
+	void SetVirtualTextures(std::vector<int> ids) { virtualIds = std::move(ids); materialTables.clear(); }
 
 private:
 	/** Render Data */
 	GLuint vbo, ebo, vao;
+	VertexFormat format; // layout of the GPU copy, vertices stay full floats on the CPU
+	GLenum indexType;    // GL_UNSIGNED_SHORT when every index fits in 16 bits
+	GeometryHandle geometry; // arena range, 0 with own buffers (vbo/ebo are then 0 and vao is the page VAO)
+
+	/** Every level's indices one after the other in the index buffer, LOD 0 first */
+	struct LodRange {
+		size_t first; // indices into the buffer
+		size_t count;
+		float error;
+	};
+	std::vector<LodRange> lodRanges;
+	unsigned int lod;
+	glm::vec3 center;
+	float radius;
+
+	std::vector<Meshlet> meshlets;
+	std::vector<size_t> clusterFirsts; // DrawClusters scratch, visible runs of the index buffer
+	std::vector<GLsizei> clusterCounts;
+
+	std::vector<TextureLayer> layers;
+	std::vector<int> virtualIds;
+
+	/**
+	* What BindTextures sends for one shader program, resolved on the first draw with it:
+	* per texture its unit and uniforms. Texture ids are read at bind time (placeholders
+	* get replaced), so only a change in the texture types (the names) or the program rebuilds it.
+	*/
+	struct MaterialBinding {
+		unsigned int unit;
+		UniformHandle sampler; // "uMaterial.<type>N"
+		UniformHandle extra;   // its "_layer" or "_vt" companion
+	};
+	struct MaterialTable {
+		GLuint program;
+		unsigned int generation; // Shader::Generation, program names get recycled
+		std::vector<TextureType> types; // of textures when built, in order: they make the sampler names
+		std::vector<MaterialBinding> bindings;
+	};
+	std::vector<MaterialTable> materialTables; // one per program drawn with, usually one or two
 
 	/** Methods */
-	void setup();
+	void setup(const std::vector<unsigned int> & allIndices);
+	void setupArena(const std::vector<unsigned int> & allIndices);
+	void drawLevel(GLsizei instances, unsigned int level);
+	size_t selectClusters(const Frustum & frustum, const glm::vec3 & eye, unsigned int cull);
+	void drawClusters();
+	const MaterialTable & materialTable(Shader & shader);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,299 @@
+#include <MeshCache.h>
+#include <MappedFile.h>
+#include <Mesh.h>
+#include <Texture.h>
+#include <Meshlet.h>
+#include <ObjLoader.h>
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cctype>
+
+static const char MESH_CACHE_MAGIC[8] = { 'L', 'O', 'G', 'L', 'M', 'S', 'H', '\0' };
+
+struct MeshCacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t vertexSize; // sizeof(Vertex) of the build that wrote the cache
+	uint32_t options;
+	uint32_t numMeshes;
+	uint32_t numDependencies;
+	uint32_t reserved;
+	int64_t sourceTime;  // FileStamp of the source when the cache was written
+	uint64_t sourceSize;
+};
+
+/** A file the import read besides the source, path relative to the source's directory */
+struct MeshCacheDependency {
+	int64_t time;
+	uint64_t size;
+	uint32_t pathLength;
+	uint32_t reserved;
+};
+
+struct MeshCacheEntry {
+	uint32_t numVertices;
+	uint32_t numIndices;
+	uint32_t numTextures;
+	uint32_t numLods;
+	uint32_t numMeshlets;
+};
+
+static size_t align4(size_t n) { return (n + 3) & ~(size_t)3; }
+
+std::string MeshCachePath(const std::string & source) {
+	return source + ".meshcache";
+}
+
+static bool checkHeader(const MeshCacheHeader & header, unsigned int options) {
+	return std::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) == 0
+		&& header.version == MESH_CACHE_VERSION
+		&& header.vertexSize == sizeof(Vertex)
+		&& header.options == options;
+}
+
+static std::string sourceDirectory(const std::string & source) {
+	return source.substr(0, source.find_last_of('/') + 1);
+}
+
+std::vector<std::string> MeshSourceDependencies(const std::string & source) {
+	std::string extension = source.substr(source.find_last_of('.') + 1);
+	for (char & c : extension)
+		c = (char) std::tolower((unsigned char) c);
+	return extension == "obj" ? ObjMaterialLibraries(source) : std::vector<std::string>();
+}
+
+void WriteMeshDependencies(std::ostream & out, const std::string & source,
+	const std::vector<std::string> & dependencies) {
+
+	// A missing library is recorded as such: creating it later invalidates the cache too
+	static const char padding[4] = { 0, 0, 0, 0 };
+	std::string directory = sourceDirectory(source);
+	for (const std::string & path : dependencies) {
+		FileStamp stamp = GetFileStamp(directory + path);
+		MeshCacheDependency dependency = { stamp.time, stamp.size, (uint32_t) path.size(), 0 };
+		out.write((const char *) &dependency, sizeof(dependency));
+		out.write(path.data(), path.size());
+		out.write(padding, align4(path.size()) - path.size());
+	}
+}
+
+bool CheckMeshDependencies(const std::string & source, uint32_t count,
+	const unsigned char *& ptr, const unsigned char * end) {
+
+	std::string directory = sourceDirectory(source);
+	for (uint32_t i=0; i<count; i++) {
+		MeshCacheDependency dependency;
+		if ((size_t)(end - ptr) < sizeof(dependency))
+			return false;
+		std::memcpy(&dependency, ptr, sizeof(dependency));
+		ptr += sizeof(dependency);
+		if ((size_t)(end - ptr) < align4(dependency.pathLength))
+			return false;
+		std::string path((const char *) ptr, dependency.pathLength);
+		ptr += align4(dependency.pathLength);
+		if (GetFileStamp(directory + path) != FileStamp{ dependency.time, dependency.size })
+			return false;
+	}
+	return true;
+}
+
+/**
+* The source and every dependency still have the size and modification time the
+* cache recorded, exactly: an edit within the second the cache was written counts.
+* Reads the dependency records following the header.
+*/
+static bool checkSources(const std::string & source, const MeshCacheHeader & header,
+	const unsigned char *& ptr, const unsigned char * end) {
+	return GetFileStamp(source) == FileStamp{ header.sourceTime, header.sourceSize }
+		&& CheckMeshDependencies(source, header.numDependencies, ptr, end);
+}
+
+bool IsMeshCacheValid(const std::string & source, unsigned int options) {
+
+	MappedFile file(MeshCachePath(source));
+	if (!file.IsOpen() || file.Size() < sizeof(MeshCacheHeader))
+		return false;
+
+	const unsigned char * ptr = file.Data();
+	const unsigned char * end = file.Data() + file.Size();
+
+	MeshCacheHeader header;
+	std::memcpy(&header, ptr, sizeof(header));
+	ptr += sizeof(header);
+	return checkHeader(header, options) && checkSources(source, header, ptr, end);
+}
+
+bool ReadMeshData(const unsigned char *& ptr, const unsigned char * end, MeshData & data) {
+
+	MeshCacheEntry entry;
+	if ((size_t)(end - ptr) < sizeof(entry))
+		return false;
+	std::memcpy(&entry, ptr, sizeof(entry));
+	ptr += sizeof(entry);
+
+	size_t vertexBytes = (size_t) entry.numVertices * sizeof(Vertex);
+	size_t indexBytes  = (size_t) entry.numIndices * sizeof(unsigned int);
+	if ((size_t)(end - ptr) < vertexBytes + indexBytes)
+		return false;
+
+	// One straight copy per array out of the mapping
+	data.vertices.resize(entry.numVertices);
+	std::memcpy((void *) data.vertices.data(), ptr, vertexBytes);
+	ptr += vertexBytes;
+	data.indices.resize(entry.numIndices);
+	std::memcpy(data.indices.data(), ptr, indexBytes);
+	ptr += indexBytes;
+
+	data.lods.resize(entry.numLods);
+	for (MeshLod & lod : data.lods) {
+		uint32_t count;
+		if ((size_t)(end - ptr) < sizeof(count) + sizeof(float))
+			return false;
+		std::memcpy(&count, ptr, sizeof(count));
+		std::memcpy(&lod.error, ptr + sizeof(count), sizeof(float));
+		ptr += sizeof(count) + sizeof(float);
+		if ((size_t)(end - ptr) < (size_t) count * sizeof(unsigned int))
+			return false;
+		lod.indices.resize(count);
+		std::memcpy(lod.indices.data(), ptr, (size_t) count * sizeof(unsigned int));
+		ptr += (size_t) count * sizeof(unsigned int);
+	}
+
+	size_t meshletBytes = (size_t) entry.numMeshlets * sizeof(Meshlet);
+	if ((size_t)(end - ptr) < meshletBytes)
+		return false;
+	data.meshlets.resize(entry.numMeshlets);
+	std::memcpy((void *) data.meshlets.data(), ptr, meshletBytes);
+	ptr += meshletBytes;
+
+	data.textures.resize(entry.numTextures);
+	for (Texture & texture : data.textures) {
+		uint32_t field[2];
+		if ((size_t)(end - ptr) < sizeof(field))
+			return false;
+		std::memcpy(field, ptr, sizeof(field));
+		ptr += sizeof(field);
+		if ((size_t)(end - ptr) < align4(field[1]))
+			return false;
+		texture.id   = 0;
+		texture.type = (TextureType) field[0];
+		texture.path.assign((const char *) ptr, field[1]);
+		ptr += align4(field[1]);
+	}
+
+	return true;
+}
+
+void WriteMeshData(std::ostream & out, const MeshData & data) {
+
+	static const char padding[4] = { 0, 0, 0, 0 };
+
+	MeshCacheEntry entry;
+	entry.numVertices = (uint32_t) data.vertices.size();
+	entry.numIndices  = (uint32_t) data.indices.size();
+	entry.numTextures = (uint32_t) data.textures.size();
+	entry.numLods     = (uint32_t) data.lods.size();
+	entry.numMeshlets = (uint32_t) data.meshlets.size();
+	out.write((const char *) &entry, sizeof(entry));
+
+	out.write((const char *) data.vertices.data(), data.vertices.size() * sizeof(Vertex));
+	out.write((const char *) data.indices.data(), data.indices.size() * sizeof(unsigned int));
+
+	for (const MeshLod & lod : data.lods) {
+		uint32_t count = (uint32_t) lod.indices.size();
+		out.write((const char *) &count, sizeof(count));
+		out.write((const char *) &lod.error, sizeof(float));
+		out.write((const char *) lod.indices.data(), lod.indices.size() * sizeof(unsigned int));
+	}
+	out.write((const char *) data.meshlets.data(), data.meshlets.size() * sizeof(Meshlet));
+
+	for (const Texture & texture : data.textures) {
+		uint32_t field[2] = { (uint32_t) texture.type, (uint32_t) texture.path.size() };
+		out.write((const char *) field, sizeof(field));
+		out.write(texture.path.data(), texture.path.size());
+		out.write(padding, align4(texture.path.size()) - texture.path.size());
+	}
+}
+
+bool ReadMeshCache(const std::string & source, std::vector<MeshData> & meshes,
+	unsigned int options) {
+
+	std::string cache = MeshCachePath(source);
+	MappedFile file(cache);
+	if (!file.IsOpen() || file.Size() < sizeof(MeshCacheHeader))
+		return false;
+
+	const unsigned char * ptr = file.Data();
+	const unsigned char * end = file.Data() + file.Size();
+
+	MeshCacheHeader header;
+	std::memcpy(&header, ptr, sizeof(header));
+	ptr += sizeof(header);
+	if (!checkHeader(header, options) || !checkSources(source, header, ptr, end))
+		return false;
+
+	std::vector<MeshData> result(header.numMeshes);
+	for (MeshData & data : result) {
+		if (!ReadMeshData(ptr, end, data)) {
+			std::cerr << "ReadMeshCache: corrupt cache " << cache << "\n";
+			return false;
+		}
+	}
+
+	meshes.swap(result);
+	return true;
+}
+
+bool WriteMeshCache(const std::string & source, const std::vector<MeshData> & meshes,
+	unsigned int options) {
+
+	std::string cache = MeshCachePath(source);
+	std::string temp  = cache + ".tmp";
+
+	std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+	if (!out.is_open()) {
+		std::cerr << "WriteMeshCache: unable to write " << temp << "\n";
+		return false;
+	}
+
+	std::vector<std::string> dependencies = MeshSourceDependencies(source);
+	FileStamp stamp = GetFileStamp(source);
+
+	MeshCacheHeader header;
+	std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+	header.version    = MESH_CACHE_VERSION;
+	header.vertexSize = sizeof(Vertex);
+	header.options    = options;
+	header.numMeshes  = (uint32_t) meshes.size();
+	header.numDependencies = (uint32_t) dependencies.size();
+	header.reserved   = 0;
+	header.sourceTime = stamp.time;
+	header.sourceSize = stamp.size;
+	out.write((const char *) &header, sizeof(header));
+	WriteMeshDependencies(out, source, dependencies);
+
+	for (const MeshData & data : meshes)
+		WriteMeshData(out, data);
+
+	out.close();
+	if (!out) {
+		std::remove(temp.c_str());
+		std::cerr << "WriteMeshCache: failed writing " << temp << "\n";
+		return false;
+	}
+
+	// Written to a temporary first so a crashed write never leaves a half cache behind
+	std::remove(cache.c_str()); // rename does not overwrite on Windows
+	if (std::rename(temp.c_str(), cache.c_str()) != 0) {
+		std::remove(temp.c_str());
+		return false;
+	}
+
+	return true;
+}
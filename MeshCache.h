@@ -0,0 +1,56 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <cstdint>
+
+#include <Mesh.h>
+
+/**
+* Binary mesh cache, stored next to the model source as "<source>.meshcache".
+*
+* Layout (little endian, every section 4-byte aligned):
+*   MeshCacheHeader (size and modification time of the source)
+*   per dependency (MTL libraries of an OBJ): MeshCacheDependency, char[pathLength] (padded)
+*   per mesh: MeshCacheEntry, Vertex[numVertices], uint32[numIndices],
+*             per LOD: uint32 indexCount, float error, uint32[indexCount],
+*             Meshlet[numMeshlets],
+*             per texture: uint32 type, uint32 pathLength, char[pathLength] (padded)
+*
+* The cache holds the final vertex/index arrays so a warm start only maps the
+* file and copies each array once before uploading it.
+*/
+
+#define MESH_CACHE_VERSION 4
+
+/** Path of the cache file for a model source file */
+std::string MeshCachePath(const std::string & source);
+
+/**
+* Cache exists, matches this build, and the source and its dependencies have
+* exactly the size and modification time recorded when it was written.
+* options: geometry-affecting import flags, a cache cooked with other options is stale.
+*/
+bool IsMeshCacheValid(const std::string & source, unsigned int options = 0);
+
+bool ReadMeshCache(const std::string & source, std::vector<MeshData> & meshes,
+	unsigned int options = 0);
+bool WriteMeshCache(const std::string & source, const std::vector<MeshData> & meshes,
+	unsigned int options = 0);
+
+/** One mesh in the cache layout, for other containers of cooked meshes (streaming cells) */
+bool ReadMeshData(const unsigned char *& ptr, const unsigned char * end, MeshData & data);
+void WriteMeshData(std::ostream & out, const MeshData & data);
+
+/** Files whose edits change the cooked meshes of source besides itself: an OBJ's MTL libraries */
+std::vector<std::string> MeshSourceDependencies(const std::string & source);
+/** Stamp and path (relative to the source's directory) of every dependency, in the cache layout */
+void WriteMeshDependencies(std::ostream & out, const std::string & source,
+	const std::vector<std::string> & dependencies);
+/** Reads count dependency records, false unless each file still has exactly its recorded stamp */
+bool CheckMeshDependencies(const std::string & source, uint32_t count,
+	const unsigned char *& ptr, const unsigned char * end);
+
+#endif
@@ -0,0 +1,374 @@
+#include <MeshOptimizer.h>
+#include <Mesh.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+float ComputeACMR(const std::vector<unsigned int> & indices, size_t vertexCount, unsigned int cacheSize) {
+
+	if (indices.size() < 3)
+		return 0.0f;
+
+	// FIFO: a vertex is still cached while fewer than cacheSize misses happened since it was loaded
+	std::vector<unsigned int> loadedAt(vertexCount, 0);
+	std::vector<char> seen(vertexCount, 0);
+	unsigned int misses = 0;
+
+	for (unsigned int index : indices) {
+		if (!seen[index] || misses - loadedAt[index] >= cacheSize) {
+			seen[index] = 1;
+			loadedAt[index] = misses;
+			misses++;
+		}
+	}
+
+	return (float) misses / (float)(indices.size() / 3);
+}
+
+
+
+
+
+/*************************************************
+*
+* Weld
+*
+*************************************************/
+
+struct VertexKey {
+	const Vertex * vertex;
+	bool operator==(const VertexKey & other) const {
+		return std::memcmp(vertex, other.vertex, sizeof(Vertex)) == 0;
+	}
+};
+
+struct VertexKeyHash {
+	size_t operator()(const VertexKey & key) const {
+		// FNV-1a over the raw floats: welding only merges bit-identical vertices
+		const unsigned char * bytes = (const unsigned char *) key.vertex;
+		uint64_t hash = 14695981039346656037ULL;
+		for (size_t i=0; i<sizeof(Vertex); i++) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ULL;
+		}
+		return (size_t) hash;
+	}
+};
+
+void WeldVertices(MeshData & mesh) {
+
+	std::vector<Vertex> & vertices = mesh.vertices;
+	std::vector<unsigned int> remap(vertices.size());
+	std::vector<Vertex> welded;
+	welded.reserve(vertices.size());
+
+	std::unordered_map<VertexKey, unsigned int, VertexKeyHash> unique;
+	unique.reserve(vertices.size());
+
+	for (size_t i=0; i<vertices.size(); i++) {
+		VertexKey key = { &vertices[i] };
+		auto it = unique.find(key);
+		if (it != unique.end()) {
+			remap[i] = it->second;
+		} else {
+			remap[i] = (unsigned int) welded.size();
+			unique.emplace(key, remap[i]);
+			welded.push_back(vertices[i]);
+		}
+	}
+
+	if (welded.size() == vertices.size())
+		return;
+
+	for (unsigned int & index : mesh.indices)
+		index = remap[index];
+	vertices.swap(welded);
+}
+
+
+
+
+
+/*************************************************
+*
+* Vertex cache (Tom Forsyth, "Linear-Speed Vertex Cache Optimisation")
+*
+*************************************************/
+
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_MAX_VALENCE 64
+
+struct ForsythTables {
+	float cache[FORSYTH_CACHE_SIZE + 1]; // last slot: not in cache
+	float valence[FORSYTH_MAX_VALENCE];
+
+	ForsythTables() {
+		for (int i=0; i<FORSYTH_CACHE_SIZE; i++) {
+			// the last triangle's vertices get a fixed score so it is not simply repeated
+			if (i < 3)
+				cache[i] = 0.75f;
+			else
+				cache[i] = std::pow(1.0f - (float)(i - 3) / (float)(FORSYTH_CACHE_SIZE - 3), 1.5f);
+		}
+		cache[FORSYTH_CACHE_SIZE] = 0.0f;
+
+		// few remaining triangles: finish them off before they become isolated
+		valence[0] = 0.0f;
+		for (int i=1; i<FORSYTH_MAX_VALENCE; i++)
+			valence[i] = 2.0f * std::pow((float) i, -0.5f);
+	}
+};
+
+static float forsythScore(const ForsythTables & tables, int cachePosition, unsigned int remaining) {
+	if (remaining == 0)
+		return -1.0f;
+	int slot = cachePosition < 0 ? FORSYTH_CACHE_SIZE : cachePosition;
+	return tables.cache[slot] + tables.valence[std::min(remaining, (unsigned int) FORSYTH_MAX_VALENCE - 1)];
+}
+
+void OptimizeVertexCache(std::vector<unsigned int> & indices, size_t vertexCount) {
+
+	static const ForsythTables tables;
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount < 2)
+		return;
+
+	// Triangle adjacency per vertex, the first `remaining` entries are the live ones
+	std::vector<unsigned int> remaining(vertexCount, 0);
+	for (unsigned int index : indices)
+		remaining[index]++;
+
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (size_t v=0; v<vertexCount; v++)
+		offsets[v + 1] = offsets[v] + remaining[v];
+
+	std::vector<unsigned int> adjacency(indices.size());
+	std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t t=0; t<triangleCount; t++)
+		for (int k=0; k<3; k++)
+			adjacency[fill[indices[3 * t + k]]++] = (unsigned int) t;
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v=0; v<vertexCount; v++)
+		vertexScore[v] = forsythScore(tables, -1, remaining[v]);
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<char> emitted(triangleCount, 0);
+	int best = -1;
+	float bestScore = -1.0f;
+	for (size_t t=0; t<triangleCount; t++) {
+		triangleScore[t] = vertexScore[indices[3 * t]] + vertexScore[indices[3 * t + 1]]
+			+ vertexScore[indices[3 * t + 2]];
+		if (triangleScore[t] > bestScore) {
+			bestScore = triangleScore[t];
+			best = (int) t;
+		}
+	}
+
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+	std::vector<unsigned int> cache, nextCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+	size_t scanCursor = 0;
+
+	for (size_t step=0; step<triangleCount; step++) {
+
+		// Dead end: restart from the next triangle not emitted yet
+		if (best < 0) {
+			while (emitted[scanCursor])
+				scanCursor++;
+			best = (int) scanCursor;
+		}
+
+		const unsigned int * triangle = &indices[3 * best];
+		emitted[best] = 1;
+		result.insert(result.end(), triangle, triangle + 3);
+
+		// Unlink the triangle from its vertices
+		for (int k=0; k<3; k++) {
+			unsigned int v = triangle[k];
+			unsigned int * begin = &adjacency[offsets[v]];
+			unsigned int * end = begin + remaining[v];
+			unsigned int * it = std::find(begin, end, (unsigned int) best);
+			if (it != end) {
+				std::swap(*it, *(end - 1));
+				remaining[v]--;
+			}
+		}
+
+		// LRU: the triangle's vertices move to the front
+		nextCache.assign(triangle, triangle + 3);
+		for (unsigned int v : cache)
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				nextCache.push_back(v);
+
+		for (size_t i=0; i<nextCache.size(); i++) {
+			unsigned int v = nextCache[i];
+			cachePosition[v] = i < FORSYTH_CACHE_SIZE ? (int) i : -1;
+			vertexScore[v] = forsythScore(tables, cachePosition[v], remaining[v]);
+		}
+
+		// Only triangles touching the cache changed score
+		best = -1;
+		bestScore = -1.0f;
+		for (unsigned int v : nextCache) {
+			for (unsigned int a=0; a<remaining[v]; a++) {
+				unsigned int t = adjacency[offsets[v] + a];
+				triangleScore[t] = vertexScore[indices[3 * t]] + vertexScore[indices[3 * t + 1]]
+					+ vertexScore[indices[3 * t + 2]];
+				if (triangleScore[t] > bestScore) {
+					bestScore = triangleScore[t];
+					best = (int) t;
+				}
+			}
+		}
+
+		if (nextCache.size() > FORSYTH_CACHE_SIZE)
+			nextCache.resize(FORSYTH_CACHE_SIZE);
+		cache.swap(nextCache);
+	}
+
+	indices.swap(result);
+}
+
+
+
+
+
+/*************************************************
+*
+* Overdraw (clustered, after Sander et al. "Fast Triangle Reordering")
+*
+*************************************************/
+
+void OptimizeOverdraw(std::vector<unsigned int> & indices, const std::vector<Vertex> & vertices,
+	float threshold) {
+
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount < 2)
+		return;
+
+	float acmr = ComputeACMR(indices, vertices.size());
+
+	// Cluster boundaries: triangles where the simulated cache restarts (all three vertices miss)
+	std::vector<size_t> clusters;
+	{
+		std::vector<unsigned int> loadedAt(vertices.size(), 0);
+		std::vector<char> seen(vertices.size(), 0);
+		unsigned int misses = 0;
+		for (size_t t=0; t<triangleCount; t++) {
+			int triangleMisses = 0;
+			for (int k=0; k<3; k++) {
+				unsigned int v = indices[3 * t + k];
+				if (!seen[v] || misses - loadedAt[v] >= MESH_OPTIMIZER_CACHE_SIZE) {
+					seen[v] = 1;
+					loadedAt[v] = misses;
+					misses++;
+					triangleMisses++;
+				}
+			}
+			if (t == 0 || triangleMisses == 3)
+				clusters.push_back(t);
+		}
+	}
+	if (clusters.size() < 2)
+		return;
+
+	glm::vec3 meshCentroid(0.0f);
+	for (const Vertex & vertex : vertices)
+		meshCentroid += vertex.position;
+	meshCentroid /= (float) vertices.size();
+
+	// Clusters facing away from the centre are likely in front: draw them first
+	struct Cluster { size_t begin, end; float key; };
+	std::vector<Cluster> sorted(clusters.size());
+	for (size_t c=0; c<clusters.size(); c++) {
+		Cluster & cluster = sorted[c];
+		cluster.begin = clusters[c];
+		cluster.end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+		glm::vec3 centroid(0.0f), normal(0.0f);
+		float area = 0.0f;
+		for (size_t t=cluster.begin; t<cluster.end; t++) {
+			const glm::vec3 & a = vertices[indices[3 * t]].position;
+			const glm::vec3 & b = vertices[indices[3 * t + 1]].position;
+			const glm::vec3 & c2 = vertices[indices[3 * t + 2]].position;
+			glm::vec3 n = glm::cross(b - a, c2 - a); // length = twice the area
+			float weight = glm::length(n);
+			centroid += (a + b + c2) * (weight / 3.0f);
+			normal += n;
+			area += weight;
+		}
+		if (area > 0.0f)
+			centroid /= area;
+		float length = glm::length(normal);
+		cluster.key = length > 0.0f ? glm::dot(centroid - meshCentroid, normal / length) : 0.0f;
+	}
+
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster & a, const Cluster & b) {
+		return a.key > b.key;
+	});
+
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+	for (const Cluster & cluster : sorted)
+		result.insert(result.end(), indices.begin() + 3 * cluster.begin, indices.begin() + 3 * cluster.end);
+
+	// Keep the cache order when sorting costs more than the allowed vertex work
+	if (ComputeACMR(result, vertices.size()) <= acmr * threshold)
+		indices.swap(result);
+}
+
+
+
+
+
+/*************************************************
+*
+* Vertex fetch
+*
+*************************************************/
+
+void OptimizeVertexFetch(MeshData & mesh) {
+
+	const unsigned int unused = ~0u;
+	std::vector<unsigned int> remap(mesh.vertices.size(), unused);
+	std::vector<Vertex> ordered;
+	ordered.reserve(mesh.vertices.size());
+
+	// First use order, vertices no triangle references are dropped
+	for (unsigned int & index : mesh.indices) {
+		if (remap[index] == unused) {
+			remap[index] = (unsigned int) ordered.size();
+			ordered.push_back(mesh.vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	mesh.vertices.swap(ordered);
+}
+
+MeshOptimizeStats OptimizeMesh(MeshData & mesh) {
+
+	MeshOptimizeStats stats;
+	stats.verticesBefore = mesh.vertices.size();
+	stats.triangles = mesh.indices.size() / 3;
+	stats.acmrBefore = ComputeACMR(mesh.indices, mesh.vertices.size());
+
+	WeldVertices(mesh);
+	OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+	OptimizeOverdraw(mesh.indices, mesh.vertices);
+	OptimizeVertexFetch(mesh);
+
+	stats.verticesAfter = mesh.vertices.size();
+	stats.acmrAfter = ComputeACMR(mesh.indices, mesh.vertices.size());
+	return stats;
+}
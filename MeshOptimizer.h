@@ -0,0 +1,42 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <vector>
+#include <cstddef>
+
+#include <Mesh.h>
+
+/**
+* Import-time index/vertex optimization for triangle lists:
+*   weld      merge bit-identical vertices
+*   cache     reorder triangles for the post-transform cache (Forsyth)
+*   overdraw  reorder cache-friendly clusters front to back, outward facing first
+*   fetch     renumber vertices in first-use order
+* Every step keeps the rendered result identical, only the order changes.
+*/
+
+#define MESH_OPTIMIZER_CACHE_SIZE 16 // FIFO size used to report ACMR
+
+struct MeshOptimizeStats {
+	size_t verticesBefore;
+	size_t verticesAfter;
+	size_t triangles;
+	float acmrBefore; // average cache miss ratio: transformed vertices per triangle
+	float acmrAfter;
+};
+
+/** Average cache miss ratio of a triangle list on a FIFO cache */
+float ComputeACMR(const std::vector<unsigned int> & indices, size_t vertexCount,
+	unsigned int cacheSize = MESH_OPTIMIZER_CACHE_SIZE);
+
+void WeldVertices(MeshData & mesh);
+void OptimizeVertexCache(std::vector<unsigned int> & indices, size_t vertexCount);
+/** threshold: largest ACMR growth accepted in exchange for less overdraw (1.05 = 5%) */
+void OptimizeOverdraw(std::vector<unsigned int> & indices, const std::vector<Vertex> & vertices,
+	float threshold = 1.05f);
+void OptimizeVertexFetch(MeshData & mesh);
+
+/** All of the above, in order. Safe on any thread */
+MeshOptimizeStats OptimizeMesh(MeshData & mesh);
+
+#endif
@@ -0,0 +1,382 @@
+#include <MeshSimplifier.h>
+#include <MeshOptimizer.h>
+#include <Mesh.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+unsigned int LodSettingsKey(const LodSettings & settings) {
+	unsigned int levels = std::min(settings.levels, (unsigned int) MESH_SIMPLIFIER_MAX_LEVELS);
+	unsigned int ratio  = (unsigned int) (glm::clamp(settings.ratio, 0.0f, 1.0f) * 255.0f + 0.5f);
+	unsigned int error  = (unsigned int) (glm::clamp(settings.maxError, 0.0f, 1.0f) * 4095.0f + 0.5f);
+	return levels | (ratio << 4) | (error << 12);
+}
+
+void ComputeBoundingSphere(const std::vector<Vertex> & vertices, glm::vec3 & center, float & radius) {
+
+	center = glm::vec3(0.0f);
+	radius = 0.0f;
+	if (vertices.empty())
+		return;
+
+	glm::vec3 low = vertices[0].position, high = low;
+	for (const Vertex & vertex : vertices) {
+		low  = glm::min(low, vertex.position);
+		high = glm::max(high, vertex.position);
+	}
+
+	center = (low + high) * 0.5f;
+	float radius2 = 0.0f;
+	for (const Vertex & vertex : vertices) {
+		glm::vec3 d = vertex.position - center;
+		radius2 = std::max(radius2, glm::dot(d, d));
+	}
+	radius = std::sqrt(radius2);
+}
+
+
+
+
+
+/*************************************************
+*
+* Quadrics
+*
+*************************************************/
+
+/** Sum of area weighted squared plane distances, symmetric 4x4 stored as its upper half */
+struct Quadric {
+	double a00, a01, a02, a11, a12, a22;
+	double b0, b1, b2;
+	double c;
+	double weight;
+};
+
+static void addPlane(Quadric & q, const glm::dvec3 & n, double d, double weight) {
+	q.a00 += weight * n.x * n.x;
+	q.a01 += weight * n.x * n.y;
+	q.a02 += weight * n.x * n.z;
+	q.a11 += weight * n.y * n.y;
+	q.a12 += weight * n.y * n.z;
+	q.a22 += weight * n.z * n.z;
+	q.b0  += weight * n.x * d;
+	q.b1  += weight * n.y * d;
+	q.b2  += weight * n.z * d;
+	q.c   += weight * d * d;
+	q.weight += weight;
+}
+
+static void addQuadric(Quadric & q, const Quadric & other) {
+	q.a00 += other.a00; q.a01 += other.a01; q.a02 += other.a02;
+	q.a11 += other.a11; q.a12 += other.a12; q.a22 += other.a22;
+	q.b0  += other.b0;  q.b1  += other.b1;  q.b2  += other.b2;
+	q.c   += other.c;
+	q.weight += other.weight;
+}
+
+/** Mean squared distance of p to the planes of the quadric */
+static double evaluate(const Quadric & q, const glm::dvec3 & p) {
+	double e = q.a00 * p.x * p.x + q.a11 * p.y * p.y + q.a22 * p.z * p.z
+		+ 2.0 * (q.a01 * p.x * p.y + q.a02 * p.x * p.z + q.a12 * p.y * p.z)
+		+ 2.0 * (q.b0 * p.x + q.b1 * p.y + q.b2 * p.z)
+		+ q.c;
+	return q.weight > 0.0 ? std::fabs(e) / q.weight : 0.0;
+}
+
+
+
+
+
+/*************************************************
+*
+* Simplification
+*
+*************************************************/
+
+struct PositionKey {
+	const glm::vec3 * position;
+	bool operator==(const PositionKey & other) const {
+		return std::memcmp(position, other.position, sizeof(glm::vec3)) == 0;
+	}
+};
+
+struct PositionKeyHash {
+	size_t operator()(const PositionKey & key) const {
+		uint32_t bits[3];
+		std::memcpy(bits, key.position, sizeof(bits));
+		return (size_t) ((bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u));
+	}
+};
+
+struct Collapse {
+	unsigned int vertex; // removed
+	unsigned int target; // kept, takes the vertex's place in its triangles
+	double cost;
+};
+
+/** Triangles around each vertex, compressed rows */
+struct TriangleAdjacency {
+	std::vector<unsigned int> offsets;
+	std::vector<unsigned int> triangles;
+
+	void build(const std::vector<unsigned int> & indices, size_t vertexCount) {
+		offsets.assign(vertexCount + 1, 0);
+		for (unsigned int index : indices)
+			offsets[index + 1]++;
+		for (size_t i=0; i<vertexCount; i++)
+			offsets[i + 1] += offsets[i];
+		triangles.resize(indices.size());
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i=0; i<indices.size(); i++)
+			triangles[fill[indices[i]]++] = (unsigned int) (i / 3);
+	}
+};
+
+static glm::dvec3 triangleNormal(const glm::dvec3 & a, const glm::dvec3 & b, const glm::dvec3 & c) {
+	return glm::cross(b - a, c - a);
+}
+
+/**
+* Moving vertex onto target must keep the surface a manifold (the two only share the
+* neighbours of their common triangles) and must not fold any remaining triangle over.
+*/
+static bool collapseAllowed(const Collapse & collapse, const std::vector<unsigned int> & indices,
+	const TriangleAdjacency & adjacency, const std::vector<glm::dvec3> & positions) {
+
+	unsigned int v = collapse.vertex, t = collapse.target;
+	std::vector<unsigned int> vertexRing, targetRing;
+	unsigned int shared = 0;
+
+	for (unsigned int k=adjacency.offsets[v]; k<adjacency.offsets[v + 1]; k++) {
+
+		const unsigned int * tri = &indices[adjacency.triangles[k] * 3];
+		for (int j=0; j<3; j++)
+			if (tri[j] != v && tri[j] != t)
+				vertexRing.push_back(tri[j]);
+
+		if (tri[0] == t || tri[1] == t || tri[2] == t) {
+			shared++;
+			continue;
+		}
+
+		// Flip / sliver check on the triangles that survive the collapse
+		glm::dvec3 p[3], q[3];
+		for (int j=0; j<3; j++) {
+			p[j] = positions[tri[j]];
+			q[j] = tri[j] == v ? positions[t] : p[j];
+		}
+		glm::dvec3 before = triangleNormal(p[0], p[1], p[2]);
+		glm::dvec3 after  = triangleNormal(q[0], q[1], q[2]);
+		if (glm::dot(before, after) <= 0.25 * glm::length(before) * glm::length(after))
+			return false;
+	}
+
+	for (unsigned int k=adjacency.offsets[t]; k<adjacency.offsets[t + 1]; k++) {
+		const unsigned int * tri = &indices[adjacency.triangles[k] * 3];
+		for (int j=0; j<3; j++)
+			if (tri[j] != t && tri[j] != v)
+				targetRing.push_back(tri[j]);
+	}
+
+	std::sort(vertexRing.begin(), vertexRing.end());
+	vertexRing.erase(std::unique(vertexRing.begin(), vertexRing.end()), vertexRing.end());
+	std::sort(targetRing.begin(), targetRing.end());
+	targetRing.erase(std::unique(targetRing.begin(), targetRing.end()), targetRing.end());
+
+	// Only the third corners of the shared triangles may be common, anything more pinches the surface
+	unsigned int common = 0;
+	for (unsigned int w : vertexRing)
+		if (std::binary_search(targetRing.begin(), targetRing.end(), w))
+			common++;
+	return shared > 0 && common <= shared;
+}
+
+std::vector<unsigned int> SimplifyMesh(const std::vector<Vertex> & vertices,
+	const std::vector<unsigned int> & indices, size_t targetIndexCount, float maxError, float & error) {
+
+	error = 0.0f;
+	std::vector<unsigned int> result(indices);
+	size_t vertexCount = vertices.size();
+	if (result.size() <= targetIndexCount || vertexCount == 0)
+		return result;
+
+	// Work in the unit sphere so costs are relative errors whatever the model scale
+	glm::vec3 center;
+	float radius;
+	ComputeBoundingSphere(vertices, center, radius);
+	double scale = radius > 0.0f ? 1.0 / radius : 1.0;
+
+	std::vector<glm::dvec3> positions(vertexCount);
+	for (size_t i=0; i<vertexCount; i++)
+		positions[i] = glm::dvec3(vertices[i].position - center) * scale;
+
+	// Vertices sharing a position: first one of the group, quadrics live there
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<unsigned int> wedges(vertexCount, 0);
+	{
+		std::unordered_map<PositionKey, unsigned int, PositionKeyHash> first;
+		first.reserve(vertexCount);
+		for (size_t i=0; i<vertexCount; i++) {
+			auto inserted = first.insert({PositionKey{&vertices[i].position}, (unsigned int) i});
+			remap[i] = inserted.first->second;
+			wedges[remap[i]]++;
+		}
+	}
+
+	// Seams (several vertices on one position) and open edges never move
+	std::vector<char> locked(vertexCount, 0);
+	for (size_t i=0; i<vertexCount; i++)
+		if (wedges[remap[i]] > 1)
+			locked[i] = 1;
+	{
+		std::unordered_map<uint64_t, unsigned int> edges;
+		edges.reserve(result.size());
+		for (size_t i=0; i<result.size(); i+=3)
+			for (int j=0; j<3; j++) {
+				uint64_t a = result[i + j], b = result[i + (j + 1) % 3];
+				edges[(a << 32) | b]++;
+			}
+		for (const auto & edge : edges) {
+			uint64_t a = edge.first >> 32, b = edge.first & 0xffffffffu;
+			if (edge.second != 1 || edges.find((b << 32) | a) == edges.end()) {
+				locked[a] = 1;
+				locked[b] = 1;
+			}
+		}
+	}
+
+	std::vector<Quadric> quadrics(vertexCount);
+	std::memset((void *) quadrics.data(), 0, quadrics.size() * sizeof(Quadric));
+	for (size_t i=0; i<result.size(); i+=3) {
+		const glm::dvec3 & p0 = positions[result[i]];
+		glm::dvec3 n = triangleNormal(p0, positions[result[i + 1]], positions[result[i + 2]]);
+		double area2 = glm::length(n);
+		if (area2 <= 0.0)
+			continue;
+		n /= area2;
+		for (int j=0; j<3; j++)
+			addPlane(quadrics[remap[result[i + j]]], n, -glm::dot(n, p0), area2 * 0.5);
+	}
+
+	double limit = (double) maxError * maxError;
+	double reached = 0.0;
+	size_t targetTriangles = targetIndexCount / 3;
+
+	TriangleAdjacency adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> collapseTo(vertexCount);
+	std::vector<char> touched(vertexCount);
+
+	/**
+	* Passes of independent collapses: the cheapest collapse of every free vertex is
+	* tried in cost order, a collapse freezes its neighbourhood until the next pass.
+	*/
+	while (result.size() / 3 > targetTriangles) {
+
+		adjacency.build(result, vertexCount);
+
+		collapses.clear();
+		for (size_t i=0; i<result.size(); i+=3)
+			for (int j=0; j<3; j++) {
+				unsigned int a = result[i + j], b = result[i + (j + 1) % 3];
+				for (int dir=0; dir<2; dir++) {
+					unsigned int v = dir ? b : a, t = dir ? a : b;
+					if (locked[v])
+						continue;
+					collapses.push_back(Collapse{v, t, evaluate(quadrics[remap[v]], positions[t])});
+				}
+			}
+
+		// Keep the cheapest target per vertex
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse & x, const Collapse & y) {
+			return x.vertex != y.vertex ? x.vertex < y.vertex : x.cost < y.cost;
+		});
+		collapses.erase(std::unique(collapses.begin(), collapses.end(), [](const Collapse & x, const Collapse & y) {
+			return x.vertex == y.vertex;
+		}), collapses.end());
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse & x, const Collapse & y) {
+			return x.cost < y.cost;
+		});
+
+		for (size_t i=0; i<vertexCount; i++)
+			collapseTo[i] = (unsigned int) i;
+		std::fill(touched.begin(), touched.end(), 0);
+
+		size_t triangles = result.size() / 3;
+		size_t applied = 0;
+
+		for (const Collapse & collapse : collapses) {
+
+			if (collapse.cost > limit || triangles <= targetTriangles)
+				break;
+
+			unsigned int v = collapse.vertex, t = collapse.target;
+			if (touched[v] || touched[t] || !collapseAllowed(collapse, result, adjacency, positions))
+				continue;
+
+			for (unsigned int k=adjacency.offsets[v]; k<adjacency.offsets[v + 1]; k++) {
+				const unsigned int * tri = &result[adjacency.triangles[k] * 3];
+				if (tri[0] == t || tri[1] == t || tri[2] == t)
+					triangles--;
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+			}
+
+			collapseTo[v] = t;
+			addQuadric(quadrics[remap[t]], quadrics[remap[v]]);
+			reached = std::max(reached, collapse.cost);
+			applied++;
+		}
+
+		if (applied == 0)
+			break;
+
+		// Move the collapsed corners and drop the triangles that became degenerate
+		size_t write = 0;
+		for (size_t i=0; i<result.size(); i+=3) {
+			unsigned int a = collapseTo[result[i]], b = collapseTo[result[i + 1]], c = collapseTo[result[i + 2]];
+			if (a == b || b == c || c == a)
+				continue;
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+	}
+
+	error = (float) std::sqrt(reached);
+	return result;
+}
+
+void GenerateLods(MeshData & mesh, const LodSettings & settings) {
+
+	mesh.lods.clear();
+	unsigned int levels = std::min(settings.levels, (unsigned int) MESH_SIMPLIFIER_MAX_LEVELS);
+	if (mesh.indices.size() < 3 || levels < 2)
+		return;
+
+	size_t previous = mesh.indices.size();
+	double target = (double) previous;
+
+	for (unsigned int level=1; level<levels; level++) {
+
+		// Every level starts from LOD 0, so its error is measured against the full mesh
+		target *= settings.ratio;
+		MeshLod lod;
+		lod.indices = SimplifyMesh(mesh.vertices, mesh.indices, (size_t) target / 3 * 3,
+			settings.maxError, lod.error);
+
+		// Locked vertices or the error bound stopped it, coarser levels would not get further
+		if (lod.indices.empty() || lod.indices.size() * 10 > previous * 9)
+			break;
+
+		OptimizeVertexCache(lod.indices, mesh.vertices.size());
+		previous = lod.indices.size();
+		mesh.lods.push_back(std::move(lod));
+	}
+}
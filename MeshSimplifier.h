@@ -0,0 +1,46 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <vector>
+#include <cstddef>
+
+#include <Mesh.h>
+
+/**
+* Import-time level of detail generation.
+*
+* Quadric error metric simplification by half-edge collapses: a vertex is
+* merged into one of its neighbours, so every LOD is only a new index list
+* over the unchanged LOD 0 vertices and the whole chain shares one vertex
+* buffer. Border and attribute seam vertices (same position, several
+* vertices) are locked, which keeps UV charts and open edges in place.
+*
+* Errors are distances relative to the mesh bounding sphere radius, so
+* the renderer turns them into pixels with the mesh's projected size.
+*/
+
+struct LodSettings {
+	unsigned int levels = 4;   // LOD 0 included, at most MESH_SIMPLIFIER_MAX_LEVELS
+	float ratio = 0.5f;        // triangle count of each level relative to the previous one
+	float maxError = 0.05f;    // largest relative error a level may reach, the chain stops there
+};
+
+#define MESH_SIMPLIFIER_MAX_LEVELS 8
+
+/** Settings folded into 24 bits, part of the mesh cache options */
+unsigned int LodSettingsKey(const LodSettings & settings);
+
+/** Bounding sphere of a vertex set (center of the bounding box, farthest vertex) */
+void ComputeBoundingSphere(const std::vector<Vertex> & vertices, glm::vec3 & center, float & radius);
+
+/**
+* Simplifies a triangle list down to about targetIndexCount indices without exceeding
+* maxError. Returns the new indices; error receives the largest relative error reached.
+*/
+std::vector<unsigned int> SimplifyMesh(const std::vector<Vertex> & vertices,
+	const std::vector<unsigned int> & indices, size_t targetIndexCount, float maxError, float & error);
+
+/** Fills mesh.lods with levels 1..settings.levels-1. Vertices must be final (after OptimizeMesh). Safe on any thread */
+void GenerateLods(MeshData & mesh, const LodSettings & settings);
+
+#endif
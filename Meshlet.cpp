@@ -0,0 +1,217 @@
+#include <Meshlet.h>
+#include <Mesh.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+Frustum ExtractFrustum(const glm::mat4 & clip) {
+
+	// Gribb / Hartmann: rows of the clip matrix (glm is column major)
+	glm::vec4 row[4];
+	for (int i=0; i<4; i++)
+		row[i] = glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+
+	Frustum frustum;
+	frustum.planes[0] = row[3] + row[0];
+	frustum.planes[1] = row[3] - row[0];
+	frustum.planes[2] = row[3] + row[1];
+	frustum.planes[3] = row[3] - row[1];
+	frustum.planes[4] = row[3] + row[2];
+	frustum.planes[5] = row[3] - row[2];
+
+	for (glm::vec4 & plane : frustum.planes) {
+		float length = glm::length(glm::vec3(plane));
+		if (length > 0.0f)
+			plane /= length;
+	}
+	return frustum;
+}
+
+bool SphereInFrustum(const Frustum & frustum, const glm::vec3 & center, float radius) {
+	for (const glm::vec4 & plane : frustum.planes)
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+			return false;
+	return true;
+}
+
+bool MeshletVisible(const Meshlet & meshlet, const Frustum & frustum, const glm::vec3 & eye, unsigned int cull) {
+
+	if ((cull & CLUSTER_CULL_FRUSTUM) && !SphereInFrustum(frustum, meshlet.center, meshlet.radius))
+		return false;
+
+	if ((cull & CLUSTER_CULL_BACKFACE) && meshlet.coneCutoff <= 1.0f) {
+		glm::vec3 view = meshlet.coneApex - eye;
+		float length = glm::length(view);
+		if (length > 0.0f && glm::dot(view, meshlet.coneAxis) >= meshlet.coneCutoff * length)
+			return false;
+	}
+
+	return true;
+}
+
+static void computeBounds(Meshlet & meshlet, const std::vector<Vertex> & vertices,
+	const unsigned int * indices) {
+
+	size_t count = meshlet.indexCount;
+
+	// Sphere: box center, farthest corner
+	glm::vec3 low = vertices[indices[0]].position, high = low;
+	for (size_t i=0; i<count; i++) {
+		low  = glm::min(low, vertices[indices[i]].position);
+		high = glm::max(high, vertices[indices[i]].position);
+	}
+	meshlet.center = (low + high) * 0.5f;
+	float radius2 = 0.0f;
+	for (size_t i=0; i<count; i++) {
+		glm::vec3 d = vertices[indices[i]].position - meshlet.center;
+		radius2 = std::max(radius2, glm::dot(d, d));
+	}
+	meshlet.radius = std::sqrt(radius2);
+
+	// Cone: average face normal, spread from the widest one
+	std::vector<glm::vec3> normals;
+	normals.reserve(count / 3);
+	glm::vec3 axis(0.0f);
+	for (size_t i=0; i<count; i+=3) {
+		const glm::vec3 & p0 = vertices[indices[i]].position;
+		glm::vec3 n = glm::cross(vertices[indices[i + 1]].position - p0, vertices[indices[i + 2]].position - p0);
+		float length = glm::length(n);
+		if (length <= 0.0f) {
+			normals.push_back(glm::vec3(0.0f));
+			continue;
+		}
+		normals.push_back(n / length);
+		axis += normals.back();
+	}
+
+	meshlet.coneApex = meshlet.center;
+	meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+	meshlet.coneCutoff = 2.0f;
+
+	float axisLength = glm::length(axis);
+	if (axisLength <= 0.0f)
+		return;
+	axis /= axisLength;
+
+	float minDot = 1.0f;
+	for (const glm::vec3 & n : normals)
+		if (n != glm::vec3(0.0f))
+			minDot = std::min(minDot, glm::dot(n, axis));
+
+	// Past ~85 degrees the cone almost never culls and the apex runs off to infinity
+	if (minDot <= 0.1f)
+		return;
+
+	// Apex far enough behind the cluster that every triangle plane faces away from it
+	float maxT = 0.0f;
+	for (size_t i=0, t=0; i<count; i+=3, t++) {
+		const glm::vec3 & n = normals[t];
+		if (n == glm::vec3(0.0f))
+			continue;
+		float along = glm::dot(meshlet.center - vertices[indices[i]].position, n) / glm::dot(axis, n);
+		maxT = std::max(maxT, along);
+	}
+
+	meshlet.coneApex = meshlet.center - axis * maxT;
+	meshlet.coneAxis = axis;
+	meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+std::vector<Meshlet> BuildMeshlets(const std::vector<Vertex> & vertices, std::vector<unsigned int> & indices) {
+
+	std::vector<Meshlet> meshlets;
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return meshlets;
+
+	// Triangles around each vertex
+	std::vector<unsigned int> offsets(vertices.size() + 1, 0);
+	for (unsigned int index : indices)
+		offsets[index + 1]++;
+	for (size_t i=0; i<vertices.size(); i++)
+		offsets[i + 1] += offsets[i];
+	std::vector<unsigned int> adjacency(indices.size());
+	{
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i=0; i<indices.size(); i++)
+			adjacency[fill[indices[i]]++] = (unsigned int) (i / 3);
+	}
+
+	std::vector<char> emitted(triangleCount, 0);
+	std::vector<unsigned int> stamp(vertices.size(), 0); // meshlet number + 1 holding the vertex
+	std::vector<unsigned int> ordered;
+	ordered.reserve(indices.size());
+	std::vector<unsigned int> meshletVertices;
+	size_t cursor = 0;
+
+	auto newVertices = [&](size_t triangle, unsigned int id) {
+		unsigned int added = 0;
+		for (int j=0; j<3; j++)
+			if (stamp[indices[triangle * 3 + j]] != id)
+				added++;
+		return added;
+	};
+
+	while (true) {
+
+		// Seed with the first free triangle in the (cache optimized) input order
+		while (cursor < triangleCount && emitted[cursor])
+			cursor++;
+		if (cursor == triangleCount)
+			break;
+
+		unsigned int id = (unsigned int) meshlets.size() + 1;
+		Meshlet meshlet;
+		meshlet.firstIndex = (unsigned int) ordered.size();
+		meshlet.indexCount = 0;
+		meshletVertices.clear();
+
+		size_t triangle = cursor;
+		while (true) {
+
+			emitted[triangle] = 1;
+			for (int j=0; j<3; j++) {
+				unsigned int index = indices[triangle * 3 + j];
+				if (stamp[index] != id) {
+					stamp[index] = id;
+					meshletVertices.push_back(index);
+				}
+				ordered.push_back(index);
+			}
+			meshlet.indexCount += 3;
+			if (meshlet.indexCount / 3 >= MESHLET_MAX_TRIANGLES)
+				break;
+
+			// Grow over shared vertices, fewest new vertices first
+			size_t best = triangleCount;
+			unsigned int bestAdded = 4;
+			for (unsigned int vertex : meshletVertices) {
+				for (unsigned int k=offsets[vertex]; k<offsets[vertex + 1]; k++) {
+					unsigned int candidate = adjacency[k];
+					if (emitted[candidate])
+						continue;
+					unsigned int added = newVertices(candidate, id);
+					if (added < bestAdded || (added == bestAdded && candidate < best)) {
+						best = candidate;
+						bestAdded = added;
+					}
+				}
+				if (bestAdded == 0)
+					break;
+			}
+
+			if (best == triangleCount || meshletVertices.size() + bestAdded > MESHLET_MAX_VERTICES)
+				break;
+			triangle = best;
+		}
+
+		computeBounds(meshlet, vertices, &ordered[meshlet.firstIndex]);
+		meshlets.push_back(meshlet);
+	}
+
+	indices.swap(ordered);
+	return meshlets;
+}
@@ -0,0 +1,55 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <vector>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+struct Vertex;
+
+#define MESHLET_MAX_VERTICES  64
+#define MESHLET_MAX_TRIANGLES 124
+
+/**
+* Cluster of neighbouring triangles, a contiguous run of the mesh's LOD 0 indices.
+* Bounds are in object space. The cone holds every triangle normal of the
+* cluster: seen from a point where dot(normalize(coneApex - eye), coneAxis) >= coneCutoff
+* the whole cluster is backfacing.
+*/
+struct Meshlet {
+	unsigned int firstIndex;
+	unsigned int indexCount;
+	glm::vec3 center;
+	float radius;
+	glm::vec3 coneApex;
+	glm::vec3 coneAxis;
+	float coneCutoff; // > 1 when the normals spread too wide for a useful cone
+};
+
+/** Cluster tests, combined as a bitmask. Draws default to the frustum alone, backface culling is opt-in */
+enum ClusterCull {
+	CLUSTER_CULL_NONE     = 0,
+	CLUSTER_CULL_FRUSTUM  = 1 << 0,
+	CLUSTER_CULL_BACKFACE = 1 << 1, // only for closed geometry drawn with back faces culled
+	CLUSTER_CULL_ALL      = CLUSTER_CULL_FRUSTUM | CLUSTER_CULL_BACKFACE
+};
+
+/** Six normalized planes (left, right, bottom, top, near, far), inside is dot(plane, p) >= 0 */
+struct Frustum {
+	glm::vec4 planes[6];
+};
+
+/** Planes of a clip matrix, in the space the matrix transforms from (projection * view * model: object space) */
+Frustum ExtractFrustum(const glm::mat4 & clip);
+bool SphereInFrustum(const Frustum & frustum, const glm::vec3 & center, float radius);
+bool MeshletVisible(const Meshlet & meshlet, const Frustum & frustum, const glm::vec3 & eye, unsigned int cull);
+
+/**
+* Splits a triangle list into clusters of at most MESHLET_MAX_VERTICES vertices and
+* MESHLET_MAX_TRIANGLES triangles, grown over shared vertices. indices are reordered
+* so every cluster is contiguous. Safe on any thread.
+*/
+std::vector<Meshlet> BuildMeshlets(const std::vector<Vertex> & vertices, std::vector<unsigned int> & indices);
+
+#endif
@@ -0,0 +1,255 @@
+#include <Mipmap.h>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIPMAP_SSE2 1
+#include <emmintrin.h>
+#endif
+
+/** Separable downsampling kernel, taps are relative to 2x */
+struct MipKernel {
+	int taps;
+	int offsets[6];
+	float weights[6];
+};
+
+static double besselI0(double x) {
+	double sum = 1.0, term = 1.0;
+	for (int k=1; k<32; k++) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+static MipKernel makeKernel(MipFilter filter) {
+
+	MipKernel kernel;
+
+	if (filter == MIP_BOX) {
+		kernel.taps = 2;
+		kernel.offsets[0] = 0;    kernel.offsets[1] = 1;
+		kernel.weights[0] = 0.5f; kernel.weights[1] = 0.5f;
+		return kernel;
+	}
+
+	// Half-band sinc under a Kaiser window (alpha 4), taps at +-0.5, +-1.5, +-2.5 texels
+	const double pi = 3.14159265358979323846, alpha = 4.0, radius = 3.0;
+	double total = 0.0, weights[6];
+	for (int k=0; k<6; k++) {
+		double x = (k - 2) - 0.5;
+		double sinc = std::sin(pi * x / 2.0) / (pi * x / 2.0);
+		double r = x / radius;
+		double window = besselI0(alpha * std::sqrt(std::max(0.0, 1.0 - r * r))) / besselI0(alpha);
+		weights[k] = sinc * window;
+		total += weights[k];
+	}
+
+	kernel.taps = 6;
+	for (int k=0; k<6; k++) {
+		kernel.offsets[k] = k - 2;
+		kernel.weights[k] = (float)(weights[k] / total);
+	}
+	return kernel;
+}
+
+/** sRGB <-> linear tables, built once */
+struct SRGBTables {
+	float toLinear[256];
+	unsigned char fromLinear[16384];
+
+	SRGBTables() {
+		for (int i=0; i<256; i++) {
+			float c = i / 255.0f;
+			toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i=0; i<16384; i++) {
+			float l = i / 16383.0f;
+			float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+			fromLinear[i] = (unsigned char) std::min(255, (int)(c * 255.0f + 0.5f));
+		}
+	}
+};
+
+static const SRGBTables & srgbTables() {
+	static SRGBTables tables;
+	return tables;
+}
+
+void ExpandToRGBA(const unsigned char * pixels, int width, int height, int channels,
+	std::vector<unsigned char> & rgba) {
+
+	size_t count = (size_t) width * height;
+	rgba.resize(count * 4);
+
+	if (channels == 4) {
+		std::memcpy(rgba.data(), pixels, count * 4);
+		return;
+	}
+
+	for (size_t i=0; i<count; i++) {
+		const unsigned char * p = pixels + i * channels;
+		unsigned char * q = &rgba[4 * i];
+		if (channels >= 3) {
+			q[0] = p[0]; q[1] = p[1]; q[2] = p[2]; q[3] = 255;
+		} else {
+			// grey or grey + alpha
+			q[0] = q[1] = q[2] = p[0];
+			q[3] = channels == 2 ? p[1] : 255;
+		}
+	}
+}
+
+int MipLevelCount(int width, int height) {
+	int levels = 1;
+	for (int size = std::max(width, height); size > 1; size /= 2)
+		levels++;
+	return levels;
+}
+
+static void toFloat(const unsigned char * rgba, size_t count, bool srgb, std::vector<float> & out) {
+	const float * toLinear = srgbTables().toLinear;
+	out.resize(count * 4);
+	for (size_t i=0; i<count; i++) {
+		const unsigned char * p = rgba + 4 * i;
+		float * q = &out[4 * i];
+		q[0] = srgb ? toLinear[p[0]] : p[0] / 255.0f;
+		q[1] = srgb ? toLinear[p[1]] : p[1] / 255.0f;
+		q[2] = srgb ? toLinear[p[2]] : p[2] / 255.0f;
+		q[3] = p[3] / 255.0f;
+	}
+}
+
+static void toBytes(const float * linear, size_t count, bool srgb, std::vector<unsigned char> & out) {
+
+	const unsigned char * fromLinear = srgbTables().fromLinear;
+	out.resize(count * 4);
+
+#ifdef MIPMAP_SSE2
+	const __m128 zero  = _mm_setzero_ps();
+	const __m128 one   = _mm_set1_ps(1.0f);
+	const __m128 half  = _mm_set1_ps(0.5f);
+	const __m128 scale = srgb ? _mm_setr_ps(16383.0f, 16383.0f, 16383.0f, 255.0f) : _mm_set1_ps(255.0f);
+	for (size_t i=0; i<count; i++) {
+		__m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(linear + 4 * i), zero), one);
+		__m128i q = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half));
+		int values[4];
+		_mm_storeu_si128((__m128i *) values, q);
+		unsigned char * p = &out[4 * i];
+		if (srgb) {
+			p[0] = fromLinear[values[0]];
+			p[1] = fromLinear[values[1]];
+			p[2] = fromLinear[values[2]];
+		} else {
+			p[0] = (unsigned char) values[0];
+			p[1] = (unsigned char) values[1];
+			p[2] = (unsigned char) values[2];
+		}
+		p[3] = (unsigned char) values[3];
+	}
+#else
+	for (size_t i=0; i<count; i++) {
+		const float * v = linear + 4 * i;
+		unsigned char * p = &out[4 * i];
+		for (int k=0; k<4; k++) {
+			float c = std::min(1.0f, std::max(0.0f, v[k]));
+			if (srgb && k < 3)
+				p[k] = fromLinear[(int)(c * 16383.0f + 0.5f)];
+			else
+				p[k] = (unsigned char)(c * 255.0f + 0.5f);
+		}
+	}
+#endif
+}
+
+/** dst(x, y) = sum w * src(2x + o, y), one RGBA pixel per SIMD register */
+static void filterRows(const float * src, int srcWidth, int height, float * dst, int dstWidth,
+	const MipKernel & kernel) {
+
+	for (int y=0; y<height; y++) {
+		const float * in = src + (size_t) y * srcWidth * 4;
+		float * out = dst + (size_t) y * dstWidth * 4;
+		for (int x=0; x<dstWidth; x++) {
+#ifdef MIPMAP_SSE2
+			__m128 sum = _mm_setzero_ps();
+			for (int k=0; k<kernel.taps; k++) {
+				int sx = std::min(std::max(2 * x + kernel.offsets[k], 0), srcWidth - 1);
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(kernel.weights[k]), _mm_loadu_ps(in + 4 * sx)));
+			}
+			_mm_storeu_ps(out + 4 * x, sum);
+#else
+			float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (int k=0; k<kernel.taps; k++) {
+				int sx = std::min(std::max(2 * x + kernel.offsets[k], 0), srcWidth - 1);
+				for (int c=0; c<4; c++)
+					sum[c] += kernel.weights[k] * in[4 * sx + c];
+			}
+			std::memcpy(out + 4 * x, sum, sizeof(sum));
+#endif
+		}
+	}
+}
+
+/** dst(x, y) = sum w * src(x, 2y + o), whole rows at a time */
+static void filterColumns(const float * src, int width, int srcHeight, float * dst, int dstHeight,
+	const MipKernel & kernel) {
+
+	size_t rowSize = (size_t) width * 4;
+	for (int y=0; y<dstHeight; y++) {
+		float * out = dst + (size_t) y * rowSize;
+		std::fill(out, out + rowSize, 0.0f);
+		for (int k=0; k<kernel.taps; k++) {
+			int sy = std::min(std::max(2 * y + kernel.offsets[k], 0), srcHeight - 1);
+			const float * in = src + (size_t) sy * rowSize;
+			float w = kernel.weights[k];
+			size_t i = 0;
+#ifdef MIPMAP_SSE2
+			__m128 weight = _mm_set1_ps(w);
+			for (; i + 8 <= rowSize; i += 8) {
+				__m128 a = _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(weight, _mm_loadu_ps(in + i)));
+				__m128 b = _mm_add_ps(_mm_loadu_ps(out + i + 4), _mm_mul_ps(weight, _mm_loadu_ps(in + i + 4)));
+				_mm_storeu_ps(out + i, a);
+				_mm_storeu_ps(out + i + 4, b);
+			}
+#endif
+			for (; i<rowSize; i++)
+				out[i] += w * in[i];
+		}
+	}
+}
+
+void GenerateMipChain(const unsigned char * rgba, int width, int height, bool srgb, MipFilter filter,
+	std::vector<std::vector<unsigned char> > & levels) {
+
+	static const MipKernel box = makeKernel(MIP_BOX);
+	static const MipKernel kaiser = makeKernel(MIP_KAISER);
+	const MipKernel & kernel = filter == MIP_KAISER ? kaiser : box;
+
+	levels.clear();
+	levels.reserve(MipLevelCount(width, height));
+	levels.emplace_back(rgba, rgba + (size_t) width * height * 4);
+
+	// Filter in linear float, each level comes from the unrounded previous one
+	std::vector<float> current, rows, next;
+	toFloat(rgba, (size_t) width * height, srgb, current);
+
+	while (width > 1 || height > 1) {
+		int nextWidth = std::max(1, width / 2), nextHeight = std::max(1, height / 2);
+
+		rows.resize((size_t) nextWidth * height * 4);
+		filterRows(current.data(), width, height, rows.data(), nextWidth, kernel);
+		next.resize((size_t) nextWidth * nextHeight * 4);
+		filterColumns(rows.data(), nextWidth, height, next.data(), nextHeight, kernel);
+
+		levels.emplace_back();
+		toBytes(next.data(), (size_t) nextWidth * nextHeight, srgb, levels.back());
+
+		current.swap(next);
+		width  = nextWidth;
+		height = nextHeight;
+	}
+}
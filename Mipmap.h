@@ -0,0 +1,30 @@
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include <vector>
+
+/**
+* CPU mip chain generation, replaces glGenerateMipmap at load time.
+*
+* Levels are filtered in linear light (sRGB colour is decoded first, alpha
+* is always linear) and each level is built from the float result of the
+* previous one, not from its 8-bit rounding. SSE2 kernels when available.
+*/
+
+enum MipFilter {
+	MIP_BOX,   // 2x2 average
+	MIP_KAISER // 6-tap Kaiser-windowed sinc, sharper, may ring slightly
+};
+
+/** RGBA8 copy of an 8-bit image with 1-4 channels, rows are 4-byte aligned for upload */
+void ExpandToRGBA(const unsigned char * pixels, int width, int height, int channels,
+	std::vector<unsigned char> & rgba);
+
+/** Every level down to 1x1 (level 0 included) from an RGBA8 image. Any thread */
+void GenerateMipChain(const unsigned char * rgba, int width, int height, bool srgb, MipFilter filter,
+	std::vector<std::vector<unsigned char> > & levels);
+
+/** Number of levels in a full chain */
+int MipLevelCount(int width, int height);
+
+#endif
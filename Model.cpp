@@ -2,6 +2,15 @@
 #include <Mesh.h>
 #include <ShaderProgram.h>
 #include <Texture.h>
+#include <MeshCache.h>
+#include <ObjLoader.h>
+#include <GltfLoader.h>
+#include <TangentSpace.h>
+#include <ThreadPool.h>
+#include <MeshOptimizer.h>
+#include <MeshSimplifier.h>
+#include <Meshlet.h>
+#include <EularCamera.h>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
@@ -14,9 +23,13 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <utility>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
 
-Model :: Model(std::string path, bool gamma)
-	: gammaCorrection(gamma)
+Model :: Model(std::string path, bool gamma, unsigned int flags, const LodSettings & lodSettings)
+	: gammaCorrection(gamma), flags(flags), lodSettings(lodSettings), virtualTextures(false)
 {
 	//position = glm::vec3(0.0f, 0.0f, 0.0f);
 	//scale    = glm::vec3(1.0f, 1.0f, 1.0f);
@@ -26,28 +39,220 @@ Model :: Model(std::string path, bool gamma)
 }
 
 Model :: ~Model() {
+	// Textures are released with textureRefs, by the last model using them
 	for (Mesh & mesh : meshes)
 		mesh.DeleteBuffers();
+	textureArrays.Delete();
 }
 
 void Model :: Draw(Shader & shader) {
 
+	if (!pendingTextures.empty())
+		resolvePendingTextures();
+
 	shader.use();
+	BindMaterials(shader);
 	for (Mesh & mesh : meshes)
 		mesh.Draw(shader);
 }
 
+size_t Model :: DrawCulled(Shader & shader, const glm::mat4 & viewProjection, const glm::mat4 & modelMatrix,
+	const glm::vec3 & eye, unsigned int cull) {
+
+	if (!pendingTextures.empty())
+		resolvePendingTextures();
+
+	// Cluster bounds are object space: bring the frustum and the eye there once
+	Frustum frustum = ExtractFrustum(viewProjection * modelMatrix);
+	glm::vec3 localEye = glm::vec3(glm::inverse(modelMatrix) * glm::vec4(eye, 1.0f));
+
+	shader.use();
+	BindMaterials(shader);
+	size_t drawn = 0;
+	for (Mesh & mesh : meshes)
+		drawn += mesh.DrawClusters(shader, frustum, localEye, cull);
+	return drawn;
+}
+
+void Model :: Submit(RenderQueue & queue, Shader & shader, const glm::mat4 & modelMatrix,
+	RenderPass pass, unsigned int cull) {
+
+	if (!pendingTextures.empty())
+		resolvePendingTextures();
+
+	// Nothing model-wide to bind: let the meshes group with other models' meshes
+	Model * owner = (textureArrays.Size() == 0 && !virtualTextures) ? NULL : this;
+	uint32_t transform = queue.AddTransform(modelMatrix, cull);
+	for (Mesh & mesh : meshes)
+		queue.Add(mesh, shader, transform, pass, owner);
+}
+
+void Model :: BindMaterials(Shader & shader) {
+	textureArrays.Bind();
+	if (virtualTextures)
+		VirtualTextureCache::Shared().Bind(shader);
+}
+
+void Model :: UpdateLod(const Camera & camera, const glm::mat4 & modelMatrix, float viewportHeight) {
+
+	if (flags & MODEL_LOD)
+		SelectLods(meshes, camera, modelMatrix, viewportHeight);
+}
+
+void Model :: SelectLods(std::vector<Mesh> & meshes, const Camera & camera, const glm::mat4 & modelMatrix,
+	float viewportHeight) {
+
+	// Largest axis scale, errors are relative to the object space radius
+	float scale = std::max(glm::length(glm::vec3(modelMatrix[0])),
+		std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+	float pixelsPerUnit = viewportHeight * 0.5f / std::tan(glm::radians(camera.fov) * 0.5f);
+
+	for (Mesh & mesh : meshes) {
+
+		if (mesh.LodCount() < 2)
+			continue;
+
+		float radius = mesh.Radius() * scale;
+		glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(mesh.Center(), 1.0f));
+		float distance = std::max(glm::length(center - camera.position) - radius, 1e-3f);
+		float pixels = radius * pixelsPerUnit / distance; // error 1.0 in pixels
+
+		// Finer right away when the error shows, coarser only once well below the threshold
+		unsigned int level = mesh.Lod();
+		while (level > 0 && mesh.LodError(level) * pixels > MODEL_LOD_PIXEL_ERROR)
+			level--;
+		while (level + 1 < mesh.LodCount()
+			&& mesh.LodError(level + 1) * pixels < MODEL_LOD_PIXEL_ERROR * MODEL_LOD_HYSTERESIS)
+			level++;
+		mesh.SetLod(level);
+	}
+}
+
 void Model :: loadModel(std::string & path) {
 
+	/**
+	* Loads a model from its binary mesh cache when that is up to date,
+	* otherwise imports it with ASSIMP and refreshes the cache.
+	* GL objects (buffers, textures) are only created after the CPU data is complete.
+	*/
+
+	// Retrieve directory path of filepath
+	directory = path.substr(0, path.find_last_of('/')) + "/";
+
+	std::vector<MeshData> data;
+	bool useCache = !(flags & MODEL_NO_CACHE);
+	unsigned int cacheOptions = CacheOptions(flags, lodSettings);
+
+	if (useCache && ReadMeshCache(path, data, cacheOptions)) {
+		std::cout << "Model::loadModel: " << directory << " (mesh cache)\n";
+	} else {
+		if (!Import(path, flags, lodSettings, data))
+			return;
+		std::cout << "Model::loadModel: " << directory << "\n";
+		if (useCache)
+			WriteMeshCache(path, data, cacheOptions);
+	}
+
+	VertexFormat format = (flags & MODEL_FULL_VERTICES) ? VERTEX_FULL : VERTEX_PACKED;
+	MeshStorage storage = (flags & MODEL_OWN_BUFFERS) ? MESH_OWN_BUFFERS : MESH_ARENA;
+
+	bool arrays = (flags & MODEL_TEXTURE_ARRAYS) && loadTextureArrays(data);
+	virtualTextures = !arrays && (flags & MODEL_VIRTUAL_TEXTURES) && loadVirtualTextures(data);
+
+	meshes.reserve(data.size());
+	for (MeshData & mesh : data) {
+		// Array and virtual meshes keep their references, the arrays or the page pool hold the images
+		std::vector<Texture> textures = arrays || virtualTextures ? mesh.textures : loadTextures(mesh.textures);
+		meshes.emplace_back(std::move(mesh.vertices), std::move(mesh.indices), std::move(textures), format, storage,
+			mesh.lods, std::move(mesh.meshlets));
+		if (arrays)
+			meshes.back().SetTextureLayers(textureLayers(mesh.textures));
+		if (virtualTextures)
+			meshes.back().SetVirtualTextures(virtualTextureIds(mesh.textures));
+	}
+}
+
+unsigned int Model :: CacheOptions(unsigned int flags, const LodSettings & lodSettings) {
+	unsigned int options = flags & (MODEL_OPTIMIZE | MODEL_LOD | MODEL_MESHLETS);
+	// Another importer, other vertices: bit 8 up holds the LOD settings, bit 0 (MODEL_NO_CACHE) is free here
+	if (flags & MODEL_ASSIMP)
+		options |= 1u << 0;
+	if (flags & MODEL_LOD)
+		options |= LodSettingsKey(lodSettings) << 8;
+	return options;
+}
+
+MeshOptimizeStats Model :: CookMesh(MeshData & mesh, unsigned int flags, const LodSettings & lodSettings) {
+
+	MeshOptimizeStats stats = {};
+	bool lod = (flags & MODEL_LOD) != 0;
+
+	if (flags & MODEL_OPTIMIZE)
+		stats = OptimizeMesh(mesh);
+	else if (lod)
+		WeldVertices(mesh); // split vertices would look like seams and stay locked
+	if (lod)
+		GenerateLods(mesh, lodSettings);
+	if (flags & MODEL_MESHLETS)
+		mesh.meshlets = BuildMeshlets(mesh.vertices, mesh.indices); // reorders LOD 0 only
+
+	return stats;
+}
+
+bool Model :: Import(const std::string & path, unsigned int flags, const LodSettings & lodSettings,
+	std::vector<MeshData> & data) {
+
+	/**
+	* OBJ and glTF binaries go through the native loaders (unless MODEL_ASSIMP),
+	* anything else or a file they reject through ASSIMP
+	*/
+
+	std::vector<MeshOptimizeStats> stats;
+	std::string extension = path.substr(path.find_last_of('.') + 1);
+	for (char & c : extension)
+		c = (char) std::tolower((unsigned char) c);
+	bool parallel = (flags & MODEL_PARALLEL) != 0;
+	bool native = false;
+	if (!(flags & MODEL_ASSIMP)) {
+		if (extension == "obj")
+			native = LoadObj(path, data, parallel);
+		else if (extension == "glb")
+			native = LoadGlb(path, data, parallel);
+	}
+
+	if (native) {
+		stats.resize(data.size());
+		auto cook = [&](size_t i) { stats[i] = CookMesh(data[i], flags, lodSettings); };
+		if (flags & MODEL_PARALLEL) {
+			ThreadPool::Shared().ParallelFor(data.size(), cook);
+		} else {
+			for (size_t i=0; i<data.size(); i++)
+				cook(i);
+		}
+	} else if (!importAssimp(path, flags, lodSettings, data, stats)) {
+		return false;
+	}
+
+	if (flags & MODEL_OPTIMIZE)
+		reportOptimization(path, stats);
+	if (flags & MODEL_LOD)
+		reportLods(path, data);
+
+	return true;
+}
+
+bool Model :: importAssimp(const std::string & path, unsigned int flags, const LodSettings & lodSettings,
+	std::vector<MeshData> & data, std::vector<MeshOptimizeStats> & stats) {
+
 	/**
 	* Loads a model with supported ASSIMP extensions from file
-	* and stores resulting meshes in meshes vector
+	* and stores resulting mesh data in data vector
 	*/
 
 	// Read file via ASSIMP
 	Assimp::Importer importer;
 	const aiScene * scene = importer.ReadFile(path,
-		aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+		aiProcess_Triangulate | aiProcess_FlipUVs);
 
 	/**
 	* iProcess_Triangulate : if the model does not (entirely) consist of triangles,
@@ -55,6 +260,8 @@ void Model :: loadModel(std::string & path) {
 
 	* aiProcess_FlipUVs : flip texture coordinates on the y-axis where necessary during processing.
 
+	* aiProcess_CalcTangentSpace : not used, processMesh builds MikkTSpace frames itself (see TangentSpace).
+
 	* aiProcess_GenNormals : creates normals for each vertex if the model didn't contain normal vectors.
 
 	* aiProcess_SplitLargeMeshes : splits large meshes into smaller sub-meshes which is useful,
@@ -66,49 +273,107 @@ void Model :: loadModel(std::string & path) {
 
 	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
 		std::cerr << "ERROR::ASSIMP::" << importer.GetErrorString() << "\n";
-		return;
+		return false;
 	}
 
-	// Retrieve directory path of filepath
-	directory = path.substr(0, path.find_last_of('/')) + "/";
+	// Gather meshes in node order first, this order is kept whatever the conversion mode
+	std::vector<aiMesh *> nodeMeshes;
+	processNode(scene->mRootNode, scene, nodeMeshes);
+
+	// Conversion only reads the scene and writes its own slot, no GL involved
+	data.resize(nodeMeshes.size());
+	stats.resize(nodeMeshes.size());
 
-	std::cout << "Model::loadModel: " << directory << "\n";
+	auto convert = [&](size_t i) {
+		processMesh(nodeMeshes[i], scene, data[i], (flags & MODEL_PARALLEL) != 0);
+		stats[i] = CookMesh(data[i], flags, lodSettings);
+	};
+
+	if (flags & MODEL_PARALLEL) {
+		ThreadPool::Shared().ParallelFor(nodeMeshes.size(), convert);
+	} else {
+		for (size_t i=0; i<nodeMeshes.size(); i++)
+			convert(i);
+	}
 
-	// Process ASSIMP's root node recursively
-	processNode(scene->mRootNode, scene);
+	return true;
 }
 
-void Model :: processNode(aiNode * node, const aiScene * scene) {
+void Model :: reportOptimization(const std::string & path, const std::vector<MeshOptimizeStats> & stats) {
+
+	// Triangle-weighted ACMR over the whole model
+	size_t triangles = 0, verticesBefore = 0, verticesAfter = 0;
+	double missesBefore = 0.0, missesAfter = 0.0;
+	for (const MeshOptimizeStats & mesh : stats) {
+		triangles      += mesh.triangles;
+		verticesBefore += mesh.verticesBefore;
+		verticesAfter  += mesh.verticesAfter;
+		missesBefore   += (double) mesh.acmrBefore * mesh.triangles;
+		missesAfter    += (double) mesh.acmrAfter * mesh.triangles;
+	}
+	if (triangles == 0)
+		return;
+
+	std::cout << "Model::importModel: " << path << ": " << triangles << " triangles, vertices "
+		<< verticesBefore << " -> " << verticesAfter << ", ACMR " << missesBefore / triangles
+		<< " -> " << missesAfter / triangles << "\n";
+}
+
+void Model :: reportLods(const std::string & path, const std::vector<MeshData> & data) {
+
+	// Triangles per level over the whole model, meshes with a shorter chain count their coarsest level
+	size_t levels = 1;
+	for (const MeshData & mesh : data)
+		levels = std::max(levels, mesh.lods.size() + 1);
+
+	std::vector<size_t> triangles(levels, 0);
+	std::vector<float> errors(levels, 0.0f);
+	for (const MeshData & mesh : data) {
+		for (size_t level=0; level<levels; level++) {
+			size_t index = std::min(level, mesh.lods.size());
+			triangles[level] += (index == 0 ? mesh.indices.size() : mesh.lods[index - 1].indices.size()) / 3;
+			if (index > 0)
+				errors[level] = std::max(errors[level], mesh.lods[index - 1].error);
+		}
+	}
+
+	std::cout << "Model::importModel: " << path << ": LOD triangles";
+	for (size_t level=0; level<triangles.size(); level++)
+		std::cout << (level ? ", " : " ") << triangles[level] << " (" << errors[level] << ")";
+	std::cout << "\n";
+}
+
+void Model :: processNode(aiNode * node, const aiScene * scene, std::vector<aiMesh *> & nodeMeshes) {
 
 	/**
-	* Process a node in recursive fashion. Process each individual mesh located at node
+	* Process a node in recursive fashion. Collect each individual mesh located at node
 	* and repeats this process on its children nodes (if any).
 	*/
 	
-	// Process all the nodes' meshes
+	// Collect all the nodes' meshes
 	for (unsigned int i=0; i<node->mNumMeshes; i++) {
 		// Node object only contains indices to index the actual objects in the scene
 		// Scene contains all data, node is just to keep stuff organized (like relations between nodes).
-		aiMesh * mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.push_back(processMesh(mesh, scene));
+		nodeMeshes.push_back(scene->mMeshes[node->mMeshes[i]]);
 	}
 
 	// then do the same for each of its children
 	for (unsigned int i=0; i<node->mNumChildren; i++) {
-		processNode(node->mChildren[i], scene);
+		processNode(node->mChildren[i], scene, nodeMeshes);
 	}
 }
 
-Mesh Model :: processMesh(aiMesh * mesh, const aiScene * scene) {
+void Model :: processMesh(aiMesh * mesh, const aiScene * scene, MeshData & data, bool parallel) {
 
-	std::vector<Vertex> vertices;
-	std::vector<unsigned int> indices;
-	std::vector<Texture> textures;
+	std::vector<Vertex> & vertices = data.vertices;
+	std::vector<unsigned int> & indices = data.indices;
+	std::vector<Texture> & textures = data.textures;
 
 	// process vertex positions, normals and texture coords
+	vertices.resize(mesh->mNumVertices);
 	for (unsigned int i=0; i<mesh->mNumVertices; i++) {
 		
-		Vertex vertex;
+		Vertex & vertex = vertices[i];
 		glm::vec3 v;
 
 		// Position
@@ -164,11 +429,10 @@ Mesh Model :: processMesh(aiMesh * mesh, const aiScene * scene) {
 			//std::cerr << "Mesh::processMesh: Unable to load Bitangent: " << i << "\n";
 			vertex.bitangent = glm::vec3(0.0f, 0.0f, 1.0f);
 		}
-
-		vertices.push_back(vertex);
 	}
 
 	// process indices
+	indices.reserve(mesh->mNumFaces * 3);
 	for (unsigned int i=0; i<mesh->mNumFaces; i++) {
 		aiFace face = mesh->mFaces[i];
 		// Retrieve all indices of the face and store them in indices vector
@@ -176,6 +440,10 @@ Mesh Model :: processMesh(aiMesh * mesh, const aiScene * scene) {
 			indices.push_back(face.mIndices[j]);
 	}
 
+	// Tangents only come with the formats that store them (glTF...), the others get ours
+	if (!mesh->mTangents && mesh->mTextureCoords[0])
+		GenerateTangents(vertices, indices, parallel);
+
 	// process material
 	if (mesh->mMaterialIndex >= 0) {
 
@@ -183,83 +451,225 @@ Mesh Model :: processMesh(aiMesh * mesh, const aiScene * scene) {
 		// Sampler names in shaders convention: "texture_typeNameN"
 
 		// diffuse maps
-		std::vector<Texture> diffuseMaps = loadTextures(material,
-			aiTextureType_DIFFUSE, TEX_DIFFUSE);
-		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+		collectTextures(material, aiTextureType_DIFFUSE, TEX_DIFFUSE, textures);
 		// specular maps
-		std::vector<Texture> specularMaps = loadTextures(material,
-			aiTextureType_SPECULAR, TEX_SPECULAR);
-		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+		collectTextures(material, aiTextureType_SPECULAR, TEX_SPECULAR, textures);
 		// normal maps
-		std::vector<Texture> normalMaps = loadTextures(material,
-			aiTextureType_NORMALS, TEX_NORMAL); // aiTextureType_NORMALS
-		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+		collectTextures(material, aiTextureType_NORMALS, TEX_NORMAL, textures); // aiTextureType_NORMALS
 		// height maps
-		std::vector<Texture> heightMaps = loadTextures(material,
-			aiTextureType_HEIGHT, TEX_HEIGHT); // aiTextureType_HEIGHT
-		textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+		collectTextures(material, aiTextureType_HEIGHT, TEX_HEIGHT, textures); // aiTextureType_HEIGHT
 		// emission maps
-		std::vector<Texture> emissionMaps = loadTextures(material,
-			aiTextureType_EMISSIVE, TEX_EMISSION);
-		textures.insert(textures.end(), emissionMaps.begin(), emissionMaps.end());
+		collectTextures(material, aiTextureType_EMISSIVE, TEX_EMISSION, textures);
 		// ambient maps
-		std::vector<Texture> ambientMaps = loadTextures(material,
-			aiTextureType_AMBIENT, TEX_AMBIENT);
-		textures.insert(textures.end(), ambientMaps.begin(), ambientMaps.end());
+		collectTextures(material, aiTextureType_AMBIENT, TEX_AMBIENT, textures);
 	}
-
-	return Mesh(vertices, indices, textures);
 }
 
-std::vector<Texture> Model :: loadTextures(
+void Model :: collectTextures(
 	aiMaterial * material,
 	aiTextureType aiTexType,
-	TextureType type) {
+	TextureType type,
+	std::vector<Texture> & textures) {
 
 	/**
-	* Check all material textures of a given type and loads 
+	* Records all material textures of a given type, no image is loaded here.
+	* An empty path asks for the default texture.
 	*/
 
-	std::vector<Texture> textures;
 	unsigned int typeCount = material->GetTextureCount(aiTexType);
 
 	for (unsigned int i=0; i<typeCount; i++) {
-
 		aiString str;
 		material->GetTexture(aiTexType, i, &str);
+		textures.push_back(Texture{0, type, str.C_Str()});
+	}
 
-		// Check if texture was loaded before. Yes: continue.
-		bool skip = false;
-		for (unsigned int j=0; j<textures_loaded.size(); j++) {
-			if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0) {
-				textures.push_back(textures_loaded[j]);
-				skip == true; break;
-			}
+	if (typeCount == 0 && (type == TEX_DIFFUSE || type == TEX_SPECULAR))
+		textures.push_back(Texture{0, type, ""});
+}
+
+std::vector<Texture> Model :: loadTextures(const std::vector<Texture> & references) {
+
+	/**
+	* Resolves the texture references of one mesh into GL textures
+	*/
+
+	std::vector<Texture> textures;
+
+	for (const Texture & reference : references) {
+
+		if (reference.path.empty()) {
+			Texture texture = DefaultTexture(reference.type);
+			textures.push_back(texture);
+			//std::cout << "Model::DefaultTexture: " << texture.id << "\t"
+			//	<< TextureTypeName[texture.type] << "\tfrom: " << texture.path << "\n";
+			continue;
+		}
+
+		// Check if texture was loaded before for this type (it picks format and filter). Yes: continue.
+		std::string key = reference.path + "|" + std::to_string((int) reference.type);
+		auto loaded = loadedIndex.find(key);
+		if (loaded != loadedIndex.end()) {
+			textures.push_back(textures_loaded[loaded->second]);
+			continue;
 		}
-		if (skip) continue;
 
-		int tid = LoadTexture(directory + std::string(str.C_Str()), gammaCorrection);
-		if (tid <= 0) continue;
+		// Shared with every other model using the same image
+		TextureRef ref = TextureRegistry::Shared().Acquire(directory + reference.path,
+			gammaCorrection, reference.type, (flags & MODEL_ASYNC_TEXTURES) != 0);
+		if (!ref) continue;
 
 		Texture texture;
-		texture.id = (unsigned int) tid;
-		texture.type = type;
-		texture.path = str.C_Str();
+		texture.id = ref->id;
+		texture.type = reference.type;
+		texture.path = reference.path;
 		textures.push_back(texture);
-		textures_loaded.push_back(texture); // record to avoid repeated loading
+
+		// record to avoid repeated loading
+		loadedIndex[key] = textures_loaded.size();
+		if (!ref->Ready())
+			pendingTextures.push_back(textures_loaded.size());
+		textures_loaded.push_back(texture);
+		textureRefs.push_back(ref);
 
 		std::cout << "Model::loadTextures: " << texture.id << "\t"
 			<< TextureTypeName[texture.type] << "\tfrom: " << texture.path << "\n";
 	}
 
-	if (typeCount == 0 && (type == TEX_DIFFUSE || type == TEX_SPECULAR)) {
-		Texture texture = DefaultTexture(type);
-		textures.push_back(texture);
-		//std::cout << "Model::DefaultTexture: " << texture.id << "\t"
-		//	<< TextureTypeName[texture.type] << "\tfrom: " << texture.path << "\n";
+	return textures;
+}
+
+bool Model :: loadTextureArrays(const std::vector<MeshData> & data) {
+
+	/**
+	* Every material image of the model (and the default image of each slot type,
+	* stand-in for missing ones) into texture arrays, one unit per array
+	*/
+
+	std::vector<std::string> paths;
+	std::vector<TextureType> types;
+	for (const MeshData & mesh : data) {
+		for (const Texture & reference : mesh.textures) {
+			if (!reference.path.empty()) {
+				paths.push_back(directory + reference.path);
+				types.push_back(reference.type);
+			}
+			paths.push_back(DefaultTexture(reference.type).path);
+			types.push_back(reference.type);
+		}
 	}
 
-	return textures;
+	if (!textureArrays.Build(paths, types, gammaCorrection))
+		return false;
+
+	GLint units = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &units);
+	if (textureArrays.Size() > (size_t) units) {
+		std::cerr << "Model::loadTextureArrays: " << textureArrays.Size() << " arrays for " << units
+			<< " texture units, using 2D textures\n";
+		textureArrays.Delete();
+		return false;
+	}
+
+	std::cout << "Model::loadTextureArrays: " << textureArrays.Layers() << " images in "
+		<< textureArrays.Size() << " arrays\n";
+	return true;
+}
+
+std::vector<TextureLayer> Model :: textureLayers(const std::vector<Texture> & references) const {
+
+	std::vector<TextureLayer> layers;
+	for (const Texture & reference : references) {
+		TextureLayer layer = { -1, 0 };
+		if (!reference.path.empty())
+			layer = textureArrays.Find(directory + reference.path, reference.type);
+		if (layer.array < 0)
+			layer = textureArrays.Find(DefaultTexture(reference.type).path, reference.type);
+		layers.push_back(layer.array < 0 ? TextureLayer{0, 0} : layer);
+	}
+	return layers;
+}
+
+bool Model :: loadVirtualTextures(const std::vector<MeshData> & data) {
+
+	/**
+	* Every material image of the model (and the default image of each slot type)
+	* as virtual textures of the shared page cache. Page files are baked on the
+	* worker pool, registering them is cheap
+	*/
+
+	VirtualTextureCache & cache = VirtualTextureCache::Shared();
+	if (!cache.Init(VT_POOL_PAGES, gammaCorrection))
+		return false;
+
+	std::vector<std::pair<std::string, TextureType> > images;
+	for (const MeshData & mesh : data) {
+		for (const Texture & reference : mesh.textures) {
+			if (!reference.path.empty())
+				images.push_back(std::make_pair(directory + reference.path, reference.type));
+			images.push_back(std::make_pair(DefaultTexture(reference.type).path, reference.type));
+		}
+	}
+	std::sort(images.begin(), images.end());
+	images.erase(std::unique(images.begin(), images.end()), images.end());
+
+	ThreadPool::Shared().ParallelFor(images.size(), [&](size_t i) {
+		BuildVirtualPages(images[i].first, gammaCorrection, images[i].second);
+	});
+
+	size_t loaded = 0;
+	for (const auto & image : images)
+		if (cache.Load(image.first, image.second) != 0)
+			loaded++;
+	if (loaded == 0)
+		return false;
+
+	std::cout << "Model::loadVirtualTextures: " << loaded << " images, " << cache.Resident() << " of "
+		<< cache.Capacity() << " pages resident\n";
+	return true;
+}
+
+std::vector<int> Model :: virtualTextureIds(const std::vector<Texture> & references) const {
+
+	// Already registered by loadVirtualTextures, Load only looks them up
+	std::vector<int> ids;
+	for (const Texture & reference : references) {
+		int id = 0;
+		if (!reference.path.empty())
+			id = VirtualTextureCache::Shared().Load(directory + reference.path, reference.type);
+		if (id == 0)
+			id = VirtualTextureCache::Shared().Load(DefaultTexture(reference.type).path, reference.type);
+		ids.push_back(id);
+	}
+	return ids;
+}
+
+void Model :: resolvePendingTextures() {
+
+	/**
+	* Swap placeholder ids for the uploaded textures that landed since the last draw
+	*/
+
+	for (size_t i=0; i<pendingTextures.size(); ) {
+
+		size_t slot = pendingTextures[i];
+		if (!textureRefs[slot]->Ready()) {
+			i++;
+			continue;
+		}
+
+		const std::string & path = textures_loaded[slot].path;
+		TextureType type = textures_loaded[slot].type;
+		unsigned int id = textureRefs[slot]->id;
+
+		textures_loaded[slot].id = id;
+		for (Mesh & mesh : meshes)
+			for (Texture & texture : mesh.textures)
+				if (texture.path == path && texture.type == type)
+					texture.id = id;
+
+		pendingTextures.erase(pendingTextures.begin() + i);
+	}
 }
 
 /**
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <string>
+#include <unordered_map>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
@@ -14,15 +15,80 @@
 #include <ShaderProgram.h>
 #include <Texture.h>
 #include <Mesh.h>
+#include <MeshOptimizer.h>
+#include <MeshSimplifier.h>
+#include <TextureRegistry.h>
+#include <TextureArray.h>
+#include <VirtualTexture.h>
+#include <EularCamera.h>
+#include <RenderQueue.h>
+
+/** Import flags, combined as a bitmask */
+enum ModelFlags {
+	MODEL_DEFAULT  = 0,
+	MODEL_NO_CACHE = 1 << 0, // always import from the source (native loader or Assimp), never read or write the mesh cache
+	MODEL_PARALLEL = 1 << 1, // convert Assimp meshes on the shared worker pool
+	MODEL_ASYNC_TEXTURES = 1 << 2, // decode textures in the background, see TextureLoader::Update
+	MODEL_FULL_VERTICES  = 1 << 3, // keep 56-byte float vertices on the GPU instead of PackedVertex
+	MODEL_OPTIMIZE       = 1 << 4, // weld and reorder for the vertex cache / overdraw at import, see MeshOptimizer
+	MODEL_OWN_BUFFERS    = 1 << 5, // one VAO per mesh instead of the shared GeometryArena (per-mesh attributes)
+	MODEL_LOD            = 1 << 6, // simplified LOD chain per mesh at import, pick levels with UpdateLod
+	MODEL_MESHLETS       = 1 << 7, // split meshes into culling clusters at import, see DrawCulled
+	MODEL_ASSIMP         = 1 << 8, // import OBJ / GLB through ASSIMP too instead of the native loaders
+	MODEL_TEXTURE_ARRAYS = 1 << 9, // pack material textures into texture arrays, needs a sampler2DArray shader (demo_arrays.frag)
+	MODEL_VIRTUAL_TEXTURES = 1 << 10 // stream material textures as pages of VirtualTextureCache::Shared() (demo_virtual.frag)
+};
+
+#define MODEL_LOD_PIXEL_ERROR 1.0f // largest screen space error of the selected level, in pixels
+#define MODEL_LOD_HYSTERESIS  0.8f // a coarser level is only taken below this fraction of the pixel error
 
 class Model
 {
 public:
 	/** Methods */
-	Model(std::string path, bool gamma = false);
+	Model(std::string path, bool gamma = false, unsigned int flags = MODEL_DEFAULT,
+		const LodSettings & lodSettings = LodSettings());
 	~Model();
 	void Draw(Shader & shader);
 
+	/**
+	* Selects each mesh's level for the model drawn with modelMatrix, from its projected size:
+	* the coarsest level whose error stays under MODEL_LOD_PIXEL_ERROR pixels on a viewport
+	* viewportHeight pixels high. No-op without MODEL_LOD.
+	*/
+	void UpdateLod(const Camera & camera, const glm::mat4 & modelMatrix, float viewportHeight);
+
+	/**
+	* Draw with per-cluster frustum culling (MODEL_MESHLETS), meshes without clusters are culled
+	* whole; add CLUSTER_CULL_BACKFACE for closed meshes drawn with GL_CULL_FACE. viewProjection
+	* and eye are world space. Returns the clusters drawn.
+	*/
+	size_t DrawCulled(Shader & shader, const glm::mat4 & viewProjection, const glm::mat4 & modelMatrix,
+		const glm::vec3 & eye, unsigned int cull = CLUSTER_CULL_FRUSTUM);
+
+	/**
+	* Queues every mesh for queue.Flush instead of drawing now, under one transform,
+	* at the levels UpdateLod last picked. Meshes are culled there as DrawCulled does.
+	*/
+	void Submit(RenderQueue & queue, Shader & shader, const glm::mat4 & modelMatrix,
+		RenderPass pass = RENDER_OPAQUE, unsigned int cull = CLUSTER_CULL_FRUSTUM);
+	/** Model-wide material state (texture arrays, page pool) on the bound shader, what Draw does before the meshes */
+	void BindMaterials(Shader & shader);
+	/** Swaps in the textures that finished loading, what Draw and Submit do first */
+	void ResolveTextures() { if (!pendingTextures.empty()) resolvePendingTextures(); }
+
+	/** UpdateLod on any set of meshes drawn with modelMatrix */
+	static void SelectLods(std::vector<Mesh> & meshes, const Camera & camera, const glm::mat4 & modelMatrix,
+		float viewportHeight);
+
+	/** CPU side import through ASSIMP, every mesh cooked as flags ask. No GL involved */
+	static bool Import(const std::string & path, unsigned int flags, const LodSettings & lodSettings,
+		std::vector<MeshData> & data);
+	/** Import-time processing of one mesh: optimization, LOD chain, clusters */
+	static MeshOptimizeStats CookMesh(MeshData & mesh, unsigned int flags, const LodSettings & lodSettings);
+	/** Mesh cache options: the flags (and settings) that change the cooked geometry, the importer included */
+	static unsigned int CacheOptions(unsigned int flags, const LodSettings & lodSettings);
+
 	//void Translate(glm::vec3 trans);
 	//void Translate(float x, float y, float z);
 	//void Scale(glm::vec3 scale);
@@ -37,6 +103,13 @@ private:
 	/** Model Data */
 	std::string directory;
 	bool gammaCorrection;
+	unsigned int flags;
+	LodSettings lodSettings;
+	std::unordered_map<std::string, size_t> loadedIndex; // "path|type" -> textures_loaded slot
+	std::vector<TextureRef> textureRefs;                  // registry references, per textures_loaded slot
+	std::vector<size_t> pendingTextures;                  // slots still showing a placeholder
+	TextureArraySet textureArrays;                        // MODEL_TEXTURE_ARRAYS, bound once per draw
+	bool virtualTextures;                                 // MODEL_VIRTUAL_TEXTURES took effect, page pool bound per draw
 
 	/** Geometry params */
 	//glm::vec3 position;
@@ -48,12 +121,27 @@ private:
 
 	/** Methods */
 	void loadModel(std::string & path);
-	void processNode(aiNode * node, const aiScene * scene);
-	Mesh processMesh(aiMesh * mesh, const aiScene * scene);
-	std::vector<Texture> loadTextures(
+	static bool importAssimp(const std::string & path, unsigned int flags, const LodSettings & lodSettings,
+		std::vector<MeshData> & data, std::vector<MeshOptimizeStats> & stats);
+	static void reportOptimization(const std::string & path, const std::vector<MeshOptimizeStats> & stats);
+	static void reportLods(const std::string & path, const std::vector<MeshData> & data);
+	static void processNode(aiNode * node, const aiScene * scene, std::vector<aiMesh *> & nodeMeshes);
+	static void processMesh(aiMesh * mesh, const aiScene * scene, MeshData & data, bool parallel);
+	static void collectTextures(
 		aiMaterial * material,
-		aiTextureType aiTexType, 
-		TextureType type);
+		aiTextureType aiTexType,
+		TextureType type,
+		std::vector<Texture> & textures);
+	std::vector<Texture> loadTextures(const std::vector<Texture> & references);
+	bool loadTextureArrays(const std::vector<MeshData> & data);
+	std::vector<TextureLayer> textureLayers(const std::vector<Texture> & references) const;
+	bool loadVirtualTextures(const std::vector<MeshData> & data);
+	std::vector<int> virtualTextureIds(const std::vector<Texture> & references) const;
+	void resolvePendingTextures();
+
+	/** Non-copyable: ~Model frees the meshes' buffers and arena ranges */
+	Model(const Model &) = delete;
+	Model & operator=(const Model &) = delete;
 };
 
 #endif
\ No newline at end of file
@@ -18,6 +18,9 @@
 
 /** Shader Wrapper */
 #include <ShaderProgram.h>
+#include <GLState.h>
+#include <StreamBuffer.h>
+#include <FrameUniforms.h>
 
 /** Camera Wrapper */
 #include <EularCamera.h>
@@ -100,33 +103,33 @@ int main() {
 	};
 	glm::vec3 directionalLightDirection(1.0f, -1.0f, 0.0f);
 
-	// Object shader config
-	objectShader.use();
-	// Light config
+	// Light config, in the uLights block rather than per-field uniforms
+	LightBlock & lights = FrameUniforms::Shared().Lights();
 	// Directional light
-	objectShader.setUniform("uDirectionalLight.direction", directionalLightDirection);
-	objectShader.setUniform("uDirectionalLight.ambient",  0.0f, 0.0f, 0.0f);
-	objectShader.setUniform("uDirectionalLight.diffuse",  0.0f, 0.0f, 0.0f);
-	objectShader.setUniform("uDirectionalLight.specular", 0.0f, 0.0f, 0.0f);
+	lights.uDirectionalLight.direction = directionalLightDirection;
+	lights.uDirectionalLight.ambient  = glm::vec3(0.0f, 0.0f, 0.0f);
+	lights.uDirectionalLight.diffuse  = glm::vec3(0.0f, 0.0f, 0.0f);
+	lights.uDirectionalLight.specular = glm::vec3(0.0f, 0.0f, 0.0f);
 	// Point light
 	for (int i=0; i<4; i++) {
-		objectShader.setUniform(("uPointLights[" + std::to_string(i) +"].position").c_str(),  pointLightPos[i]);
-		objectShader.setUniform(("uPointLights[" + std::to_string(i) +"].ambient").c_str(),   0.0f, 0.0f, 0.0f);
-		objectShader.setUniform(("uPointLights[" + std::to_string(i) +"].diffuse").c_str(),   pointLightColors[i]);
-		objectShader.setUniform(("uPointLights[" + std::to_string(i) +"].specular").c_str(),  pointLightColors[i]);
-		objectShader.setUniform(("uPointLights[" + std::to_string(i) +"].constant").c_str(),  1.0f);
-		objectShader.setUniform(("uPointLights[" + std::to_string(i) +"].linear").c_str(),    0.09f);
-		objectShader.setUniform(("uPointLights[" + std::to_string(i) +"].quadratic").c_str(), 0.032f);
+		lights.uPointLights[i].position  = pointLightPos[i];
+		lights.uPointLights[i].ambient   = glm::vec3(0.0f, 0.0f, 0.0f);
+		lights.uPointLights[i].diffuse   = pointLightColors[i];
+		lights.uPointLights[i].specular  = pointLightColors[i];
+		lights.uPointLights[i].constant  = 1.0f;
+		lights.uPointLights[i].linear    = 0.09f;
+		lights.uPointLights[i].quadratic = 0.032f;
 	}
+	lights.uPointLightCount = 4;
 	// Spot light
-	objectShader.setUniform("uSpotLight.innerCutOff", glm::cos(glm::radians(12.5f)));
-	objectShader.setUniform("uSpotLight.outerCutOff", glm::cos(glm::radians(17.5f)));
-	objectShader.setUniform("uSpotLight.ambient",  0.0f, 0.0f, 0.0f);
-	objectShader.setUniform("uSpotLight.diffuse",  1.0f, 1.0f, 1.0f);
-	objectShader.setUniform("uSpotLight.specular", 1.0f, 1.0f, 1.0f);
-	objectShader.setUniform("uSpotLight.constant", 1.0f);
-	objectShader.setUniform("uSpotLight.linear", 0.09f);
-	objectShader.setUniform("uSpotLight.quadratic", 0.032f);
+	lights.uSpotLight.innerCutOff = glm::cos(glm::radians(12.5f));
+	lights.uSpotLight.outerCutOff = glm::cos(glm::radians(17.5f));
+	lights.uSpotLight.ambient  = glm::vec3(0.0f, 0.0f, 0.0f);
+	lights.uSpotLight.diffuse  = glm::vec3(1.0f, 1.0f, 1.0f);
+	lights.uSpotLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+	lights.uSpotLight.constant = 1.0f;
+	lights.uSpotLight.linear = 0.09f;
+	lights.uSpotLight.quadratic = 0.032f;
 
 
 
@@ -172,8 +175,10 @@ int main() {
 		objectShader.setUniform("uProjection", projection);
 		objectShader.setUniform("uCameraPos", camera.position);
 
-		objectShader.setUniform("uSpotLight.position", camera.position);
-		objectShader.setUniform("uSpotLight.direction", camera.front);
+		// Torch follows the camera, one buffer write for every light
+		FrameUniforms::Shared().Lights().uSpotLight.position = camera.position;
+		FrameUniforms::Shared().Lights().uSpotLight.direction = camera.front;
+		FrameUniforms::Shared().Update();
 
 		// Render scene
 		float degree = (float)glfwGetTime()*glm::radians(10.0f);
@@ -204,6 +209,9 @@ int main() {
 
 
 
+		// This frame's uploads are fenced, the next one writes the next region of the ring
+		StreamBuffer::Shared().EndFrame();
+
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		glfwPollEvents();
 		glfwSwapBuffers(gWindow);
@@ -265,12 +273,12 @@ bool initOpenGL() {
 	//glViewport(0, 0, gWindowWidth, gWindowHeight);
 
 	// Configure global OpenGL state	
-	glEnable(GL_DEPTH_TEST);
+	GLState::Shared().Enable(GL_DEPTH_TEST);
 
 	// Blending functionality
-	glEnable(GL_BLEND);
+	GLState::Shared().Enable(GL_BLEND);
 	// Tell OpenGL how to calc colors of blended fragments (pixels)
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::Shared().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	// Hide the cursor and capture it
 	glfwSetInputMode(gWindow, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -0,0 +1,562 @@
+#include <ObjLoader.h>
+#include <Mesh.h>
+#include <Texture.h>
+#include <MappedFile.h>
+#include <ThreadPool.h>
+#include <TangentSpace.h>
+
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <cctype>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+static const double POWERS_OF_TEN[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+static inline bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+const char * ParseFloat(const char * begin, const char * end, float & value) {
+
+	const char * ptr = begin;
+	bool negative = false;
+	if (ptr < end && (*ptr == '-' || *ptr == '+')) {
+		negative = *ptr == '-';
+		ptr++;
+	}
+
+	// Up to 19 significant digits in an integer, the rest only moves the exponent
+	uint64_t mantissa = 0;
+	int digits = 0, exponent = 0;
+	const char * start = ptr;
+	for (; ptr < end && isDigit(*ptr); ptr++) {
+		if (digits < 19) {
+			mantissa = mantissa * 10 + (*ptr - '0');
+			if (mantissa) digits++;
+		} else {
+			exponent++;
+		}
+	}
+	if (ptr < end && *ptr == '.') {
+		ptr++;
+		for (; ptr < end && isDigit(*ptr); ptr++) {
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*ptr - '0');
+				if (mantissa) digits++;
+				exponent--;
+			}
+		}
+	}
+	if (ptr == start || (ptr == start + 1 && *start == '.'))
+		return begin;
+
+	if (ptr < end && (*ptr == 'e' || *ptr == 'E')) {
+		const char * mark = ptr++;
+		bool negativeExponent = false;
+		if (ptr < end && (*ptr == '-' || *ptr == '+')) {
+			negativeExponent = *ptr == '-';
+			ptr++;
+		}
+		if (ptr < end && isDigit(*ptr)) {
+			int e = 0;
+			for (; ptr < end && isDigit(*ptr); ptr++)
+				if (e < 10000) e = e * 10 + (*ptr - '0');
+			exponent += negativeExponent ? -e : e;
+		} else {
+			ptr = mark;
+		}
+	}
+
+	double result = (double) mantissa;
+	if (exponent < 0)
+		result = exponent >= -22 ? result / POWERS_OF_TEN[-exponent] : result * std::pow(10.0, exponent);
+	else if (exponent > 0)
+		result = exponent <= 22 ? result * POWERS_OF_TEN[exponent] : result * std::pow(10.0, exponent);
+
+	value = (float) (negative ? -result : result);
+	return ptr;
+}
+
+static const char * parseInt(const char * ptr, const char * end, int & value) {
+	bool negative = false;
+	if (ptr < end && (*ptr == '-' || *ptr == '+')) {
+		negative = *ptr == '-';
+		ptr++;
+	}
+	int result = 0;
+	for (; ptr < end && isDigit(*ptr); ptr++)
+		result = result * 10 + (*ptr - '0');
+	value = negative ? -result : result;
+	return ptr;
+}
+
+static const char * skipBlanks(const char * ptr, const char * end) {
+	while (ptr < end && isBlank(*ptr))
+		ptr++;
+	return ptr;
+}
+
+static const char * lineEnd(const char * ptr, const char * end) {
+	const char * newline = (const char *) std::memchr(ptr, '\n', end - ptr);
+	return newline ? newline : end;
+}
+
+/** Rest of the line, trailing blanks trimmed */
+static std::string restOfLine(const char * ptr, const char * end) {
+	ptr = skipBlanks(ptr, end);
+	while (end > ptr && isBlank(end[-1]))
+		end--;
+	return std::string(ptr, end);
+}
+
+static bool keyword(const char * ptr, const char * end, const char * word) {
+	size_t length = std::strlen(word);
+	return (size_t)(end - ptr) > length && std::memcmp(ptr, word, length) == 0 && isBlank(ptr[length]);
+}
+
+
+
+
+
+/*************************************************
+*
+* OBJ
+*
+*************************************************/
+
+/** Resolved 0-based indices, -1 when the corner has no such attribute */
+struct ObjCorner {
+	int position, texCoord, normal;
+};
+
+struct ObjGroup {
+	std::string material;
+	bool inherit;   // continues the material active at the end of the previous chunk
+	std::vector<ObjCorner> corners; // triangles
+};
+
+struct ObjChunk {
+	const char * begin;
+	const char * end;
+	size_t positions, texCoords, normals; // records in the chunk
+	size_t positionBase, texCoordBase, normalBase;
+	std::vector<ObjGroup> groups;
+	std::vector<std::string> libraries;
+	size_t badFaces;
+};
+
+static void countChunk(ObjChunk & chunk) {
+	chunk.positions = chunk.texCoords = chunk.normals = 0;
+	for (const char * ptr = chunk.begin; ptr < chunk.end; ) {
+		const char * end = lineEnd(ptr, chunk.end);
+		ptr = skipBlanks(ptr, end);
+		if (end - ptr > 1 && ptr[0] == 'v') {
+			if (isBlank(ptr[1]))
+				chunk.positions++;
+			else if (end - ptr > 2 && ptr[1] == 't' && isBlank(ptr[2]))
+				chunk.texCoords++;
+			else if (end - ptr > 2 && ptr[1] == 'n' && isBlank(ptr[2]))
+				chunk.normals++;
+		}
+		ptr = end + 1;
+	}
+}
+
+/** OBJ indices are 1-based, negative ones count back from the last record read */
+static int resolveIndex(int index, size_t readSoFar) {
+	if (index > 0)
+		return index - 1;
+	if (index < 0)
+		return (int) readSoFar + index;
+	return -1;
+}
+
+static void parseChunk(ObjChunk & chunk, std::vector<glm::vec3> & positions,
+	std::vector<glm::vec2> & texCoords, std::vector<glm::vec3> & normals) {
+
+	size_t p = chunk.positionBase, t = chunk.texCoordBase, n = chunk.normalBase;
+	chunk.groups.push_back(ObjGroup{"", true, {}});
+	chunk.badFaces = 0;
+
+	std::vector<ObjCorner> polygon;
+
+	for (const char * ptr = chunk.begin; ptr < chunk.end; ) {
+
+		const char * end = lineEnd(ptr, chunk.end);
+		ptr = skipBlanks(ptr, end);
+
+		if (ptr == end || *ptr == '#') {
+			// empty line or comment
+		} else if (ptr[0] == 'v' && end - ptr > 1 && isBlank(ptr[1])) {
+			glm::vec3 & v = positions[p++];
+			const char * q = ptr + 1;
+			for (int i=0; i<3; i++)
+				q = ParseFloat(skipBlanks(q, end), end, v[i]);
+		} else if (end - ptr > 2 && ptr[0] == 'v' && ptr[1] == 't' && isBlank(ptr[2])) {
+			glm::vec2 & v = texCoords[t++];
+			v = glm::vec2(0.0f);
+			const char * q = ptr + 2;
+			for (int i=0; i<2; i++)
+				q = ParseFloat(skipBlanks(q, end), end, v[i]);
+			v.y = 1.0f - v.y; // like aiProcess_FlipUVs
+		} else if (end - ptr > 2 && ptr[0] == 'v' && ptr[1] == 'n' && isBlank(ptr[2])) {
+			glm::vec3 & v = normals[n++];
+			const char * q = ptr + 2;
+			for (int i=0; i<3; i++)
+				q = ParseFloat(skipBlanks(q, end), end, v[i]);
+		} else if (ptr[0] == 'f' && end - ptr > 1 && isBlank(ptr[1])) {
+
+			polygon.clear();
+			const char * q = skipBlanks(ptr + 1, end);
+			while (q < end) {
+				ObjCorner corner = { -1, -1, -1 };
+				int index;
+				const char * next = parseInt(q, end, index);
+				if (next == q)
+					break;
+				corner.position = resolveIndex(index, p);
+				q = next;
+				if (q < end && *q == '/') {
+					q++;
+					if (q < end && *q != '/') {
+						q = parseInt(q, end, index);
+						corner.texCoord = resolveIndex(index, t);
+					}
+					if (q < end && *q == '/') {
+						q = parseInt(q + 1, end, index);
+						corner.normal = resolveIndex(index, n);
+					}
+				}
+				polygon.push_back(corner);
+				q = skipBlanks(q, end);
+			}
+
+			if (polygon.size() < 3) {
+				chunk.badFaces++;
+			} else {
+				// Fan triangulation, like aiProcess_Triangulate for convex polygons
+				std::vector<ObjCorner> & corners = chunk.groups.back().corners;
+				for (size_t i=1; i+1<polygon.size(); i++) {
+					corners.push_back(polygon[0]);
+					corners.push_back(polygon[i]);
+					corners.push_back(polygon[i + 1]);
+				}
+			}
+		} else if (keyword(ptr, end, "usemtl")) {
+			chunk.groups.push_back(ObjGroup{restOfLine(ptr + 6, end), false, {}});
+		} else if (keyword(ptr, end, "mtllib")) {
+			chunk.libraries.push_back(restOfLine(ptr + 6, end));
+		}
+		// o, g, s, l, p: grouping and smoothing only, meshes follow materials
+
+		ptr = end + 1;
+	}
+}
+
+
+
+
+
+/*************************************************
+*
+* MTL
+*
+*************************************************/
+
+struct ObjMaterial {
+	std::vector<Texture> textures;
+};
+
+static std::string lowerCase(std::string text) {
+	for (char & c : text)
+		c = (char) std::tolower((unsigned char) c);
+	return text;
+}
+
+/** Map statements end with the file name, after options like "-bm 0.5" */
+static std::string mapFile(const std::string & arguments) {
+	size_t space = arguments.find_last_of(" \t");
+	return space == std::string::npos ? arguments : arguments.substr(space + 1);
+}
+
+static void loadMaterials(const std::string & path, std::unordered_map<std::string, ObjMaterial> & materials) {
+
+	MappedFile file(path);
+	if (!file.IsOpen()) {
+		std::cerr << "LoadObj: unable to open material library " << path << "\n";
+		return;
+	}
+
+	const char * ptr = (const char *) file.Data();
+	const char * fileEnd = ptr + file.Size();
+	ObjMaterial * current = NULL;
+
+	for (; ptr < fileEnd; ) {
+
+		const char * end = lineEnd(ptr, fileEnd);
+		ptr = skipBlanks(ptr, end);
+		const char * word = ptr;
+		while (ptr < end && !isBlank(*ptr))
+			ptr++;
+		std::string name = lowerCase(std::string(word, ptr));
+		std::string arguments = restOfLine(ptr, end);
+		ptr = end + 1;
+
+		if (name == "newmtl") {
+			current = &materials[arguments];
+			current->textures.clear();
+			continue;
+		}
+		if (!current || arguments.empty())
+			continue;
+
+		// Same mapping as ASSIMP's OBJ importer
+		TextureType type;
+		if (name == "map_kd")
+			type = TEX_DIFFUSE;
+		else if (name == "map_ks")
+			type = TEX_SPECULAR;
+		else if (name == "norm" || name == "map_kn")
+			type = TEX_NORMAL;
+		else if (name == "map_bump" || name == "bump")
+			type = TEX_HEIGHT;
+		else if (name == "map_ke")
+			type = TEX_EMISSION;
+		else if (name == "map_ka")
+			type = TEX_AMBIENT;
+		else
+			continue;
+
+		current->textures.push_back(Texture{0, type, mapFile(arguments)});
+	}
+}
+
+/** Texture references in the order Model::processMesh collects them */
+static std::vector<Texture> materialTextures(const ObjMaterial * material) {
+
+	static const TextureType order[] = { TEX_DIFFUSE, TEX_SPECULAR, TEX_NORMAL, TEX_HEIGHT, TEX_EMISSION, TEX_AMBIENT };
+
+	std::vector<Texture> textures;
+	for (TextureType type : order) {
+		size_t count = 0;
+		if (material)
+			for (const Texture & texture : material->textures)
+				if (texture.type == type) {
+					textures.push_back(texture);
+					count++;
+				}
+		if (count == 0 && (type == TEX_DIFFUSE || type == TEX_SPECULAR))
+			textures.push_back(Texture{0, type, ""});
+	}
+	return textures;
+}
+
+
+
+
+
+/*************************************************
+*
+* Meshes
+*
+*************************************************/
+
+struct CornerHash {
+	size_t operator()(const ObjCorner & corner) const {
+		return (size_t) corner.position * 73856093u ^ (size_t) corner.texCoord * 19349663u
+			^ (size_t) corner.normal * 83492791u;
+	}
+};
+
+struct CornerEqual {
+	bool operator()(const ObjCorner & a, const ObjCorner & b) const {
+		return a.position == b.position && a.texCoord == b.texCoord && a.normal == b.normal;
+	}
+};
+
+/** One vertex per distinct corner, triangles with out of range indices are dropped */
+static size_t buildMesh(const std::vector<const std::vector<ObjCorner> *> & groups,
+	const std::vector<glm::vec3> & positions, const std::vector<glm::vec2> & texCoords,
+	const std::vector<glm::vec3> & normals, MeshData & mesh, bool parallel) {
+
+	std::unordered_map<ObjCorner, unsigned int, CornerHash, CornerEqual> unique;
+	size_t dropped = 0;
+	bool hasTexCoords = false;
+
+	for (const std::vector<ObjCorner> * corners : groups) {
+		for (size_t i=0; i+2<corners->size(); i+=3) {
+
+			const ObjCorner * triangle = &(*corners)[i];
+			bool valid = true;
+			for (int j=0; j<3; j++) {
+				const ObjCorner & c = triangle[j];
+				valid = valid && c.position >= 0 && (size_t) c.position < positions.size()
+					&& c.texCoord >= -1 && c.texCoord < (int) texCoords.size()
+					&& c.normal >= -1 && c.normal < (int) normals.size();
+			}
+			if (!valid) {
+				dropped++;
+				continue;
+			}
+
+			for (int j=0; j<3; j++) {
+				const ObjCorner & c = triangle[j];
+				auto inserted = unique.emplace(c, (unsigned int) mesh.vertices.size());
+				if (inserted.second) {
+					Vertex vertex;
+					vertex.position  = positions[c.position];
+					vertex.normal    = c.normal >= 0 ? normals[c.normal] : glm::vec3(0.0f, 1.0f, 0.0f);
+					vertex.texCoords = c.texCoord >= 0 ? texCoords[c.texCoord] : glm::vec2(0.0f);
+					vertex.tangent   = glm::vec3(1.0f, 0.0f, 0.0f);
+					vertex.bitangent = glm::vec3(0.0f, 0.0f, 1.0f);
+					hasTexCoords = hasTexCoords || c.texCoord >= 0;
+					mesh.vertices.push_back(vertex);
+				}
+				mesh.indices.push_back(inserted.first->second);
+			}
+		}
+	}
+
+	if (hasTexCoords)
+		GenerateTangents(mesh.vertices, mesh.indices, parallel);
+	return dropped;
+}
+
+bool LoadObj(const std::string & path, std::vector<MeshData> & meshes, bool parallel) {
+
+	MappedFile file(path);
+	if (!file.IsOpen()) {
+		std::cerr << "LoadObj: unable to open " << path << "\n";
+		return false;
+	}
+
+	const char * data = (const char *) file.Data();
+	const char * dataEnd = data + file.Size();
+
+	// Line-aligned chunks
+	ThreadPool & pool = ThreadPool::Shared();
+	size_t wanted = parallel ? (size_t) pool.Size() * 4 : 1;
+	size_t chunkSize = std::max((size_t) OBJ_CHUNK_SIZE, file.Size() / std::max(wanted, (size_t) 1) + 1);
+	std::vector<ObjChunk> chunks;
+	for (const char * begin = data; begin < dataEnd; ) {
+		const char * end = begin + std::min(chunkSize, (size_t)(dataEnd - begin));
+		if (end < dataEnd)
+			end = lineEnd(end, dataEnd) + (end < dataEnd ? 1 : 0);
+		if (end > dataEnd)
+			end = dataEnd;
+		ObjChunk chunk;
+		chunk.begin = begin;
+		chunk.end = end;
+		chunks.push_back(chunk);
+		begin = end;
+	}
+
+	auto run = [&](size_t count, const std::function<void(size_t)> & body) {
+		if (parallel)
+			pool.ParallelFor(count, body);
+		else
+			for (size_t i=0; i<count; i++)
+				body(i);
+	};
+
+	// Pass 1: record counts, so every chunk knows its place in the arrays
+	run(chunks.size(), [&](size_t i) { countChunk(chunks[i]); });
+
+	size_t positionCount = 0, texCoordCount = 0, normalCount = 0;
+	for (ObjChunk & chunk : chunks) {
+		chunk.positionBase = positionCount;
+		chunk.texCoordBase = texCoordCount;
+		chunk.normalBase = normalCount;
+		positionCount += chunk.positions;
+		texCoordCount += chunk.texCoords;
+		normalCount += chunk.normals;
+	}
+
+	// Pass 2: parse in place
+	std::vector<glm::vec3> positions(positionCount, glm::vec3(0.0f));
+	std::vector<glm::vec2> texCoords(texCoordCount, glm::vec2(0.0f));
+	std::vector<glm::vec3> normals(normalCount, glm::vec3(0.0f));
+	run(chunks.size(), [&](size_t i) { parseChunk(chunks[i], positions, texCoords, normals); });
+
+	// Materials, then faces by material in order of first use
+	std::string directory = path.substr(0, path.find_last_of('/') + 1);
+	std::unordered_map<std::string, ObjMaterial> materials;
+	for (const ObjChunk & chunk : chunks)
+		for (const std::string & library : chunk.libraries)
+			loadMaterials(directory + library, materials);
+
+	std::vector<std::string> order;
+	std::unordered_map<std::string, size_t> slot;
+	std::vector<std::vector<const std::vector<ObjCorner> *> > groups;
+	std::string material;
+	size_t badFaces = 0;
+
+	for (const ObjChunk & chunk : chunks) {
+		badFaces += chunk.badFaces;
+		for (const ObjGroup & group : chunk.groups) {
+			if (!group.inherit)
+				material = group.material;
+			if (group.corners.empty())
+				continue;
+			auto found = slot.find(material);
+			if (found == slot.end()) {
+				found = slot.emplace(material, order.size()).first;
+				order.push_back(material);
+				groups.emplace_back();
+			}
+			groups[found->second].push_back(&group.corners);
+		}
+	}
+
+	std::vector<MeshData> result(order.size());
+	std::vector<size_t> dropped(order.size(), 0);
+	run(order.size(), [&](size_t i) {
+		dropped[i] = buildMesh(groups[i], positions, texCoords, normals, result[i], parallel);
+		auto found = materials.find(order[i]);
+		result[i].textures = materialTextures(found != materials.end() ? &found->second : NULL);
+	});
+
+	size_t droppedTriangles = 0;
+	for (size_t count : dropped)
+		droppedTriangles += count;
+	if (badFaces || droppedTriangles)
+		std::cerr << "LoadObj: " << path << ": skipped " << badFaces << " faces with fewer than 3 corners, "
+			<< droppedTriangles << " triangles with invalid indices\n";
+
+	if (result.empty()) {
+		std::cerr << "LoadObj: no faces in " << path << "\n";
+		return false;
+	}
+
+	meshes.swap(result);
+	return true;
+}
+
+std::vector<std::string> ObjMaterialLibraries(const std::string & path) {
+
+	std::vector<std::string> libraries;
+	MappedFile file(path);
+	if (!file.IsOpen())
+		return libraries;
+
+	const char * ptr = (const char *) file.Data();
+	const char * dataEnd = ptr + file.Size();
+	while (ptr < dataEnd) {
+		const char * end = lineEnd(ptr, dataEnd);
+		const char * line = skipBlanks(ptr, end);
+		if (keyword(line, end, "mtllib"))
+			libraries.push_back(restOfLine(line + 6, end));
+		ptr = end + 1;
+	}
+	return libraries;
+}
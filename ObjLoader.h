@@ -0,0 +1,33 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+#include <Mesh.h>
+
+/**
+* Native Wavefront OBJ / MTL reader, the fast path behind Model for ".obj".
+*
+* The file is memory mapped and cut into line-aligned chunks. A first pass
+* counts the v / vt / vn records of every chunk so each chunk knows where its
+* elements land (and what relative indices point at), a second pass parses
+* the chunks in parallel straight into the shared arrays. Faces are fan
+* triangulated and grouped by material, one MeshData per material in order of
+* first use, with the conventions of the ASSIMP path: flipped v coordinates,
+* tangent frames generated, MTL maps mapped like ASSIMP's OBJ importer.
+*/
+
+#define OBJ_CHUNK_SIZE (256 * 1024) // bytes per parse task, at least
+
+/** Fast decimal to float, returns the character after the number (begin when there is none) */
+const char * ParseFloat(const char * begin, const char * end, float & value);
+
+/** parallel: parse on the shared worker pool. Textures are unresolved references (see MeshData) */
+bool LoadObj(const std::string & path, std::vector<MeshData> & meshes, bool parallel = true);
+
+/** The "mtllib" files of an OBJ, relative to its directory as written there */
+std::vector<std::string> ObjMaterialLibraries(const std::string & path);
+
+#endif
@@ -17,6 +17,7 @@
 
 /** Shader Wrapper */
 #include <ShaderProgram.h>
+#include <GLState.h>
 
 /** Camera Wrapper */
 #include <EularCamera.h>
@@ -39,15 +40,15 @@ public:
 	}
 
 	~DepthMap() {
-		glDeleteFramebuffers(1, &fbo);
+		GLState::Shared().DeleteFramebuffers(1, &fbo);
 	}
 
 	void Bind() {
-		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, fbo);
 	}
 
 	void Unbind() {
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, 0);
 	}
 
 	unsigned int FBO() { return fbo; }
@@ -64,7 +65,7 @@ private:
 void DepthMap :: setup() {
 	// create depth texture
 	glGenTextures(1, &tid);
-	glBindTexture(GL_TEXTURE_2D, tid);
+	GLState::Shared().BindTexture(GL_TEXTURE_2D, tid);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, width, height,
 		0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -75,11 +76,11 @@ void DepthMap :: setup() {
 	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
 	// generate fbo, attach depth texture as fbo's depth buffer
 	glGenFramebuffers(1, &fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, fbo);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, tid, 0);
 	glDrawBuffer(GL_NONE);
 	glReadBuffer(GL_NONE);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 // Global Variables
@@ -203,9 +204,9 @@ int main() {
 		glViewport(0, 0, depthMap.width, depthMap.height);
 		depthMap.Bind();
 		glClear(GL_DEPTH_BUFFER_BIT);
-		glCullFace(GL_FRONT);
+		GLState::Shared().CullFace(GL_FRONT);
 		renderScene(simpleDepthShader, objPlane, objCube, objPlanet);
-		glCullFace(GL_BACK);
+		GLState::Shared().CullFace(GL_BACK);
 		depthMap.Unbind();
 
 		// reset viewport
@@ -231,10 +232,10 @@ int main() {
 		objectShader.setUniform("uSpotLight.position", camera.position);
 		objectShader.setUniform("uSpotLight.direction", camera.front);
 		objectShader.setUniform("uLightSpaceMatrix", lightProjection * lightView);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, woodTexture);
-		glActiveTexture(GL_TEXTURE15);
-		glBindTexture(GL_TEXTURE_2D, depthMap.TID());
+		GLState::Shared().ActiveTexture(GL_TEXTURE0);
+		GLState::Shared().BindTexture(GL_TEXTURE_2D, woodTexture);
+		GLState::Shared().ActiveTexture(GL_TEXTURE15);
+		GLState::Shared().BindTexture(GL_TEXTURE_2D, depthMap.TID());
 		renderScene(objectShader, objPlane, objCube, objPlanet);
 
 		// render Depth map to quad for visual debugging
@@ -242,8 +243,8 @@ int main() {
 		//debugDepthQuad.use();
 		//debugDepthQuad.setUniform("uNearPlane", near_plane);
 		//debugDepthQuad.setUniform("uFarPlane", far_plane);
-		//glActiveTexture(GL_TEXTURE0);
-		//glBindTexture(GL_TEXTURE_2D, depthMap);
+		//GLState::Shared().ActiveTexture(GL_TEXTURE0);
+		//GLState::Shared().BindTexture(GL_TEXTURE_2D, depthMap);
 		//objQuad.Draw(debugDepthQuad);
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
@@ -266,8 +267,7 @@ void renderScene(Shader &shader, Plane & plane, Cube & cube, Model & obj)
 	model = glm::scale(model, glm::vec3(50.0f));
 	shader.use();
 	shader.setUniform("uModel", model);
-	glBindVertexArray(plane.VAO());
-	glDrawElements(GL_TRIANGLES, plane.indices.size(), GL_UNSIGNED_INT, 0);
+	plane.DrawGeometry();
 	// cubes
 	model = glm::mat4();
 	model = glm::translate(model, glm::vec3(0.0f, 1.5f, 0.0));
@@ -349,12 +349,12 @@ bool initOpenGL() {
 	//glViewport(0, 0, gWindowWidth, gWindowHeight);
 
 	// Depth testing
-	glEnable(GL_DEPTH_TEST);
+	GLState::Shared().Enable(GL_DEPTH_TEST);
 
 	// Blending
-	glEnable(GL_BLEND);
+	GLState::Shared().Enable(GL_BLEND);
 	glBlendEquation(GL_FUNC_ADD);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::Shared().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	// Hide the cursor and capture it
 	glfwSetInputMode(gWindow, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -18,6 +18,7 @@
 
 /** Shader Wrapper */
 #include <ShaderProgram.h>
+#include <GLState.h>
 
 /** Camera Wrapper */
 #include <EularCamera.h>
@@ -43,15 +44,15 @@ public:
 	}
 
 	~DepthMap() {
-		glDeleteFramebuffers(1, &fbo);
+		GLState::Shared().DeleteFramebuffers(1, &fbo);
 	}
 
 	void Bind() {
-		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, fbo);
 	}
 
 	void Unbind() {
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, 0);
 	}
 
 	std::vector<glm::mat4> GetTransforms(glm::vec3 & position) const;
@@ -70,7 +71,7 @@ private:
 void DepthMap :: setup() {
 	// create depth texture
 	glGenTextures(1, &tid);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, tid);
+	GLState::Shared().BindTexture(GL_TEXTURE_CUBE_MAP, tid);
 	for (unsigned int i = 0; i < 6; i++)
 		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, width, height,
 			0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
@@ -81,11 +82,11 @@ void DepthMap :: setup() {
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 	// generate fbo, attach depth texture as fbo's depth buffer
 	glGenFramebuffers(1, &fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, fbo);
 	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, tid, 0);
 	glDrawBuffer(GL_NONE);
 	glReadBuffer(GL_NONE);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 std::vector<glm::mat4> DepthMap :: GetTransforms(glm::vec3 & lightPos) const {
@@ -202,6 +203,11 @@ int main() {
 
 	float aspect = (float) gWindowWidth / (float) gWindowHeight;
 
+	// Face matrices change every frame: resolve their uniforms once
+	UniformHandle shadowMatrices[6];
+	for (int i = 0; i < 6; i++)
+		shadowMatrices[i] = simpleDepthShader.uniform(("uShadowMatrices[" + std::to_string(i) + "]").c_str());
+
 	// render loop
 	// -----------
 	while (!glfwWindowShouldClose(gWindow)) {
@@ -235,7 +241,7 @@ int main() {
 		simpleDepthShader.setUniform("uFarPlane", depthMap.far);
 		simpleDepthShader.setUniform("uLightPos", lightPos);
 		for (int i = 0; i < 6; i++)
-			simpleDepthShader.setUniform("uShadowMatrices[" + std::to_string(i) + "]", shadowTransforms[i]);
+			simpleDepthShader.setUniform(shadowMatrices[i], shadowTransforms[i]);
 		renderScene(simpleDepthShader);
 		depthMap.Unbind();
 
@@ -265,8 +271,8 @@ int main() {
 		objectShader.setUniform("uSpotLight.position", camera.position);
 		objectShader.setUniform("uSpotLight.direction", camera.front);
 		// bind shadow map texture
-		glActiveTexture(GL_TEXTURE0 + depthMapTexUnit);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, depthMap.TID());
+		GLState::Shared().ActiveTexture(GL_TEXTURE0 + depthMapTexUnit);
+		GLState::Shared().BindTexture(GL_TEXTURE_CUBE_MAP, depthMap.TID());
 		// render scene as normal case
 		renderScene(objectShader);
 
@@ -289,11 +295,11 @@ void renderScene(Shader &shader)
 	model = glm::scale(model, glm::vec3(10.0f));
 	shader.use();
 	shader.setUniform("uModel", model);
-	glDisable(GL_CULL_FACE);
+	GLState::Shared().Disable(GL_CULL_FACE);
 	shader.setUniform("uReverseNormal", 1);
 	pObjCube.get()->Draw(shader);
 	shader.setUniform("uReverseNormal", 0);
-	glEnable(GL_CULL_FACE);
+	GLState::Shared().Enable(GL_CULL_FACE);
 
 	// cubes
 	model = glm::mat4();
@@ -390,15 +396,15 @@ bool initOpenGL() {
 	//glViewport(0, 0, gWindowWidth, gWindowHeight);
 
 	// Depth testing
-	glEnable(GL_DEPTH_TEST);
+	GLState::Shared().Enable(GL_DEPTH_TEST);
 
 	// Winding order
-	glEnable(GL_CULL_FACE);
+	GLState::Shared().Enable(GL_CULL_FACE);
 
 	// Blending
-	glEnable(GL_BLEND);
+	GLState::Shared().Enable(GL_BLEND);
 	glBlendEquation(GL_FUNC_ADD);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::Shared().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	// Hide the cursor and capture it
 	glfwSetInputMode(gWindow, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
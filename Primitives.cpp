@@ -1,6 +1,10 @@
 #include <Primitives.h>
 #include <Texture.h>
 #include <ShaderProgram.h>
+#include <GLState.h>
+#include <GeometryArena.h>
+#include <StreamBuffer.h>
+#include <TangentSpace.h>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
@@ -22,38 +26,25 @@
 *
 *************************************************/
 
-Base2D :: Base2D() {
+Base2D :: Base2D() : vbo(0), ebo(0), vao(0), geometry(0) {
 	//position = glm::vec3(0.0f, 0.0f, 0.0f);
 	//scale    = glm::vec3(1.0f, 1.0f, 1.0f);
 	//rotation = glm::mat4(1.0f);
 }
 
 Base2D :: ~Base2D() {
-	glDeleteVertexArrays(1, &vao);
-	glDeleteBuffers(1, &vbo);
-	glDeleteBuffers(1, &ebo);
+	GeometryArena::Shared().Free(geometry);
 }
 
 void Base2D :: setup() {
 
-	glGenBuffers(1, &vbo); // Generate an empty vertex buffer on the GPU
-	glGenBuffers(1, &ebo);
-	glGenVertexArrays(1, &vao); // Tell OpenGL to create new Pixel Array Object
-	
-	glBindVertexArray(vao); // Make the vertices buffer the current one
-	
-	glBindBuffer(GL_ARRAY_BUFFER, vbo); // "bind" or set as the current buffer we are working with
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Pixel), vertices.data(), GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+	// Sub-allocated from the shared arena, the VAO belongs to the arena page
+	GeometryArena & arena = GeometryArena::Shared();
+	geometry = arena.Allocate(VERTEX_PIXEL, vertices.data(), vertices.size(), indices.data(), indices.size());
 
-	glEnableVertexAttribArray(0); // vertex positions
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Pixel), NULL);
-	glEnableVertexAttribArray(1); // vertex texture coords
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Pixel), (void*)offsetof(Pixel, texCoords));
-
-	glBindVertexArray(0); // Release control of vao
+	const GeometryRange * range = arena.Range(geometry);
+	vbo = ebo = 0;
+	vao = range ? range->vao : 0;
 }
 
 void Base2D :: Draw(Shader & shader) {
@@ -71,46 +62,30 @@ void Base2D :: Draw(Shader & shader) {
 
 	shader.use();
 
-	// Bind textures
-	unsigned int diffuseNr  = 1;
-	unsigned int specularNr = 1;
-	unsigned int normalNr   = 1;
-	unsigned int heightNr   = 1;
-	unsigned int emissionNr = 1;
-	unsigned int ambientNr  = 1;
+	BindTextures(shader);
+
+	// Draw mesh
+	GeometryArena::Shared().Draw(geometry);
+
+	GLState::Shared().ActiveTexture(GL_TEXTURE0);
+}
+
+void Base2D :: BindTextures(Shader & shader) {
+
+	if (samplerNames.size() != textures.size())
+		samplerNames = SamplerUniformNames(textures);
 
 	for (unsigned int i=0; i<textures.size(); i++) {
-		
-		glActiveTexture(GL_TEXTURE0 + i); // activate proper texture unit before binding
-
-		std::string number;
-		TextureType type = textures[i].type;
-
-		if (type == TEX_DIFFUSE)
-			number = std::to_string(diffuseNr++);
-		else if (type == TEX_SPECULAR)
-			number = std::to_string(specularNr++);
-		else if (type == TEX_NORMAL)
-			number = std::to_string(normalNr++);
-		else if (type == TEX_HEIGHT)
-			number = std::to_string(heightNr++);
-		else if (type == TEX_EMISSION)
-			number = std::to_string(emissionNr++);
-		else if (type == TEX_AMBIENT)
-			number = std::to_string(ambientNr++);
-
-		shader.setUniform("uMaterial." + TextureTypeName[type] + number, (int)i);
+		GLState::Shared().ActiveTexture(GL_TEXTURE0 + i); // activate proper texture unit before binding
+		shader.setUniform(samplerNames[i].c_str(), (int)i);
 		// Bind the texture
-		glBindTexture(GL_TEXTURE_2D, textures[i].id);
+		GLState::Shared().BindTexture(GL_TEXTURE_2D, textures[i].id);
 	}
-	glActiveTexture(GL_TEXTURE0);
-
-	// Draw mesh
-	glBindVertexArray(vao);
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+	GLState::Shared().ActiveTexture(GL_TEXTURE0);
+}
 
-	glActiveTexture(GL_TEXTURE0);
+void Base2D :: DrawGeometry() {
+	GeometryArena::Shared().Draw(geometry);
 }
 
 void Base2D :: AddTexture(unsigned int tid) { // for frame buffer
@@ -179,44 +154,25 @@ Quad :: Quad() {
 *
 *************************************************/
 
-Base3D :: Base3D() {
+Base3D :: Base3D() : vbo(0), ebo(0), vao(0), geometry(0) {
 	//position = glm::vec3(0.0f, 0.0f, 0.0f);
 	//scale    = glm::vec3(1.0f, 1.0f, 1.0f);
 	//rotation = glm::mat4(1.0f);
 }
 
 Base3D :: ~Base3D() {
-	glDeleteVertexArrays(1, &vao);
-	glDeleteBuffers(1, &vbo);
-	glDeleteBuffers(1, &ebo);
+	GeometryArena::Shared().Free(geometry);
 }
 
 void Base3D :: setup() {
 
-	glGenBuffers(1, &vbo); // Generate an empty vertex buffer on the GPU
-	glGenBuffers(1, &ebo);
-	glGenVertexArrays(1, &vao); // Tell OpenGL to create new Vertex Array Object
-	
-	glBindVertexArray(vao); // Make the vertices buffer the current one
-	
-	glBindBuffer(GL_ARRAY_BUFFER, vbo); // "bind" or set as the current buffer we are working with
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
-
-	glEnableVertexAttribArray(0); // vertex positions
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), NULL);
-	glEnableVertexAttribArray(1); // vertex normals
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-	glEnableVertexAttribArray(2); // vertex texture coords
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
-	glEnableVertexAttribArray(3); // vertex tangent coords
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tangent));
-	glEnableVertexAttribArray(4); // vertex bitangent coords
-	glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, bitangent));
+	// Sub-allocated from the shared arena, the VAO belongs to the arena page
+	GeometryArena & arena = GeometryArena::Shared();
+	geometry = arena.Allocate(VERTEX_FULL, vertices.data(), vertices.size(), indices.data(), indices.size());
 
-	glBindVertexArray(0); // Release control of vao
+	const GeometryRange * range = arena.Range(geometry);
+	vbo = ebo = 0;
+	vao = range ? range->vao : 0;
 }
 
 void Base3D :: Draw(Shader & shader) {
@@ -234,46 +190,34 @@ void Base3D :: Draw(Shader & shader) {
 
 	shader.use();
 
-	// Bind textures
-	unsigned int diffuseNr  = 1;
-	unsigned int specularNr = 1;
-	unsigned int normalNr   = 1;
-	unsigned int heightNr   = 1;
-	unsigned int emissionNr = 1;
-	unsigned int ambientNr  = 1;
+	BindTextures(shader);
 
-	for (unsigned int i=0; i<textures.size(); i++) {
+	// Draw mesh
+	drawMesh();
+
+	GLState::Shared().ActiveTexture(GL_TEXTURE0);
+}
+
+void Base3D :: drawMesh() {
+	GeometryArena::Shared().Draw(geometry);
+}
 
-		glActiveTexture(GL_TEXTURE0 + i); // activate proper texture unit before binding
-
-		std::string number;
-		TextureType type = textures[i].type;
-
-		if (type == TEX_DIFFUSE)
-			number = std::to_string(diffuseNr++);
-		else if (type == TEX_SPECULAR)
-			number = std::to_string(specularNr++);
-		else if (type == TEX_NORMAL)
-			number = std::to_string(normalNr++);
-		else if (type == TEX_HEIGHT)
-			number = std::to_string(heightNr++);
-		else if (type == TEX_EMISSION)
-			number = std::to_string(emissionNr++);
-		else if (type == TEX_AMBIENT)
-			number = std::to_string(ambientNr++);
-
-		shader.setUniform("uMaterial." + TextureTypeName[type] + number, (int)i);
+void Base3D :: BindTextures(Shader & shader) {
+
+	if (samplerNames.size() != textures.size())
+		samplerNames = SamplerUniformNames(textures);
+
+	for (unsigned int i=0; i<textures.size(); i++) {
+		GLState::Shared().ActiveTexture(GL_TEXTURE0 + i); // activate proper texture unit before binding
+		shader.setUniform(samplerNames[i].c_str(), (int)i);
 		// Bind the texture
-		glBindTexture(GL_TEXTURE_2D, textures[i].id);
+		GLState::Shared().BindTexture(GL_TEXTURE_2D, textures[i].id);
 	}
-	glActiveTexture(GL_TEXTURE0);
-
-	// Draw mesh
-	glBindVertexArray(vao);
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+	GLState::Shared().ActiveTexture(GL_TEXTURE0);
+}
 
-	glActiveTexture(GL_TEXTURE0);
+void Base3D :: DrawGeometry() {
+	drawMesh();
 }
 
 void Base3D :: AddTexture(unsigned int tid) {
@@ -337,11 +281,11 @@ void Base2D :: Rotate(float radian, glm::vec3 axis) {
 *************************************************/
 
 std::vector<std::vector<float> > Plane :: plane_vertices = {
-	// positions        // normals          // texCoords   // tangent         // bitangent
-	{-0.5,  0.0, -0.5,   0.0,  1.0,  0.0,   0.0f,  0.0f,   1.0,  0.0,  0.0,   0.0,  0.0,  1.0,},
-	{ 0.5,  0.0, -0.5,   0.0,  1.0,  0.0,   1.0f,  0.0f,   1.0,  0.0,  0.0,   0.0,  0.0,  1.0,},
-	{ 0.5,  0.0,  0.5,   0.0,  1.0,  0.0,   1.0f,  1.0f,   1.0,  0.0,  0.0,   0.0,  0.0,  1.0,},
-	{-0.5,  0.0,  0.5,   0.0,  1.0,  0.0,   0.0f,  1.0f,   1.0,  0.0,  0.0,   0.0,  0.0,  1.0,}
+	// positions        // normals          // texCoords
+	{-0.5,  0.0, -0.5,   0.0,  1.0,  0.0,   0.0f,  0.0f,},
+	{ 0.5,  0.0, -0.5,   0.0,  1.0,  0.0,   1.0f,  0.0f,},
+	{ 0.5,  0.0,  0.5,   0.0,  1.0,  0.0,   1.0f,  1.0f,},
+	{-0.5,  0.0,  0.5,   0.0,  1.0,  0.0,   0.0f,  1.0f,}
 };
 
 std::vector<unsigned int> Plane :: plane_elements = {
@@ -365,16 +309,11 @@ Plane :: Plane() {
 		u.x = item[6]; u.y = item[7];
 		vertex.texCoords = u;
 
-		v.x = item[8]; v.y = item[9]; v.z = item[10];
-		vertex.tangent = v;
-
-		v.x = item[11]; v.y = item[12]; v.z = item[13];
-		vertex.bitangent = v;
-
 		vertices.push_back(vertex);
 	}
 	
 	indices = plane_elements;
+	GenerateTangents(vertices, indices);
 	
 	setup();
 }
@@ -384,37 +323,37 @@ Plane :: Plane() {
 *************************************************/
 
 std::vector<std::vector<float> > Cube :: cube_vertices = {
-	// positions         // normals         // texCoords   // tangent         // bitangent
+	// positions         // normals         // texCoords
 	// front
-	{-0.5, -0.5,  0.5,   0.0,  0.0,  1.0,   0.0f,  0.0f,   1.0,  0.0,  0.0,   0.0,  1.0,  0.0,},
-	{ 0.5, -0.5,  0.5,   0.0,  0.0,  1.0,   1.0f,  0.0f,   1.0,  0.0,  0.0,   0.0,  1.0,  0.0,},
-	{ 0.5,  0.5,  0.5,   0.0,  0.0,  1.0,   1.0f,  1.0f,   1.0,  0.0,  0.0,   0.0,  1.0,  0.0,},
-	{-0.5,  0.5,  0.5,   0.0,  0.0,  1.0,   0.0f,  1.0f,   1.0,  0.0,  0.0,   0.0,  1.0,  0.0,},
+	{-0.5, -0.5,  0.5,   0.0,  0.0,  1.0,   0.0f,  0.0f,},
+	{ 0.5, -0.5,  0.5,   0.0,  0.0,  1.0,   1.0f,  0.0f,},
+	{ 0.5,  0.5,  0.5,   0.0,  0.0,  1.0,   1.0f,  1.0f,},
+	{-0.5,  0.5,  0.5,   0.0,  0.0,  1.0,   0.0f,  1.0f,},
 	// back
-	{-0.5, -0.5, -0.5,   0.0,  0.0, -1.0,   0.0f,  0.0f,   1.0,  0.0,  0.0,   0.0,  1.0,  0.0,},
-	{-0.5,  0.5, -0.5,   0.0,  0.0, -1.0,   0.0f,  1.0f,   1.0,  0.0,  0.0,   0.0,  1.0,  0.0,},
-	{ 0.5,  0.5, -0.5,   0.0,  0.0, -1.0,   1.0f,  1.0f,   1.0,  0.0,  0.0,   0.0,  1.0,  0.0,},
-	{ 0.5, -0.5, -0.5,   0.0,  0.0, -1.0,   1.0f,  0.0f,   1.0,  0.0,  0.0,   0.0,  1.0,  0.0,},
+	{-0.5, -0.5, -0.5,   0.0,  0.0, -1.0,   0.0f,  0.0f,},
+	{-0.5,  0.5, -0.5,   0.0,  0.0, -1.0,   0.0f,  1.0f,},
+	{ 0.5,  0.5, -0.5,   0.0,  0.0, -1.0,   1.0f,  1.0f,},
+	{ 0.5, -0.5, -0.5,   0.0,  0.0, -1.0,   1.0f,  0.0f,},
 	// left
-	{-0.5, -0.5, -0.5,  -1.0,  0.0,  0.0,   0.0f,  0.0f,   0.0,  0.0,  1.0,   0.0,  1.0,  0.0,},
-	{-0.5, -0.5,  0.5,  -1.0,  0.0,  0.0,   1.0f,  0.0f,   0.0,  0.0,  1.0,   0.0,  1.0,  0.0,},
-	{-0.5,  0.5,  0.5,  -1.0,  0.0,  0.0,   1.0f,  1.0f,   0.0,  0.0,  1.0,   0.0,  1.0,  0.0,},
-	{-0.5,  0.5, -0.5,  -1.0,  0.0,  0.0,   0.0f,  1.0f,   0.0,  0.0,  1.0,   0.0,  1.0,  0.0,},
+	{-0.5, -0.5, -0.5,  -1.0,  0.0,  0.0,   0.0f,  0.0f,},
+	{-0.5, -0.5,  0.5,  -1.0,  0.0,  0.0,   1.0f,  0.0f,},
+	{-0.5,  0.5,  0.5,  -1.0,  0.0,  0.0,   1.0f,  1.0f,},
+	{-0.5,  0.5, -0.5,  -1.0,  0.0,  0.0,   0.0f,  1.0f,},
 	// right
-	{ 0.5, -0.5,  0.5,   1.0,  0.0,  0.0,   1.0f,  0.0f,   0.0,  0.0,  1.0,   0.0,  1.0,  0.0,},
-	{ 0.5, -0.5, -0.5,   1.0,  0.0,  0.0,   0.0f,  0.0f,   0.0,  0.0,  1.0,   0.0,  1.0,  0.0,},
-	{ 0.5,  0.5, -0.5,   1.0,  0.0,  0.0,   0.0f,  1.0f,   0.0,  0.0,  1.0,   0.0,  1.0,  0.0,},
-	{ 0.5,  0.5,  0.5,   1.0,  0.0,  0.0,   1.0f,  1.0f,   0.0,  0.0,  1.0,   0.0,  1.0,  0.0,},
+	{ 0.5, -0.5,  0.5,   1.0,  0.0,  0.0,   1.0f,  0.0f,},
+	{ 0.5, -0.5, -0.5,   1.0,  0.0,  0.0,   0.0f,  0.0f,},
+	{ 0.5,  0.5, -0.5,   1.0,  0.0,  0.0,   0.0f,  1.0f,},
+	{ 0.5,  0.5,  0.5,   1.0,  0.0,  0.0,   1.0f,  1.0f,},
 	// top
-	{-0.5,  0.5,  0.5,   0.0,  1.0,  0.0,   0.0f,  1.0f,   1.0,  0.0,  0.0,   0.0,  0.0,  1.0,},
-	{ 0.5,  0.5,  0.5,   0.0,  1.0,  0.0,   1.0f,  1.0f,   1.0,  0.0,  0.0,   0.0,  0.0,  1.0,},
-	{ 0.5,  0.5, -0.5,   0.0,  1.0,  0.0,   1.0f,  0.0f,   1.0,  0.0,  0.0,   0.0,  0.0,  1.0,},
-	{-0.5,  0.5, -0.5,   0.0,  1.0,  0.0,   0.0f,  0.0f,   1.0,  0.0,  0.0,   0.0,  0.0,  1.0,},
+	{-0.5,  0.5,  0.5,   0.0,  1.0,  0.0,   0.0f,  1.0f,},
+	{ 0.5,  0.5,  0.5,   0.0,  1.0,  0.0,   1.0f,  1.0f,},
+	{ 0.5,  0.5, -0.5,   0.0,  1.0,  0.0,   1.0f,  0.0f,},
+	{-0.5,  0.5, -0.5,   0.0,  1.0,  0.0,   0.0f,  0.0f,},
 	// buttom
-	{ 0.5, -0.5, -0.5,   0.0, -1.0,  0.0,   1.0f,  0.0f,   1.0,  0.0,  0.0,   0.0,  0.0,  1.0,},
-	{ 0.5, -0.5,  0.5,   0.0, -1.0,  0.0,   1.0f,  1.0f,   1.0,  0.0,  0.0,   0.0,  0.0,  1.0,},
-	{-0.5, -0.5,  0.5,   0.0, -1.0,  0.0,   0.0f,  1.0f,   1.0,  0.0,  0.0,   0.0,  0.0,  1.0,},
-	{-0.5, -0.5, -0.5,   0.0, -1.0,  0.0,   0.0f,  0.0f,   1.0,  0.0,  0.0,   0.0,  0.0,  1.0,}
+	{ 0.5, -0.5, -0.5,   0.0, -1.0,  0.0,   1.0f,  0.0f,},
+	{ 0.5, -0.5,  0.5,   0.0, -1.0,  0.0,   1.0f,  1.0f,},
+	{-0.5, -0.5,  0.5,   0.0, -1.0,  0.0,   0.0f,  1.0f,},
+	{-0.5, -0.5, -0.5,   0.0, -1.0,  0.0,   0.0f,  0.0f,}
 };
 
 std::vector<unsigned int> Cube :: cube_elements = {
@@ -454,16 +393,11 @@ Cube :: Cube() {
 		u.x = item[6]; u.y = item[7];
 		vertex.texCoords = u;
 
-		v.x = item[8]; v.y = item[9]; v.z = item[10];
-		vertex.tangent = v;
-
-		v.x = item[11]; v.y = item[12]; v.z = item[13];
-		vertex.bitangent = v;
-
 		vertices.push_back(vertex);
 	}
 	
 	indices = cube_elements;
+	GenerateTangents(vertices, indices);
 
 	setup();
 }
@@ -477,6 +411,16 @@ std::vector<glm::vec3> TrCube :: FaceCenters = {
 	{ 0.0, -0.5,  0.0}, // buttom
 };
 
+TrCube :: TrCube()
+	: streamVao(0), streamVbo(0), streamEbo(0), streamOffset(0), streamed(false)
+{
+}
+
+TrCube :: ~TrCube() {
+	if (streamVao)
+		GLState::Shared().DeleteVertexArrays(1, &streamVao);
+}
+
 void TrCube :: UpdateRenderOrder(glm::vec3 & camPos, glm::mat4 & modelMatrix) {
 
 	std::map<float, int> distdict;
@@ -502,8 +446,44 @@ void TrCube :: UpdateRenderOrder(glm::vec3 & camPos, glm::mat4 & modelMatrix) {
 			indices.push_back(e + face_id * 4);
 	}
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+	// Transient indices: a fresh range of the ring, rather than rewriting the arena range the last frames still draw
+	GeometryArena & arena = GeometryArena::Shared();
+	const GeometryRange * range = arena.Range(geometry);
+	StreamRange stream = StreamBuffer::Shared().Upload(indices.data(), indices.size() * sizeof(unsigned int), sizeof(unsigned int));
+	GLuint vbo = 0, ebo = 0;
+	if (!range || !stream.buffer || !arena.PageBuffers(range->page, vbo, ebo)) {
+		streamed = false;
+		arena.UpdateIndices(geometry, indices.data(), indices.size());
+		return;
+	}
+
+	// The ring buffer keeps its name, only a Compact() of the arena calls for a new setup
+	if (!streamVao || streamVbo != vbo || streamEbo != stream.buffer) {
+		if (!streamVao)
+			glGenVertexArrays(1, &streamVao);
+		GLState::Shared().BindVertexArray(streamVao);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		SetupVertexAttributes(range->format);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, stream.buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		streamVbo = vbo;
+		streamEbo = stream.buffer;
+	}
+	streamOffset = stream.offset;
+	streamed = true;
+}
+
+void TrCube :: drawMesh() {
+
+	const GeometryRange * range = GeometryArena::Shared().Range(geometry);
+	if (!streamed || !range) {
+		Base3D::drawMesh();
+		return;
+	}
+
+	GLState::Shared().BindVertexArray(streamVao);
+	glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei) indices.size(), GL_UNSIGNED_INT,
+		(void*) streamOffset, range->baseVertex);
 }
 
 /**
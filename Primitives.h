@@ -4,6 +4,7 @@
 #include <ShaderProgram.h>
 #include <Texture.h>
 #include <Mesh.h>
+#include <GeometryArena.h>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
@@ -24,6 +25,10 @@ public:
 	~Base2D();
 
 	void Draw(Shader & shader);
+	/** Geometry only: no shader or texture setup */
+	void DrawGeometry();
+	/** Samplers and texture units, what Draw does before drawing */
+	void BindTextures(Shader & shader);
 	void AddTexture(unsigned int tid);
 	void AddTexture(const std::string path, TextureType type, bool gamma = false);
 	void DeleteBuffers();
@@ -40,7 +45,9 @@ public:
 
 protected:
 	/** Render Data */
-	unsigned int vbo, ebo, vao;
+	unsigned int vbo, ebo, vao; // vao: shared arena page VAO, vbo / ebo unused
+	GeometryHandle geometry;
+	std::vector<std::string> samplerNames; // per texture, rebuilt when textures change size
 
 	/** Geometry params 
 	glm::vec3 position;
@@ -75,9 +82,13 @@ public:
 
 	/** Methods */
 	Base3D();
-	~Base3D();
+	virtual ~Base3D();
 
 	void Draw(Shader & shader);
+	/** Geometry only: no shader or texture setup */
+	void DrawGeometry();
+	/** Samplers and texture units, what Draw does before drawing */
+	void BindTextures(Shader & shader);
 	void AddTexture(unsigned int tid);
 	void AddTexture(const std::string path, TextureType type, bool gamma = false);
 	void DeleteBuffers();
@@ -94,7 +105,9 @@ public:
 
 protected:
 	/** Render Data */
-	unsigned int vbo, ebo, vao;
+	unsigned int vbo, ebo, vao; // vao: shared arena page VAO, vbo / ebo unused
+	GeometryHandle geometry;
+	std::vector<std::string> samplerNames; // per texture, rebuilt when textures change size
 
 	/** Geometry params 
 	glm::vec3 position;
@@ -106,6 +119,8 @@ protected:
 	
 	/** Methods */
 	void setup();
+	/** The draw call of Draw and DrawGeometry, the arena range by default */
+	virtual void drawMesh();
 };
 
 class Plane : public Base3D {
@@ -133,11 +148,25 @@ protected:
 class TrCube : public Cube {
 public:
 	/** Methods */
+	TrCube();
+	~TrCube();
+	/**
+	* Faces back to front from the camera. The order is uploaded to StreamBuffer::Shared()
+	* and drawn from there until the ring's EndFrame: call it every frame before drawing.
+	*/
 	void UpdateRenderOrder(glm::vec3 & camPos, glm::mat4 & modelMatrix);
 
 protected:
 	//enum FaceDir { FRONT, BACK, LEFT, RIGHT, TOP, BUTTOM };
 	static std::vector<glm::vec3> FaceCenters;
+
+	/** Arena page vertices with the stream ring as element buffer */
+	GLuint streamVao;
+	GLuint streamVbo, streamEbo; // what streamVao was set up with
+	size_t streamOffset;         // bytes into streamEbo of the current order
+	bool streamed;               // else the order was written into the arena range
+
+	void drawMesh() override;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,238 @@
+#include <RenderQueue.h>
+#include <GLState.h>
+#include <Model.h>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+
+RenderQueue :: RenderQueue()
+	: mView(1.0f), mViewProjection(1.0f), mEye(0.0f), mCulled(0)
+{
+}
+
+void RenderQueue :: Begin(const glm::mat4 & view, const glm::mat4 & projection) {
+
+	mView = view;
+	mViewProjection = projection * view;
+	mEye = glm::vec3(glm::inverse(view)[3]);
+
+	mPackets.clear();
+	mTransforms.clear();
+	mItems.clear();
+	mShaderIds.clear();
+	mMaterialIds.clear();
+	mVaoIds.clear();
+	mCulled = 0;
+}
+
+uint32_t RenderQueue :: AddTransform(const glm::mat4 & modelMatrix, unsigned int cull) {
+
+	// Cluster bounds are object space: bring the frustum and the eye there once per object
+	Transform transform;
+	transform.model = modelMatrix;
+	transform.frustum = ExtractFrustum(mViewProjection * modelMatrix);
+	transform.eye = glm::vec3(glm::inverse(modelMatrix) * glm::vec4(mEye, 1.0f));
+	transform.cull = cull;
+	mTransforms.push_back(transform);
+	return (uint32_t) (mTransforms.size() - 1);
+}
+
+void RenderQueue :: Add(Mesh & mesh, Shader & shader, uint32_t transform, RenderPass pass, Model * owner) {
+
+	const Transform & placement = mTransforms[transform];
+	if ((placement.cull & CLUSTER_CULL_FRUSTUM) && !SphereInFrustum(placement.frustum, mesh.Center(), mesh.Radius())) {
+		mCulled++;
+		return;
+	}
+
+	// Same textures through another model's arrays or page tables are another material
+	uint64_t material = mesh.MaterialKey() ^ ((uint64_t) (uintptr_t) owner * 0x9E3779B97F4A7C15ull);
+	glm::vec3 center = glm::vec3(placement.model * glm::vec4(mesh.Center(), 1.0f));
+	add(PACKET_MESH, &mesh, shader, owner, transform, material, mesh.VAO(), center, pass, mesh.Lod());
+}
+
+void RenderQueue :: Add(Base3D & object, Shader & shader, const glm::mat4 & modelMatrix, RenderPass pass) {
+
+	uint64_t material = 0;
+	for (const Texture & texture : object.textures)
+		material = material * 1099511628211ull + (((uint64_t) texture.type << 32) | texture.id);
+	uint32_t transform = AddTransform(modelMatrix, CLUSTER_CULL_NONE);
+	add(PACKET_BASE3D, &object, shader, NULL, transform, material, object.VAO(), glm::vec3(modelMatrix[3]), pass);
+}
+
+void RenderQueue :: Add(Base2D & object, Shader & shader, const glm::mat4 & modelMatrix, RenderPass pass) {
+
+	uint64_t material = 0;
+	for (const Texture & texture : object.textures)
+		material = material * 1099511628211ull + (((uint64_t) texture.type << 32) | texture.id);
+	uint32_t transform = AddTransform(modelMatrix, CLUSTER_CULL_NONE);
+	add(PACKET_BASE2D, &object, shader, NULL, transform, material, object.VAO(), glm::vec3(modelMatrix[3]), pass);
+}
+
+void RenderQueue :: add(PacketKind kind, void * object, Shader & shader, Model * owner, uint32_t transform,
+	uint64_t material, GLuint vao, const glm::vec3 & center, RenderPass pass, unsigned int lod) {
+
+	Packet packet;
+	packet.kind = kind;
+	packet.object = object;
+	packet.shader = &shader;
+	packet.owner = owner;
+	packet.transform = transform;
+	packet.material = material;
+	packet.lod = lod;
+
+	uint64_t materialId = number(mMaterialIds, material, RENDER_KEY_MATERIAL_BITS);
+	uint64_t shaderId = number(mShaderIds, shader.ID(), RENDER_KEY_SHADER_BITS);
+	uint64_t vaoId = number(mVaoIds, vao, RENDER_KEY_VAO_BITS);
+
+	// Positive floats order like their bits: drop the sign, keep the top 24 of the rest
+	float distance = -(mView * glm::vec4(center, 1.0f)).z;
+	if (!(distance > 0.0f))
+		distance = 0.0f;
+	uint32_t bits;
+	std::memcpy(&bits, &distance, sizeof(bits));
+	uint64_t depth = bits >> (31 - RENDER_KEY_DEPTH_BITS);
+
+	const uint64_t depthMask = (1ull << RENDER_KEY_DEPTH_BITS) - 1;
+	const int vaoShift = 0;
+	const int materialShift = vaoShift + RENDER_KEY_VAO_BITS;
+	const int shaderShift = materialShift + RENDER_KEY_MATERIAL_BITS;
+	const int stateBits = shaderShift + RENDER_KEY_SHADER_BITS;
+
+	uint64_t key = (uint64_t) pass << 62;
+	switch (pass) {
+	case RENDER_OPAQUE:
+		key |= (shaderId << (shaderShift + RENDER_KEY_DEPTH_BITS))
+			| (materialId << (materialShift + RENDER_KEY_DEPTH_BITS))
+			| (vaoId << (vaoShift + RENDER_KEY_DEPTH_BITS))
+			| depth;
+		break;
+	case RENDER_TRANSPARENT:
+		key |= ((depthMask - depth) << stateBits)
+			| (shaderId << shaderShift)
+			| (materialId << materialShift)
+			| (vaoId << vaoShift);
+		break;
+	default:
+		key |= mPackets.size();
+		break;
+	}
+
+	SortItem item;
+	item.key = key;
+	item.packet = (uint32_t) mPackets.size();
+	mPackets.push_back(packet);
+	mItems.push_back(item);
+}
+
+uint32_t RenderQueue :: number(std::unordered_map<uint64_t, uint32_t> & ids, uint64_t value, unsigned int bits) {
+
+	auto found = ids.find(value);
+	if (found != ids.end())
+		return found->second;
+	uint32_t last = (1u << bits) - 1;
+	uint32_t id = ids.size() < last ? (uint32_t) ids.size() : last;
+	ids[value] = id;
+	return id;
+}
+
+uint32_t RenderQueue :: number(std::unordered_map<GLuint, uint32_t> & ids, GLuint value, unsigned int bits) {
+
+	auto found = ids.find(value);
+	if (found != ids.end())
+		return found->second;
+	uint32_t last = (1u << bits) - 1;
+	uint32_t id = ids.size() < last ? (uint32_t) ids.size() : last;
+	ids[value] = id;
+	return id;
+}
+
+RenderQueueStats RenderQueue :: Flush() {
+
+	RenderQueueStats stats = {};
+	stats.packets = mPackets.size();
+	stats.culled = mCulled;
+
+	RadixSortKeys(mItems, mScratch);
+
+	// Materials and uModel are program state: a shader switch invalidates both
+	GLuint currentShader = 0;
+	uint64_t currentMaterial = 0;
+	bool haveMaterial = false;
+	Model * currentOwner = NULL;
+	uint32_t currentTransform = UINT32_MAX;
+
+	for (const SortItem & item : mItems) {
+		Packet & packet = mPackets[item.packet];
+		Shader & shader = *packet.shader;
+
+		if (shader.ID() != currentShader) {
+			shader.use();
+			currentShader = shader.ID();
+			haveMaterial = false;
+			currentOwner = NULL;
+			currentTransform = UINT32_MAX;
+			stats.shaderChanges++;
+		}
+		if (packet.owner != currentOwner) {
+			if (packet.owner)
+				packet.owner->BindMaterials(shader);
+			currentOwner = packet.owner;
+		}
+		if (packet.transform != currentTransform) {
+			shader.setUniform("uModel", mTransforms[packet.transform].model);
+			currentTransform = packet.transform;
+			stats.transformChanges++;
+		}
+
+		// Full keys: numbers past the field width are shared
+		bool bind = !haveMaterial || packet.material != currentMaterial;
+		if (bind) {
+			currentMaterial = packet.material;
+			haveMaterial = true;
+			stats.materialChanges++;
+		}
+
+		switch (packet.kind) {
+		case PACKET_MESH: {
+			Mesh & mesh = *(Mesh *) packet.object;
+			if (bind)
+				mesh.BindTextures(shader);
+			const Transform & placement = mTransforms[packet.transform];
+			size_t drawn = mesh.DrawClusterGeometry(placement.frustum, placement.eye, packet.lod, placement.cull);
+			if (drawn != 0)
+				stats.draws++;
+			stats.clusters += drawn;
+			break;
+		}
+		case PACKET_BASE3D: {
+			Base3D & object = *(Base3D *) packet.object;
+			if (bind)
+				object.BindTextures(shader);
+			object.DrawGeometry();
+			stats.draws++;
+			break;
+		}
+		case PACKET_BASE2D: {
+			Base2D & object = *(Base2D *) packet.object;
+			if (bind)
+				object.BindTextures(shader);
+			object.DrawGeometry();
+			stats.draws++;
+			break;
+		}
+		}
+	}
+	GLState::Shared().ActiveTexture(GL_TEXTURE0);
+
+	mPackets.clear();
+	mTransforms.clear();
+	mItems.clear();
+	mCulled = 0;
+	return stats;
+}
@@ -0,0 +1,177 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <ShaderProgram.h>
+#include <Mesh.h>
+#include <Meshlet.h>
+#include <Primitives.h>
+
+class Model;
+
+/** Passes are drawn in this order */
+enum RenderPass {
+	RENDER_OPAQUE      = 0, // grouped by state, front to back within a state
+	RENDER_TRANSPARENT = 1, // back to front, state only breaks depth ties
+	RENDER_OVERLAY     = 2  // submission order (screen space quads, debug...)
+};
+
+/**
+* 64-bit sort keys, most significant field first:
+*   opaque:      pass 2 | shader 10 | material 14 | vao 14 | depth 24
+*   transparent: pass 2 | far-to-near depth 24 | shader 10 | material 14 | vao 14
+*   overlay:     pass 2 | submission index
+* Shaders, materials and VAOs are numbered per frame in the order they are first
+* seen; past the field width they share the last number (still drawn right, only
+* less grouped). Depth is the view distance of the bounding sphere center, its
+* float bits truncated to 24.
+*/
+#define RENDER_KEY_SHADER_BITS   10
+#define RENDER_KEY_MATERIAL_BITS 14
+#define RENDER_KEY_VAO_BITS      14
+#define RENDER_KEY_DEPTH_BITS    24
+
+struct RenderQueueStats {
+	size_t packets;
+	size_t culled;          // dropped whole by the frustum when added
+	size_t draws;           // packets that drew something
+	size_t clusters;        // clusters drawn, meshes drawn whole count one
+	size_t shaderChanges;
+	size_t materialChanges;
+	size_t transformChanges;
+};
+
+/**
+* Draws collected over a frame, sorted to minimise state changes and submitted
+* at once: the shader is bound once per run of packets sharing it, textures
+* once per run sharing a material, uModel once per object. Uniforms other than
+* uModel must be set on the shaders before Flush (they live in the programs).
+*
+*   queue.Begin(view, projection);
+*   model.Submit(queue, shader, modelMatrix);
+*   queue.Add(cube, shader, cubeMatrix, RENDER_TRANSPARENT);
+*   queue.Flush();
+*
+* GL thread only; objects must stay alive until Flush.
+*/
+class RenderQueue {
+
+public:
+	RenderQueue();
+
+	/** Starts a frame, empties the queue */
+	void Begin(const glm::mat4 & view, const glm::mat4 & projection);
+
+	/**
+	* One object placement: its uModel, and the frustum and eye in its space for
+	* culling (cull: CLUSTER_CULL_* flags). Returns the handle packets refer to
+	*/
+	uint32_t AddTransform(const glm::mat4 & modelMatrix, unsigned int cull = CLUSTER_CULL_FRUSTUM);
+
+	/**
+	* Mesh drawn with a transform from AddTransform, at its current Lod(): select
+	* the level for this placement (UpdateLod) before adding it. Culled here by its
+	* bounding sphere; clustered meshes also cull their clusters at Flush. owner:
+	* the model whose texture arrays or page pool the mesh samples (BindMaterials)
+	*/
+	void Add(Mesh & mesh, Shader & shader, uint32_t transform, RenderPass pass = RENDER_OPAQUE,
+		Model * owner = NULL);
+	void Add(Base3D & object, Shader & shader, const glm::mat4 & modelMatrix, RenderPass pass = RENDER_OPAQUE);
+	void Add(Base2D & object, Shader & shader, const glm::mat4 & modelMatrix, RenderPass pass = RENDER_OVERLAY);
+
+	/** Sorts, draws every packet and empties the queue */
+	RenderQueueStats Flush();
+
+	size_t Size() const { return mPackets.size(); }
+	const glm::mat4 & ViewProjection() const { return mViewProjection; }
+
+private:
+	enum PacketKind {
+		PACKET_MESH,
+		PACKET_BASE3D,
+		PACKET_BASE2D
+	};
+
+	struct Packet {
+		PacketKind kind;
+		void * object;
+		Shader * shader;
+		Model * owner;
+		uint32_t transform;
+		uint64_t material; // full key, the sort key holds its per-frame number
+		unsigned int lod;  // meshes: Mesh::Lod() when added, the mesh may be placed again at another level
+	};
+
+	struct Transform {
+		glm::mat4 model;
+		Frustum frustum;  // object space
+		glm::vec3 eye;    // object space
+		unsigned int cull;
+	};
+
+	struct SortItem {
+		uint64_t key;
+		uint32_t packet;
+	};
+
+	glm::mat4 mView;
+	glm::mat4 mViewProjection;
+	glm::vec3 mEye;
+
+	std::vector<Packet> mPackets;
+	std::vector<Transform> mTransforms;
+	std::vector<SortItem> mItems;
+	std::vector<SortItem> mScratch;
+	std::unordered_map<GLuint, uint32_t> mShaderIds;
+	std::unordered_map<uint64_t, uint32_t> mMaterialIds;
+	std::unordered_map<GLuint, uint32_t> mVaoIds;
+	size_t mCulled;
+
+	void add(PacketKind kind, void * object, Shader & shader, Model * owner, uint32_t transform,
+		uint64_t material, GLuint vao, const glm::vec3 & center, RenderPass pass, unsigned int lod = 0);
+	static uint32_t number(std::unordered_map<uint64_t, uint32_t> & ids, uint64_t value, unsigned int bits);
+	static uint32_t number(std::unordered_map<GLuint, uint32_t> & ids, GLuint value, unsigned int bits);
+};
+
+/** Stable LSD radix sort on the keys, 8 bits per pass, passes where every key agrees are skipped */
+template<class Item>
+void RadixSortKeys(std::vector<Item> & items, std::vector<Item> & scratch);
+
+template<class Item>
+void RadixSortKeys(std::vector<Item> & items, std::vector<Item> & scratch) {
+
+	size_t count = items.size();
+	if (count < 2)
+		return;
+	scratch.resize(count);
+
+	// Every histogram in one read
+	size_t histograms[8][256] = {};
+	for (const Item & item : items)
+		for (int pass=0; pass<8; pass++)
+			histograms[pass][(item.key >> (pass * 8)) & 0xFF]++;
+
+	for (int pass=0; pass<8; pass++) {
+		size_t * histogram = histograms[pass];
+		if (histogram[(items[0].key >> (pass * 8)) & 0xFF] == count)
+			continue;
+
+		size_t offset = 0;
+		for (int digit=0; digit<256; digit++) {
+			size_t n = histogram[digit];
+			histogram[digit] = offset;
+			offset += n;
+		}
+		for (const Item & item : items)
+			scratch[histogram[(item.key >> (pass * 8)) & 0xFF]++] = item;
+		items.swap(scratch);
+	}
+}
+
+#endif
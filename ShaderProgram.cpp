@@ -1,22 +1,45 @@
 #include <ShaderProgram.h>
+#include <GLState.h>
+#include <FrameUniforms.h>
+#include <IndirectScene.h>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <cstring>
+#include <algorithm>
 
 using std::string;
 
+// Sources of "#pragma block" by block name
+static std::unordered_map<string, BlockSource>& blockSources()
+{
+	static std::unordered_map<string, BlockSource>* sources = new std::unordered_map<string, BlockSource>({
+		{ FRAME_BLOCK_NAME, BlockDeclaration<FrameBlock>(FRAME_BLOCK_NAME) },
+		{ LIGHT_BLOCK_NAME, BlockDeclaration<LightBlock>(LIGHT_BLOCK_NAME) },
+		{ INDIRECT_INSTANCE_BLOCK, BlockArrayDeclaration<IndirectInstance>(INDIRECT_INSTANCE_BLOCK, "instances", INDIRECT_INSTANCE_BINDING) },
+		{ INDIRECT_MESH_BLOCK, BlockArrayDeclaration<IndirectMesh>(INDIRECT_MESH_BLOCK, "meshes", INDIRECT_MESH_BINDING, "readonly") },
+		{ INDIRECT_COMMAND_BLOCK, BlockArrayDeclaration<IndirectCommand>(INDIRECT_COMMAND_BLOCK, "commands", INDIRECT_COMMAND_BINDING) },
+		{ INDIRECT_VISIBLE_BLOCK, BlockArrayDeclaration<unsigned int>(INDIRECT_VISIBLE_BLOCK, "visible", INDIRECT_VISIBLE_BINDING, "writeonly") }
+	});
+	return *sources;
+}
+
+unsigned int Shader :: sGenerations = 0;
+size_t Shader :: sUniformCalls = 0;
+size_t Shader :: sUniformsDropped = 0;
+
 //-----------------------------------------------------------------------------
 // Constructor
 //-----------------------------------------------------------------------------
 Shader :: Shader()
-	: mHandle(0)
+	: mHandle(0), mGeneration(0)
 {}
 
 Shader :: Shader(
 		const char* vsFilename,
 		const char* fsFilename,
 		const char* gsFilename)
-	: mHandle(0)
+	: mHandle(0), mGeneration(0)
 {
 	loadShaders(vsFilename, fsFilename, gsFilename);
 }
@@ -27,7 +50,7 @@ Shader :: Shader(
 Shader :: ~Shader()
 {
 	// Delete the program
-	glDeleteProgram(mHandle);
+	GLState::Shared().DeleteProgram(mHandle);
 }
 
 //-----------------------------------------------------------------------------
@@ -45,7 +68,7 @@ bool Shader::loadShaders(
 	}
 
 	GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-	std::string vsString = fileToString(vsFilename);
+	std::string vsString = expandBlocks(fileToString(vsFilename), vsFilename);
 	const GLchar* vsSourcePtr = vsString.c_str();
 	glShaderSource(vs, 1, &vsSourcePtr, NULL);
 	glCompileShader(vs);
@@ -53,7 +76,7 @@ bool Shader::loadShaders(
 	glAttachShader(mHandle, vs);
 
 	GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
-	std::string fsString = fileToString(fsFilename);
+	std::string fsString = expandBlocks(fileToString(fsFilename), fsFilename);
 	const GLchar* fsSourcePtr = fsString.c_str();
 	glShaderSource(fs, 1, &fsSourcePtr, NULL);
 	glCompileShader(fs);
@@ -63,7 +86,7 @@ bool Shader::loadShaders(
 	GLuint gs;
 	if (gsFilename) {
 		gs = glCreateShader(GL_GEOMETRY_SHADER);
-		std::string gsString = fileToString(gsFilename);
+		std::string gsString = expandBlocks(fileToString(gsFilename), gsFilename);
 		const GLchar* gsSourcePtr = gsString.c_str();
 		glShaderSource(gs, 1, &gsSourcePtr, NULL);
 		glCompileShader(gs);
@@ -79,7 +102,39 @@ bool Shader::loadShaders(
 	if (gsFilename)
 		glDeleteShader(gs);
 
-	mUniformLocations.clear();
+	// Engine blocks (uFrame, uLights) to their fixed binding points
+	FrameUniforms::BindBlocks(mHandle);
+	introspect();
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Load a compute shader, alone in its program
+//-----------------------------------------------------------------------------
+bool Shader :: loadCompute(const char* csFilename)
+{
+	mHandle = glCreateProgram();
+	if (mHandle == 0) {
+		std::cerr << "Unable to create shader program!" << std::endl;
+		return false;
+	}
+
+	GLuint cs = glCreateShader(GL_COMPUTE_SHADER);
+	std::string csString = expandBlocks(fileToString(csFilename), csFilename);
+	const GLchar* csSourcePtr = csString.c_str();
+	glShaderSource(cs, 1, &csSourcePtr, NULL);
+	glCompileShader(cs);
+	checkCompileErrors(cs, COMPUTE);
+	glAttachShader(mHandle, cs);
+
+	glLinkProgram(mHandle);
+	checkCompileErrors(mHandle, PROGRAM);
+
+	glDeleteShader(cs);
+
+	FrameUniforms::BindBlocks(mHandle);
+	introspect();
 
 	return true;
 }
@@ -113,13 +168,68 @@ string Shader :: fileToString(const string& filename)
 	return ss.str();
 }
 
+//-----------------------------------------------------------------------------
+// Replaces "#pragma block <name>" lines with the declared GLSL of the block,
+// the structs it uses first (once per source)
+//-----------------------------------------------------------------------------
+string Shader :: expandBlocks(const string& source, const string& filename)
+{
+	static const string directive = "#pragma block ";
+	if (source.find(directive) == string::npos)
+		return source;
+
+	string result;
+	std::vector<string> declared;
+	size_t start = 0;
+	while (start < source.size())
+	{
+		size_t end = source.find('\n', start);
+		end = end == string::npos ? source.size() : end + 1;
+		string line = source.substr(start, end - start);
+		start = end;
+
+		size_t first = line.find_first_not_of(" \t");
+		if (first == string::npos || line.compare(first, directive.size(), directive) != 0)
+		{
+			result += line;
+			continue;
+		}
+
+		size_t nameStart = first + directive.size();
+		size_t nameEnd = line.find_first_of(" \t\r\n", nameStart);
+		string name = line.substr(nameStart, nameEnd == string::npos ? string::npos : nameEnd - nameStart);
+		auto found = blockSources().find(name);
+		if (found == blockSources().end())
+		{
+			std::cerr << "Unknown block " << name << " in " << filename << std::endl;
+			result += line;
+			continue;
+		}
+
+		for (const auto& declaration : found->second.structs)
+		{
+			if (std::find(declared.begin(), declared.end(), declaration.first) != declared.end())
+				continue;
+			declared.push_back(declaration.first);
+			result += declaration.second;
+		}
+		result += found->second.block;
+	}
+	return result;
+}
+
+void Shader :: DeclareBlock(const string& name, const BlockSource& source)
+{
+	blockSources()[name] = source;
+}
+
 //-----------------------------------------------------------------------------
 // Activate the shader program
 //-----------------------------------------------------------------------------
 void Shader :: use()
 {
 	if (mHandle > 0)
-		glUseProgram(mHandle);
+		GLState::Shared().UseProgram(mHandle);
 }
 
 //-----------------------------------------------------------------------------
@@ -168,120 +278,220 @@ GLuint Shader :: ID() const
 	return mHandle;
 }
 
+//-----------------------------------------------------------------------------
+// Records every active uniform once linked, array elements one by one
+//-----------------------------------------------------------------------------
+void Shader :: introspect()
+{
+	mUniforms.clear();
+	mUniformIndex.clear();
+	mGeneration = ++sGenerations;
+
+	GLint count = 0, maxLength = 0;
+	glGetProgramiv(mHandle, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(mHandle, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	std::vector<GLchar> buffer(maxLength > 0 ? maxLength : 1);
+
+	for (GLint i = 0; i < count; i++)
+	{
+		GLint size = 0;
+		GLenum type = 0;
+		GLsizei length = 0;
+		glGetActiveUniform(mHandle, (GLuint) i, (GLsizei) buffer.size(), &length, &size, &type, buffer.data());
+		string name(buffer.data(), length);
+		GLint location = glGetUniformLocation(mHandle, name.c_str());
+		if (location < 0)
+			continue; // uniform block member
+
+		// "name[0]" for arrays: the bare name is element 0 too
+		if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+		{
+			string base = name.substr(0, name.size() - 3);
+			int first = addUniform(name, location);
+			mUniformIndex[UniformHash(base.c_str())] = first;
+			for (GLint element = 1; element < size; element++)
+			{
+				string elementName = base + "[" + std::to_string(element) + "]";
+				addUniform(elementName, glGetUniformLocation(mHandle, elementName.c_str()));
+			}
+		}
+		else
+		{
+			addUniform(name, location);
+		}
+	}
+}
+
+int Shader :: addUniform(const string& name, GLint location)
+{
+	Uniform uniform;
+	uniform.name = name;
+	uniform.location = location;
+	uniform.known = false;
+	mUniforms.push_back(uniform);
+
+	int index = (int) mUniforms.size() - 1;
+	mUniformIndex[UniformHash(name.c_str())] = index;
+	return index;
+}
+
+//-----------------------------------------------------------------------------
+// Returns the handle of a uniform given its name
+//-----------------------------------------------------------------------------
+UniformHandle Shader :: uniform(const char* name)
+{
+	uint64_t hash = UniformHash(name);
+	std::unordered_map<uint64_t, int>::iterator it = mUniformIndex.find(hash);
+	if (it != mUniformIndex.end())
+	{
+		const Uniform & found = mUniforms[it->second];
+		if (found.name == name || (found.name.size() > 3 && found.name.compare(0, found.name.size() - 3, name) == 0))
+			return UniformHandle(it->second);
+		std::cerr << "Shader::uniform: hash collision between " << found.name << " and " << name << std::endl;
+		return UniformHandle();
+	}
+
+	// Not active (optimized out, or not linked yet): remembered so the lookup stays a hash
+	return UniformHandle(addUniform(name, mHandle > 0 ? glGetUniformLocation(mHandle, name) : -1));
+}
+
+//-----------------------------------------------------------------------------
+// Updates the shadow copy, true when GL must be told
+//-----------------------------------------------------------------------------
+bool Shader :: changed(UniformHandle handle, const void* value, size_t bytes)
+{
+	if (!handle.valid() || handle.index >= (int) mUniforms.size())
+		return false;
+	Uniform & uniform = mUniforms[handle.index];
+	if (uniform.location < 0)
+		return false;
+
+	// glUniform* lands in the current program: the copy is only right when that is this one
+	if (GLState::Shared().Program() != mHandle)
+	{
+		uniform.known = false;
+		sUniformCalls++;
+		return true;
+	}
+
+	if (uniform.known && std::memcmp(uniform.value, value, bytes) == 0)
+	{
+		sUniformsDropped++;
+		return false;
+	}
+	std::memcpy(uniform.value, value, bytes);
+	uniform.known = true;
+	sUniformCalls++;
+	return true;
+}
+
+size_t Shader :: UniformCalls()
+{
+	return sUniformCalls;
+}
+
+size_t Shader :: UniformsDropped()
+{
+	return sUniformsDropped;
+}
+
+void Shader :: ResetUniformStats()
+{
+	sUniformCalls = 0;
+	sUniformsDropped = 0;
+}
+
 //-----------------------------------------------------------------------------
 // Sets a boolean shader uniform
 //-----------------------------------------------------------------------------
-void Shader :: setUniform(const string& name, bool value)
+void Shader :: setUniform(UniformHandle handle, bool value)
 {
-	GLint loc = getUniformLocation(name.c_str());
-	glUniform1i(loc, (int) value);
+	setUniform(handle, (int) value);
 }
 
 //-----------------------------------------------------------------------------
 // Sets an integer shader uniform
 //-----------------------------------------------------------------------------
-void Shader :: setUniform(const string& name, int value)
+void Shader :: setUniform(UniformHandle handle, int value)
 {
-	GLint loc = getUniformLocation(name.c_str());
-	glUniform1i(loc, value);
+	if (changed(handle, &value, sizeof(value)))
+		glUniform1i(mUniforms[handle.index].location, value);
 }
 
 //-----------------------------------------------------------------------------
 // Sets a float shader uniform
 //-----------------------------------------------------------------------------
-void Shader :: setUniform(const string& name, float value)
+void Shader :: setUniform(UniformHandle handle, float value)
 {
-	GLint loc = getUniformLocation(name.c_str());
-	glUniform1f(loc, value);
+	if (changed(handle, &value, sizeof(value)))
+		glUniform1f(mUniforms[handle.index].location, value);
 }
 
 //-----------------------------------------------------------------------------
 // Sets a glm::vec2 shader uniform
 //-----------------------------------------------------------------------------
-void Shader :: setUniform(const string& name, const glm::vec2& v)
+void Shader :: setUniform(UniformHandle handle, const glm::vec2& v)
 {
-	GLint loc = getUniformLocation(name.c_str());
-	glUniform2fv(loc, 1, &v[0]);
+	if (changed(handle, &v[0], sizeof(v)))
+		glUniform2fv(mUniforms[handle.index].location, 1, &v[0]);
 }
 
-void Shader :: setUniform(const string& name, float x, float y)
+void Shader :: setUniform(UniformHandle handle, float x, float y)
 {
-	GLint loc = getUniformLocation(name.c_str());
-	glUniform2f(loc, x, y);
+	setUniform(handle, glm::vec2(x, y));
 }
 
 //-----------------------------------------------------------------------------
 // Sets a glm::vec3 shader uniform
 //-----------------------------------------------------------------------------
-void Shader :: setUniform(const string& name, const glm::vec3& v)
+void Shader :: setUniform(UniformHandle handle, const glm::vec3& v)
 {
-	GLint loc = getUniformLocation(name.c_str());
-	glUniform3fv(loc, 1, &v[0]);
+	if (changed(handle, &v[0], sizeof(v)))
+		glUniform3fv(mUniforms[handle.index].location, 1, &v[0]);
 }
 
-void Shader :: setUniform(const string& name, float x, float y, float z)
+void Shader :: setUniform(UniformHandle handle, float x, float y, float z)
 {
-	GLint loc = getUniformLocation(name.c_str());
-	glUniform3f(loc, x, y, z);
+	setUniform(handle, glm::vec3(x, y, z));
 }
 
 //-----------------------------------------------------------------------------
 // Sets a glm::vec4 shader uniform
 //-----------------------------------------------------------------------------
-void Shader :: setUniform(const string& name, const glm::vec4& v)
+void Shader :: setUniform(UniformHandle handle, const glm::vec4& v)
 {
-	GLint loc = getUniformLocation(name.c_str());
-	glUniform4fv(loc, 1, &v[0]);
+	if (changed(handle, &v[0], sizeof(v)))
+		glUniform4fv(mUniforms[handle.index].location, 1, &v[0]);
 }
 
-void Shader :: setUniform(const string& name, float x, float y, float z, float w)
+void Shader :: setUniform(UniformHandle handle, float x, float y, float z, float w)
 {
-	GLint loc = getUniformLocation(name.c_str());
-	glUniform4f(loc, x, y, z, w);
+	setUniform(handle, glm::vec4(x, y, z, w));
 }
 
 //-----------------------------------------------------------------------------
 // Sets a glm::mat2 shader uniform
 //-----------------------------------------------------------------------------
-void Shader :: setUniform(const string& name, const glm::mat2& m)
+void Shader :: setUniform(UniformHandle handle, const glm::mat2& m)
 {
-	GLint loc = getUniformLocation(name.c_str());
-	glUniformMatrix2fv(loc, 1, GL_FALSE, &m[0][0]);
+	if (changed(handle, &m[0][0], sizeof(m)))
+		glUniformMatrix2fv(mUniforms[handle.index].location, 1, GL_FALSE, &m[0][0]);
 }
 
 //-----------------------------------------------------------------------------
 // Sets a glm::mat3 shader uniform
 //-----------------------------------------------------------------------------
-void Shader :: setUniform(const string& name, const glm::mat3& m)
+void Shader :: setUniform(UniformHandle handle, const glm::mat3& m)
 {
-	GLint loc = getUniformLocation(name.c_str());
-	glUniformMatrix3fv(loc, 1, GL_FALSE, &m[0][0]);
+	if (changed(handle, &m[0][0], sizeof(m)))
+		glUniformMatrix3fv(mUniforms[handle.index].location, 1, GL_FALSE, &m[0][0]);
 }
 
 //-----------------------------------------------------------------------------
 // Sets a glm::mat4 shader uniform
 //-----------------------------------------------------------------------------
-void Shader :: setUniform(const string& name, const glm::mat4& m)
-{
-	GLint loc = getUniformLocation(name.c_str());
-	glUniformMatrix4fv(loc, 1, GL_FALSE, &m[0][0]);
-}
-
-//-----------------------------------------------------------------------------
-// Returns the uniform identifier given it's string name.
-// NOTE: Shader must be currently active first.
-//-----------------------------------------------------------------------------
-GLint Shader :: getUniformLocation(const GLchar* name)
+void Shader :: setUniform(UniformHandle handle, const glm::mat4& m)
 {
-	std::map<string, GLint>::iterator it = mUniformLocations.find(name);
-
-	// Only need to query the shader program IF it doesn't already exist.
-	if (it == mUniformLocations.end())
-	{
-		// Find it and add it to the map
-		mUniformLocations[name] = glGetUniformLocation(mHandle, name);
-	}
-
-	// Return it
-	return mUniformLocations[name];
+	if (changed(handle, &m[0][0], sizeof(m)))
+		glUniformMatrix4fv(mUniforms[handle.index].location, 1, GL_FALSE, &m[0][0]);
 }
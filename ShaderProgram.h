@@ -2,9 +2,35 @@
 #define SHADER_H
 
 #include <string>
-#include <map>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <BlockLayout.h>
+
+//-----------------------------------------------------------------------------
+// FNV-1a of a uniform name, also usable at compile time
+//-----------------------------------------------------------------------------
+constexpr uint64_t UniformHash(const char* name)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (; *name; name++)
+		hash = (hash ^ (unsigned char) *name) * 1099511628211ull;
+	return hash;
+}
+
+//-----------------------------------------------------------------------------
+// Uniform of one Shader, resolved once with Shader::uniform.
+// Setting an invalid handle (unknown name) does nothing.
+//-----------------------------------------------------------------------------
+struct UniformHandle {
+	int index;
+
+	UniformHandle() : index(-1) {}
+	explicit UniformHandle(int index) : index(index) {}
+	bool valid() const { return index >= 0; }
+};
 
 class Shader {
 
@@ -23,6 +49,7 @@ public:
 		VERTEX,
 		FRAGMENT,
 		GEOMETRY,
+		COMPUTE,
 		PROGRAM
 	};
 
@@ -30,34 +57,77 @@ public:
 
 	GLuint ID() const;
 
+	// Changes with every link, unlike ID() which GL may hand out again after a delete
+	unsigned int Generation() const { return mGeneration; }
+
 	bool loadShaders(
 		const char* vsFilename,
 		const char* fsFilename,
 		const char* gsFilename = NULL);
 
-	void setUniform(const std::string& name, bool value);
-	void setUniform(const std::string& name, int value);
-	void setUniform(const std::string& name, float value);
-	void setUniform(const std::string& name, float x, float y);
-	void setUniform(const std::string& name, float x, float y, float z);
-	void setUniform(const std::string& name, float x, float y, float z, float w);
-	void setUniform(const std::string& name, const glm::vec2& v);
-	void setUniform(const std::string& name, const glm::vec3& v);
-	void setUniform(const std::string& name, const glm::vec4& v);
-	void setUniform(const std::string& name, const glm::mat2& m);
-	void setUniform(const std::string& name, const glm::mat3& m);
-	void setUniform(const std::string& name, const glm::mat4& m);
+	// A compute shader as the whole program (GL 4.3), run with glDispatchCompute
+	bool loadCompute(const char* csFilename);
+
+	// Handle of a uniform, active ones are known from link time
+	UniformHandle uniform(const char* name);
+
+	// Values are shadowed per program: setting what the uniform already holds
+	// makes no GL call. The shader must be in use, as for glUniform*
+	void setUniform(UniformHandle handle, bool value);
+	void setUniform(UniformHandle handle, int value);
+	void setUniform(UniformHandle handle, float value);
+	void setUniform(UniformHandle handle, float x, float y);
+	void setUniform(UniformHandle handle, float x, float y, float z);
+	void setUniform(UniformHandle handle, float x, float y, float z, float w);
+	void setUniform(UniformHandle handle, const glm::vec2& v);
+	void setUniform(UniformHandle handle, const glm::vec3& v);
+	void setUniform(UniformHandle handle, const glm::vec4& v);
+	void setUniform(UniformHandle handle, const glm::mat2& m);
+	void setUniform(UniformHandle handle, const glm::mat3& m);
+	void setUniform(UniformHandle handle, const glm::mat4& m);
+
+	// By name: a hash lookup, no allocation
+	template<class... Values>
+	void setUniform(const char* name, const Values&... values) { setUniform(uniform(name), values...); }
+	template<class... Values>
+	void setUniform(const std::string& name, const Values&... values) { setUniform(uniform(name.c_str()), values...); }
+
+	// "#pragma block <name>" lines of later loaded sources expand to this GLSL,
+	// e.g. BlockDeclaration<Block>(name). uFrame, uLights and the storage blocks
+	// of IndirectScene.h are always known
+	static void DeclareBlock(const std::string& name, const BlockSource& source);
+
+	// Uniform calls that reached GL / were dropped as unchanged, over every shader
+	static size_t UniformCalls();
+	static size_t UniformsDropped();
+	static void ResetUniformStats();
 
 private:
 
+	struct Uniform {
+		std::string name;
+		GLint location;   // -1 when not active: sets are dropped
+		bool known;       // value holds what the program has
+		GLuint value[16]; // last value sent, as bits
+	};
+
 	std::string fileToString(const std::string& filename);
+	std::string expandBlocks(const std::string& source, const std::string& filename);
 
 	void  checkCompileErrors(GLuint shader, ShaderType type);
 
-	GLint getUniformLocation(const GLchar * name);
-	
+	void introspect();
+	int addUniform(const std::string& name, GLint location);
+	bool changed(UniformHandle handle, const void* value, size_t bytes);
+
 	GLuint mHandle;
-	std::map<std::string, GLint> mUniformLocations;
+	unsigned int mGeneration;
+	std::vector<Uniform> mUniforms;
+	std::unordered_map<uint64_t, int> mUniformIndex; // by UniformHash(name)
+
+	static unsigned int sGenerations;
+	static size_t sUniformCalls;
+	static size_t sUniformsDropped;
 };
 
 #endif // SHADER_H
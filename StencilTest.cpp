@@ -17,6 +17,7 @@
 
 /** Shader Wrapper */
 #include <ShaderProgram.h>
+#include <GLState.h>
 
 /** Camera Wrapper */
 #include <EularCamera.h>
@@ -165,7 +166,7 @@ int main() {
 		glm::mat4 modelMatrix;
 
 		// Draw CountryHouse as normal, but don't write it to stencil buffer as we care about nanosuit only
-		glStencilMask(0x00); // Set mask to 0x00 to not write to stencil buffer
+		GLState::Shared().StencilMask(0x00); // Set mask to 0x00 to not write to stencil buffer
 		modelMatrix = glm::mat4(1.0f);
 		modelMatrix = glm::translate(modelMatrix, glm::vec3(5.0f, -5.0f, 10.0f));
 		modelMatrix = glm::scale(modelMatrix, glm::vec3(0.001f, 0.001f, 0.001f));
@@ -174,8 +175,8 @@ int main() {
 		objectCountryhouseModel.Draw(objectShader);
 
 		// Draw Nanosuit, writing to stencil buffer
-		glStencilFunc(GL_ALWAYS, 1, 0xFF);
-		glStencilMask(0xFF); // Enable writing to stencil buffer
+		GLState::Shared().StencilFunc(GL_ALWAYS, 1, 0xFF);
+		GLState::Shared().StencilMask(0xFF); // Enable writing to stencil buffer
 		modelMatrix = glm::mat4(1.0f);
 		modelMatrix = glm::translate(modelMatrix, glm::vec3(-7.0f, -4.5f, 12.0f));
 		modelMatrix = glm::scale(modelMatrix, glm::vec3(0.2f, 0.2f, 0.2f));
@@ -185,9 +186,9 @@ int main() {
 		// Then draw slightly scaled versions of Nanosuit, disabling stencil writing this time.
 		// As stencil buffer is now filled with several 1's, the parts of buffer that are 1 are not drawn,
 		// thus shader only draws size's difference, making which looks like borders.
-		glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-		glStencilMask(0x00); // Disable writing to stencil buffer
-		glDisable(GL_DEPTH_TEST);
+		GLState::Shared().StencilFunc(GL_NOTEQUAL, 1, 0xFF);
+		GLState::Shared().StencilMask(0x00); // Disable writing to stencil buffer
+		GLState::Shared().Disable(GL_DEPTH_TEST);
 		modelMatrix = glm::mat4(1.0f);
 		modelMatrix = glm::translate(modelMatrix, glm::vec3(-7.0f, -4.5f, 12.0f));
 		modelMatrix = glm::scale(modelMatrix, glm::vec3(0.201f, 0.201f, 0.201f));
@@ -198,8 +199,8 @@ int main() {
 
 
 		// Restore all configs to default
-		glStencilMask(0xFF); // Enable stencil buffer writing
-		glEnable(GL_DEPTH_TEST); // Enable depth testing
+		GLState::Shared().StencilMask(0xFF); // Enable stencil buffer writing
+		GLState::Shared().Enable(GL_DEPTH_TEST); // Enable depth testing
 
 
 
@@ -264,13 +265,13 @@ bool initOpenGL() {
 	//glViewport(0, 0, gWindowWidth, gWindowHeight);
 
 	// Depth testing
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LESS);
+	GLState::Shared().Enable(GL_DEPTH_TEST);
+	GLState::Shared().DepthFunc(GL_LESS);
 
 	// Stencil
-	glEnable(GL_STENCIL_TEST);
-	glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-	glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+	GLState::Shared().Enable(GL_STENCIL_TEST);
+	GLState::Shared().StencilFunc(GL_NOTEQUAL, 1, 0xFF);
+	GLState::Shared().StencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
 
 	// Hide the cursor and capture it
 	glfwSetInputMode(gWindow, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
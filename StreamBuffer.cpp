@@ -0,0 +1,182 @@
+#include <StreamBuffer.h>
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstring>
+
+StreamBuffer :: StreamBuffer(size_t frameBytes)
+	: mFrameBytes(frameBytes), mBuffer(0), mMapped(NULL), mRegion(0), mHead(0),
+	mUniformAlignment(256), mStorageAlignment(256), mStalls(0)
+{
+	for (unsigned int i=0; i<STREAM_BUFFER_FRAMES; i++) {
+		mFences[i] = 0;
+		mFrameRegions[i] = false;
+	}
+}
+
+StreamBuffer :: ~StreamBuffer() {
+
+	for (GLsync & fence : mFences)
+		if (fence)
+			glDeleteSync(fence);
+	if (mMapped) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	if (mBuffer)
+		glDeleteBuffers(1, &mBuffer);
+}
+
+StreamBuffer & StreamBuffer :: Shared() {
+	// Never destroyed: the mapping would outlive the context at static teardown
+	static StreamBuffer * stream = new StreamBuffer();
+	return *stream;
+}
+
+void StreamBuffer :: create() {
+
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (alignment > 0)
+		mUniformAlignment = alignment;
+	if (GLAD_GL_VERSION_4_3) {
+		alignment = 0;
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		if (alignment > 0)
+			mStorageAlignment = alignment;
+	}
+
+	size_t size = mFrameBytes * STREAM_BUFFER_FRAMES;
+	glGenBuffers(1, &mBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+	if (GLAD_GL_VERSION_4_4) {
+		// Mapped for good: coherent, so a memcpy is all an upload takes
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+		mMapped = (unsigned char *) glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+		if (!mMapped) {
+			// Immutable storage cannot be respecified: start over with a plain buffer
+			glDeleteBuffers(1, &mBuffer);
+			glGenBuffers(1, &mBuffer);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+		}
+	}
+	if (!mMapped)
+		glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+StreamRange StreamBuffer :: Upload(const void * data, size_t bytes, size_t alignment) {
+
+	StreamRange range = { 0, 0, bytes };
+	if (bytes == 0 || bytes > mFrameBytes)
+		return range;
+	if (!mBuffer)
+		create();
+	if (alignment == 0)
+		alignment = 1;
+
+	// Aligned in the buffer, not the region: region sizes need not be multiples of the alignment
+	size_t base = mRegion * mFrameBytes;
+	size_t position = (base + mHead + alignment - 1) / alignment * alignment;
+	if (position + bytes > base + mFrameBytes) {
+		// Went round the ring within one frame: its own ranges are still to be drawn
+		if (!advance(false))
+			return range;
+		base = mRegion * mFrameBytes;
+		position = (base + alignment - 1) / alignment * alignment;
+		if (position + bytes > base + mFrameBytes)
+			return range;
+	}
+
+	if (mMapped) {
+		std::memcpy(mMapped + position, data, bytes);
+	} else {
+		// The region's fence has passed: nothing to synchronize with
+		glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+		void * target = glMapBufferRange(GL_COPY_WRITE_BUFFER, position, bytes,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (target) {
+			std::memcpy(target, data, bytes);
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		if (!target)
+			return range;
+	}
+
+	mHead = position + bytes - base;
+	mFrameRegions[mRegion] = true;
+	range.buffer = mBuffer;
+	range.offset = position;
+	return range;
+}
+
+StreamRange StreamBuffer :: UploadUniform(const void * data, size_t bytes) {
+	if (!mBuffer)
+		create();
+	return Upload(data, bytes, mUniformAlignment);
+}
+
+StreamRange StreamBuffer :: UploadStorage(const void * data, size_t bytes) {
+	if (!mBuffer)
+		create();
+	return Upload(data, bytes, mStorageAlignment);
+}
+
+void StreamBuffer :: EndFrame() {
+
+	if (!mBuffer)
+		return;
+
+	// Draws of this frame read every region it wrote, not only the one it ends in
+	bool written = false;
+	for (unsigned int i=0; i<STREAM_BUFFER_FRAMES; i++) {
+		if (!mFrameRegions[i])
+			continue;
+		if (mFences[i])
+			glDeleteSync(mFences[i]);
+		mFences[i] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		mFrameRegions[i] = false;
+		written = true;
+	}
+	if (written)
+		advance(true);
+}
+
+bool StreamBuffer :: advance(bool frameEnd) {
+
+	// Regions of the frame in progress are fenced by EndFrame, after their last draw
+	unsigned int next = (mRegion + 1) % STREAM_BUFFER_FRAMES;
+	if (mFrameRegions[next])
+		return false;
+	mRegion = next;
+	mHead = 0;
+
+	GLsync fence = mFences[mRegion];
+	if (!fence)
+		return true;
+	mFences[mRegion] = 0;
+
+	if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+		mStalls++;
+		if (!mMapped && frameEnd) {
+			// Orphan rather than wait: draws in flight keep the old storage, every region is free again.
+			// Mid-frame this would drop what the frame already uploaded, so only at its end
+			glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+			glBufferData(GL_COPY_WRITE_BUFFER, mFrameBytes * STREAM_BUFFER_FRAMES, NULL, GL_STREAM_DRAW);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			for (GLsync & other : mFences) {
+				if (other)
+					glDeleteSync(other);
+				other = 0;
+			}
+		} else {
+			while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+		}
+	}
+	glDeleteSync(fence);
+	return true;
+}
@@ -0,0 +1,76 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+#define STREAM_BUFFER_FRAMES      3         // regions in flight: the CPU writes one while the GPU reads the others
+#define STREAM_BUFFER_FRAME_BYTES (1 << 20) // region size of StreamBuffer::Shared()
+
+/** Where an upload landed, valid until the frame ends. buffer is 0 when it did not fit a region */
+struct StreamRange {
+	GLuint buffer;
+	size_t offset; // bytes
+	size_t size;
+};
+
+/**
+* Ring of STREAM_BUFFER_FRAMES regions for data rewritten every frame: instance
+* data, uniform blocks, transient indices. One buffer serves every target
+* (glBindBufferRange, element / indirect / attribute offsets into Buffer()).
+*
+*   StreamRange range = StreamBuffer::Shared().UploadUniform(&block, sizeof(block));
+*   glBindBufferRange(GL_UNIFORM_BUFFER, binding, range.buffer, range.offset, range.size);
+*   ... draws ...
+*   StreamBuffer::Shared().EndFrame();
+*
+* GL 4.4: immutable storage mapped once (persistent, coherent), uploads are a
+* memcpy. Below: unsynchronized glMapBufferRange per upload. Either way a region
+* is only written again once the fence of its last use passed; on 3.3 a busy
+* region at frame end orphans the whole buffer instead of waiting. A full region
+* moves on by itself; EndFrame fences every region the frame wrote and keeps
+* frames from sharing regions. A frame that fills all of them gets empty ranges.
+* GL thread only, created by the first upload.
+*/
+class StreamBuffer {
+
+public:
+	explicit StreamBuffer(size_t frameBytes = STREAM_BUFFER_FRAME_BYTES);
+	~StreamBuffer();
+
+	/** Copies bytes at an offset that is a multiple of alignment */
+	StreamRange Upload(const void * data, size_t bytes, size_t alignment = 4);
+	/** At GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, for a uniform block range */
+	StreamRange UploadUniform(const void * data, size_t bytes);
+	/** At GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, for a storage block range (GL 4.3) */
+	StreamRange UploadStorage(const void * data, size_t bytes);
+
+	/** Fences what this frame wrote and moves to the next region, once per frame after its draws */
+	void EndFrame();
+
+	GLuint Buffer() const { return mBuffer; }
+	/** Persistently mapped (GL 4.4) */
+	bool Persistent() const { return mMapped != NULL; }
+	/** Times a region was still in use by the GPU when its turn came */
+	size_t Stalls() const { return mStalls; }
+
+	static StreamBuffer & Shared();
+
+private:
+	size_t mFrameBytes;
+	GLuint mBuffer;
+	unsigned char * mMapped;          // whole buffer, NULL without persistent mapping
+	GLsync mFences[STREAM_BUFFER_FRAMES];
+	unsigned int mRegion;
+	size_t mHead;                     // bytes used in the current region
+	bool mFrameRegions[STREAM_BUFFER_FRAMES]; // written by the frame in progress, fenced by EndFrame
+	size_t mUniformAlignment, mStorageAlignment;
+	size_t mStalls;
+
+	void create();
+	/** Moves to the next region once its fence passed, false when the frame in progress wrote it */
+	bool advance(bool frameEnd);
+};
+
+#endif
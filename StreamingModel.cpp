@@ -0,0 +1,603 @@
+#include <StreamingModel.h>
+#include <GLState.h>
+#include <Model.h>
+#include <Mesh.h>
+#include <MeshCache.h>
+#include <Meshlet.h>
+#include <MappedFile.h>
+#include <ThreadPool.h>
+#include <TextureRegistry.h>
+#include <VertexPacking.h>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+static const char STREAMING_MAGIC[8] = { 'L', 'O', 'G', 'L', 'C', 'E', 'L', '\0' };
+
+struct StreamingHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t vertexSize; // sizeof(Vertex) of the build that cooked the cells
+	uint32_t options;    // Model::CacheOptions
+	uint32_t numCells;
+	float cellSize;      // as requested, 0 for automatic
+	uint32_t numDependencies; // MeshSourceDependencies records after the cell table
+	int64_t sourceTime;  // FileStamp of the source when the cells were cooked
+	uint64_t sourceSize;
+};
+
+struct StreamingCellEntry {
+	float low[3];
+	float high[3];
+	uint64_t offset;
+	uint64_t size;
+	uint32_t numMeshes;
+	uint32_t reserved;
+};
+
+static std::string cellsPath(const std::string & source) {
+	return source + ".cells";
+}
+
+/** Path and type: the type picks format and mip filter, the registry keeps one texture per pair */
+static std::string textureKey(const Texture & texture) {
+	return texture.path + "|" + std::to_string((int) texture.type);
+}
+
+/** GPU bytes of every level of a 2D texture */
+static size_t textureMemory(GLuint id) {
+
+	GLState::Shared().BindTexture(GL_TEXTURE_2D, id);
+
+	size_t bytes = 0;
+	for (GLint level=0; level<32; level++) {
+		GLint width = 0, height = 0, compressed = 0;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+		if (width == 0 || height == 0)
+			break;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED, &compressed);
+		if (compressed) {
+			GLint size = 0;
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+			bytes += size;
+		} else {
+			bytes += (size_t) width * height * 4; // drivers pad RGB8 to 4 bytes anyway
+		}
+	}
+
+	return bytes;
+}
+
+StreamingModel :: StreamingModel(std::string path, bool gamma, unsigned int flags,
+	const StreamingSettings & settings, const LodSettings & lodSettings)
+	: gammaCorrection(gamma), flags(flags), mSettings(settings),
+	mGeometryBytes(0), mTextureBytes(0), mLoads(0), mEvictions(0), mDeferred(0)
+{
+	directory = path.substr(0, path.find_last_of('/')) + "/";
+
+	// Only the cell table is read here, geometry comes with Update()
+	std::string cells = cellsPath(path);
+	unsigned int options = Model::CacheOptions(flags, lodSettings);
+	if (!open(cells, options)) {
+		if (!Cook(path, flags, settings, lodSettings) || !open(cells, options)) {
+			std::cerr << "StreamingModel: unable to stream " << path << "\n";
+			return;
+		}
+	}
+
+	std::cout << "StreamingModel: " << directory << " (" << mCells.size() << " cells)\n";
+}
+
+StreamingModel :: ~StreamingModel() {
+	for (Cell & cell : mCells) {
+		if (cell.state == CELL_LOADING)
+			cell.pending.wait(); // the task reads the mapping
+		if (cell.state == CELL_RESIDENT)
+			evict(cell);
+	}
+}
+
+bool StreamingModel :: open(const std::string & cells, unsigned int options) {
+
+	std::string source = cells.substr(0, cells.size() - std::strlen(".cells"));
+
+	mFile.Close();
+	if (!mFile.Open(cells) || mFile.Size() < sizeof(StreamingHeader))
+		return false;
+
+	StreamingHeader header;
+	std::memcpy(&header, mFile.Data(), sizeof(header));
+	bool valid = std::memcmp(header.magic, STREAMING_MAGIC, sizeof(STREAMING_MAGIC)) == 0
+		&& header.version == STREAMING_VERSION
+		&& header.vertexSize == sizeof(Vertex)
+		&& header.options == options
+		&& header.cellSize == mSettings.cellSize
+		&& GetFileStamp(source) == FileStamp{ header.sourceTime, header.sourceSize }
+		&& mFile.Size() >= sizeof(header) + (size_t) header.numCells * sizeof(StreamingCellEntry);
+	if (valid) {
+		// Texture paths of the cells come from the MTL: its edits make them stale too
+		const unsigned char * ptr = mFile.Data() + sizeof(header) + (size_t) header.numCells * sizeof(StreamingCellEntry);
+		valid = CheckMeshDependencies(source, header.numDependencies, ptr, mFile.Data() + mFile.Size());
+	}
+	if (!valid) {
+		mFile.Close();
+		return false;
+	}
+
+	const StreamingCellEntry * entries = (const StreamingCellEntry *) (mFile.Data() + sizeof(header));
+	mCells.clear();
+	mCells.resize(header.numCells);
+	for (uint32_t i=0; i<header.numCells; i++) {
+		const StreamingCellEntry & entry = entries[i];
+		Cell & cell = mCells[i];
+		cell.low  = glm::vec3(entry.low[0], entry.low[1], entry.low[2]);
+		cell.high = glm::vec3(entry.high[0], entry.high[1], entry.high[2]);
+		cell.offset = entry.offset;
+		cell.size = entry.size;
+		cell.geometryBytes = 0;
+		cell.state = CELL_UNLOADED;
+		cell.distance = 0.0f;
+		if (entry.offset + entry.size > mFile.Size()) {
+			std::cerr << "StreamingModel: corrupt cell file " << cells << "\n";
+			mCells.clear();
+			mFile.Close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+
+
+
+/*************************************************
+*
+* Cook
+*
+*************************************************/
+
+bool StreamingModel :: Cook(const std::string & source, unsigned int flags, const StreamingSettings & settings,
+	const LodSettings & lodSettings) {
+
+	// Raw import: pieces are optimized, simplified and clustered once cut
+	std::vector<MeshData> meshes;
+	if (!Model::Import(source, flags & ~(MODEL_OPTIMIZE | MODEL_LOD | MODEL_MESHLETS), lodSettings, meshes))
+		return false;
+
+	glm::vec3 low(0.0f), high(0.0f);
+	bool first = true;
+	for (const MeshData & mesh : meshes)
+		for (const Vertex & vertex : mesh.vertices) {
+			low  = first ? vertex.position : glm::min(low, vertex.position);
+			high = first ? vertex.position : glm::max(high, vertex.position);
+			first = false;
+		}
+
+	glm::vec3 extent = high - low;
+	float longest = std::max(extent.x, std::max(extent.y, extent.z));
+	float cellSize = settings.cellSize > 0.0f ? settings.cellSize : longest / STREAMING_AUTO_CELLS;
+	if (cellSize <= 0.0f)
+		cellSize = 1.0f;
+
+	int dims[3];
+	for (int a=0; a<3; a++)
+		dims[a] = std::min(std::max((int) std::ceil(extent[a] / cellSize), 1), 256);
+	size_t cellCount = (size_t) dims[0] * dims[1] * dims[2];
+
+	// Cut every mesh by triangle centroid, one piece per (mesh, cell)
+	std::vector<std::vector<MeshData> > cells(cellCount);
+	std::vector<unsigned int> remap;
+
+	for (const MeshData & mesh : meshes) {
+
+		size_t triangles = mesh.indices.size() / 3;
+		std::vector<unsigned int> cellOf(triangles);
+		for (size_t t=0; t<triangles; t++) {
+			glm::vec3 centroid = (mesh.vertices[mesh.indices[t * 3]].position
+				+ mesh.vertices[mesh.indices[t * 3 + 1]].position
+				+ mesh.vertices[mesh.indices[t * 3 + 2]].position) / 3.0f;
+			size_t cell = 0;
+			for (int a=2; a>=0; a--) {
+				int c = (int) ((centroid[a] - low[a]) / cellSize);
+				cell = cell * dims[a] + std::min(std::max(c, 0), dims[a] - 1);
+			}
+			cellOf[t] = (unsigned int) cell;
+		}
+
+		std::vector<unsigned int> order(triangles);
+		for (size_t t=0; t<triangles; t++)
+			order[t] = (unsigned int) t;
+		std::stable_sort(order.begin(), order.end(), [&](unsigned int x, unsigned int y) {
+			return cellOf[x] < cellOf[y];
+		});
+
+		remap.assign(mesh.vertices.size(), ~0u);
+		for (size_t begin=0; begin<triangles; ) {
+
+			unsigned int cell = cellOf[order[begin]];
+			MeshData piece;
+			piece.textures = mesh.textures;
+
+			size_t end = begin;
+			for (; end<triangles && cellOf[order[end]] == cell; end++) {
+				for (int j=0; j<3; j++) {
+					unsigned int index = mesh.indices[order[end] * 3 + j];
+					if (remap[index] == ~0u) {
+						remap[index] = (unsigned int) piece.vertices.size();
+						piece.vertices.push_back(mesh.vertices[index]);
+					}
+					piece.indices.push_back(remap[index]);
+				}
+			}
+			for (size_t t=begin; t<end; t++)
+				for (int j=0; j<3; j++)
+					remap[mesh.indices[order[t] * 3 + j]] = ~0u;
+
+			cells[cell].push_back(std::move(piece));
+			begin = end;
+		}
+	}
+
+	std::vector<MeshData *> pieces;
+	for (std::vector<MeshData> & cell : cells)
+		for (MeshData & piece : cell)
+			pieces.push_back(&piece);
+
+	auto cook = [&](size_t i) { Model::CookMesh(*pieces[i], flags, lodSettings); };
+	if (flags & MODEL_PARALLEL) {
+		ThreadPool::Shared().ParallelFor(pieces.size(), cook);
+	} else {
+		for (size_t i=0; i<pieces.size(); i++)
+			cook(i);
+	}
+
+	// Empty cells are not stored
+	std::vector<StreamingCellEntry> entries;
+	std::vector<size_t> stored;
+	for (size_t c=0; c<cellCount; c++) {
+		if (cells[c].empty())
+			continue;
+		StreamingCellEntry entry;
+		std::memset(&entry, 0, sizeof(entry));
+		glm::vec3 cellLow = cells[c][0].vertices[0].position, cellHigh = cellLow;
+		for (const MeshData & piece : cells[c])
+			for (const Vertex & vertex : piece.vertices) {
+				cellLow  = glm::min(cellLow, vertex.position);
+				cellHigh = glm::max(cellHigh, vertex.position);
+			}
+		for (int a=0; a<3; a++) {
+			entry.low[a] = cellLow[a];
+			entry.high[a] = cellHigh[a];
+		}
+		entry.numMeshes = (uint32_t) cells[c].size();
+		entries.push_back(entry);
+		stored.push_back(c);
+	}
+
+	std::string path = cellsPath(source);
+	std::string temp = UniqueTempPath(path);
+	std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+	if (!out.is_open()) {
+		std::cerr << "StreamingModel::Cook: unable to write " << temp << "\n";
+		return false;
+	}
+
+	StreamingHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, STREAMING_MAGIC, sizeof(STREAMING_MAGIC));
+	header.version    = STREAMING_VERSION;
+	header.vertexSize = sizeof(Vertex);
+	header.options    = Model::CacheOptions(flags, lodSettings);
+	header.numCells   = (uint32_t) entries.size();
+	header.cellSize   = settings.cellSize;
+	std::vector<std::string> dependencies = MeshSourceDependencies(source);
+	FileStamp stamp   = GetFileStamp(source);
+	header.numDependencies = (uint32_t) dependencies.size();
+	header.sourceTime = stamp.time;
+	header.sourceSize = stamp.size;
+	out.write((const char *) &header, sizeof(header));
+	out.write((const char *) entries.data(), entries.size() * sizeof(StreamingCellEntry)); // offsets below
+	WriteMeshDependencies(out, source, dependencies);
+
+	for (size_t i=0; i<stored.size(); i++) {
+		entries[i].offset = (uint64_t) out.tellp();
+		for (const MeshData & piece : cells[stored[i]])
+			WriteMeshData(out, piece);
+		entries[i].size = (uint64_t) out.tellp() - entries[i].offset;
+	}
+
+	out.seekp(sizeof(header));
+	out.write((const char *) entries.data(), entries.size() * sizeof(StreamingCellEntry));
+	out.close();
+	if (!out) {
+		std::remove(temp.c_str());
+		std::cerr << "StreamingModel::Cook: failed writing " << temp << "\n";
+		return false;
+	}
+
+	std::remove(path.c_str()); // rename does not overwrite on Windows
+	if (std::rename(temp.c_str(), path.c_str()) != 0) {
+		std::remove(temp.c_str());
+		return false;
+	}
+
+	std::cout << "StreamingModel::Cook: " << source << ": " << entries.size() << " cells of "
+		<< dims[0] << "x" << dims[1] << "x" << dims[2] << ", cell size " << cellSize << "\n";
+	return true;
+}
+
+
+
+
+
+/*************************************************
+*
+* Residency
+*
+*************************************************/
+
+void StreamingModel :: Update(const glm::vec3 & eye, const glm::mat4 & modelMatrix) {
+
+	if (!mFile.IsOpen())
+		return;
+
+	// Distances in model space, scaled back to world units
+	glm::vec3 localEye = glm::vec3(glm::inverse(modelMatrix) * glm::vec4(eye, 1.0f));
+	float scale = std::max(glm::length(glm::vec3(modelMatrix[0])),
+		std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+	for (Cell & cell : mCells) {
+		glm::vec3 outside = glm::max(glm::max(cell.low - localEye, localEye - cell.high), glm::vec3(0.0f));
+		cell.distance = glm::length(outside) * scale;
+	}
+
+	// Loads that landed since the last frame
+	size_t loading = 0, loadingBytes = 0;
+	for (Cell & cell : mCells) {
+		if (cell.state != CELL_LOADING)
+			continue;
+		if (cell.pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+			finishLoad(cell);
+		} else {
+			loading++;
+			loadingBytes += cell.geometryBytes ? cell.geometryBytes : (size_t) cell.size;
+		}
+	}
+	resolveTextures();
+
+	for (Cell & cell : mCells)
+		if (cell.state == CELL_RESIDENT && cell.distance > mSettings.loadDistance * STREAMING_UNLOAD_FACTOR)
+			evict(cell);
+
+	std::vector<Cell *> wanted;
+	for (Cell & cell : mCells)
+		if (cell.state == CELL_UNLOADED && cell.distance <= mSettings.loadDistance)
+			wanted.push_back(&cell);
+	std::sort(wanted.begin(), wanted.end(), [](const Cell * x, const Cell * y) {
+		return x->distance < y->distance;
+	});
+
+	mDeferred = 0;
+	for (size_t i=0; i<wanted.size(); i++) {
+
+		if (loading >= STREAMING_MAX_LOADS)
+			break;
+
+		Cell & cell = *wanted[i];
+		// Cooked bytes until the first load measured the real cost (packed vertices are smaller)
+		size_t estimate = cell.geometryBytes ? cell.geometryBytes : (size_t) cell.size;
+
+		// Make room with resident cells farther away than this one, farthest first
+		while (mGeometryBytes + mTextureBytes + loadingBytes + estimate > mSettings.budgetBytes) {
+			Cell * farthest = NULL;
+			for (Cell & other : mCells)
+				if (other.state == CELL_RESIDENT && other.distance > cell.distance
+					&& (!farthest || other.distance > farthest->distance))
+					farthest = &other;
+			if (!farthest)
+				break;
+			evict(*farthest);
+		}
+
+		if (mGeometryBytes + mTextureBytes + loadingBytes + estimate > mSettings.budgetBytes) {
+			mDeferred = wanted.size() - i;
+			break;
+		}
+
+		const unsigned char * begin = mFile.Data() + cell.offset;
+		const unsigned char * end = begin + cell.size;
+		cell.pending = ThreadPool::Shared().Submit([begin, end]() {
+			std::vector<MeshData> meshes;
+			const unsigned char * ptr = begin;
+			while (ptr < end) {
+				meshes.emplace_back();
+				if (!ReadMeshData(ptr, end, meshes.back())) {
+					meshes.pop_back();
+					break;
+				}
+			}
+			return meshes;
+		});
+		cell.state = CELL_LOADING;
+		loading++;
+		loadingBytes += estimate;
+	}
+}
+
+void StreamingModel :: UpdateLod(const Camera & camera, const glm::mat4 & modelMatrix, float viewportHeight) {
+	if (!(flags & MODEL_LOD))
+		return;
+	for (Cell & cell : mCells)
+		Model::SelectLods(cell.meshes, camera, modelMatrix, viewportHeight);
+}
+
+void StreamingModel :: finishLoad(Cell & cell) {
+
+	std::vector<MeshData> data = cell.pending.get();
+	VertexFormat format = (flags & MODEL_FULL_VERTICES) ? VERTEX_FULL : VERTEX_PACKED;
+	MeshStorage storage = (flags & MODEL_OWN_BUFFERS) ? MESH_OWN_BUFFERS : MESH_ARENA;
+
+	size_t bytes = 0;
+	cell.meshes.reserve(data.size());
+	for (MeshData & mesh : data) {
+
+		size_t indexCount = mesh.indices.size();
+		for (const MeshLod & lod : mesh.lods)
+			indexCount += lod.indices.size();
+		bytes += mesh.vertices.size() * VertexStride(format)
+			+ indexCount * (mesh.vertices.size() <= 65536 ? sizeof(GLushort) : sizeof(GLuint));
+
+		// Textures shared by the cells come from one registry reference
+		std::vector<Texture> textures;
+		for (const Texture & reference : mesh.textures) {
+			if (reference.path.empty()) {
+				textures.push_back(DefaultTexture(reference.type));
+				continue;
+			}
+			std::string key = textureKey(reference);
+			auto found = mTextures.find(key);
+			if (found == mTextures.end()) {
+				TextureRef ref = TextureRegistry::Shared().Acquire(directory + reference.path,
+					gammaCorrection, reference.type, (flags & MODEL_ASYNC_TEXTURES) != 0);
+				if (!ref)
+					continue;
+				found = mTextures.emplace(key, StreamedTexture{ref, 0, 0}).first;
+			}
+			found->second.users++;
+			textures.push_back(Texture{found->second.ref->id, reference.type, reference.path});
+		}
+
+		cell.meshes.emplace_back(std::move(mesh.vertices), std::move(mesh.indices), std::move(textures),
+			format, storage, mesh.lods, std::move(mesh.meshlets));
+		cell.meshes.back().ReleaseCpuData();
+	}
+
+	cell.geometryBytes = bytes;
+	cell.state = CELL_RESIDENT;
+	mGeometryBytes += bytes;
+	mLoads++;
+}
+
+void StreamingModel :: evict(Cell & cell) {
+
+	for (Mesh & mesh : cell.meshes) {
+		for (const Texture & texture : mesh.textures) {
+			if (texture.path.empty())
+				continue;
+			auto found = mTextures.find(textureKey(texture));
+			if (found == mTextures.end())
+				continue;
+			if (--found->second.users == 0) {
+				mTextureBytes -= found->second.bytes;
+				mTextures.erase(found); // the registry deletes it with its last reference
+			}
+		}
+		mesh.DeleteBuffers();
+	}
+
+	cell.meshes.clear();
+	cell.state = CELL_UNLOADED;
+	mGeometryBytes -= cell.geometryBytes;
+	mEvictions++;
+}
+
+void StreamingModel :: resolveTextures() {
+
+	/**
+	* Count uploads that landed and swap them in for the placeholders
+	*/
+
+	for (auto & entry : mTextures) {
+
+		StreamedTexture & texture = entry.second;
+		if (texture.bytes != 0 || !texture.ref->Ready())
+			continue;
+
+		texture.bytes = textureMemory(texture.ref->id);
+		mTextureBytes += texture.bytes;
+
+		for (Cell & cell : mCells)
+			for (Mesh & mesh : cell.meshes)
+				for (Texture & slot : mesh.textures)
+					if (!slot.path.empty() && textureKey(slot) == entry.first)
+						slot.id = texture.ref->id;
+	}
+}
+
+void StreamingModel :: Draw(Shader & shader) {
+
+	shader.use();
+	for (Cell & cell : mCells)
+		for (Mesh & mesh : cell.meshes)
+			mesh.Draw(shader);
+}
+
+size_t StreamingModel :: DrawCulled(Shader & shader, const glm::mat4 & viewProjection, const glm::mat4 & modelMatrix,
+	const glm::vec3 & eye, unsigned int cull) {
+
+	Frustum frustum = ExtractFrustum(viewProjection * modelMatrix);
+	glm::vec3 localEye = glm::vec3(glm::inverse(modelMatrix) * glm::vec4(eye, 1.0f));
+
+	shader.use();
+	size_t drawn = 0;
+	for (Cell & cell : mCells) {
+		if (cell.meshes.empty())
+			continue;
+		if ((cull & CLUSTER_CULL_FRUSTUM)
+			&& !SphereInFrustum(frustum, (cell.low + cell.high) * 0.5f, glm::length(cell.high - cell.low) * 0.5f))
+			continue;
+		for (Mesh & mesh : cell.meshes)
+			drawn += mesh.DrawClusters(shader, frustum, localEye, cull);
+	}
+	return drawn;
+}
+
+void StreamingModel :: Submit(RenderQueue & queue, Shader & shader, const glm::mat4 & modelMatrix,
+	RenderPass pass, unsigned int cull) {
+
+	uint32_t transform = queue.AddTransform(modelMatrix, cull);
+	Frustum frustum = ExtractFrustum(queue.ViewProjection() * modelMatrix);
+	for (Cell & cell : mCells) {
+		if (cell.meshes.empty())
+			continue;
+		if ((cull & CLUSTER_CULL_FRUSTUM)
+			&& !SphereInFrustum(frustum, (cell.low + cell.high) * 0.5f, glm::length(cell.high - cell.low) * 0.5f))
+			continue;
+		for (Mesh & mesh : cell.meshes)
+			queue.Add(mesh, shader, transform, pass);
+	}
+}
+
+StreamingStats StreamingModel :: Stats() const {
+
+	StreamingStats stats;
+	stats.cells = mCells.size();
+	stats.resident = 0;
+	stats.loading = 0;
+	for (const Cell & cell : mCells) {
+		if (cell.state == CELL_RESIDENT)
+			stats.resident++;
+		else if (cell.state == CELL_LOADING)
+			stats.loading++;
+	}
+	stats.geometryBytes = mGeometryBytes;
+	stats.textureBytes = mTextureBytes;
+	stats.budgetBytes = mSettings.budgetBytes;
+	stats.loads = mLoads;
+	stats.evictions = mEvictions;
+	stats.deferred = mDeferred;
+	return stats;
+}
@@ -0,0 +1,127 @@
+#ifndef STREAMING_MODEL_H
+#define STREAMING_MODEL_H
+
+#include <vector>
+#include <string>
+#include <future>
+#include <cstdint>
+#include <unordered_map>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <ShaderProgram.h>
+#include <Mesh.h>
+#include <Model.h>
+#include <MappedFile.h>
+#include <TextureRegistry.h>
+
+/**
+* Cell file, stored next to the model source as "<source>.cells":
+*   StreamingHeader, StreamingCellEntry[numCells], the stamps of the source's
+*   dependencies (see WriteMeshDependencies), per cell its meshes in the mesh
+*   cache layout (see WriteMeshData), each cell starting 4-byte aligned.
+*/
+
+#define STREAMING_VERSION 2
+#define STREAMING_AUTO_CELLS 8    // cells along the longest axis when StreamingSettings::cellSize is 0
+#define STREAMING_MAX_LOADS 4     // cells decoding in the background at once
+#define STREAMING_UNLOAD_FACTOR 1.25f // resident cells are dropped past this many load distances
+
+struct StreamingSettings {
+	size_t budgetBytes = 256u << 20; // GPU geometry + textures of the resident cells
+	float loadDistance = 60.0f;      // world units between the eye and a cell box, farther cells stay unloaded
+	float cellSize = 0.0f;           // cook time, in model units
+};
+
+struct StreamingStats {
+	size_t cells;
+	size_t resident;
+	size_t loading;
+	size_t geometryBytes; // resident
+	size_t textureBytes;  // resident, every texture counted once
+	size_t budgetBytes;
+	size_t loads;         // since creation
+	size_t evictions;
+	size_t deferred;      // wanted cells the budget kept out during the last Update
+};
+
+/**
+* Model cut into a grid of spatial cells at cook time, every cell loaded and
+* dropped on its own at runtime:
+*   - Update() ranks cells by distance to the eye, decodes the near ones on the
+*     worker pool and uploads them when ready (GL thread), farthest first out
+*     when the budget is exceeded;
+*   - a cell's GPU geometry and its textures (shared between cells) are its cost,
+*     meshes drop their CPU copy once uploaded.
+* Triangles go to the cell holding their centroid; cell boxes are the bounds of
+* what they actually hold. Import flags are the Model ones.
+*/
+class StreamingModel {
+
+public:
+	StreamingModel(std::string path, bool gamma = false, unsigned int flags = MODEL_DEFAULT,
+		const StreamingSettings & settings = StreamingSettings(),
+		const LodSettings & lodSettings = LodSettings());
+	~StreamingModel();
+
+	/** Residency for an eye position in world space. GL thread, once per frame */
+	void Update(const glm::vec3 & eye, const glm::mat4 & modelMatrix);
+	/** Model::UpdateLod for the resident cells */
+	void UpdateLod(const Camera & camera, const glm::mat4 & modelMatrix, float viewportHeight);
+
+	void Draw(Shader & shader);
+	size_t DrawCulled(Shader & shader, const glm::mat4 & viewProjection, const glm::mat4 & modelMatrix,
+		const glm::vec3 & eye, unsigned int cull = CLUSTER_CULL_FRUSTUM);
+	/** Queues the meshes of the resident cells in view, see Model::Submit */
+	void Submit(RenderQueue & queue, Shader & shader, const glm::mat4 & modelMatrix,
+		RenderPass pass = RENDER_OPAQUE, unsigned int cull = CLUSTER_CULL_FRUSTUM);
+
+	StreamingStats Stats() const;
+	void SetBudget(size_t bytes) { mSettings.budgetBytes = bytes; }
+
+	/** Cooks "<source>.cells" from the model source. No GL involved */
+	static bool Cook(const std::string & source, unsigned int flags, const StreamingSettings & settings,
+		const LodSettings & lodSettings);
+
+private:
+	enum CellState {
+		CELL_UNLOADED,
+		CELL_LOADING,
+		CELL_RESIDENT
+	};
+
+	struct Cell {
+		glm::vec3 low, high;   // model space
+		uint64_t offset;       // into the cell file
+		uint64_t size;
+		size_t geometryBytes;  // GPU vertex + index bytes once resident
+		CellState state;
+		float distance;        // world units, last Update
+		std::future<std::vector<MeshData> > pending;
+		std::vector<Mesh> meshes;
+	};
+
+	struct StreamedTexture {
+		TextureRef ref;
+		size_t bytes;          // 0 until the upload landed
+		unsigned int users;    // resident meshes referencing it
+	};
+
+	std::string directory;
+	bool gammaCorrection;
+	unsigned int flags;
+	StreamingSettings mSettings;
+	MappedFile mFile;
+	std::vector<Cell> mCells;
+	std::unordered_map<std::string, StreamedTexture> mTextures; // by textureKey
+	size_t mGeometryBytes, mTextureBytes;
+	size_t mLoads, mEvictions, mDeferred;
+
+	bool open(const std::string & cells, unsigned int options);
+	void finishLoad(Cell & cell);
+	void evict(Cell & cell);
+	void resolveTextures();
+};
+
+#endif
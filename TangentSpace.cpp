@@ -0,0 +1,239 @@
+#include <TangentSpace.h>
+#include <Mesh.h>
+#include <ThreadPool.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TANGENT_SSE2 1
+#include <emmintrin.h>
+#endif
+
+/** Per triangle frame: unit tangent and UV orientation, sign 0 when the UVs or positions are degenerate */
+struct FaceTangent {
+	float x, y, z;
+	float sign;
+};
+
+static void faceTangent(const Vertex & a, const Vertex & b, const Vertex & c, FaceTangent & face) {
+
+	glm::vec3 d1 = b.position - a.position, d2 = c.position - a.position;
+	glm::vec2 t1 = b.texCoords - a.texCoords, t2 = c.texCoords - a.texCoords;
+
+	float area = t1.x * t2.y - t1.y * t2.x;
+	glm::vec3 os = d1 * t2.y - d2 * t1.y;
+	float length2 = glm::dot(os, os);
+
+	if (!(std::fabs(area) > FLT_MIN) || !(length2 > FLT_MIN)) {
+		face = FaceTangent{0.0f, 0.0f, 0.0f, 0.0f};
+		return;
+	}
+
+	float sign = area > 0.0f ? 1.0f : -1.0f;
+	float scale = sign / std::sqrt(length2);
+	face = FaceTangent{os.x * scale, os.y * scale, os.z * scale, sign};
+}
+
+/** Triangles [first, first + count) */
+static void faceTangents(const std::vector<Vertex> & vertices, const std::vector<unsigned int> & indices,
+	size_t first, size_t count, FaceTangent * faces) {
+
+	size_t i = 0;
+
+#ifdef TANGENT_SSE2
+	// Same arithmetic as faceTangent, one triangle per lane
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 minimum = _mm_set1_ps(FLT_MIN);
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+	for (; i + 4 <= count; i += 4) {
+
+		alignas(16) float p[3][3][4], t[3][2][4]; // corner, component, lane
+		for (int lane=0; lane<4; lane++) {
+			const unsigned int * triangle = &indices[(first + i + lane) * 3];
+			for (int k=0; k<3; k++) {
+				const Vertex & vertex = vertices[triangle[k]];
+				p[k][0][lane] = vertex.position.x;
+				p[k][1][lane] = vertex.position.y;
+				p[k][2][lane] = vertex.position.z;
+				t[k][0][lane] = vertex.texCoords.x;
+				t[k][1][lane] = vertex.texCoords.y;
+			}
+		}
+
+		__m128 os[3];
+		__m128 t1x = _mm_sub_ps(_mm_load_ps(t[1][0]), _mm_load_ps(t[0][0]));
+		__m128 t1y = _mm_sub_ps(_mm_load_ps(t[1][1]), _mm_load_ps(t[0][1]));
+		__m128 t2x = _mm_sub_ps(_mm_load_ps(t[2][0]), _mm_load_ps(t[0][0]));
+		__m128 t2y = _mm_sub_ps(_mm_load_ps(t[2][1]), _mm_load_ps(t[0][1]));
+		for (int c=0; c<3; c++) {
+			__m128 d1 = _mm_sub_ps(_mm_load_ps(p[1][c]), _mm_load_ps(p[0][c]));
+			__m128 d2 = _mm_sub_ps(_mm_load_ps(p[2][c]), _mm_load_ps(p[0][c]));
+			os[c] = _mm_sub_ps(_mm_mul_ps(d1, t2y), _mm_mul_ps(d2, t1y));
+		}
+
+		__m128 area = _mm_sub_ps(_mm_mul_ps(t1x, t2y), _mm_mul_ps(t1y, t2x));
+		__m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(os[0], os[0]), _mm_mul_ps(os[1], os[1])),
+			_mm_mul_ps(os[2], os[2]));
+		__m128 valid = _mm_and_ps(_mm_cmpgt_ps(_mm_and_ps(area, absMask), minimum), _mm_cmpgt_ps(length2, minimum));
+
+		__m128 positive = _mm_cmpgt_ps(area, zero);
+		__m128 sign = _mm_or_ps(_mm_and_ps(positive, one), _mm_andnot_ps(positive, _mm_sub_ps(zero, one)));
+		__m128 scale = _mm_and_ps(valid, _mm_div_ps(sign, _mm_sqrt_ps(length2)));
+
+		alignas(16) float out[4][4];
+		_mm_store_ps(out[0], _mm_mul_ps(os[0], scale));
+		_mm_store_ps(out[1], _mm_mul_ps(os[1], scale));
+		_mm_store_ps(out[2], _mm_mul_ps(os[2], scale));
+		_mm_store_ps(out[3], _mm_and_ps(valid, sign));
+		for (int lane=0; lane<4; lane++)
+			faces[i + lane] = FaceTangent{out[0][lane], out[1][lane], out[2][lane], out[3][lane]};
+	}
+#endif
+
+	for (; i<count; i++) {
+		const unsigned int * triangle = &indices[(first + i) * 3];
+		faceTangent(vertices[triangle[0]], vertices[triangle[1]], vertices[triangle[2]], faces[i]);
+	}
+}
+
+/** Any unit vector perpendicular to n */
+static glm::vec3 perpendicular(const glm::vec3 & n) {
+	glm::vec3 axis = std::fabs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::vec3 t = axis - n * glm::dot(n, axis);
+	float length = glm::length(t);
+	return length > FLT_MIN ? t / length : glm::vec3(1.0f, 0.0f, 0.0f);
+}
+
+static glm::vec3 projectNormalized(const glm::vec3 & v, const glm::vec3 & n) {
+	glm::vec3 p = v - n * glm::dot(n, v);
+	float length = glm::length(p);
+	return length > FLT_MIN ? p / length : glm::vec3(0.0f);
+}
+
+void GenerateTangents(std::vector<Vertex> & vertices, std::vector<unsigned int> & indices, bool parallel) {
+
+	size_t triangleCount = indices.size() / 3;
+	size_t vertexCount = vertices.size();
+	if (vertexCount == 0)
+		return;
+
+	auto run = [parallel](size_t count, const std::function<void(size_t, size_t)> & body) {
+		size_t blocks = (count + TANGENT_BLOCK - 1) / TANGENT_BLOCK;
+		auto block = [&](size_t b) { body(b * TANGENT_BLOCK, std::min((size_t) TANGENT_BLOCK, count - b * TANGENT_BLOCK)); };
+		if (parallel && blocks > 1) {
+			ThreadPool::Shared().ParallelFor(blocks, block);
+		} else {
+			for (size_t b=0; b<blocks; b++)
+				block(b);
+		}
+	};
+
+	// Triangle frames
+	std::vector<FaceTangent> faces(triangleCount);
+	run(triangleCount, [&](size_t first, size_t count) {
+		faceTangents(vertices, indices, first, count, &faces[first]);
+	});
+
+	// Corners around each vertex
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (size_t i=0; i<triangleCount * 3; i++)
+		offsets[indices[i] + 1]++;
+	for (size_t v=0; v<vertexCount; v++)
+		offsets[v + 1] += offsets[v];
+	std::vector<unsigned int> corners(triangleCount * 3);
+	{
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i=0; i<triangleCount * 3; i++)
+			corners[fill[indices[i]]++] = (unsigned int) i;
+	}
+
+	// Vertex frames, one per UV orientation; the negative one only survives a split
+	std::vector<glm::vec3> mirrored(vertexCount);
+	std::vector<char> split(vertexCount, 0);
+
+	run(vertexCount, [&](size_t first, size_t count) {
+		for (size_t v=first; v<first+count; v++) {
+
+			Vertex & vertex = vertices[v];
+			glm::vec3 n = vertex.normal;
+			float length = glm::length(n);
+			if (length > FLT_MIN)
+				n /= length;
+
+			glm::vec3 sum[2] = { glm::vec3(0.0f), glm::vec3(0.0f) };
+			bool used[2] = { false, false };
+
+			for (unsigned int k=offsets[v]; k<offsets[v + 1]; k++) {
+				unsigned int corner = corners[k];
+				const FaceTangent & face = faces[corner / 3];
+				if (face.sign == 0.0f)
+					continue;
+
+				glm::vec3 t = projectNormalized(glm::vec3(face.x, face.y, face.z), n);
+				if (t == glm::vec3(0.0f))
+					continue;
+
+				// Corner angle measured in the tangent plane of the vertex
+				size_t base = corner - corner % 3;
+				const glm::vec3 & p0 = vertices[indices[base + (corner % 3 + 2) % 3]].position;
+				const glm::vec3 & p2 = vertices[indices[base + (corner % 3 + 1) % 3]].position;
+				glm::vec3 e1 = projectNormalized(p0 - vertex.position, n);
+				glm::vec3 e2 = projectNormalized(p2 - vertex.position, n);
+				float angle = std::acos(std::max(-1.0f, std::min(1.0f, glm::dot(e1, e2))));
+
+				int side = face.sign < 0.0f ? 1 : 0;
+				sum[side] += t * angle;
+				used[side] = true;
+			}
+
+			glm::vec3 frame[2];
+			for (int side=0; side<2; side++) {
+				float l = glm::length(sum[side]);
+				frame[side] = l > FLT_MIN ? sum[side] / l : perpendicular(n);
+			}
+
+			int own = used[0] || !used[1] ? 0 : 1;
+			float sign = own == 0 ? 1.0f : -1.0f;
+			vertex.tangent = frame[own];
+			vertex.bitangent = glm::cross(n, frame[own]) * sign;
+
+			if (used[0] && used[1]) {
+				split[v] = 1;
+				mirrored[v] = frame[1];
+			}
+		}
+	});
+
+	// Mirrored side of the split vertices as new vertices
+	std::vector<unsigned int> remap(vertexCount);
+	for (size_t v=0; v<vertexCount; v++) {
+		if (!split[v])
+			continue;
+		Vertex copy = vertices[v];
+		glm::vec3 n = copy.normal;
+		float length = glm::length(n);
+		if (length > FLT_MIN)
+			n /= length;
+		copy.tangent = mirrored[v];
+		copy.bitangent = -glm::cross(n, mirrored[v]);
+		remap[v] = (unsigned int) vertices.size();
+		vertices.push_back(copy);
+	}
+
+	if (vertices.size() == vertexCount)
+		return;
+
+	for (size_t f=0; f<triangleCount; f++)
+		if (faces[f].sign < 0.0f)
+			for (size_t k=f*3; k<f*3+3; k++)
+				if (split[indices[k]])
+					indices[k] = remap[indices[k]];
+}
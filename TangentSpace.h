@@ -0,0 +1,31 @@
+#ifndef TANGENT_SPACE_H
+#define TANGENT_SPACE_H
+
+#include <vector>
+
+#include <Mesh.h>
+
+/**
+* Tangent frames for whole meshes, following the MikkTSpace conventions so
+* normal maps baked by the usual tools come out right:
+*   - each triangle gets a unit tangent from its texture coordinate
+*     derivatives and the orientation of its UVs (+1 / -1);
+*   - each vertex sums the tangents of its triangles, projected on the plane of
+*     its normal and weighted by the corner angle in that plane, then the
+*     bitangent is sign * cross(normal, tangent);
+*   - a vertex shared by triangles of both orientations (mirrored UV seam) is
+*     split, each copy keeping the frame of its own side.
+* Triangle setup runs four triangles at a time with SSE2 when available, large
+* meshes are spread over the shared worker pool.
+*/
+
+#define TANGENT_BLOCK 16384 // triangles (or vertices) per parallel task, smaller meshes stay on one thread
+
+/**
+* Overwrites every tangent and bitangent from positions, normals and texture
+* coordinates. Handedness splits append vertices and rewrite the affected
+* indices. Any thread
+*/
+void GenerateTangents(std::vector<Vertex> & vertices, std::vector<unsigned int> & indices, bool parallel = false);
+
+#endif
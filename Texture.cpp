@@ -1,4 +1,8 @@
 #include <Texture.h>
+#include <GLState.h>
+#include <ThreadPool.h>
+#include <TextureCompression.h>
+#include <Mipmap.h>
 
 /** Only include this once */
 #define STB_IMAGE_IMPLEMENTATION
@@ -11,6 +15,7 @@
 #include <vector>
 #include <string>
 #include <unordered_map>
+#include <algorithm>
 
 std::unordered_map<TextureType, std::string> TextureTypeName = {
 	std::pair<TextureType, std::string> (TEX_UNKNOWN,  "texture_unknown"),
@@ -22,45 +27,134 @@ std::unordered_map<TextureType, std::string> TextureTypeName = {
 	std::pair<TextureType, std::string> (TEX_AMBIENT,  "texture_ambient")
 };
 
-unsigned int LoadTexture(const std::string filename, bool gamma) {
+bool DecodeImage(const std::string & filename, ImageData & image) {
 
-	unsigned int textureID{};
 	int width, height, nrComponents;
 	unsigned char * data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
 
 	if (!data)
-		std::cerr << "LoadTexture: Texture failed to load at path: " << filename << "\n";
+		return false;
 
-	else {
-		GLenum imageFormat;
-		GLenum dataFormat;
-		if (nrComponents == 1) {
-			imageFormat = GL_RED;
-			dataFormat = GL_RED;
-		} else if (nrComponents == 3) {
-			imageFormat = gamma ? GL_SRGB : GL_RGB;
-			dataFormat = GL_RGB;
-		} else if (nrComponents == 4) {
-			imageFormat = gamma ? GL_SRGB_ALPHA : GL_RGBA;
-			dataFormat = GL_RGBA;
-		}
+	image.width    = width;
+	image.height   = height;
+	image.channels = nrComponents;
+	image.pixels   = std::shared_ptr<unsigned char>(data, stbi_image_free);
+	image.format   = IMAGE_RAW;
+	image.levels.clear();
+
+	return true;
+}
+
+/** Colour gets the sharper filter, data maps (normals, heights...) must not ring */
+MipFilter MipFilterFor(TextureType type) {
+	if (type == TEX_DIFFUSE || type == TEX_EMISSION || type == TEX_AMBIENT)
+		return MIP_KAISER;
+	return MIP_BOX;
+}
+
+/** Replace the decoded pixels with an RGBA8 mip chain */
+static void buildMipChain(ImageData & image, bool gamma, MipFilter filter) {
+	std::vector<unsigned char> rgba;
+	ExpandToRGBA(image.pixels.get(), image.width, image.height, image.channels, rgba);
+	GenerateMipChain(rgba.data(), image.width, image.height, gamma, filter, image.levels);
+	image.format = IMAGE_RGBA8;
+	image.pixels.reset();
+}
+
+bool PrepareImage(const std::string & filename, ImageData & image, bool gamma, TextureType type) {
+
+	int width, height, nrComponents;
+	if (!stbi_info(filename.c_str(), &width, &height, &nrComponents))
+		return false;
 
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, imageFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+	ImageFormat format = IMAGE_RGBA8;
+	if (TextureCompressionEnabled() && CompressedFormatFor(type, nrComponents) != IMAGE_RAW)
+		format = CompressedFormatFor(type, nrComponents);
+	MipFilter filter = MipFilterFor(type);
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	// Decode and filter (and transcode) once, then every load is a cache read
+	if (ReadTextureCache(filename, format, gamma, filter, image))
+		return true;
+	if (!DecodeImage(filename, image))
+		return false;
+
+	if (format == IMAGE_RGBA8)
+		buildMipChain(image, gamma, filter);
+	else
+		CompressImage(image, format, gamma, filter);
+
+	WriteTextureCache(filename, image, gamma, filter);
+	return true;
+}
+
+unsigned int ImageInternalFormat(const ImageData & image, bool gamma) {
+
+	if (image.format != IMAGE_RGBA8 && image.format != IMAGE_RAW)
+		return CompressedInternalFormat(image.format, gamma);
+
+	// Levels are always RGBA8 (4-byte rows), the internal format keeps the source channels
+	if (image.channels == 1)
+		return GL_R8;
+	if (image.channels == 3)
+		return gamma ? GL_SRGB8 : GL_RGB8;
+	if (image.channels == 2 || image.channels == 4)
+		return gamma ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+	return 0;
+}
+
+unsigned int UploadTexture(const ImageData & image, bool gamma) {
+
+	// Straight from DecodeImage: build the chain here rather than glGenerateMipmap
+	if (image.format == IMAGE_RAW) {
+		if (!image.pixels)
+			return 0;
+		ImageData prepared = image;
+		buildMipChain(prepared, gamma, MIP_BOX);
+		return UploadTexture(prepared, gamma);
 	}
 
-	stbi_image_free(data);
+	if (image.format != IMAGE_RGBA8)
+		return UploadCompressedTexture(image, gamma);
+
+	GLenum imageFormat = ImageInternalFormat(image, gamma);
+	if (imageFormat == 0) {
+		std::cerr << "UploadTexture: unsupported channel count " << image.channels << "\n";
+		return 0;
+	}
+
+	unsigned int textureID{};
+	glGenTextures(1, &textureID);
+	GLState::Shared().BindTexture(GL_TEXTURE_2D, textureID);
+
+	int width = image.width, height = image.height;
+	for (size_t level=0; level<image.levels.size(); level++) {
+		glTexImage2D(GL_TEXTURE_2D, (GLint) level, imageFormat, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+			image.levels[level].data());
+		width  = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint) image.levels.size() - 1);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
 	return textureID;
 }
 
+unsigned int LoadTexture(const std::string filename, bool gamma, TextureType type) {
+
+	ImageData image{};
+
+	if (!PrepareImage(filename, image, gamma, type)) {
+		std::cerr << "LoadTexture: Texture failed to load at path: " << filename << "\n";
+		return 0;
+	}
+
+	return UploadTexture(image, gamma);
+}
+
 unsigned int LoadCubemap(const std::vector<std::string> & faces) {
 
 	/**
@@ -74,30 +168,32 @@ unsigned int LoadCubemap(const std::vector<std::string> & faces) {
 	* -Z (back)
 	*/
 
+	// Faces are independent: decode them on the worker pool, upload in order here
+	std::vector<ImageData> images(faces.size());
+	std::vector<char> decoded(faces.size(), 0);
+	ThreadPool::Shared().ParallelFor(faces.size(), [&](size_t i) {
+		decoded[i] = DecodeImage(faces[i], images[i]);
+	});
+
 	unsigned int textureID{};
 	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-	int width, height, nrComponents;
+	GLState::Shared().BindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
 	for (unsigned int i=0; i<faces.size(); i++) {
 
-		unsigned char * data = stbi_load(faces[i].c_str(), &width, &height, &nrComponents, 0);
-
-		if (!data)
+		if (!decoded[i])
 			std::cerr << "LoadCubemap: Texture failed to load at path: " << faces[i] << "\n";
 
 		else {
 			GLenum imageFormat;
-			if (nrComponents == 1) imageFormat = GL_RED;
-			else if (nrComponents == 3) imageFormat = GL_RGB;
-			else if (nrComponents == 4) imageFormat = GL_RGBA;
+			if (images[i].channels == 1) imageFormat = GL_RED;
+			else if (images[i].channels == 3) imageFormat = GL_RGB;
+			else if (images[i].channels == 4) imageFormat = GL_RGBA;
 
 			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-				0, imageFormat, width, height, 0, imageFormat, GL_UNSIGNED_BYTE, data);
+				0, imageFormat, images[i].width, images[i].height, 0, imageFormat, GL_UNSIGNED_BYTE,
+				images[i].pixels.get());
 		}
-
-		stbi_image_free(data);
 	}
 
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -122,6 +218,18 @@ Texture defaultEmissionTexture {0, TEX_EMISSION, defaultTextureFilename};
 */
 Texture defaultUnknownTexture  {0, TEX_UNKNOWN, defaultTextureFilename};
 
+std::vector<std::string> SamplerUniformNames(const std::vector<Texture> & textures) {
+
+	std::unordered_map<int, unsigned int> counts;
+	std::vector<std::string> names;
+	names.reserve(textures.size());
+	for (const Texture & texture : textures) {
+		std::string number = texture.type == TEX_UNKNOWN ? "" : std::to_string(++counts[texture.type]);
+		names.push_back("uMaterial." + TextureTypeName[texture.type] + number);
+	}
+	return names;
+}
+
 Texture DefaultTexture(TextureType type) {
 	if (type == defaultDiffuseTexture.type) {
 		if (defaultDiffuseTexture.id == 0)
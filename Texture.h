@@ -3,8 +3,11 @@
 
 #include <vector>
 #include <string>
+#include <memory>
 #include <unordered_map>
 
+#include <Mipmap.h>
+
 enum TextureType {
 	TEX_UNKNOWN,
 	TEX_DIFFUSE,
@@ -21,12 +24,44 @@ struct Texture {
 	std::string path;
 };
 
+enum ImageFormat {
+	IMAGE_RAW,
+	IMAGE_BC1,
+	IMAGE_BC3,
+	IMAGE_BC4,
+	IMAGE_BC5,
+	IMAGE_RGBA8 // uncompressed mip chain, RGBA8 whatever the source channel count
+};
+
+/** Decoded 8-bit image in CPU memory, pixels are shared and freed with the last copy */
+struct ImageData {
+	int width;
+	int height;
+	int channels;
+	std::shared_ptr<unsigned char> pixels; // level 0 as decoded (raw images)
+	ImageFormat format;
+	std::vector<std::vector<unsigned char> > levels; // full mip chain: RGBA8 texels or BC blocks
+};
+
 extern std::unordered_map<TextureType, std::string> TextureTypeName;
 
 /** Methods */
 
-unsigned int LoadTexture(const std::string textureFile, bool gamma = false);
+unsigned int LoadTexture(const std::string textureFile, bool gamma = false, TextureType type = TEX_UNKNOWN);
 unsigned int LoadCubemap(const std::vector<std::string> & faces);
 Texture DefaultTexture(TextureType type);
+/** "uMaterial.<type>N" sampler uniform of each texture, N counting from 1 per type in order (none for TEX_UNKNOWN) */
+std::vector<std::string> SamplerUniformNames(const std::vector<Texture> & textures);
+
+/** Decode only, no GL call: safe on any thread */
+bool DecodeImage(const std::string & filename, ImageData & image);
+/** Everything LoadTexture does before touching GL (decode or cache read, mip chain, compression). Any thread */
+bool PrepareImage(const std::string & filename, ImageData & image, bool gamma = false, TextureType type = TEX_UNKNOWN);
+/** Mip filter of a texture type: colour gets the sharper one */
+MipFilter MipFilterFor(TextureType type);
+/** GL internal format a prepared image is uploaded with, 0 when unsupported */
+unsigned int ImageInternalFormat(const ImageData & image, bool gamma = false);
+/** Create a 2D texture with every level of a prepared image, GL thread only */
+unsigned int UploadTexture(const ImageData & image, bool gamma = false);
 
 #endif
\ No newline at end of file
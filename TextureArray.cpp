@@ -0,0 +1,139 @@
+#include <TextureArray.h>
+#include <GLState.h>
+#include <Texture.h>
+#include <TextureCompression.h>
+#include <ThreadPool.h>
+
+#include <glad/glad.h>
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <tuple>
+#include <algorithm>
+
+std::string TextureArraySet :: key(const std::string & path, TextureType type) {
+	return path + "|" + std::to_string((int) type);
+}
+
+bool TextureArraySet :: Build(const std::vector<std::string> & paths, const std::vector<TextureType> & types,
+	bool gamma) {
+
+	Delete();
+
+	// Distinct images
+	std::vector<size_t> unique;
+	{
+		std::unordered_map<std::string, size_t> seen;
+		for (size_t i=0; i<paths.size(); i++)
+			if (seen.emplace(key(paths[i], types[i]), i).second)
+				unique.push_back(i);
+	}
+
+	// Decode / cache read, mip chain and compression off the GL thread
+	std::vector<ImageData> images(unique.size());
+	std::vector<char> loaded(unique.size(), 0);
+	ThreadPool::Shared().ParallelFor(unique.size(), [&](size_t i) {
+		loaded[i] = PrepareImage(paths[unique[i]], images[i], gamma, types[unique[i]]) ? 1 : 0;
+	});
+
+	// Same shape and format share an array
+	typedef std::tuple<int, int, size_t, unsigned int> Shape; // width, height, levels, internal format
+	std::map<Shape, std::vector<size_t> > groups;
+	for (size_t i=0; i<unique.size(); i++) {
+		const std::string & path = paths[unique[i]];
+		if (!loaded[i] || images[i].levels.empty()) {
+			std::cerr << "TextureArraySet::Build: Texture failed to load at path: " << path << "\n";
+			mLayers[key(path, types[unique[i]])] = TextureLayer{-1, 0};
+			continue;
+		}
+		unsigned int format = ImageInternalFormat(images[i], gamma);
+		if (format == 0) {
+			std::cerr << "TextureArraySet::Build: unsupported image format: " << path << "\n";
+			mLayers[key(path, types[unique[i]])] = TextureLayer{-1, 0};
+			continue;
+		}
+		groups[Shape(images[i].width, images[i].height, images[i].levels.size(), format)].push_back(i);
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4); // RGBA8 rows, blocks are byte streams anyway
+
+	for (const auto & group : groups) {
+
+		int width           = std::get<0>(group.first);
+		int height          = std::get<1>(group.first);
+		size_t levels       = std::get<2>(group.first);
+		GLenum format       = std::get<3>(group.first);
+		const std::vector<size_t> & members = group.second;
+
+		for (size_t first=0; first<members.size(); first+=TEXTURE_ARRAY_MAX_LAYERS) {
+
+			GLsizei layers = (GLsizei) std::min(members.size() - first, (size_t) TEXTURE_ARRAY_MAX_LAYERS);
+			bool compressed = images[members[first]].format != IMAGE_RGBA8;
+
+			GLuint array;
+			glGenTextures(1, &array);
+			GLState::Shared().BindTexture(GL_TEXTURE_2D_ARRAY, array);
+
+			int w = width, h = height;
+			for (size_t level=0; level<levels; level++) {
+				// Storage for every layer, then one layer at a time
+				if (compressed)
+					glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, (GLint) level, format, w, h, layers, 0,
+						(GLsizei) (images[members[first]].levels[level].size() * layers), NULL);
+				else
+					glTexImage3D(GL_TEXTURE_2D_ARRAY, (GLint) level, format, w, h, layers, 0,
+						GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+				for (GLsizei layer=0; layer<layers; layer++) {
+					const std::vector<unsigned char> & data = images[members[first + layer]].levels[level];
+					if (compressed)
+						glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint) level, 0, 0, layer, w, h, 1,
+							format, (GLsizei) data.size(), data.data());
+					else
+						glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint) level, 0, 0, layer, w, h, 1,
+							GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+				}
+				w = std::max(1, w / 2);
+				h = std::max(1, h / 2);
+			}
+
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (GLint) levels - 1);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+			for (GLsizei layer=0; layer<layers; layer++) {
+				size_t i = members[first + layer];
+				mLayers[key(paths[unique[i]], types[unique[i]])] = TextureLayer{(int) mArrays.size(), (int) layer};
+				images[i] = ImageData(); // CPU copy no longer needed
+			}
+			mArrays.push_back(array);
+		}
+	}
+
+	GLState::Shared().BindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	return !mArrays.empty();
+}
+
+TextureLayer TextureArraySet :: Find(const std::string & path, TextureType type) const {
+	auto found = mLayers.find(key(path, type));
+	return found != mLayers.end() ? found->second : TextureLayer{-1, 0};
+}
+
+void TextureArraySet :: Bind() const {
+	for (size_t i=0; i<mArrays.size(); i++) {
+		GLState::Shared().ActiveTexture(GL_TEXTURE0 + (GLenum) i);
+		GLState::Shared().BindTexture(GL_TEXTURE_2D_ARRAY, mArrays[i]);
+	}
+	GLState::Shared().ActiveTexture(GL_TEXTURE0);
+}
+
+void TextureArraySet :: Delete() {
+	if (!mArrays.empty())
+		GLState::Shared().DeleteTextures((GLsizei) mArrays.size(), mArrays.data());
+	mArrays.clear();
+	mLayers.clear();
+}
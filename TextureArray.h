@@ -0,0 +1,58 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+#include <glad/glad.h>
+
+#include <Texture.h>
+
+/**
+* Material textures of a model packed into GL_TEXTURE_2D_ARRAY objects.
+*
+* Images sharing size, mip count and GL format become layers of one array, so
+* a model binds its few arrays once per draw and each mesh only selects layers
+* (uniforms) instead of rebinding 2D textures. Images are prepared on the
+* worker pool (texture cache or decode, mip chain, compression) and uploaded
+* one layer at a time. Shaders sample them as sampler2DArray, see
+* shaders/demo_arrays.frag.
+*/
+
+#define TEXTURE_ARRAY_MAX_LAYERS 256 // layers per array, the GL 3.3 minimum of GL_MAX_ARRAY_TEXTURE_LAYERS
+
+/** Where one image landed */
+struct TextureLayer {
+	int array; // index in the TextureArraySet (and texture unit once bound), -1 if the image failed
+	int layer;
+};
+
+class TextureArraySet {
+
+public:
+	/**
+	* Loads every (path, type) image, paths as given. An image used with several
+	* types is loaded once per type (the type picks compression and mip filter).
+	* False when nothing could be loaded. GL thread
+	*/
+	bool Build(const std::vector<std::string> & paths, const std::vector<TextureType> & types, bool gamma = false);
+
+	TextureLayer Find(const std::string & path, TextureType type) const;
+
+	size_t Size() const { return mArrays.size(); }
+	GLuint Array(size_t i) const { return mArrays[i]; }
+	size_t Layers() const { return mLayers.size(); }
+
+	/** Array i on texture unit i */
+	void Bind() const;
+	void Delete();
+
+private:
+	std::vector<GLuint> mArrays;
+	std::unordered_map<std::string, TextureLayer> mLayers; // by key(path, type)
+
+	static std::string key(const std::string & path, TextureType type);
+};
+
+#endif
@@ -0,0 +1,485 @@
+#include <TextureCompression.h>
+#include <GLState.h>
+#include <MappedFile.h>
+#include <ThreadPool.h>
+#include <Texture.h>
+#include <Mipmap.h>
+
+#include <glad/glad.h>
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+
+/** S3TC enums, the loader header only carries core GL */
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT        0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT       0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT       0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+static std::atomic<bool> compressionEnabled(false);
+static bool srgbCompressionSupported = false;
+
+static bool hasExtension(const char * name) {
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i=0; i<count; i++) {
+		const char * extension = (const char *) glGetStringi(GL_EXTENSIONS, i);
+		if (extension && std::strcmp(extension, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+bool EnableTextureCompression(bool enable) {
+
+	// RGTC (BC4/BC5) is core since GL 3.0, S3TC (BC1/BC3) is still an extension
+	bool supported = hasExtension("GL_EXT_texture_compression_s3tc");
+	srgbCompressionSupported = supported && hasExtension("GL_EXT_texture_sRGB");
+
+	if (enable && !supported)
+		std::cerr << "EnableTextureCompression: S3TC not supported, textures stay uncompressed\n";
+
+	compressionEnabled = enable && supported;
+	return compressionEnabled;
+}
+
+bool TextureCompressionEnabled() {
+	return compressionEnabled;
+}
+
+ImageFormat CompressedFormatFor(TextureType type, int channels) {
+	if (type == TEX_NORMAL && channels >= 3) return IMAGE_BC5;
+	if (channels == 1) return IMAGE_BC4;
+	if (channels == 3) return IMAGE_BC1;
+	if (channels == 4) return IMAGE_BC3;
+	return IMAGE_RAW;
+}
+
+size_t CompressedLevelSize(ImageFormat format, int width, int height) {
+	size_t blocks = (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4);
+	bool small = format == IMAGE_BC1 || format == IMAGE_BC4;
+	return blocks * (small ? 8 : 16);
+}
+
+
+
+
+
+/*************************************************
+*
+* Block encoders
+*
+*************************************************/
+
+static inline int clampByte(float v) {
+	return v < 0.0f ? 0 : (v > 255.0f ? 255 : (int)(v + 0.5f));
+}
+
+static inline uint16_t packRGB565(const float c[3]) {
+	// round to the nearest representable value, not towards zero
+	int r = (clampByte(c[0]) * 31 + 127) / 255;
+	int g = (clampByte(c[1]) * 63 + 127) / 255;
+	int b = (clampByte(c[2]) * 31 + 127) / 255;
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static inline void unpackRGB565(uint16_t v, float c[3]) {
+	int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+	c[0] = (float)((r << 3) | (r >> 2));
+	c[1] = (float)((g << 2) | (g >> 4));
+	c[2] = (float)((b << 3) | (b >> 2));
+}
+
+static inline float distance2(const float a[3], const float b[3]) {
+	float dr = a[0] - b[0], dg = a[1] - b[1], db = a[2] - b[2];
+	return dr * dr + dg * dg + db * db;
+}
+
+/** Choose palette indices for 16 pixels, returns the squared error */
+static float fitColorIndices(const float pixels[16][3], uint16_t c0, uint16_t c1, uint32_t & bits) {
+
+	float palette[4][3];
+	unpackRGB565(c0, palette[0]);
+	unpackRGB565(c1, palette[1]);
+	for (int k=0; k<3; k++) {
+		palette[2][k] = (2.0f * palette[0][k] + palette[1][k]) / 3.0f;
+		palette[3][k] = (palette[0][k] + 2.0f * palette[1][k]) / 3.0f;
+	}
+
+	float error = 0.0f;
+	bits = 0;
+	for (int i=0; i<16; i++) {
+		int best = 0;
+		float bestDist = distance2(pixels[i], palette[0]);
+		for (int p=1; p<4; p++) {
+			float d = distance2(pixels[i], palette[p]);
+			if (d < bestDist) { bestDist = d; best = p; }
+		}
+		bits |= (uint32_t) best << (2 * i);
+		error += bestDist;
+	}
+	return error;
+}
+
+/** BC1 colour block (always 4-colour mode, also used inside BC3) */
+static void encodeColorBlock(const unsigned char rgba[64], unsigned char out[8]) {
+
+	float pixels[16][3];
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i=0; i<16; i++)
+		for (int k=0; k<3; k++) {
+			pixels[i][k] = rgba[4 * i + k];
+			mean[k] += pixels[i][k] / 16.0f;
+		}
+
+	// Principal axis of the colours by power iteration on the covariance
+	float cov[6] = { 0, 0, 0, 0, 0, 0 };
+	for (int i=0; i<16; i++) {
+		float r = pixels[i][0] - mean[0], g = pixels[i][1] - mean[1], b = pixels[i][2] - mean[2];
+		cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+		cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+	}
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (int it=0; it<8; it++) {
+		float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+		float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+		float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+		float len = std::max(std::fabs(x), std::max(std::fabs(y), std::fabs(z)));
+		if (len < 1e-6f) break;
+		axis[0] = x / len; axis[1] = y / len; axis[2] = z / len;
+	}
+
+	// Extent along the axis, inset a little to spread the error over the palette
+	float tMin = 1e30f, tMax = -1e30f;
+	for (int i=0; i<16; i++) {
+		float t = (pixels[i][0] - mean[0]) * axis[0] + (pixels[i][1] - mean[1]) * axis[1]
+			+ (pixels[i][2] - mean[2]) * axis[2];
+		tMin = std::min(tMin, t);
+		tMax = std::max(tMax, t);
+	}
+	float inset = (tMax - tMin) / 16.0f;
+	tMin += inset;
+	tMax -= inset;
+
+	float e0[3], e1[3];
+	for (int k=0; k<3; k++) {
+		e0[k] = mean[k] + axis[k] * tMax;
+		e1[k] = mean[k] + axis[k] * tMin;
+	}
+
+	uint16_t c0 = packRGB565(e0), c1 = packRGB565(e1);
+	uint32_t bits;
+	float error = fitColorIndices(pixels, c0, c1, bits);
+
+	// One least-squares pass: best endpoints for the chosen indices
+	static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+	float aa = 0, bb = 0, ab = 0, ax[3] = { 0, 0, 0 }, bx[3] = { 0, 0, 0 };
+	for (int i=0; i<16; i++) {
+		float a = weights[(bits >> (2 * i)) & 3], b = 1.0f - a;
+		aa += a * a; bb += b * b; ab += a * b;
+		for (int k=0; k<3; k++) {
+			ax[k] += a * pixels[i][k];
+			bx[k] += b * pixels[i][k];
+		}
+	}
+	float det = aa * bb - ab * ab;
+	if (std::fabs(det) > 1e-6f) {
+		float l0[3], l1[3];
+		for (int k=0; k<3; k++) {
+			l0[k] = (ax[k] * bb - bx[k] * ab) / det;
+			l1[k] = (bx[k] * aa - ax[k] * ab) / det;
+		}
+		uint16_t d0 = packRGB565(l0), d1 = packRGB565(l1);
+		uint32_t refined;
+		float refinedError = fitColorIndices(pixels, d0, d1, refined);
+		if (refinedError < error) {
+			c0 = d0; c1 = d1; bits = refined; error = refinedError;
+		}
+	}
+
+	// 4-colour mode needs c0 > c1: swapping the endpoints swaps indices 0<->1 and 2<->3
+	if (c0 < c1) {
+		std::swap(c0, c1);
+		bits ^= 0x55555555;
+	} else if (c0 == c1) {
+		bits = 0;
+	}
+
+	out[0] = c0 & 0xFF; out[1] = c0 >> 8;
+	out[2] = c1 & 0xFF; out[3] = c1 >> 8;
+	out[4] = bits & 0xFF; out[5] = (bits >> 8) & 0xFF;
+	out[6] = (bits >> 16) & 0xFF; out[7] = (bits >> 24) & 0xFF;
+}
+
+/** BC4 single channel block (also the alpha of BC3 and each half of BC5) */
+static void encodeChannelBlock(const unsigned char rgba[64], int channel, unsigned char out[8]) {
+
+	int lo = 255, hi = 0;
+	for (int i=0; i<16; i++) {
+		lo = std::min(lo, (int) rgba[4 * i + channel]);
+		hi = std::max(hi, (int) rgba[4 * i + channel]);
+	}
+
+	// 8-value mode (r0 > r1): index 0 = r0, 1 = r1, k in 2..7 = ((8-k) r0 + (k-1) r1) / 7
+	out[0] = (unsigned char) hi;
+	out[1] = (unsigned char) lo;
+
+	uint64_t bits = 0;
+	if (hi > lo) {
+		for (int i=0; i<16; i++) {
+			int v = rgba[4 * i + channel];
+			int p = (int)((float)(v - lo) * 7.0f / (float)(hi - lo) + 0.5f); // 0 at lo .. 7 at hi
+			int index = p == 7 ? 0 : (p == 0 ? 1 : 8 - p);
+			bits |= (uint64_t) index << (3 * i);
+		}
+	}
+
+	for (int b=0; b<6; b++)
+		out[2 + b] = (unsigned char)((bits >> (8 * b)) & 0xFF);
+}
+
+/** Gather a 4x4 block, clamping at the image edge */
+static void fetchBlock(const unsigned char * rgba, int width, int height, int bx, int by,
+	unsigned char block[64]) {
+	for (int y=0; y<4; y++)
+		for (int x=0; x<4; x++) {
+			int sx = std::min(bx * 4 + x, width - 1);
+			int sy = std::min(by * 4 + y, height - 1);
+			std::memcpy(block + 4 * (4 * y + x), rgba + 4 * ((size_t) sy * width + sx), 4);
+		}
+}
+
+static void compressLevel(const unsigned char * rgba, int width, int height, ImageFormat format,
+	std::vector<unsigned char> & out) {
+
+	int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	size_t blockSize = (format == IMAGE_BC1 || format == IMAGE_BC4) ? 8 : 16;
+	out.resize((size_t) blocksX * blocksY * blockSize);
+
+	// Rows of blocks are independent
+	ThreadPool::Shared().ParallelFor((size_t) blocksY, [&](size_t by) {
+		unsigned char block[64];
+		for (int bx=0; bx<blocksX; bx++) {
+			unsigned char * dst = &out[((size_t) by * blocksX + bx) * blockSize];
+			fetchBlock(rgba, width, height, bx, (int) by, block);
+			if (format == IMAGE_BC1) {
+				encodeColorBlock(block, dst);
+			} else if (format == IMAGE_BC3) {
+				encodeChannelBlock(block, 3, dst);
+				encodeColorBlock(block, dst + 8);
+			} else if (format == IMAGE_BC4) {
+				encodeChannelBlock(block, 0, dst);
+			} else if (format == IMAGE_BC5) {
+				encodeChannelBlock(block, 0, dst);
+				encodeChannelBlock(block, 1, dst + 8);
+			}
+		}
+	});
+}
+
+void CompressImage(ImageData & image, ImageFormat format, bool gamma, MipFilter filter) {
+
+	if (!image.pixels || format == IMAGE_RAW || format == IMAGE_RGBA8)
+		return;
+
+	// Filter the chain in RGBA8 whatever the source layout, then encode every level
+	std::vector<unsigned char> rgba;
+	ExpandToRGBA(image.pixels.get(), image.width, image.height, image.channels, rgba);
+	GenerateMipChain(rgba.data(), image.width, image.height, gamma, filter, image.levels);
+
+	int width = image.width, height = image.height;
+	for (std::vector<unsigned char> & level : image.levels) {
+		std::vector<unsigned char> blocks;
+		compressLevel(level.data(), width, height, format, blocks);
+		level.swap(blocks);
+		width  = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+	}
+
+	image.format = format;
+	image.pixels.reset();
+}
+
+unsigned int CompressedInternalFormat(ImageFormat format, bool gamma) {
+	if (format == IMAGE_BC1)
+		return gamma && srgbCompressionSupported ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	if (format == IMAGE_BC3)
+		return gamma && srgbCompressionSupported ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	if (format == IMAGE_BC4)
+		return GL_COMPRESSED_RED_RGTC1;
+	if (format == IMAGE_BC5)
+		return GL_COMPRESSED_RG_RGTC2;
+	return 0;
+}
+
+unsigned int UploadCompressedTexture(const ImageData & image, bool gamma) {
+
+	GLenum internalFormat = CompressedInternalFormat(image.format, gamma);
+	if (internalFormat == 0)
+		return 0;
+
+	unsigned int textureID{};
+	glGenTextures(1, &textureID);
+	GLState::Shared().BindTexture(GL_TEXTURE_2D, textureID);
+
+	int width = image.width, height = image.height;
+	for (size_t level=0; level<image.levels.size(); level++) {
+		glCompressedTexImage2D(GL_TEXTURE_2D, (GLint) level, internalFormat, width, height, 0,
+			(GLsizei) image.levels[level].size(), image.levels[level].data());
+		width  = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+	}
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint) image.levels.size() - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	return textureID;
+}
+
+
+
+
+
+/*************************************************
+*
+* On-disk cache
+*
+*************************************************/
+
+static const char TEXTURE_CACHE_MAGIC[8] = { 'L', 'O', 'G', 'L', 'T', 'E', 'X', '\0' };
+
+struct TextureCacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t channels;
+	uint32_t numLevels;
+	uint32_t gamma;
+	uint32_t filter;
+	int64_t sourceTime;  // FileStamp of the source when the cache was written
+	uint64_t sourceSize;
+};
+
+std::string TextureCachePath(const std::string & source, ImageFormat format, bool gamma, MipFilter filter) {
+	static const char * formats[] = { "raw", "bc1", "bc3", "bc4", "bc5", "rgba8" };
+	return source + "." + formats[format] + (gamma ? ".srgb" : ".linear")
+		+ (filter == MIP_KAISER ? ".kaiser" : ".box") + ".texcache";
+}
+
+/** Expected byte size of one level, so a truncated or foreign file is rejected */
+static size_t levelSize(ImageFormat format, int width, int height) {
+	if (format == IMAGE_RGBA8)
+		return (size_t) width * height * 4;
+	return CompressedLevelSize(format, width, height);
+}
+
+bool ReadTextureCache(const std::string & source, ImageFormat format, bool gamma, MipFilter filter,
+	ImageData & image) {
+
+	std::string cache = TextureCachePath(source, format, gamma, filter);
+	MappedFile file(cache);
+	if (!file.IsOpen() || file.Size() < sizeof(TextureCacheHeader))
+		return false;
+
+	TextureCacheHeader header;
+	std::memcpy(&header, file.Data(), sizeof(header));
+	if (std::memcmp(header.magic, TEXTURE_CACHE_MAGIC, sizeof(TEXTURE_CACHE_MAGIC)) != 0
+		|| header.version != TEXTURE_CACHE_VERSION || header.format != (uint32_t) format
+		|| header.gamma != (uint32_t) gamma || header.filter != (uint32_t) filter
+		|| GetFileStamp(source) != FileStamp{ header.sourceTime, header.sourceSize }
+		|| header.numLevels != (uint32_t) MipLevelCount((int) header.width, (int) header.height))
+		return false;
+
+	const unsigned char * ptr = file.Data() + sizeof(header);
+	const unsigned char * end = file.Data() + file.Size();
+
+	int width = (int) header.width, height = (int) header.height;
+	std::vector<std::vector<unsigned char> > levels(header.numLevels);
+	for (std::vector<unsigned char> & level : levels) {
+		uint32_t size;
+		if ((size_t)(end - ptr) < sizeof(size))
+			return false;
+		std::memcpy(&size, ptr, sizeof(size));
+		ptr += sizeof(size);
+		if ((size_t)(end - ptr) < size || size != levelSize(format, width, height))
+			return false;
+		level.assign(ptr, ptr + size);
+		ptr += size;
+		width  = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+	}
+
+	image.width    = (int) header.width;
+	image.height   = (int) header.height;
+	image.channels = (int) header.channels;
+	image.format   = format;
+	image.pixels.reset();
+	image.levels.swap(levels);
+
+	return true;
+}
+
+bool WriteTextureCache(const std::string & source, const ImageData & image, bool gamma, MipFilter filter) {
+
+	// Workers preparing the same image for the same type may race here: the last rename wins, both are whole
+	std::string cache = TextureCachePath(source, image.format, gamma, filter);
+	std::string temp  = UniqueTempPath(cache);
+
+	std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+	if (!out.is_open()) {
+		std::cerr << "WriteTextureCache: unable to write " << temp << "\n";
+		return false;
+	}
+
+	TextureCacheHeader header;
+	std::memcpy(header.magic, TEXTURE_CACHE_MAGIC, sizeof(TEXTURE_CACHE_MAGIC));
+	header.version   = TEXTURE_CACHE_VERSION;
+	header.format    = (uint32_t) image.format;
+	header.width     = (uint32_t) image.width;
+	header.height    = (uint32_t) image.height;
+	header.channels  = (uint32_t) image.channels;
+	header.numLevels = (uint32_t) image.levels.size();
+	header.gamma     = (uint32_t) gamma;
+	header.filter    = (uint32_t) filter;
+	FileStamp stamp  = GetFileStamp(source);
+	header.sourceTime = stamp.time;
+	header.sourceSize = stamp.size;
+	out.write((const char *) &header, sizeof(header));
+
+	for (const std::vector<unsigned char> & level : image.levels) {
+		uint32_t size = (uint32_t) level.size();
+		out.write((const char *) &size, sizeof(size));
+		out.write((const char *) level.data(), level.size());
+	}
+
+	out.close();
+	if (!out) {
+		std::remove(temp.c_str());
+		return false;
+	}
+
+	std::remove(cache.c_str());
+	if (std::rename(temp.c_str(), cache.c_str()) != 0) {
+		std::remove(temp.c_str());
+		return false;
+	}
+
+	return true;
+}
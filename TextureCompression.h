@@ -0,0 +1,52 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <vector>
+#include <string>
+
+#include <Texture.h>
+#include <Mipmap.h>
+
+/**
+* CPU block compression (S3TC / RGTC) with an on-disk cache.
+*
+* Source images are transcoded once, with their whole mip chain, into
+* "<source>.<format>.<srgb|linear>.<filter>.texcache" (an image used as several
+* texture types keeps one cache per encoding). Later loads read it and upload the blocks
+* with glCompressedTexImage2D. Uncompressed RGBA8 chains use the same cache.
+*
+*   BC1: RGB, 4 bpp        BC3: RGBA, 8 bpp
+*   BC4: one channel, 4 bpp BC5: two channels (normal maps, z rebuilt in shaders), 8 bpp
+*/
+
+#define TEXTURE_CACHE_VERSION 3
+
+/** Enable the compressed path when the driver exposes S3TC. GL thread, call after GL init */
+bool EnableTextureCompression(bool enable = true);
+bool TextureCompressionEnabled();
+
+/** Format picked for an image of this type and channel count */
+ImageFormat CompressedFormatFor(TextureType type, int channels);
+
+/** Encode a decoded image and its mip chain into image.levels (replaces the raw pixels) */
+void CompressImage(ImageData & image, ImageFormat format, bool gamma = false, MipFilter filter = MIP_BOX);
+
+/** GL internal format of a block-compressed image, 0 for the other formats */
+unsigned int CompressedInternalFormat(ImageFormat format, bool gamma = false);
+
+/** glCompressedTexImage2D every level, GL thread only */
+unsigned int UploadCompressedTexture(const ImageData & image, bool gamma = false);
+
+/** Bytes taken by one level of a block-compressed image */
+size_t CompressedLevelSize(ImageFormat format, int width, int height);
+
+std::string TextureCachePath(const std::string & source, ImageFormat format, bool gamma, MipFilter filter);
+/**
+* gamma and filter change the mip chain, a cache built with other settings is a miss,
+* as is one whose source no longer has the recorded size and modification time
+*/
+bool ReadTextureCache(const std::string & source, ImageFormat format, bool gamma, MipFilter filter,
+	ImageData & image);
+bool WriteTextureCache(const std::string & source, const ImageData & image, bool gamma, MipFilter filter);
+
+#endif
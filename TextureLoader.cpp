@@ -0,0 +1,97 @@
+#include <TextureLoader.h>
+#include <ThreadPool.h>
+#include <Texture.h>
+
+#include <glad/glad.h>
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+
+TextureLoader & TextureLoader :: Shared() {
+	static TextureLoader loader;
+	return loader;
+}
+
+TextureHandle TextureLoader :: Request(const std::string & path, bool gamma, TextureType type) {
+
+	TextureHandle request = std::make_shared<TextureRequest>();
+	request->path    = path;
+	request->gamma   = gamma;
+	request->type    = type;
+	request->id      = DefaultTexture(type).id; // placeholder until the upload lands
+	request->ready   = false;
+	request->failed  = false;
+
+	request->image = ThreadPool::Shared().Submit([path, gamma, type]() {
+		ImageData image{};
+		if (!PrepareImage(path, image, gamma, type))
+			image = ImageData{};
+		return image;
+	});
+
+	mPending.push_back(request);
+	return request;
+}
+
+void TextureLoader :: upload(const TextureHandle & request) {
+
+	ImageData image = request->image.get();
+	unsigned int placeholder = request->id;
+
+	bool valid = image.pixels || !image.levels.empty();
+	unsigned int tid = valid ? UploadTexture(image, request->gamma) : 0;
+
+	if (tid == 0) {
+		std::cerr << "TextureLoader: Texture failed to load at path: " << request->path << "\n";
+		request->failed = true; // keeps the placeholder
+	} else {
+		request->id = tid;
+	}
+	request->ready = true;
+
+	if (request->onReady && !request->failed)
+		request->onReady(placeholder, request->id);
+}
+
+unsigned int TextureLoader :: Update(double budgetMs) {
+
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+	unsigned int uploaded = 0;
+
+	for (size_t i=0; i<mPending.size(); ) {
+
+		// Nobody holds the handle any more: drop it without uploading
+		if (mPending[i].use_count() == 1) {
+			mPending.erase(mPending.begin() + i);
+			continue;
+		}
+
+		TextureHandle request = mPending[i];
+		bool decoded = request->image.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		if (!decoded) {
+			i++;
+			continue;
+		}
+
+		upload(request);
+		uploaded++;
+		mPending.erase(mPending.begin() + i);
+
+		double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		if (elapsed >= budgetMs)
+			break;
+	}
+
+	return uploaded;
+}
+
+void TextureLoader :: Finish() {
+	// Oldest first, get() blocks on whatever is still decoding
+	for (const TextureHandle & request : mPending)
+		if (request.use_count() > 1) // abandoned handles are dropped
+			upload(request);
+	mPending.clear();
+}
@@ -0,0 +1,60 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <future>
+#include <functional>
+
+#include <Texture.h>
+
+/**
+* One asynchronous texture load. id holds the default texture of the requested
+* type until the decoded image has been uploaded, then the real texture.
+*/
+struct TextureRequest {
+	std::string path;
+	bool gamma;
+	TextureType type;
+	unsigned int id;
+	bool ready;
+	bool failed;
+	/** Called on the GL thread once the upload landed (placeholder id, new id) */
+	std::function<void(unsigned int, unsigned int)> onReady;
+
+	std::future<ImageData> image;
+};
+
+typedef std::shared_ptr<TextureRequest> TextureHandle;
+
+/**
+* Texture loading service: images are decoded on the shared worker pool and
+* uploaded by the GL thread in Update(), a few milliseconds per frame.
+*/
+class TextureLoader {
+
+public:
+	/** GL thread only. Returns immediately, decoding starts right away */
+	TextureHandle Request(const std::string & path, bool gamma = false, TextureType type = TEX_DIFFUSE);
+
+	/**
+	* Upload decoded images until budgetMs is spent (at least one per call).
+	* Returns the number of textures uploaded. GL thread only.
+	*/
+	unsigned int Update(double budgetMs = 2.0);
+
+	/** Block until every pending request is uploaded */
+	void Finish();
+
+	size_t Pending() const { return mPending.size(); }
+
+	static TextureLoader & Shared();
+
+private:
+	std::vector<TextureHandle> mPending;
+
+	void upload(const TextureHandle & request);
+};
+
+#endif
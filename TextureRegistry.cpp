@@ -0,0 +1,139 @@
+#include <TextureRegistry.h>
+#include <GLState.h>
+#include <TextureLoader.h>
+#include <MappedFile.h>
+#include <Texture.h>
+
+#include <glad/glad.h>
+
+#include <iostream>
+#include <string>
+#include <memory>
+#include <algorithm>
+
+/** 64-bit FNV-1a, plenty for telling image files apart */
+static uint64_t hashContent(const unsigned char * data, size_t size) {
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i=0; i<size; i++) {
+		hash ^= data[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/** The type picks the compression format and mip filter: another type is another texture */
+static std::string pathKey(const std::string & canonical, bool gamma, TextureType type) {
+	std::string key = canonical + "|" + std::to_string((int) type);
+	return gamma ? key + "|srgb" : key;
+}
+
+static uint64_t contentKey(uint64_t hash, bool gamma, TextureType type) {
+	hash ^= ((uint64_t) type + 1) * 0xC2B2AE3D27D4EB4FULL;
+	return gamma ? hash ^ 0x9E3779B97F4A7C15ULL : hash;
+}
+
+bool SharedTexture :: Ready() {
+	if (request) {
+		if (!request->ready)
+			return false;
+		if (!request->failed) {
+			id = request->id;
+			owned = true;
+		}
+		request.reset();
+	}
+	return true;
+}
+
+TextureRegistry & TextureRegistry :: Shared() {
+	// Never destroyed: models held in globals release their textures after static teardown
+	static TextureRegistry * registry = new TextureRegistry();
+	return *registry;
+}
+
+TextureRef TextureRegistry :: Acquire(const std::string & path, bool gamma,
+	TextureType type, bool async) {
+
+	std::string canonical = CanonicalPath(path);
+	if (canonical.empty()) {
+		std::cerr << "TextureRegistry::Acquire: Texture failed to load at path: " << path << "\n";
+		return TextureRef();
+	}
+
+	// Same file seen before
+	std::string key = pathKey(canonical, gamma, type);
+	auto byPath = mByPath.find(key);
+	if (byPath != mByPath.end()) {
+		TextureRef texture = byPath->second.lock();
+		if (texture)
+			return texture;
+	}
+
+	// Same bytes under another name
+	uint64_t hash;
+	size_t size;
+	{
+		MappedFile file(canonical);
+		if (!file.IsOpen()) {
+			std::cerr << "TextureRegistry::Acquire: unable to read " << canonical << "\n";
+			return TextureRef();
+		}
+		hash = hashContent(file.Data(), file.Size());
+		size = file.Size();
+	}
+
+	auto byContent = mByContent.find(contentKey(hash, gamma, type));
+	if (byContent != mByContent.end()) {
+		TextureRef texture = byContent->second.lock();
+		if (texture && texture->contentSize == size) {
+			texture->pathKeys.push_back(key);
+			mByPath[key] = texture;
+			return texture;
+		}
+	}
+
+	// New image
+	TextureRef texture(new SharedTexture(), [this](SharedTexture * texture) { release(texture); });
+	texture->path        = canonical;
+	texture->contentHash = hash;
+	texture->contentSize = size;
+	texture->gamma       = gamma;
+	texture->type        = type;
+	texture->pathKeys.push_back(key);
+
+	if (async) {
+		texture->request = TextureLoader::Shared().Request(canonical, gamma, type);
+		texture->id      = texture->request->id;
+		texture->owned   = false;
+	} else {
+		texture->id    = LoadTexture(canonical, gamma, type);
+		texture->owned = true;
+		if (texture->id == 0)
+			return TextureRef();
+	}
+
+	mByPath[key] = texture;
+	mByContent[contentKey(hash, gamma, type)] = texture;
+
+	return texture;
+}
+
+void TextureRegistry :: release(SharedTexture * texture) {
+
+	// Only drop map slots that still refer to this (now expired) entry
+	for (const std::string & key : texture->pathKeys) {
+		auto it = mByPath.find(key);
+		if (it != mByPath.end() && it->second.expired())
+			mByPath.erase(it);
+	}
+	auto it = mByContent.find(contentKey(texture->contentHash, texture->gamma, texture->type));
+	if (it != mByContent.end() && it->second.expired())
+		mByContent.erase(it);
+
+	// A pending request nobody holds any more is dropped by the loader
+	texture->Ready();
+	if (texture->owned && texture->id != 0)
+		GLState::Shared().DeleteTextures(1, &texture->id);
+
+	delete texture;
+}
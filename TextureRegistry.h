@@ -0,0 +1,58 @@
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+
+#include <Texture.h>
+#include <TextureLoader.h>
+
+/**
+* One GL texture shared by every user of the same image.
+* The texture is deleted when the last TextureRef goes away.
+*/
+struct SharedTexture {
+	unsigned int id;       // placeholder (default texture) while an async upload is pending
+	std::string path;      // canonical path of the first file that produced it
+	uint64_t contentHash;
+	size_t contentSize;
+	bool gamma;
+	TextureType type;      // picks format and mip filter, part of the keys
+	bool owned;            // id belongs to this entry and is deleted with it
+	TextureHandle request; // pending async upload, null once resolved
+	std::vector<std::string> pathKeys; // every registry path entry pointing here
+
+	/** Picks up a finished async upload, true when id is final. GL thread only */
+	bool Ready();
+};
+
+typedef std::shared_ptr<SharedTexture> TextureRef;
+
+/**
+* Process-wide texture cache. Lookups go by canonical path first, then by a hash
+* of the file content, so the same image reached through different paths or
+* copied into another directory is decoded and uploaded once per texture type
+* (the type decides how it is compressed and filtered).
+*/
+class TextureRegistry {
+
+public:
+	/** Null when the file cannot be read or decoded. GL thread only */
+	TextureRef Acquire(const std::string & path, bool gamma = false,
+		TextureType type = TEX_DIFFUSE, bool async = false);
+
+	size_t Size() const { return mByContent.size(); }
+
+	static TextureRegistry & Shared();
+
+private:
+	std::unordered_map<std::string, std::weak_ptr<SharedTexture> > mByPath;
+	std::unordered_map<uint64_t, std::weak_ptr<SharedTexture> > mByContent;
+
+	void release(SharedTexture * texture);
+};
+
+#endif
@@ -0,0 +1,100 @@
+#include <ThreadPool.h>
+
+#include <atomic>
+#include <algorithm>
+
+ThreadPool :: ThreadPool(unsigned int threads)
+	: mStopping(false)
+{
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+
+	for (unsigned int i=0; i<threads; i++)
+		mWorkers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool :: ~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+	}
+	mCondition.notify_all();
+
+	for (std::thread & worker : mWorkers)
+		worker.join();
+}
+
+ThreadPool & ThreadPool :: Shared() {
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool :: enqueue(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTasks.push(std::move(task));
+	}
+	mCondition.notify_one();
+}
+
+void ThreadPool :: workerLoop() {
+
+	for (;;) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mCondition.wait(lock, [this]() { return mStopping || !mTasks.empty(); });
+			// Drain the queue before leaving so no future is left without a value
+			if (mTasks.empty())
+				return;
+			task = std::move(mTasks.front());
+			mTasks.pop();
+		}
+		task();
+	}
+}
+
+void ThreadPool :: ParallelFor(size_t count, const std::function<void(size_t)> & body) {
+
+	if (count == 0)
+		return;
+
+	/**
+	* Helpers and caller pull indices from a shared counter. Helpers that only start
+	* after the loop is over find nothing left, so the state lives on the heap.
+	*/
+	struct State {
+		std::atomic<size_t> next;
+		std::atomic<size_t> done;
+		std::mutex mutex;
+		std::condition_variable finished;
+		const std::function<void(size_t)> * body;
+		size_t count;
+	};
+
+	std::shared_ptr<State> state = std::make_shared<State>();
+	state->next  = 0;
+	state->done  = 0;
+	state->body  = &body;
+	state->count = count;
+
+	auto run = [](std::shared_ptr<State> state) {
+		size_t i;
+		while ((i = state->next.fetch_add(1)) < state->count) {
+			(*state->body)(i);
+			if (state->done.fetch_add(1) + 1 == state->count) {
+				std::lock_guard<std::mutex> lock(state->mutex);
+				state->finished.notify_all();
+			}
+		}
+	};
+
+	size_t helpers = std::min<size_t>(mWorkers.size(), count - 1);
+	for (size_t h=0; h<helpers; h++)
+		enqueue([state, run]() { run(state); });
+
+	run(state);
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->finished.wait(lock, [&state]() { return state->done.load() == state->count; });
+}
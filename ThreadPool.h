@@ -0,0 +1,68 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+
+/**
+* Fixed-size worker pool for loader work (mesh conversion, image decoding...).
+* Tasks must not touch the GL context: GL calls stay on the thread that owns it.
+*/
+class ThreadPool {
+
+public:
+	ThreadPool(unsigned int threads = 0); // 0: one worker per hardware thread
+	~ThreadPool();
+
+	/** Queue a task, the future carries its result (or exception) */
+	template<class F>
+	std::future<typename std::result_of<F()>::type> Submit(F task);
+
+	/**
+	* Run body(i) for every i in [0, count) and return when all are done.
+	* The calling thread takes part, so this is safe to call from a worker.
+	*/
+	void ParallelFor(size_t count, const std::function<void(size_t)> & body);
+
+	unsigned int Size() const { return (unsigned int) mWorkers.size(); }
+
+	/** Process-wide pool shared by the loaders */
+	static ThreadPool & Shared();
+
+private:
+	std::vector<std::thread> mWorkers;
+	std::queue<std::function<void()> > mTasks;
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	bool mStopping;
+
+	void enqueue(std::function<void()> task);
+	void workerLoop();
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool & operator=(const ThreadPool &) = delete;
+};
+
+template<class F>
+std::future<typename std::result_of<F()>::type> ThreadPool :: Submit(F task) {
+
+	typedef typename std::result_of<F()>::type Result;
+
+	// std::function needs a copyable target, packaged_task is move-only
+	std::shared_ptr<std::packaged_task<Result()> > packaged =
+		std::make_shared<std::packaged_task<Result()> >(std::move(task));
+	std::future<Result> future = packaged->get_future();
+
+	enqueue([packaged]() { (*packaged)(); });
+
+	return future;
+}
+
+#endif
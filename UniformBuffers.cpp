@@ -17,6 +17,8 @@
 
 /** Shader Wrapper */
 #include <ShaderProgram.h>
+#include <GLState.h>
+#include <StreamBuffer.h>
 
 /** Camera Wrapper */
 #include <EularCamera.h>
@@ -85,20 +87,11 @@ int main() {
 	glUniformBlockBinding(shaders[1].ID(), uBlockIds[1], 0);
 	glUniformBlockBinding(shaders[2].ID(), uBlockIds[2], 0);
 	glUniformBlockBinding(shaders[3].ID(), uBlockIds[3], 0);
-	// 3. Create the buffer
-	GLuint uboMatrices;
-	glGenBuffers(1, &uboMatrices);
-	glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-	glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), NULL, GL_STATIC_DRAW);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
-	// 4. Define range of the buffer linking to a uniform binding point
-	glBindBufferRange(GL_UNIFORM_BUFFER, 0, uboMatrices, 0, 2 * sizeof(glm::mat4));
-	// 5. Store related data
+	// 3. The buffer: a range of the stream ring each frame, see below
+	// 4. Store related data
 	float width_height_ratio = (float)gWindowWidth / (float)gWindowHeight;
-	glm::mat4 projection = glm::perspective(glm::radians(camera.fov), width_height_ratio, 0.1f, 100.0f);
-	glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glm::mat4 matrices[2]; // the uMatrices block: projection, view
+	matrices[0] = glm::perspective(glm::radians(camera.fov), width_height_ratio, 0.1f, 100.0f);
 	// Notice, there are 4 shaders, but one only needs to set camera 1 time, instead of 4.
 
 
@@ -122,11 +115,11 @@ int main() {
 
 
 
-		// Set view together with projection matrix in the uniform block
-		glm::mat4 view = camera.getViewMatrix();
-		glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-		glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(view));
-		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		// Set view together with projection matrix in the uniform block: written to a range
+		// the GPU is done with and linked to the uniform binding point, no wait on last frame's draws
+		matrices[1] = camera.getViewMatrix();
+		StreamRange ubo = StreamBuffer::Shared().UploadUniform(matrices, sizeof(matrices));
+		glBindBufferRange(GL_UNIFORM_BUFFER, 0, ubo.buffer, ubo.offset, ubo.size);
 		// Notice, there are 4 shaders, but one only needs to set camera 1 time, instead of 4.
 
 		// Draw scene
@@ -158,6 +151,9 @@ int main() {
 
 
 
+		// This frame's uploads are fenced, the next one writes the next region of the ring
+		StreamBuffer::Shared().EndFrame();
+
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		glfwPollEvents();
 		glfwSwapBuffers(gWindow);
@@ -219,12 +215,12 @@ bool initOpenGL() {
 	//glViewport(0, 0, gWindowWidth, gWindowHeight);
 
 	// Configure global OpenGL state	
-	glEnable(GL_DEPTH_TEST);
+	GLState::Shared().Enable(GL_DEPTH_TEST);
 
 	// Blending functionality
-	glEnable(GL_BLEND);
+	GLState::Shared().Enable(GL_BLEND);
 	// Tell OpenGL how to calc colors of blended fragments (pixels)
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::Shared().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	// Hide the cursor and capture it
 	glfwSetInputMode(gWindow, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
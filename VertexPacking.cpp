@@ -0,0 +1,118 @@
+#include <VertexPacking.h>
+#include <Mesh.h>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+uint16_t FloatToHalf(float value) {
+
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	uint32_t sign = (bits >> 16) & 0x8000;
+	int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+	uint32_t mantissa = bits & 0x7FFFFF;
+
+	if (((bits >> 23) & 0xFF) == 0xFF) // inf / nan
+		return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+	if (exponent >= 31) // overflow
+		return (uint16_t)(sign | 0x7C00);
+	if (exponent <= 0) {
+		// denormal or zero
+		if (exponent < -10)
+			return (uint16_t) sign;
+		mantissa |= 0x800000;
+		uint32_t shift = (uint32_t)(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t midpoint = 1u << (shift - 1);
+		if (rest > midpoint || (rest == midpoint && (half & 1)))
+			half++;
+		return (uint16_t)(sign | half);
+	}
+
+	// round to nearest even, a carry into the exponent is still the right encoding
+	uint32_t half = sign | ((uint32_t) exponent << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1FFF;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+		half++;
+	return (uint16_t) half;
+}
+
+static inline uint32_t packSnorm(float value, int bits) {
+	int maximum = (1 << (bits - 1)) - 1;
+	float clamped = std::min(1.0f, std::max(-1.0f, value));
+	int quantized = (int) std::lround(clamped * maximum);
+	return (uint32_t) quantized & ((1u << bits) - 1);
+}
+
+uint32_t PackSnorm1010102(const glm::vec4 & value) {
+	return packSnorm(value.x, 10) | (packSnorm(value.y, 10) << 10)
+		| (packSnorm(value.z, 10) << 20) | (packSnorm(value.w, 2) << 30);
+}
+
+void PackVertices(const Vertex * vertices, size_t count, PackedVertex * packed) {
+
+	for (size_t i=0; i<count; i++) {
+		const Vertex & vertex = vertices[i];
+		PackedVertex & out = packed[i];
+
+		out.position = vertex.position;
+		out.normal = PackSnorm1010102(glm::vec4(vertex.normal, 0.0f));
+		out.texCoords[0] = FloatToHalf(vertex.texCoords.x);
+		out.texCoords[1] = FloatToHalf(vertex.texCoords.y);
+
+		// Handedness of the frame, so B = cross(N, T) * w reproduces the stored bitangent
+		float handedness = glm::dot(glm::cross(vertex.normal, vertex.tangent), vertex.bitangent) < 0.0f ? -1.0f : 1.0f;
+		out.tangent = PackSnorm1010102(glm::vec4(vertex.tangent, handedness));
+	}
+}
+
+size_t VertexStride(VertexFormat format) {
+	if (format == VERTEX_PACKED)
+		return sizeof(PackedVertex);
+	if (format == VERTEX_PIXEL)
+		return sizeof(Pixel);
+	return sizeof(Vertex);
+}
+
+void SetupVertexAttributes(VertexFormat format, size_t offset) {
+
+	GLsizei stride = (GLsizei) VertexStride(format);
+
+	if (format == VERTEX_PACKED) {
+		glEnableVertexAttribArray(0); // vertex positions
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(PackedVertex, position)));
+		glEnableVertexAttribArray(1); // vertex normals
+		glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)(offset + offsetof(PackedVertex, normal)));
+		glEnableVertexAttribArray(2); // vertex texture coords
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(PackedVertex, texCoords)));
+		glEnableVertexAttribArray(3); // vertex tangent + bitangent sign
+		glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)(offset + offsetof(PackedVertex, tangent)));
+		glDisableVertexAttribArray(4); // bitangent: generic (0, 0, 0, 1), xyz is zero so shaders rebuild it
+		return;
+	}
+
+	if (format == VERTEX_PIXEL) {
+		glEnableVertexAttribArray(0); // vertex positions
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(Pixel, position)));
+		glEnableVertexAttribArray(1); // vertex texture coords
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(Pixel, texCoords)));
+		return;
+	}
+
+	glEnableVertexAttribArray(0); // vertex positions
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(Vertex, position)));
+	glEnableVertexAttribArray(1); // vertex normals
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(Vertex, normal)));
+	glEnableVertexAttribArray(2); // vertex texture coords
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(Vertex, texCoords)));
+	glEnableVertexAttribArray(3); // vertex tangent coords
+	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(Vertex, tangent)));
+	glEnableVertexAttribArray(4); // vertex bitangent coords
+	glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(Vertex, bitangent)));
+}
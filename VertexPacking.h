@@ -0,0 +1,44 @@
+#ifndef VERTEX_PACKING_H
+#define VERTEX_PACKING_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+struct Vertex;
+
+enum VertexFormat {
+	VERTEX_FULL,   // struct Vertex, 56 bytes of floats
+	VERTEX_PACKED, // struct PackedVertex, 24 bytes
+	VERTEX_PIXEL   // struct Pixel, 2D position + texture coords
+};
+
+/**
+* Compact GPU vertex, same attribute locations as Vertex:
+*   0 position   3 x float
+*   1 normal     GL_INT_2_10_10_10_REV, normalized
+*   2 texCoords  2 x half float
+*   3 tangent    GL_INT_2_10_10_10_REV, normalized, w = bitangent sign
+*   4 bitangent  not stored, shaders rebuild it as cross(N, T) * tangent.w
+*/
+struct PackedVertex {
+	glm::vec3 position;
+	uint32_t normal;
+	uint16_t texCoords[2];
+	uint32_t tangent;
+};
+
+static_assert(sizeof(PackedVertex) == 24, "PackedVertex must stay tightly packed");
+
+uint16_t FloatToHalf(float value);
+/** Signed normalized 10:10:10:2 (xyz in [-1, 1], w in {-1, 0, 1}) */
+uint32_t PackSnorm1010102(const glm::vec4 & value);
+
+void PackVertices(const Vertex * vertices, size_t count, PackedVertex * packed);
+
+size_t VertexStride(VertexFormat format);
+/** Attribute pointers (0-4, 0-1 for pixels) for the bound GL_ARRAY_BUFFER, offset in bytes into it. VAO must be bound */
+void SetupVertexAttributes(VertexFormat format, size_t offset = 0);
+
+#endif
@@ -0,0 +1,721 @@
+#include <VirtualTexture.h>
+#include <Texture.h>
+#include <Mipmap.h>
+#include <MappedFile.h>
+#include <ThreadPool.h>
+#include <ShaderProgram.h>
+#include <GLState.h>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+
+#define VT_SLOT_BYTES ((size_t) VT_SLOT_SIZE * VT_SLOT_SIZE * 4)
+
+static const char VIRTUAL_PAGES_MAGIC[8] = { 'L', 'O', 'G', 'L', 'V', 'T', 'P', '\0' };
+
+struct VirtualPagesHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levels;
+	uint32_t pageSize;
+	uint32_t border;
+	uint32_t gamma;
+	uint32_t filter;
+	int64_t sourceTime;  // FileStamp of the source when the pages were baked
+	uint64_t sourceSize;
+};
+
+/** Texels of a mip level along one axis, as GenerateMipChain halves them */
+static int levelExtent(int size, int level) {
+	return std::max(1, size >> level);
+}
+
+static int pageCount(int size, int level) {
+	return (levelExtent(size, level) + VT_PAGE_SIZE - 1) / VT_PAGE_SIZE;
+}
+
+/** Levels down to the first one that fits in a single page */
+static int pageLevels(int width, int height) {
+	int levels = 1;
+	while (pageCount(width, levels - 1) > 1 || pageCount(height, levels - 1) > 1)
+		levels++;
+	return levels;
+}
+
+static size_t pageFileSize(int width, int height, int levels) {
+	size_t pages = 0;
+	for (int level=0; level<levels; level++)
+		pages += (size_t) pageCount(width, level) * pageCount(height, level);
+	return sizeof(VirtualPagesHeader) + pages * VT_SLOT_BYTES;
+}
+
+/** Page identity in the feedback, the residency map and the slots: id, level, x, y, 8 bits each */
+static uint32_t pageKey(int id, int level, int x, int y) {
+	return ((uint32_t) id << 24) | ((uint32_t) level << 16) | ((uint32_t) x << 8) | (uint32_t) y;
+}
+
+static int keyId(uint32_t key)    { return (int) (key >> 24); }
+static int keyLevel(uint32_t key) { return (int) ((key >> 16) & 0xFF); }
+static int keyX(uint32_t key)     { return (int) ((key >> 8) & 0xFF); }
+static int keyY(uint32_t key)     { return (int) (key & 0xFF); }
+
+/** Page file of source as it is now, baked with these settings */
+static bool readHeader(const MappedFile & file, const std::string & source, bool gamma, MipFilter filter,
+	VirtualPagesHeader & header) {
+
+	if (!file.IsOpen() || file.Size() < sizeof(header))
+		return false;
+	std::memcpy(&header, file.Data(), sizeof(header));
+
+	return std::memcmp(header.magic, VIRTUAL_PAGES_MAGIC, sizeof(VIRTUAL_PAGES_MAGIC)) == 0
+		&& header.version == VT_PAGES_VERSION
+		&& header.pageSize == VT_PAGE_SIZE && header.border == VT_PAGE_BORDER
+		&& header.gamma == (uint32_t) gamma && header.filter == (uint32_t) filter
+		&& GetFileStamp(source) == FileStamp{ header.sourceTime, header.sourceSize }
+		&& header.width > 0 && header.height > 0
+		&& header.levels == (uint32_t) pageLevels((int) header.width, (int) header.height)
+		&& file.Size() == pageFileSize((int) header.width, (int) header.height, (int) header.levels);
+}
+
+std::string VirtualPagesPath(const std::string & source, bool gamma, MipFilter filter) {
+	return source + (gamma ? ".srgb" : ".linear") + (filter == MIP_KAISER ? ".kaiser" : ".box") + ".vtpages";
+}
+
+
+
+
+
+/*************************************************
+*
+* Page files
+*
+*************************************************/
+
+static int wrap(int texel, int size) {
+	texel %= size;
+	return texel < 0 ? texel + size : texel;
+}
+
+/** One slot: the page and its border, wrapping around the level like GL_REPEAT */
+static void cutPage(const unsigned char * level, int width, int height, int px, int py, unsigned char * slot) {
+	for (int sy=0; sy<VT_SLOT_SIZE; sy++) {
+		const unsigned char * row = level + (size_t) wrap(py * VT_PAGE_SIZE - VT_PAGE_BORDER + sy, height) * width * 4;
+		unsigned char * out = slot + (size_t) sy * VT_SLOT_SIZE * 4;
+		for (int sx=0; sx<VT_SLOT_SIZE; sx++)
+			std::memcpy(out + sx * 4, row + (size_t) wrap(px * VT_PAGE_SIZE - VT_PAGE_BORDER + sx, width) * 4, 4);
+	}
+}
+
+bool BuildVirtualPages(const std::string & source, bool gamma, TextureType type) {
+
+	MipFilter filter = MipFilterFor(type);
+	std::string pages = VirtualPagesPath(source, gamma, filter);
+
+	{
+		VirtualPagesHeader header;
+		MappedFile file(pages);
+		if (readHeader(file, source, gamma, filter, header))
+			return true;
+	}
+
+	ImageData image{};
+	if (!DecodeImage(source, image)) {
+		std::cerr << "BuildVirtualPages: Texture failed to load at path: " << source << "\n";
+		return false;
+	}
+	if (pageCount(image.width, 0) > VT_MAX_PAGES || pageCount(image.height, 0) > VT_MAX_PAGES) {
+		std::cerr << "BuildVirtualPages: " << source << " is larger than " << VT_MAX_PAGES << " pages\n";
+		return false;
+	}
+
+	std::vector<std::vector<unsigned char> > levels;
+	{
+		std::vector<unsigned char> rgba;
+		ExpandToRGBA(image.pixels.get(), image.width, image.height, image.channels, rgba);
+		image.pixels.reset();
+		GenerateMipChain(rgba.data(), image.width, image.height, gamma, filter, levels);
+	}
+
+	// Types sharing a filter share the file, Model bakes them in parallel: each writer has its own temp file
+	std::string temp = UniqueTempPath(pages);
+	std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+	if (!out.is_open()) {
+		std::cerr << "BuildVirtualPages: unable to write " << temp << "\n";
+		return false;
+	}
+
+	VirtualPagesHeader header;
+	std::memcpy(header.magic, VIRTUAL_PAGES_MAGIC, sizeof(VIRTUAL_PAGES_MAGIC));
+	header.version  = VT_PAGES_VERSION;
+	header.width    = (uint32_t) image.width;
+	header.height   = (uint32_t) image.height;
+	header.levels   = (uint32_t) pageLevels(image.width, image.height);
+	header.pageSize = VT_PAGE_SIZE;
+	header.border   = VT_PAGE_BORDER;
+	header.gamma    = (uint32_t) gamma;
+	header.filter   = (uint32_t) filter;
+	FileStamp stamp = GetFileStamp(source);
+	header.sourceTime = stamp.time;
+	header.sourceSize = stamp.size;
+	out.write((const char *) &header, sizeof(header));
+
+	// Level by level, rows of pages: the offset of a page follows from its coordinates
+	std::vector<unsigned char> slot(VT_SLOT_BYTES);
+	for (int level=0; level<(int) header.levels; level++) {
+		int width = levelExtent(image.width, level), height = levelExtent(image.height, level);
+		for (int y=0; y<pageCount(image.height, level); y++) {
+			for (int x=0; x<pageCount(image.width, level); x++) {
+				cutPage(levels[level].data(), width, height, x, y, slot.data());
+				out.write((const char *) slot.data(), slot.size());
+			}
+		}
+	}
+
+	out.close();
+	if (!out) {
+		std::remove(temp.c_str());
+		return false;
+	}
+
+	std::remove(pages.c_str());
+	if (std::rename(temp.c_str(), pages.c_str()) != 0) {
+		std::remove(temp.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+int LoadVirtualTexture(const std::string & textureFile, TextureType type) {
+	return VirtualTextureCache::Shared().Load(textureFile, type);
+}
+
+
+
+
+
+/*************************************************
+*
+* Page cache
+*
+*************************************************/
+
+VirtualTextureCache & VirtualTextureCache :: Shared() {
+	static VirtualTextureCache cache;
+	return cache;
+}
+
+VirtualTextureCache :: VirtualTextureCache()
+	: mGamma(false), mPoolPages(0), mPool(0), mFrame(0),
+	mFeedbackFbo(0), mFeedbackColor(0), mFeedbackDepth(0), mFeedbackWidth(0), mFeedbackHeight(0),
+	mNextReadback(0), mSavedFramebuffer(0)
+{
+	mSavedViewport[0] = mSavedViewport[1] = mSavedViewport[2] = mSavedViewport[3] = 0;
+}
+
+bool VirtualTextureCache :: Init(int poolPages, bool gamma) {
+
+	if (mPool) {
+		if (gamma != mGamma)
+			std::cerr << "VirtualTextureCache::Init: already set up with gamma " << mGamma << "\n";
+		return true;
+	}
+
+	// Slot coordinates are 8-bit in the page tables
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	poolPages = std::min(poolPages, std::min((int) maxSize / VT_SLOT_SIZE, 256));
+	if (poolPages < 1) {
+		std::cerr << "VirtualTextureCache::Init: no room for a page pool\n";
+		return false;
+	}
+
+	int side = poolPages * VT_SLOT_SIZE;
+	glGenTextures(1, &mPool);
+	GLState::Shared().BindTexture(GL_TEXTURE_2D, mPool);
+	glTexImage2D(GL_TEXTURE_2D, 0, gamma ? GL_SRGB8_ALPHA8 : GL_RGBA8, side, side, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	mGamma = gamma;
+	mPoolPages = poolPages;
+	mSlots.assign((size_t) poolPages * poolPages, Slot{0, 0, false});
+
+	std::cout << "VirtualTextureCache::Init: " << mSlots.size() << " pages, "
+		<< (size_t) side * side * 4 / (1024 * 1024) << " MB\n";
+	return true;
+}
+
+int VirtualTextureCache :: Load(const std::string & path, TextureType type) {
+
+	if (!mPool && !Init())
+		return 0;
+
+	std::string name = path + "|" + std::to_string((int) type);
+	auto found = mIds.find(name);
+	if (found != mIds.end())
+		return found->second;
+
+	if (mImages.size() >= VT_MAX_TEXTURES) {
+		std::cerr << "VirtualTextureCache::Load: more than " << VT_MAX_TEXTURES << " textures: " << path << "\n";
+		return 0;
+	}
+
+	if (!BuildVirtualPages(path, mGamma, type))
+		return 0;
+
+	std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>(VirtualPagesPath(path, mGamma, MipFilterFor(type)));
+	VirtualPagesHeader header;
+	if (!readHeader(*file, path, mGamma, MipFilterFor(type), header)) {
+		std::cerr << "VirtualTextureCache::Load: invalid page file for " << path << "\n";
+		return 0;
+	}
+
+	Image image;
+	image.path   = path;
+	image.type   = type;
+	image.width  = (int) header.width;
+	image.height = (int) header.height;
+	image.levels = (int) header.levels;
+	image.file   = file;
+	image.dirty  = true;
+
+	image.tableSize = 1;
+	while (image.tableSize < std::max(pageCount(image.width, 0), pageCount(image.height, 0)))
+		image.tableSize *= 2;
+
+	size_t offset = sizeof(VirtualPagesHeader);
+	for (int level=0; level<image.levels; level++) {
+		image.levelOffsets.push_back(offset);
+		offset += (size_t) pageCount(image.width, level) * pageCount(image.height, level) * VT_SLOT_BYTES;
+		int side = std::max(1, image.tableSize >> level);
+		image.entries.push_back(std::vector<unsigned char>((size_t) side * side * 4, 0));
+	}
+
+	// Integer texels are fetched, never filtered
+	glGenTextures(1, &image.table);
+	GLState::Shared().BindTexture(GL_TEXTURE_2D, image.table);
+	for (int level=0; level<image.levels; level++) {
+		int side = std::max(1, image.tableSize >> level);
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8UI, side, side, 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, NULL);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image.levels - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	mImages.push_back(image);
+	int id = (int) mImages.size();
+
+	// Coarsest page stays resident: every lookup falls back to it
+	int coarsest = image.levels - 1;
+	if (!upload(pageKey(id, coarsest, 0, 0), file->Data() + image.levelOffsets[coarsest], true)) {
+		std::cerr << "VirtualTextureCache::Load: page pool full, " << path << " not loaded\n";
+		GLState::Shared().DeleteTextures(1, &mImages.back().table);
+		mImages.pop_back();
+		return 0;
+	}
+	rebuildTable(mImages.back());
+
+	mIds[name] = id;
+	return id;
+}
+
+glm::vec4 VirtualTextureCache :: Params(int id) const {
+	if (id < 1 || id > (int) mImages.size())
+		return glm::vec4(0.0f);
+	const Image & image = mImages[id - 1];
+	return glm::vec4((float) id, (float) image.width, (float) image.height, (float) image.levels);
+}
+
+void VirtualTextureCache :: BindTable(int id, unsigned int unit) const {
+	GLState::Shared().ActiveTexture(GL_TEXTURE0 + unit);
+	GLState::Shared().BindTexture(GL_TEXTURE_2D, id >= 1 && id <= (int) mImages.size() ? mImages[id - 1].table : 0);
+}
+
+void VirtualTextureCache :: Bind(Shader & shader) const {
+	GLState::Shared().ActiveTexture(GL_TEXTURE0 + VT_POOL_UNIT);
+	GLState::Shared().BindTexture(GL_TEXTURE_2D, mPool);
+	GLState::Shared().ActiveTexture(GL_TEXTURE0);
+	shader.setUniform("uVirtualPool", VT_POOL_UNIT);
+}
+
+int VirtualTextureCache :: allocateSlot() {
+
+	// Free slot, else the least recently used page nobody asked for this frame
+	int victim = -1;
+	for (size_t i=0; i<mSlots.size(); i++) {
+		const Slot & slot = mSlots[i];
+		if (slot.key == 0)
+			return (int) i;
+		if (slot.pinned || slot.used == mFrame)
+			continue;
+		if (victim < 0 || slot.used < mSlots[victim].used)
+			victim = (int) i;
+	}
+
+	if (victim >= 0) {
+		uint32_t key = mSlots[victim].key;
+		mResident.erase(key);
+		mImages[keyId(key) - 1].dirty = true;
+		mSlots[victim].key = 0;
+	}
+	return victim;
+}
+
+bool VirtualTextureCache :: upload(uint32_t key, const unsigned char * texels, bool pinned) {
+
+	int slot = allocateSlot();
+	if (slot < 0)
+		return false;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	GLState::Shared().BindTexture(GL_TEXTURE_2D, mPool);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, (slot % mPoolPages) * VT_SLOT_SIZE, (slot / mPoolPages) * VT_SLOT_SIZE,
+		VT_SLOT_SIZE, VT_SLOT_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+
+	mSlots[slot] = Slot{key, mFrame, pinned};
+	mResident[key] = slot;
+	mImages[keyId(key) - 1].dirty = true;
+	return true;
+}
+
+void VirtualTextureCache :: rebuildTable(Image & image) {
+
+	/**
+	* Coarsest level first, so a page that is not resident copies the entry of
+	* its parent: (slot x, slot y, level of the page in the slot, valid)
+	*/
+
+	int id = (int) (&image - mImages.data()) + 1;
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	GLState::Shared().BindTexture(GL_TEXTURE_2D, image.table);
+
+	for (int level=image.levels-1; level>=0; level--) {
+
+		int side = std::max(1, image.tableSize >> level);
+		int parentSide = std::max(1, image.tableSize >> (level + 1));
+		std::vector<unsigned char> & entries = image.entries[level];
+
+		for (int y=0; y<pageCount(image.height, level); y++) {
+			for (int x=0; x<pageCount(image.width, level); x++) {
+
+				unsigned char * entry = &entries[((size_t) y * side + x) * 4];
+				auto resident = mResident.find(pageKey(id, level, x, y));
+
+				if (resident != mResident.end()) {
+					entry[0] = (unsigned char) (resident->second % mPoolPages);
+					entry[1] = (unsigned char) (resident->second / mPoolPages);
+					entry[2] = (unsigned char) level;
+					entry[3] = 1;
+				} else if (level + 1 < image.levels) {
+					const std::vector<unsigned char> & parents = image.entries[level + 1];
+					std::memcpy(entry, &parents[((size_t) (y >> 1) * parentSide + (x >> 1)) * 4], 4);
+				} else {
+					std::memset(entry, 0, 4);
+				}
+			}
+		}
+
+		glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, side, side, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, entries.data());
+	}
+
+	image.dirty = false;
+}
+
+
+
+
+
+/*************************************************
+*
+* Feedback
+*
+*************************************************/
+
+bool VirtualTextureCache :: setupFeedback(int width, int height) {
+
+	width  = std::max(1, width / VT_FEEDBACK_SCALE);
+	height = std::max(1, height / VT_FEEDBACK_SCALE);
+	if (mFeedbackFbo && width == mFeedbackWidth && height == mFeedbackHeight)
+		return true;
+
+	deleteFeedback();
+
+	glGenTextures(1, &mFeedbackColor);
+	GLState::Shared().BindTexture(GL_TEXTURE_2D, mFeedbackColor);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8UI, width, height, 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glGenRenderbuffers(1, &mFeedbackDepth);
+	glBindRenderbuffer(GL_RENDERBUFFER, mFeedbackDepth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+	glGenFramebuffers(1, &mFeedbackFbo);
+	GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, mFeedbackFbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mFeedbackColor, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mFeedbackDepth);
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, (GLuint) mSavedFramebuffer);
+
+	if (!complete) {
+		std::cerr << "VirtualTextureCache::setupFeedback: Framebuffer is not complete!\n";
+		deleteFeedback();
+		return false;
+	}
+
+	// Readbacks land in pixel buffers, mapped once their fence has passed
+	mReadbacks.resize(VT_FEEDBACK_FRAMES);
+	for (Readback & readback : mReadbacks) {
+		glGenBuffers(1, &readback.buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr) width * height * 4, NULL, GL_STREAM_READ);
+		readback.fence  = 0;
+		readback.width  = width;
+		readback.height = height;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	mNextReadback = 0;
+
+	mFeedbackWidth  = width;
+	mFeedbackHeight = height;
+	return true;
+}
+
+void VirtualTextureCache :: deleteFeedback() {
+	for (Readback & readback : mReadbacks) {
+		if (readback.fence)
+			glDeleteSync(readback.fence);
+		glDeleteBuffers(1, &readback.buffer);
+	}
+	mReadbacks.clear();
+	if (mFeedbackFbo) {
+		GLState::Shared().DeleteFramebuffers(1, &mFeedbackFbo);
+		glDeleteRenderbuffers(1, &mFeedbackDepth);
+		GLState::Shared().DeleteTextures(1, &mFeedbackColor);
+	}
+	mFeedbackFbo = mFeedbackDepth = mFeedbackColor = 0;
+	mFeedbackWidth = mFeedbackHeight = 0;
+}
+
+bool VirtualTextureCache :: BeginFeedback(Shader & shader, int width, int height) {
+
+	glGetIntegerv(GL_VIEWPORT, mSavedViewport);
+	mSavedFramebuffer = (GLint) GLState::Shared().Framebuffer();
+
+	if (!setupFeedback(width, height))
+		return false;
+
+	GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, mFeedbackFbo);
+	glViewport(0, 0, mFeedbackWidth, mFeedbackHeight);
+	const GLuint none[4] = { 0, 0, 0, 0 };
+	glClearBufferuiv(GL_COLOR, 0, none);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	// Derivatives are VT_FEEDBACK_SCALE times larger than at full resolution
+	shader.use();
+	shader.setUniform("uVirtualFeedbackBias", -std::log2((float) VT_FEEDBACK_SCALE));
+	shader.setUniform("uVirtualFrame", (int) mFrame);
+	return true;
+}
+
+void VirtualTextureCache :: EndFeedback() {
+
+	if (mFeedbackFbo) {
+		// GPU still holding every buffer: skip this frame rather than stall
+		Readback & readback = mReadbacks[mNextReadback];
+		if (!readback.fence) {
+			glReadBuffer(GL_COLOR_ATTACHMENT0);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+			glReadPixels(0, 0, readback.width, readback.height, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, 0);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			mNextReadback = (mNextReadback + 1) % mReadbacks.size();
+		}
+	}
+
+	GLState::Shared().BindFramebuffer(GL_FRAMEBUFFER, (GLuint) mSavedFramebuffer);
+	glViewport(mSavedViewport[0], mSavedViewport[1], mSavedViewport[2], mSavedViewport[3]);
+}
+
+void VirtualTextureCache :: consumeFeedback(const unsigned char * pixels, size_t count) {
+
+	// (page x, page y, level, id) per pixel, id 0 where nothing virtual was drawn
+	std::vector<uint32_t> keys;
+	keys.reserve(count / 4);
+	for (size_t i=0; i<count; i++) {
+		const unsigned char * pixel = pixels + i * 4;
+		if (pixel[3] != 0)
+			keys.push_back(pageKey(pixel[3], pixel[2], pixel[0], pixel[1]));
+	}
+
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+	request(keys);
+}
+
+void VirtualTextureCache :: request(std::vector<uint32_t> & keys) {
+
+	// Drop what the shader cannot have meant, then add the ancestors of every page
+	size_t requested = keys.size();
+	size_t valid = 0;
+	for (size_t i=0; i<requested; i++) {
+		uint32_t key = keys[i];
+		int id = keyId(key), level = keyLevel(key);
+		if (id < 1 || id > (int) mImages.size())
+			continue;
+		const Image & image = mImages[id - 1];
+		if (level >= image.levels || keyX(key) >= pageCount(image.width, level) || keyY(key) >= pageCount(image.height, level))
+			continue;
+		keys[valid++] = key;
+	}
+	keys.resize(valid);
+	for (size_t i=0; i<valid; i++) {
+		uint32_t key = keys[i];
+		const Image & image = mImages[keyId(key) - 1];
+		for (int level=keyLevel(key)+1, x=keyX(key)>>1, y=keyY(key)>>1; level<image.levels; level++, x>>=1, y>>=1)
+			keys.push_back(pageKey(keyId(key), level, x, y));
+	}
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+	std::vector<uint32_t> missing;
+	for (uint32_t key : keys) {
+		auto resident = mResident.find(key);
+		if (resident != mResident.end())
+			mSlots[resident->second].used = mFrame;
+		else if (mLoading.find(key) == mLoading.end())
+			missing.push_back(key);
+	}
+
+	// Coarse pages first: they cover the most screen and make the finer ones useful
+	std::stable_sort(missing.begin(), missing.end(), [](uint32_t a, uint32_t b) {
+		return keyLevel(a) > keyLevel(b);
+	});
+
+	// Never read more than the pool can take without evicting pages in use
+	size_t room = 0;
+	for (const Slot & slot : mSlots)
+		if (slot.key == 0 || (!slot.pinned && slot.used != mFrame))
+			room++;
+	room = room > mLoads.size() ? room - mLoads.size() : 0;
+	size_t slots = VT_MAX_REQUESTS > mLoads.size() ? VT_MAX_REQUESTS - mLoads.size() : 0;
+	size_t submit = std::min(missing.size(), std::min(room, slots));
+
+	for (size_t i=0; i<submit; i++) {
+		uint32_t key = missing[i];
+		const Image & image = mImages[keyId(key) - 1];
+		int level = keyLevel(key);
+		size_t offset = image.levelOffsets[level]
+			+ ((size_t) keyY(key) * pageCount(image.width, level) + keyX(key)) * VT_SLOT_BYTES;
+
+		// The copy faults the page in from disk off the GL thread
+		std::shared_ptr<MappedFile> file = image.file;
+		PageLoad load;
+		load.key = key;
+		load.texels = ThreadPool::Shared().Submit([file, offset]() {
+			const unsigned char * page = file->Data() + offset;
+			return std::vector<unsigned char>(page, page + VT_SLOT_BYTES);
+		});
+		mLoads.push_back(std::move(load));
+		mLoading.insert(key);
+	}
+}
+
+unsigned int VirtualTextureCache :: Update(double budgetMs) {
+
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	mFrame++;
+
+	// Readbacks whose fence has passed, oldest first
+	for (size_t n=0; n<mReadbacks.size(); n++) {
+		Readback & readback = mReadbacks[(mNextReadback + n) % mReadbacks.size()];
+		if (!readback.fence)
+			continue;
+		GLenum status = glClientWaitSync(readback.fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			continue;
+		glDeleteSync(readback.fence);
+		readback.fence = 0;
+
+		size_t count = (size_t) readback.width * readback.height;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+		const unsigned char * pixels = (const unsigned char *) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+			(GLsizeiptr) count * 4, GL_MAP_READ_BIT);
+		if (pixels)
+			consumeFeedback(pixels, count);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+
+	// Pages read since the last update
+	unsigned int uploaded = 0;
+	for (size_t i=0; i<mLoads.size(); ) {
+
+		if (mLoads[i].texels.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			i++;
+			continue;
+		}
+
+		uint32_t key = mLoads[i].key;
+		std::vector<unsigned char> texels = mLoads[i].texels.get();
+		mLoads.erase(mLoads.begin() + i);
+		mLoading.erase(key);
+
+		if (mResident.find(key) == mResident.end() && upload(key, texels.data(), false))
+			uploaded++;
+
+		double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		if (elapsed >= budgetMs)
+			break;
+	}
+
+	for (Image & image : mImages)
+		if (image.dirty)
+			rebuildTable(image);
+
+	return uploaded;
+}
+
+void VirtualTextureCache :: Delete() {
+
+	// Reads in flight use the mappings
+	for (PageLoad & load : mLoads)
+		load.texels.wait();
+	mLoads.clear();
+	mLoading.clear();
+
+	deleteFeedback();
+
+	for (Image & image : mImages)
+		GLState::Shared().DeleteTextures(1, &image.table);
+	mImages.clear();
+	mIds.clear();
+
+	if (mPool)
+		GLState::Shared().DeleteTextures(1, &mPool);
+	mPool = 0;
+	mPoolPages = 0;
+	mSlots.clear();
+	mResident.clear();
+}
@@ -0,0 +1,183 @@
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <future>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <Texture.h>
+#include <MappedFile.h>
+#include <ShaderProgram.h>
+
+/**
+* Virtual texturing: texture memory bounded by a fixed page pool.
+*
+* Each source image is baked once, with its whole mip chain, into
+* "<source>.<srgb|linear>.<filter>.vtpages" (one per mip chain an image is used
+* with): VT_PAGE_SIZE² pages with a VT_PAGE_BORDER texel border
+* (bilinear filtering never reads across pages). At run time a single physical
+* texture of VT_SLOT_SIZE² slots holds the pages in use by every virtual
+* texture, and each virtual texture has a page table (GL_RGBA8UI, one mip per
+* page level) giving the slot of a page, or of its nearest resident ancestor.
+*
+* A feedback pass renders the scene at 1/VT_FEEDBACK_SCALE resolution with
+* shaders/virtual_feedback.frag, writing the page and level every pixel needs.
+* It is read back through a ring of pixel buffers a few frames later, missing
+* pages are read from the page files on the worker pool and uploaded by
+* Update(), least recently used pages make room. The coarsest page of each
+* texture is pinned, so there is always something to sample.
+*
+* Per frame, GL thread:
+*   if (cache.BeginFeedback(feedbackShader, width, height)) {
+*       ... draw the scene with feedbackShader ...
+*       cache.EndFeedback();
+*   }
+*   cache.Update(2.0);
+*   ... draw the scene with a virtual shader (shaders/demo_virtual.frag) ...
+*/
+
+#define VT_PAGE_SIZE       128 // texels per page side
+#define VT_PAGE_BORDER     4   // texels copied from the neighbours on each side
+#define VT_SLOT_SIZE       (VT_PAGE_SIZE + 2 * VT_PAGE_BORDER)
+#define VT_POOL_PAGES      24  // default slots per side of the physical texture (576 pages, 42 MB RGBA8)
+#define VT_MAX_TEXTURES    255 // ids and page coordinates are 8-bit in the feedback and page tables
+#define VT_MAX_PAGES       256 // pages per side at level 0
+#define VT_FEEDBACK_SCALE  8   // feedback buffer is the viewport divided by this
+#define VT_FEEDBACK_FRAMES 3   // readbacks in flight
+#define VT_MAX_REQUESTS    64  // page reads in flight
+#define VT_POOL_UNIT       15  // texture unit of the physical texture, last of the GL 3.3 minimum
+
+#define VT_PAGES_VERSION 2
+
+std::string VirtualPagesPath(const std::string & source, bool gamma, MipFilter filter);
+
+/** Bake the page file unless one recording the source's current size and modification time exists. Any thread */
+bool BuildVirtualPages(const std::string & source, bool gamma = false, TextureType type = TEX_UNKNOWN);
+
+/** Virtual texture id in the shared cache (see VirtualTextureCache::Load), 0 on failure */
+int LoadVirtualTexture(const std::string & textureFile, TextureType type = TEX_UNKNOWN);
+
+class VirtualTextureCache {
+
+public:
+	VirtualTextureCache();
+
+	/**
+	* Creates the physical texture, poolPages² slots (clamped to GL_MAX_TEXTURE_SIZE).
+	* gamma stores the pages as sRGB. Done once, later calls only report. GL thread
+	*/
+	bool Init(int poolPages = VT_POOL_PAGES, bool gamma = false);
+
+	/**
+	* Registers an image (baking its page file if needed) and makes its coarsest
+	* page resident. Loading the same path and type again returns the same id.
+	* Returns 1..VT_MAX_TEXTURES, 0 on failure. GL thread
+	*/
+	int Load(const std::string & path, TextureType type = TEX_UNKNOWN);
+
+	/** Shader parameters of a virtual texture: (id, width, height, levels), zero for an unknown id */
+	glm::vec4 Params(int id) const;
+
+	/** Page table of id on texture unit */
+	void BindTable(int id, unsigned int unit) const;
+	/** Physical texture on VT_POOL_UNIT, sampler "uVirtualPool" */
+	void Bind(Shader & shader) const;
+
+	/**
+	* Redirects drawing to the feedback buffer of a width x height viewport.
+	* Returns false, with nothing redirected, when that buffer cannot be created:
+	* skip the feedback draw and EndFeedback() then
+	*/
+	bool BeginFeedback(Shader & shader, int width, int height);
+	/** Queues the readback and restores the framebuffer and viewport */
+	void EndFeedback();
+
+	/**
+	* Consumes finished readbacks, queues missing pages and uploads loaded ones
+	* until budgetMs is spent (at least one per call). Returns the pages uploaded
+	*/
+	unsigned int Update(double budgetMs = 2.0);
+
+	size_t Textures() const { return mImages.size(); }
+	size_t Resident() const { return mResident.size(); }
+	size_t Capacity() const { return mSlots.size(); }
+
+	/** Releases every GL object and forgets every texture */
+	void Delete();
+
+	static VirtualTextureCache & Shared();
+
+private:
+	struct Image {
+		std::string path;
+		TextureType type;
+		int width;
+		int height;
+		int levels;    // page levels, the last one is a single page
+		int tableSize; // page table side at level 0, a power of two
+		GLuint table;
+		std::vector<std::vector<unsigned char> > entries; // RGBA per table texel and level
+		std::vector<size_t> levelOffsets;                // page file offset of each level
+		std::shared_ptr<MappedFile> file;
+		bool dirty;
+	};
+
+	struct Slot {
+		uint32_t key;  // resident page, 0 when free
+		uint32_t used; // last frame the page was asked for
+		bool pinned;
+	};
+
+	struct PageLoad {
+		uint32_t key;
+		std::future<std::vector<unsigned char> > texels;
+	};
+
+	struct Readback {
+		GLuint buffer;
+		GLsync fence;
+		int width;
+		int height;
+	};
+
+	bool mGamma;
+	int mPoolPages;
+	GLuint mPool;
+	std::vector<Image> mImages; // id - 1
+	std::unordered_map<std::string, int> mIds;
+	std::vector<Slot> mSlots;
+	std::unordered_map<uint32_t, int> mResident; // page key -> slot
+	std::vector<PageLoad> mLoads;
+	std::unordered_set<uint32_t> mLoading;
+	uint32_t mFrame;
+
+	GLuint mFeedbackFbo;
+	GLuint mFeedbackColor;
+	GLuint mFeedbackDepth;
+	int mFeedbackWidth;
+	int mFeedbackHeight;
+	std::vector<Readback> mReadbacks;
+	size_t mNextReadback;
+	GLint mSavedViewport[4];
+	GLint mSavedFramebuffer;
+
+	bool setupFeedback(int width, int height);
+	void deleteFeedback();
+	void consumeFeedback(const unsigned char * pixels, size_t count);
+	void request(std::vector<uint32_t> & keys);
+	int allocateSlot();
+	bool upload(uint32_t key, const unsigned char * texels, bool pinned);
+	void rebuildTable(Image & image);
+
+	VirtualTextureCache(const VirtualTextureCache &) = delete;
+	VirtualTextureCache & operator=(const VirtualTextureCache &) = delete;
+};
+
+#endif
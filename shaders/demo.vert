@@ -9,8 +9,8 @@ out vec3 Normal;
 out vec2 TexCoords;
 
 uniform mat4 uModel;
-uniform mat4 uView;
-uniform mat4 uProjection;
+// Camera (uFrame block of FrameUniforms.h)
+#pragma block uFrame
 
 void main() {
 
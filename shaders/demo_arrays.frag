@@ -0,0 +1,149 @@
+#version 330 core
+
+/** Lights: the light structs and the uLights block of FrameUniforms.h */
+
+#pragma block uLights
+#define NR_POINT_LIGHTS 4
+
+/** Directional Light */
+
+vec3 CalcDirectionalLight(Directional_Light_t light, vec3 normal, vec3 viewDir,
+	vec3 diffuse, vec3 specular, vec3 emission);
+
+/** Point Light */
+
+vec3 CalcPointLight(Point_Light_t light, vec3 normal, vec3 viewDir,
+	vec3 diffuse, vec3 specular);
+
+/** Spot Light */
+
+vec3 CalcSpotLight(Spot_Light_t light, vec3 normal, vec3 viewDir,
+	vec3 diffuse, vec3 specular);
+
+/** Texture mapping: arrays shared by the whole model, one layer per material image (MODEL_TEXTURE_ARRAYS) */
+
+struct MatTexMap_t {
+	// texture diffuse
+	sampler2DArray texture_diffuse1;
+	float texture_diffuse1_layer;
+	// texture specular
+	sampler2DArray texture_specular1;
+	float texture_specular1_layer;
+	// texture normal
+	sampler2DArray texture_normal1;
+	float texture_normal1_layer;
+	// texture emission
+	sampler2DArray texture_emission1;
+	float texture_emission1_layer;
+	// To be added ...
+};
+
+/** Uniform variables */
+
+// Camera (uFrame block of FrameUniforms.h)
+#pragma block uFrame
+
+// Texture (Model Importer specified)
+uniform MatTexMap_t uMaterial;
+
+/** Stream variables */
+
+out vec4 FragColor;
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+
+void main() {
+
+	vec3 normal = normalize(Normal);
+	vec3 viewDir = normalize(uCameraPos - FragPos);
+	vec3 resultColor = vec3(0.0, 0.0, 0.0);
+
+	// Material samples, shared by every light
+	vec3 diffuse = texture(uMaterial.texture_diffuse1, vec3(TexCoords, uMaterial.texture_diffuse1_layer)).rgb;
+	vec3 specular = texture(uMaterial.texture_specular1, vec3(TexCoords, uMaterial.texture_specular1_layer)).rgb;
+	vec3 emission = texture(uMaterial.texture_emission1, vec3(TexCoords, uMaterial.texture_emission1_layer)).rgb;
+
+	// Directional lighting
+	resultColor += CalcDirectionalLight(uDirectionalLight, normal, viewDir,
+		diffuse, specular, emission);
+
+	// Spot lighting
+	resultColor += CalcSpotLight(uSpotLight, normal, viewDir,
+		diffuse, specular);
+
+	// Point lighting
+	/**
+	for (int i=0; i<NR_POINT_LIGHTS; i++) {
+		resultColor += CalcPointLight(uPointLights[i], normal, viewDir,
+			diffuse, specular);
+	}*/
+
+	// Result
+	FragColor = vec4(resultColor, 1.0);
+}
+
+vec3 CalcDirectionalLight(Directional_Light_t light, vec3 normal, vec3 viewDir,
+	vec3 diffuse, vec3 specular, vec3 emission) {
+
+	vec3 lightDir = normalize(-light.direction);
+	// ambient
+	vec3 ambientColor = light.ambient * diffuse;
+	// diffuse
+	float diffEff = max(dot(normal, lightDir), 0.0);
+	vec3 diffuseColor = diffEff * light.diffuse * diffuse;
+	// specular
+	vec3 reflectDir = reflect(-lightDir, normal);
+	float specEff = pow(max(dot(viewDir, reflectDir), 0.0), 64.0);
+	vec3 specularColor = specEff * light.specular * specular;
+	// emission
+	vec3 emissionColor = vec3(0.0);
+	if (specular.r == 0.0)
+		emissionColor = emission;
+	// result
+	return ambientColor + diffuseColor + specularColor + emissionColor;
+}
+
+vec3 CalcPointLight(Point_Light_t light, vec3 normal, vec3 viewDir,
+	vec3 diffuse, vec3 specular) {
+
+	vec3 lightDir = normalize(light.position - FragPos);
+	// Physics
+	float distance = length(light.position - FragPos);
+	float attenuation = 1.0 / (light.constant + light.linear*distance + light.quadratic*distance*distance);
+	// ambient
+	vec3 ambientColor = light.ambient * diffuse;
+	// diffuse
+	float diffEff = max(dot(normal, lightDir), 0.0);
+	vec3 diffuseColor = diffEff * light.diffuse * diffuse;
+	// specular
+	vec3 reflectDir = reflect(-lightDir, normal);
+	float specEff = pow(max(dot(viewDir, reflectDir), 0.0), 64.0);
+	vec3 specularColor = specEff * light.specular * specular;
+	// result
+	return attenuation * (ambientColor + diffuseColor + specularColor);
+}
+
+vec3 CalcSpotLight(Spot_Light_t light, vec3 normal, vec3 viewDir,
+	vec3 diffuse, vec3 specular) {
+
+	vec3 lightDir = normalize(light.position - FragPos);
+	// Physics
+	float distance = length(light.position - FragPos);
+	float attenuation = 1.0 / (light.constant + light.linear*distance + light.quadratic*distance*distance);
+	float theta = dot(lightDir, normalize(-light.direction));
+	float epsilon = light.innerCutOff - light.outerCutOff;
+	float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+	// Ambient lighting
+	vec3 ambientColor = light.ambient * diffuse;
+	// Diffuse lighting
+	float diffEff = max(dot(normal, lightDir), 0.0);
+	vec3 diffuseColor = diffEff * light.diffuse * diffuse;
+	// Specular lighting
+	vec3 reflectDir = reflect(-lightDir, normal);
+	float specEff = pow(max(dot(viewDir, reflectDir), 0.0), 64.0);
+	vec3 specularColor = specEff * light.specular * specular;
+	// Result lighting
+	return attenuation * (ambientColor + (diffuseColor + specularColor) * intensity);
+}
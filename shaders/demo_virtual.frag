@@ -0,0 +1,188 @@
+#version 330 core
+
+/** Lights: the light structs and the uLights block of FrameUniforms.h */
+
+#pragma block uLights
+#define NR_POINT_LIGHTS 4
+
+/** Directional Light */
+
+vec3 CalcDirectionalLight(Directional_Light_t light, vec3 normal, vec3 viewDir,
+	vec3 diffuse, vec3 specular, vec3 emission);
+
+/** Point Light */
+
+vec3 CalcPointLight(Point_Light_t light, vec3 normal, vec3 viewDir,
+	vec3 diffuse, vec3 specular);
+
+/** Spot Light */
+
+vec3 CalcSpotLight(Spot_Light_t light, vec3 normal, vec3 viewDir,
+	vec3 diffuse, vec3 specular);
+
+/** Texture mapping: virtual textures, pages of one shared pool (MODEL_VIRTUAL_TEXTURES) */
+
+#define VT_PAGE_SIZE   128
+#define VT_PAGE_BORDER 4
+#define VT_SLOT_SIZE   136
+
+struct MatTexMap_t {
+	// page tables, (id, width, height, levels)
+	// texture diffuse
+	usampler2D texture_diffuse1;
+	vec4 texture_diffuse1_vt;
+	// texture specular
+	usampler2D texture_specular1;
+	vec4 texture_specular1_vt;
+	// texture normal
+	usampler2D texture_normal1;
+	vec4 texture_normal1_vt;
+	// texture emission
+	usampler2D texture_emission1;
+	vec4 texture_emission1_vt;
+	// To be added ...
+};
+
+vec4 VirtualTexture(usampler2D table, vec4 params, vec2 uv);
+
+/** Uniform variables */
+
+// Camera (uFrame block of FrameUniforms.h)
+#pragma block uFrame
+
+// Texture (Model Importer specified)
+uniform MatTexMap_t uMaterial;
+uniform sampler2D uVirtualPool;
+
+/** Stream variables */
+
+out vec4 FragColor;
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+
+void main() {
+
+	vec3 normal = normalize(Normal);
+	vec3 viewDir = normalize(uCameraPos - FragPos);
+	vec3 resultColor = vec3(0.0, 0.0, 0.0);
+
+	// Material samples, shared by every light
+	vec3 diffuse = VirtualTexture(uMaterial.texture_diffuse1, uMaterial.texture_diffuse1_vt, TexCoords).rgb;
+	vec3 specular = VirtualTexture(uMaterial.texture_specular1, uMaterial.texture_specular1_vt, TexCoords).rgb;
+	vec3 emission = VirtualTexture(uMaterial.texture_emission1, uMaterial.texture_emission1_vt, TexCoords).rgb;
+
+	// Directional lighting
+	resultColor += CalcDirectionalLight(uDirectionalLight, normal, viewDir,
+		diffuse, specular, emission);
+
+	// Spot lighting
+	resultColor += CalcSpotLight(uSpotLight, normal, viewDir,
+		diffuse, specular);
+
+	// Point lighting
+	/**
+	for (int i=0; i<NR_POINT_LIGHTS; i++) {
+		resultColor += CalcPointLight(uPointLights[i], normal, viewDir,
+			diffuse, specular);
+	}*/
+
+	// Result
+	FragColor = vec4(resultColor, 1.0);
+}
+
+vec3 CalcDirectionalLight(Directional_Light_t light, vec3 normal, vec3 viewDir,
+	vec3 diffuse, vec3 specular, vec3 emission) {
+
+	vec3 lightDir = normalize(-light.direction);
+	// ambient
+	vec3 ambientColor = light.ambient * diffuse;
+	// diffuse
+	float diffEff = max(dot(normal, lightDir), 0.0);
+	vec3 diffuseColor = diffEff * light.diffuse * diffuse;
+	// specular
+	vec3 reflectDir = reflect(-lightDir, normal);
+	float specEff = pow(max(dot(viewDir, reflectDir), 0.0), 64.0);
+	vec3 specularColor = specEff * light.specular * specular;
+	// emission
+	vec3 emissionColor = vec3(0.0);
+	if (specular.r == 0.0)
+		emissionColor = emission;
+	// result
+	return ambientColor + diffuseColor + specularColor + emissionColor;
+}
+
+vec3 CalcPointLight(Point_Light_t light, vec3 normal, vec3 viewDir,
+	vec3 diffuse, vec3 specular) {
+
+	vec3 lightDir = normalize(light.position - FragPos);
+	// Physics
+	float distance = length(light.position - FragPos);
+	float attenuation = 1.0 / (light.constant + light.linear*distance + light.quadratic*distance*distance);
+	// ambient
+	vec3 ambientColor = light.ambient * diffuse;
+	// diffuse
+	float diffEff = max(dot(normal, lightDir), 0.0);
+	vec3 diffuseColor = diffEff * light.diffuse * diffuse;
+	// specular
+	vec3 reflectDir = reflect(-lightDir, normal);
+	float specEff = pow(max(dot(viewDir, reflectDir), 0.0), 64.0);
+	vec3 specularColor = specEff * light.specular * specular;
+	// result
+	return attenuation * (ambientColor + diffuseColor + specularColor);
+}
+
+vec3 CalcSpotLight(Spot_Light_t light, vec3 normal, vec3 viewDir,
+	vec3 diffuse, vec3 specular) {
+
+	vec3 lightDir = normalize(light.position - FragPos);
+	// Physics
+	float distance = length(light.position - FragPos);
+	float attenuation = 1.0 / (light.constant + light.linear*distance + light.quadratic*distance*distance);
+	float theta = dot(lightDir, normalize(-light.direction));
+	float epsilon = light.innerCutOff - light.outerCutOff;
+	float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+	// Ambient lighting
+	vec3 ambientColor = light.ambient * diffuse;
+	// Diffuse lighting
+	float diffEff = max(dot(normal, lightDir), 0.0);
+	vec3 diffuseColor = diffEff * light.diffuse * diffuse;
+	// Specular lighting
+	vec3 reflectDir = reflect(-lightDir, normal);
+	float specEff = pow(max(dot(viewDir, reflectDir), 0.0), 64.0);
+	vec3 specularColor = specEff * light.specular * specular;
+	// Result lighting
+	return attenuation * (ambientColor + (diffuseColor + specularColor) * intensity);
+}
+
+vec4 VirtualTexture(usampler2D table, vec4 params, vec2 uv) {
+
+	ivec2 size = ivec2(params.yz);
+	int levels = int(params.w);
+	if (levels == 0)
+		return vec4(0.0);
+
+	// Level as the hardware would pick it, from the unwrapped coordinates
+	vec2 dx = dFdx(uv) * vec2(size);
+	vec2 dy = dFdy(uv) * vec2(size);
+	float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8));
+	int level = clamp(int(floor(lod)), 0, levels - 1);
+
+	// Page table entry: (slot x, slot y, level of the page in the slot, valid)
+	vec2 wrapped = fract(uv);
+	ivec2 page = ivec2(wrapped * vec2(max(size >> level, ivec2(1)))) / VT_PAGE_SIZE;
+	page = min(page, textureSize(table, level) - 1);
+	uvec4 entry = texelFetch(table, page, level);
+	if (entry.a == 0u)
+		return vec4(0.5);
+
+	// Texel in the resident (maybe coarser) page, the border absorbs rounding between levels
+	int resident = int(entry.b);
+	ivec2 residentPage = page >> (resident - level);
+	vec2 texel = wrapped * vec2(max(size >> resident, ivec2(1))) - vec2(residentPage * VT_PAGE_SIZE);
+	texel = clamp(texel, vec2(0.5 - VT_PAGE_BORDER), vec2(VT_PAGE_SIZE + VT_PAGE_BORDER - 0.5));
+
+	vec2 pool = vec2(textureSize(uVirtualPool, 0));
+	return textureLod(uVirtualPool, (vec2(entry.rg) * VT_SLOT_SIZE + VT_PAGE_BORDER + texel) / pool, 0.0);
+}
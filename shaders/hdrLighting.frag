@@ -133,8 +133,9 @@ void main() {
 			transpose(fs_in.TBN) * viewDir, transpose(fs_in.TBN) * fs_in.Normal);
 		if (texCoords.x > 1.0 || texCoords.y > 1.0 || texCoords.x < 0.0 || texCoords.y < 0.0)
 			discard;
-		normal = texture(uMaterial.texture_normal1, texCoords).rgb;
-		normal = normalize(normal * 2.0 - 1.0);
+		// Only x/y are read so two-channel (BC5) maps work too, z follows from unit length
+		normal.xy = texture(uMaterial.texture_normal1, texCoords).rg * 2.0 - 1.0;
+		normal.z = sqrt(max(1.0 - dot(normal.xy, normal.xy), 0.0));
 		normal = normalize(fs_in.TBN * normal);
 	}
 
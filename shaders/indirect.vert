@@ -0,0 +1,30 @@
+#version 430 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in uint aInstance; // visible list of IndirectScene, stepped per instance
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+
+// Camera (uFrame block of FrameUniforms.h)
+#pragma block uFrame
+// Placements (IndirectScene.h)
+#pragma block uIndirectInstances
+
+void main() {
+
+	mat4 model = instances[aInstance].model;
+
+	gl_Position = uProjection * uView * model * vec4(aPos, 1.0f);
+
+	// Get one fragment's position in World Space
+	FragPos = vec3(model * vec4(aPos, 1.0));
+
+	// Also don't forget to transform normal vector
+	Normal = mat3(model) * aNormal;
+
+	TexCoords = aTexCoords;
+}
@@ -1,47 +1,22 @@
 #version 330 core
 
-/** Directional Light */
+/** Lights: the light structs and the uLights block of FrameUniforms.h */
 
-struct Directional_Light_t {
-	vec3 direction;
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-};
+#pragma block uLights
+#define NR_POINT_LIGHTS 4
+
+/** Directional Light */
 
 vec3 CalcDirectionalLight(Directional_Light_t light, vec3 normal, vec3 viewDir,
 	sampler2D diffuse, sampler2D specular, sampler2D emission);
 
 /** Point Light */
 
-struct  Point_Light_t {
-	vec3 position;
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-	float constant;
-	float linear;
-	float quadratic;
-};
-
 vec3 CalcPointLight(Point_Light_t light, vec3 normal, vec3 viewDir,
 	sampler2D diffuse, sampler2D specular);
 
 /** Spot Light */
 
-struct Spot_Light_t {
-	vec3 position;
-	vec3 direction;
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-	float constant;
-	float linear;
-	float quadratic;
-	float innerCutOff;
-	float outerCutOff;
-};
-
 vec3 CalcSpotLight(Spot_Light_t light, vec3 normal, vec3 viewDir,
 	sampler2D diffuse, sampler2D specular);
 
@@ -72,14 +47,8 @@ struct MatTexMap_t {
 
 /** Uniform variables */
 
-// Camera
-uniform vec3 uCameraPos;
-
-// Lighting
-#define NR_POINT_LIGHTS 4
-uniform Directional_Light_t uDirectionalLight;
-uniform Spot_Light_t uSpotLight;
-uniform Point_Light_t uPointLights[NR_POINT_LIGHTS];
+// Camera (uFrame block of FrameUniforms.h)
+#pragma block uFrame
 
 // Texture (Model Importer specified)
 uniform MatTexMap_t uMaterial;
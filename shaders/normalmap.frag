@@ -1,40 +1,9 @@
 #version 330 core
 
-/** Directional Light */
+/** Lights: the light structs and the uLights block of FrameUniforms.h */
 
-struct Directional_Light_t {
-	vec3 direction;
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-};
-
-/** Point Light */
-
-struct  Point_Light_t {
-	vec3 position;
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-	float constant;
-	float linear;
-	float quadratic;
-};
-
-/** Spot Light */
-
-struct Spot_Light_t {
-	vec3 position;
-	vec3 direction;
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-	float constant;
-	float linear;
-	float quadratic;
-	float innerCutOff;
-	float outerCutOff;
-};
+#pragma block uLights
+#define NR_POINT_LIGHTS 4
 
 /** Texture mapping */
 
@@ -90,11 +59,7 @@ vec3 CalcEmission(
 // Camera
 uniform vec3 uCameraPos;
 
-// Lighting
-uniform Directional_Light_t uDirectionalLight;
-uniform Spot_Light_t uSpotLight;
-uniform Point_Light_t uPointLight;
-uniform Point_Light_t uPointLights[4];
+// Lighting switches
 uniform bool uEnableTorch;
 uniform bool uEnableBlinn;
 uniform bool uEnableNormal;
@@ -121,8 +86,9 @@ void main() {
 	vec3 resultColor = vec3(0.0, 0.0, 0.0);
 
 	if (uEnableNormal) {
-		normal = texture(uMaterial.texture_normal1, fs_in.TexCoords).rgb;
-		normal = normalize(normal * 2.0 - 1.0);
+		// Only x/y are read so two-channel (BC5) maps work too, z follows from unit length
+		normal.xy = texture(uMaterial.texture_normal1, fs_in.TexCoords).rg * 2.0 - 1.0;
+		normal.z = sqrt(max(1.0 - dot(normal.xy, normal.xy), 0.0));
 		normal = normalize(fs_in.TBN * normal);
 	}
 
@@ -136,7 +102,7 @@ void main() {
 			uMaterial.texture_diffuse1, uMaterial.texture_specular1);
 
 	// Point lighting
-	for (int i=0; i<4; i++) {
+	for (int i=0; i<NR_POINT_LIGHTS; i++) {
 		resultColor += CalcPointLight(uPointLights[i], normal, viewDir, fs_in.FragPos, fs_in.TexCoords,
 			uMaterial.texture_diffuse1, uMaterial.texture_specular1);
 	}
@@ -3,7 +3,7 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in vec3 aTangent;
+layout (location = 3) in vec4 aTangent; // w: bitangent sign for packed vertices
 layout (location = 4) in vec3 aBitangent;
 
 out VS_OUT {
@@ -21,8 +21,10 @@ void main() {
 
 	mat3 normalMatrix = mat3(transpose(inverse(uModel)));
 
-	vec3 T = normalize(normalMatrix * aTangent);
-	vec3 B = normalize(normalMatrix * aBitangent);
+	vec3 T = normalize(normalMatrix * aTangent.xyz);
+	// Packed vertices carry no bitangent (attribute reads zero), rebuild it from the frame
+	vec3 bitangent = dot(aBitangent, aBitangent) > 0.0 ? aBitangent : cross(aNormal, aTangent.xyz) * sign(aTangent.w);
+	vec3 B = normalize(normalMatrix * bitangent);
 	vec3 N = normalize(normalMatrix * aNormal);
 
 	gl_Position = uProjection * uView * uModel * vec4(aPos, 1.0f);
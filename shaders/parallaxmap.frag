@@ -1,40 +1,9 @@
 #version 330 core
 
-/** Directional Light */
+/** Lights: the light structs and the uLights block of FrameUniforms.h */
 
-struct Directional_Light_t {
-	vec3 direction;
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-};
-
-/** Point Light */
-
-struct  Point_Light_t {
-	vec3 position;
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-	float constant;
-	float linear;
-	float quadratic;
-};
-
-/** Spot Light */
-
-struct Spot_Light_t {
-	vec3 position;
-	vec3 direction;
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-	float constant;
-	float linear;
-	float quadratic;
-	float innerCutOff;
-	float outerCutOff;
-};
+#pragma block uLights
+#define NR_POINT_LIGHTS 4
 
 /** Texture mapping */
 
@@ -94,11 +63,7 @@ vec2 ParallaxMapping(
 // Camera
 uniform vec3 uCameraPos;
 
-// Lighting
-uniform Directional_Light_t uDirectionalLight;
-uniform Spot_Light_t uSpotLight;
-uniform Point_Light_t uPointLight;
-uniform Point_Light_t uPointLights[4];
+// Lighting switches
 uniform bool uEnableTorch;
 uniform bool uEnableBlinn;
 uniform bool uEnableNormal;
@@ -133,8 +98,9 @@ void main() {
 			transpose(fs_in.TBN) * viewDir, transpose(fs_in.TBN) * fs_in.Normal);
 		if (texCoords.x > 1.0 || texCoords.y > 1.0 || texCoords.x < 0.0 || texCoords.y < 0.0)
 			discard;
-		normal = texture(uMaterial.texture_normal1, texCoords).rgb;
-		normal = normalize(normal * 2.0 - 1.0);
+		// Only x/y are read so two-channel (BC5) maps work too, z follows from unit length
+		normal.xy = texture(uMaterial.texture_normal1, texCoords).rg * 2.0 - 1.0;
+		normal.z = sqrt(max(1.0 - dot(normal.xy, normal.xy), 0.0));
 		normal = normalize(fs_in.TBN * normal);
 	}
 
@@ -148,7 +114,7 @@ void main() {
 			uMaterial.texture_diffuse1, uMaterial.texture_specular1);
 
 	// Point lighting
-	for (int i=0; i<4; i++) {
+	for (int i=0; i<NR_POINT_LIGHTS; i++) {
 		resultColor += CalcPointLight(uPointLights[i], normal, viewDir, fs_in.FragPos, texCoords,
 			uMaterial.texture_diffuse1, uMaterial.texture_specular1);
 	}
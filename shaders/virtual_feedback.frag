@@ -0,0 +1,52 @@
+#version 330 core
+
+/**
+* Virtual texture feedback (VirtualTextureCache::BeginFeedback): the page and
+* level each pixel samples, written as (page x, page y, level, id). Pixels
+* take turns between the material's textures, in a pattern shifted every frame.
+*/
+
+#define VT_PAGE_SIZE 128
+
+struct MatTexMap_t {
+	// (id, width, height, levels), zero when not virtual
+	vec4 texture_diffuse1_vt;
+	vec4 texture_specular1_vt;
+	vec4 texture_normal1_vt;
+	vec4 texture_emission1_vt;
+};
+
+uniform MatTexMap_t uMaterial;
+uniform float uVirtualFeedbackBias;
+uniform int uVirtualFrame;
+
+layout (location = 0) out uvec4 Feedback;
+
+in vec2 TexCoords;
+
+uvec4 VirtualPage(vec4 params, vec2 uv) {
+
+	ivec2 size = ivec2(params.yz);
+	int levels = int(params.w);
+
+	vec2 dx = dFdx(uv) * vec2(size);
+	vec2 dy = dFdy(uv) * vec2(size);
+	float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) + uVirtualFeedbackBias;
+	int level = clamp(int(floor(lod)), 0, levels - 1);
+
+	ivec2 page = ivec2(fract(uv) * vec2(max(size >> level, ivec2(1)))) / VT_PAGE_SIZE;
+	return uvec4(uvec2(page), uint(level), uint(params.x));
+}
+
+void main() {
+
+	vec4 params[4] = vec4[4](uMaterial.texture_diffuse1_vt, uMaterial.texture_specular1_vt,
+		uMaterial.texture_normal1_vt, uMaterial.texture_emission1_vt);
+
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	int pick = (pixel.x + pixel.y * 2 + uVirtualFrame) & 3;
+	vec4 chosen = params[pick].x > 0.0 ? params[pick] : params[0];
+
+	uvec4 page = VirtualPage(chosen, TexCoords);
+	Feedback = chosen.x > 0.0 ? page : uvec4(0u);
+}